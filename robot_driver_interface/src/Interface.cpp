@@ -125,19 +125,21 @@ Interface::Interface(QMainWindow *parent) :
 	connect(checkBox_UseTCPMarkerTransform, SIGNAL(clicked(bool)), this,
 			SLOT(useTCPMarkerTransformChanged()));
 	// Others related
-	connect(&dtController_, SIGNAL(newFeedback(Feedback* )), this,
-			SLOT(newFeedbackReceived(Feedback* )), Qt::QueuedConnection);
 	connect(&dtController_, SIGNAL(newFeedback(Feedback* )), this,
 			SLOT(displayFeedback(Feedback* )), Qt::QueuedConnection);
 	connect(&dtController_, SIGNAL(shutdown()), this, SLOT(shutdown()),
 			Qt::QueuedConnection);
 
-	connect(&dtController_, SIGNAL(visualizeMotionPlan(MotionPlan)), this,
-			SLOT(visualizeMotionPlan(MotionPlan)), Qt::QueuedConnection);
+	connect(&dtController_, SIGNAL(visualizeMotionPlan(MotionPlanPtr)), this,
+			SLOT(visualizeMotionPlan(MotionPlanPtr)), Qt::QueuedConnection);
 	connect(this, SIGNAL(addWaypointsSignal()), &dtController_,
 			SLOT(addWaypointsCb()), Qt::QueuedConnection);
 	connect(this, SIGNAL(visualizeExecutePlan()), &dtController_,
 			SLOT(visualizeExecutePlanCb()), Qt::QueuedConnection);
+	connect(this, SIGNAL(toggleServo()), &dtController_,
+			SLOT(toggleServoMode()), Qt::QueuedConnection);
+	connect(this, SIGNAL(cartesianPath()), &dtController_,
+			SLOT(cartesianPathCb()), Qt::QueuedConnection);
 	connect(this,
 			SIGNAL(endEffectorPos(const InteractiveMarkerFeedbackConstPtr&)),
 			&dtController_,
@@ -148,9 +150,17 @@ Interface::Interface(QMainWindow *parent) :
 
 	connect(&dtController_, SIGNAL(closeWindow()), this,
 			SLOT(closeDialogWindow()));
+	connect(&dtController_, SIGNAL(planFinished(PlanHandle)), this,
+			SLOT(planFinished(PlanHandle)), Qt::QueuedConnection);
+	connect(&dtSubWindowMotionPlanDecision_, SIGNAL(finished(int)), this,
+			SLOT(targetMotionDecided()));
+	connect(&dtSubWindowWaitForExecution_, SIGNAL(finished(int)), this,
+			SLOT(targetMotionExecuted()));
 	connect(this, SIGNAL(changeMotionCompleteDelayTime(double)), &dtController_,
 			SIGNAL(changeMotionCompleteDelayTime(double)),
 			Qt::QueuedConnection);
+	connect(this, SIGNAL(servoToAxis(Axis)), &dtController_,
+			SIGNAL(servoToAxisSignal(Axis)), Qt::QueuedConnection);
 
 	// pointer to node handle
 	pdtNodeHandle_ = boost::make_shared<ros::NodeHandle>("");
@@ -161,10 +171,6 @@ Interface::Interface(QMainWindow *parent) :
 			moveit_msgs::DisplayTrajectory>("/move_group/display_planned_path",
 			1, true);
 
-	// Set publisher for joint state visualization
-	dtJointStatePublisher_ = pdtNodeHandle_->advertise<sensor_msgs::JointState>(
-			"/joint_states", 1000, true);
-
 	// Set subscriber for obtaining interactive marker position
 	dtInteractiveMarkerSubsriber_ =
 			pdtNodeHandle_->subscribe<
@@ -172,9 +178,6 @@ Interface::Interface(QMainWindow *parent) :
 					"/rviz_moveit_motion_planning_display/robot_interaction_interactive_marker_topic/feedback",
 					10, &Interface::endEffectorPosCb, this);
 
-	dtPlanningSceneDiffPublisher_ = pdtNodeHandle_->advertise<
-			moveit_msgs::PlanningScene>("/planning_scene", 1);
-
 	// Set up menu marker
 	marker_pos_ = 0.0;
 	pdtInteractiveMarkerServer_.reset(
@@ -185,17 +188,6 @@ Interface::Interface(QMainWindow *parent) :
 	dtMenuHandler_.apply(*pdtInteractiveMarkerServer_, "marker1");
 	pdtInteractiveMarkerServer_->applyChanges();
 
-	// initialize joint state publish count
-	nJointStatePublishCount_ = 0;
-	// allocate memory for position variable
-	dtJointState_.position.resize(6);
-	dtJointState_.name.resize(6);
-	dtJointState_.name[0] = "joint1";
-	dtJointState_.name[1] = "joint2";
-	dtJointState_.name[2] = "joint3";
-	dtJointState_.name[3] = "joint4";
-	dtJointState_.name[4] = "joint5";
-	dtJointState_.name[5] = "joint6";
 	nJointStateDisplayCount_ = 0;
 	nJointStateCallbackCount_ = 0;
 
@@ -205,6 +197,11 @@ Interface::Interface(QMainWindow *parent) :
 	nCollisionOperationCount_ = 0;
 // NDI related
 	pdtCommandHandling_ = boost::make_shared<CommandHandling>();
+	pdtNDITracker_ = boost::make_shared<NDITracker>(pdtCommandHandling_);
+	connect(pdtNDITracker_.get(), SIGNAL(portOccupied()), this,
+			SLOT(restartTracking()), Qt::QueuedConnection);
+	memset(pdtNDIHandles_, 0, sizeof(pdtNDIHandles_));
+	ulNDISampleCount_ = 0;
 
 	nCOMPort_ = 0;
 	nTrackingMode_ = 0;
@@ -285,98 +282,155 @@ Interface::Interface(QMainWindow *parent) :
 	bTCPMarkerFlip_ = false;
 
 	dParallelMoveThreshold_ = MINIMUM_PARALLEL_MOVE_THRESHOLD;
+	pdtPendingPlanButton_ = NULL;
+	pcTargetMotionContinuation_ = NULL;
+	bTargetMotionExecuting_ = false;
+	pcParallelMoveContinuation_ = NULL;
 }
 
 Interface::~Interface() {
 	std::cout << "Interface Deconstructing..." << std::endl;
 
+	std::cout << "NDI acquisition thread ends..." << std::endl;
+	pdtNDITracker_->stopAcquisition();
 	std::cout << "Controller thread ends..." << std::endl;
 	dtControllerThread_->exit();
 }
-int Interface::PlanAndExecuteTargetMotion(geometry_msgs::Pose target_pose,
-		std::string end_effector_link) {
-
-	do {
-		if (!dtController_.planTargetMotion(target_pose, end_effector_link)) {
-			ROS_ERROR("Motion plan failed");
-			return MOTION_PLAN_FAIL;
-		}
-		moveit::planning_interface::MoveGroup::Plan motion_plan =
-				dtController_.getMotionPlan();
-		Axis axis_plan;
-		axis_plan.set(0, 0, 0, 0, 0, 0);
-
-		for (int i = 0;
-				i < motion_plan.trajectory_.joint_trajectory.points.size() - 1;
-				i++) {
-
-			axis_plan.A1 +=
-					fabs(
-							motion_plan.trajectory_.joint_trajectory.points[i
-									+ 1].positions[0]
-									- motion_plan.trajectory_.joint_trajectory.points[i].positions[0]);
-			axis_plan.A2 +=
-					fabs(
-							motion_plan.trajectory_.joint_trajectory.points[i
-									+ 1].positions[1]
-									- motion_plan.trajectory_.joint_trajectory.points[i].positions[1]);
-			axis_plan.A3 +=
-					fabs(
-							motion_plan.trajectory_.joint_trajectory.points[i
-									+ 1].positions[2]
-									- motion_plan.trajectory_.joint_trajectory.points[i].positions[2]);
-			axis_plan.A4 +=
-					fabs(
-							motion_plan.trajectory_.joint_trajectory.points[i
-									+ 1].positions[3]
-									- motion_plan.trajectory_.joint_trajectory.points[i].positions[3]);
-			axis_plan.A5 +=
-					fabs(
-							motion_plan.trajectory_.joint_trajectory.points[i
-									+ 1].positions[4]
-									- motion_plan.trajectory_.joint_trajectory.points[i].positions[4]);
-			axis_plan.A6 +=
-					fabs(
-							motion_plan.trajectory_.joint_trajectory.points[i
-									+ 1].positions[5]
-									- motion_plan.trajectory_.joint_trajectory.points[i].positions[5]);
-		}
-		axis_plan.A1 = axis_plan.A1 / M_PI * 180.0;
-		axis_plan.A2 = axis_plan.A2 / M_PI * 180.0;
-		axis_plan.A3 = axis_plan.A3 / M_PI * 180.0;
-		axis_plan.A4 = axis_plan.A4 / M_PI * 180.0;
-		axis_plan.A5 = axis_plan.A5 / M_PI * 180.0;
-		axis_plan.A6 = axis_plan.A6 / M_PI * 180.0;
-
-		// If any single axis's angle motion is larger than MAX_MOVE_ANGLE, we need to let the user know to check whether they want the motion plan or not
-		if (axis_plan.A1 > MAX_MOVE_ANGLE || axis_plan.A2 > MAX_MOVE_ANGLE
-				|| axis_plan.A3 > MAX_MOVE_ANGLE
-				|| axis_plan.A4 > MAX_MOVE_ANGLE
-				|| axis_plan.A5 > MAX_MOVE_ANGLE
-				|| axis_plan.A6 > MAX_MOVE_ANGLE) {
-
-			dtSubWindowMotionPlanDecision_.exec();
-			if (dtSubWindowMotionPlanDecision_.nReturnValue_
-					== MOTION_PLAN_EXECUTE) {
-				emit changeMotionCompleteDelayTime(180.0);
-				emit executeMotionPlan_signal();
-				return MOTION_PLAN_EXECUTE;
-
-			} else if (dtSubWindowMotionPlanDecision_.nReturnValue_
-					== MOTION_PLAN_REPLAN) {
-				continue;
-			} else {
-				return MOTION_PLAN_CANCEL;
-			}
-		} else {
-			ROS_INFO("Small motion is allowed for automatic mode");
-			emit changeMotionCompleteDelayTime(60.0);
-			emit executeMotionPlan_signal();
-			return MOTION_PLAN_EXECUTE;
+void Interface::PlanAndExecuteTargetMotion(geometry_msgs::Pose target_pose,
+		std::string end_effector_link, const char* continuation,
+		Frame* small_target) {
+	if (pcTargetMotionContinuation_ != NULL) {
+		ROS_ERROR("Another target motion is not complete yet");
+		QMetaObject::invokeMethod(this, continuation, Qt::QueuedConnection,
+				Q_ARG(int, MOTION_PLAN_CANCEL));
+		return;
+	}
+	dtTargetMotionPose_ = target_pose;
+	strTargetMotionLink_ = end_effector_link;
+	pcTargetMotionContinuation_ = continuation;
+
+	// Small corrections go directly to Plannar, without MoveIt planning
+	if (small_target != NULL) {
+		emit changeMotionCompleteDelayTime(MOTION_COMPLETE_SMALL_DELAY);
+		Axis AxisCurrent = dtController_.getFeedbackAxis();
+		Axis AxisTarget;
+		if (pdtPlannar_->solveServoToFrame(AxisCurrent, *small_target,
+				AxisTarget)) {
+			ROS_INFO("Small correction, servo to target frame");
+			emit servoToAxis(AxisTarget);
+			waitForTargetMotion();
+			return;
 		}
-
-	} while (1);
-
+	}
+	planTargetMotion();
+}
+void Interface::planTargetMotion() {
+	// Continued by targetMotionPlanned, the GUI keeps running meanwhile
+	pdtTargetMotionPlan_ = dtController_.planAsync(dtTargetMotionPose_,
+			strTargetMotionLink_, GUI_PLAN_DEADLINE);
+}
+void Interface::targetMotionPlanned(PlanHandle handle) {
+	pdtTargetMotionPlan_.reset();
+	if (handle->getStatus() != PlanRequest::Succeeded) {
+		ROS_ERROR("Motion plan %s",
+				PlanRequest::getStatusName(handle->getStatus()));
+		finishTargetMotion(MOTION_PLAN_FAIL);
+		return;
+	}
+	MotionPlanPtr motion_plan = handle->getMotionPlan();
+	dtController_.setMotionPlan(motion_plan);
+	Axis axis_plan;
+	axis_plan.set(0, 0, 0, 0, 0, 0);
+
+	for (int i = 0;
+			i < motion_plan->trajectory_.joint_trajectory.points.size() - 1;
+			i++) {
+
+		axis_plan.A1 +=
+				fabs(
+						motion_plan->trajectory_.joint_trajectory.points[i
+								+ 1].positions[0]
+								- motion_plan->trajectory_.joint_trajectory.points[i].positions[0]);
+		axis_plan.A2 +=
+				fabs(
+						motion_plan->trajectory_.joint_trajectory.points[i
+								+ 1].positions[1]
+								- motion_plan->trajectory_.joint_trajectory.points[i].positions[1]);
+		axis_plan.A3 +=
+				fabs(
+						motion_plan->trajectory_.joint_trajectory.points[i
+								+ 1].positions[2]
+								- motion_plan->trajectory_.joint_trajectory.points[i].positions[2]);
+		axis_plan.A4 +=
+				fabs(
+						motion_plan->trajectory_.joint_trajectory.points[i
+								+ 1].positions[3]
+								- motion_plan->trajectory_.joint_trajectory.points[i].positions[3]);
+		axis_plan.A5 +=
+				fabs(
+						motion_plan->trajectory_.joint_trajectory.points[i
+								+ 1].positions[4]
+								- motion_plan->trajectory_.joint_trajectory.points[i].positions[4]);
+		axis_plan.A6 +=
+				fabs(
+						motion_plan->trajectory_.joint_trajectory.points[i
+								+ 1].positions[5]
+								- motion_plan->trajectory_.joint_trajectory.points[i].positions[5]);
+	}
+	axis_plan.A1 = axis_plan.A1 / M_PI * 180.0;
+	axis_plan.A2 = axis_plan.A2 / M_PI * 180.0;
+	axis_plan.A3 = axis_plan.A3 / M_PI * 180.0;
+	axis_plan.A4 = axis_plan.A4 / M_PI * 180.0;
+	axis_plan.A5 = axis_plan.A5 / M_PI * 180.0;
+	axis_plan.A6 = axis_plan.A6 / M_PI * 180.0;
+
+	// If any single axis's angle motion is larger than MAX_MOVE_ANGLE, we need to let the user know to check whether they want the motion plan or not
+	if (axis_plan.A1 > MAX_MOVE_ANGLE || axis_plan.A2 > MAX_MOVE_ANGLE
+			|| axis_plan.A3 > MAX_MOVE_ANGLE
+			|| axis_plan.A4 > MAX_MOVE_ANGLE
+			|| axis_plan.A5 > MAX_MOVE_ANGLE
+			|| axis_plan.A6 > MAX_MOVE_ANGLE) {
+		// Continued by targetMotionDecided, closing the window cancels
+		dtSubWindowMotionPlanDecision_.nReturnValue_ = MOTION_PLAN_CANCEL;
+		dtSubWindowMotionPlanDecision_.open();
+	} else {
+		ROS_INFO("Small motion is allowed for automatic mode");
+		executeTargetMotion(60.0);
+	}
+}
+void Interface::targetMotionDecided() {
+	if (pcTargetMotionContinuation_ == NULL)
+		return;
+	if (dtSubWindowMotionPlanDecision_.nReturnValue_ == MOTION_PLAN_EXECUTE)
+		executeTargetMotion(180.0);
+	else if (dtSubWindowMotionPlanDecision_.nReturnValue_
+			== MOTION_PLAN_REPLAN)
+		planTargetMotion();
+	else
+		finishTargetMotion(MOTION_PLAN_CANCEL);
+}
+void Interface::executeTargetMotion(double delay_time) {
+	emit changeMotionCompleteDelayTime(delay_time);
+	emit executeMotionPlan_signal();
+	waitForTargetMotion();
+}
+void Interface::waitForTargetMotion() {
+	// Closed by closeDialogWindow when the motion is complete, continued by
+	// targetMotionExecuted
+	bTargetMotionExecuting_ = true;
+	dtSubWindowWaitForExecution_.open();
+}
+void Interface::targetMotionExecuted() {
+	if (!bTargetMotionExecuting_)
+		return;
+	bTargetMotionExecuting_ = false;
+	finishTargetMotion(MOTION_PLAN_EXECUTE);
+}
+void Interface::finishTargetMotion(int motion_return_value) {
+	const char* continuation = pcTargetMotionContinuation_;
+	pcTargetMotionContinuation_ = NULL;
+	QMetaObject::invokeMethod(this, continuation, Qt::QueuedConnection,
+			Q_ARG(int, motion_return_value));
 }
 void Interface::copyCurrentTCPState() {
 
@@ -434,7 +488,7 @@ void Interface::ndiFeedbackMove() {
 	int nMarker = ASCIIToHex(
 			(char*) (comboBox_Marker->currentText().toStdString().c_str()), 2);
 
-	if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.ulFlags
+	if (pdtNDIHandles_[nMarker].dtXfrms.ulFlags
 			!= TRANSFORM_VALID) {
 		ROS_ERROR("NDI failed to track Marker");
 		return;
@@ -449,13 +503,35 @@ void Interface::ndiFeedbackMove() {
 	pushButton_NDIFeedbackMove->setEnabled(false);
 	dtGetDataTimer_->stop();
 
+	Eigen::Vector3d EulerAngleVector;
+
+	EulerAngleVector.data()[0] = lineEdit_NDI_A_2->text().toDouble()
+			/ 180.0* M_PI;
+	EulerAngleVector.data()[1] = lineEdit_NDI_B_2->text().toDouble()
+			/ 180.0* M_PI;
+	EulerAngleVector.data()[2] = lineEdit_NDI_C_2->text().toDouble()
+			/ 180.0* M_PI;
+	dtFeedbackMoveRotationMatrix_ = createRotationMatrix(
+			EulerAngleVector.data()[2], EulerAngleVector.data()[1],
+			EulerAngleVector.data()[0]).rotation();
+	dtFeedbackMoveTranslationVector_ = Eigen::Vector3d(
+			lineEdit_NDI_X_2->text().toDouble(),
+			lineEdit_NDI_Y_2->text().toDouble(),
+			lineEdit_NDI_Z_2->text().toDouble());
+	nFeedbackMoveMarker_ = nMarker;
+
+	// Here we need to obtain the marker position instead of the tip position
+	checkBox_UseTCPMarkerTransform->setChecked(false);
+	bUseTCPMarkerTransform_ = false;
+
+	ndiFeedbackMoveStep();
+}
+void Interface::ndiFeedbackMoveStep() {
 	QuatTransformation dtMarker, dtDummy;
 
 	Axis AxisFeedback;
 	Frame FrameFeedback;
 
-	//Eigen::Vector3d EulerAngleVector;
-	std::vector<double> Translation(3);
 	Eigen::Vector4d Quaternion;
 	Eigen::Affine3d RotationPart;
 	Eigen::Affine3d TranslationPart;
@@ -463,42 +539,24 @@ void Interface::ndiFeedbackMove() {
 
 	Eigen::Matrix4d TCPMarkerTransform;
 	Eigen::Matrix4d NDIKUKATransform;
-	Eigen::Matrix4d TCPFlangeTransform;
 
 	Eigen::Matrix4d CurrentMarkerNDITransform;
 	Eigen::Matrix4d CurrentTCPNDITransform;
 	Eigen::Matrix4d TargetTCPNDITransform;
 	Eigen::Matrix4d CurrentTCPKUKATransform;
 	Eigen::Matrix4d TargetTCPKUKATransform;
-	Eigen::Matrix4d CurrentFlangeKUKATransform;
-	Eigen::Matrix4d TargetFlangeKUKATransform;
 
 	Eigen::Matrix4d TCPErrorNDITransform;
 	Eigen::Matrix4d TCPErrorKUKATransform;
-	Eigen::Matrix4d FlangeErrorKUKATransform;
 
-	bool Replan_flag;
 	geometry_msgs::Pose TargetPose;
 	Eigen::Vector3d EulerAngleVector;
 
 	double dPositionError, dAngleError;
-	int motion_return_value;
 
-	EulerAngleVector.data()[0] = lineEdit_NDI_A_2->text().toDouble()
-			/ 180.0* M_PI;
-	EulerAngleVector.data()[1] = lineEdit_NDI_B_2->text().toDouble()
-			/ 180.0* M_PI;
-	EulerAngleVector.data()[2] = lineEdit_NDI_C_2->text().toDouble()
-			/ 180.0* M_PI;
-	Translation[0] = lineEdit_NDI_X_2->text().toDouble();
-	Translation[1] = lineEdit_NDI_Y_2->text().toDouble();
-	Translation[2] = lineEdit_NDI_Z_2->text().toDouble();
-	RotationPart = createRotationMatrix(EulerAngleVector.data()[2],
-			EulerAngleVector.data()[1], EulerAngleVector.data()[0]);
+	RotationPart = dtFeedbackMoveRotationMatrix_;
 	TranslationPart = Eigen::Affine3d(
-			Eigen::Translation3d(
-					Eigen::Vector3d(Translation[0], Translation[1],
-							Translation[2])));
+			Eigen::Translation3d(dtFeedbackMoveTranslationVector_));
 	TargetTCPNDITransform = (TranslationPart * RotationPart).matrix();
 
 	// From ABC 2-point method and pivoting method
@@ -513,112 +571,106 @@ void Interface::ndiFeedbackMove() {
 			Eigen::Translation3d(dtNDIKUKATranslationVector_));
 	NDIKUKATransform = (TranslationPart * RotationPart).matrix();
 
-	// Here we need to obtain the marker position instead of the tip position
-	checkBox_UseTCPMarkerTransform->setChecked(false);
-	bUseTCPMarkerTransform_ = false;
-
-	do {
-
-		if (!getNDIFramesAverage(nMarker, -1, dtMarker, dtDummy, true,
-		NDI_FRAME_COUNT)) {
-			ROS_ERROR("Cannot get marker position data");
-			pushButton_NDIFeedbackMove->setEnabled(true);
-			dtGetDataTimer_->start(NDI_TIME_INTERVAL);
-			return;
-		}
-
-		// Marker to NDI Transform
-		EulerAngleVector = Quaternion2Euler(dtMarker.dtRotation.fQx,
-				dtMarker.dtRotation.fQy, dtMarker.dtRotation.fQz,
-				dtMarker.dtRotation.fQ0);
-		RotationPart = createRotationMatrix(EulerAngleVector.data()[2],
-				EulerAngleVector.data()[1], EulerAngleVector.data()[0]);
-		TranslationPart = Eigen::Affine3d(
-				Eigen::Translation3d(
-						Eigen::Vector3d(dtMarker.dtTranslation.fTx,
-								dtMarker.dtTranslation.fTy,
-								dtMarker.dtTranslation.fTz)));
-		CurrentMarkerNDITransform = (TranslationPart * RotationPart).matrix();
-
-		CurrentTCPNDITransform = CurrentMarkerNDITransform * TCPMarkerTransform;
-		TCPErrorNDITransform = TargetTCPNDITransform
-				* CurrentTCPNDITransform.inverse();
-
-		// For error calculation
-		Rotation = TargetTCPNDITransform.block(0, 0, 3, 3);
-		EulerAngleVector = Rotation.eulerAngles(2, 1, 0);
-
-		Rotation = CurrentTCPNDITransform.block(0, 0, 3, 3);
-		EulerAngleVector -= Rotation.eulerAngles(2, 1, 0);
-
-		dPositionError = sqrt(
-				TCPErrorNDITransform.coeff(0, 3)
-						* TCPErrorNDITransform.coeff(0, 3)
-						+ TCPErrorNDITransform.coeff(1, 3)
-								* TCPErrorNDITransform.coeff(1, 3)
-						+ TCPErrorNDITransform.coeff(2, 3)
-								* TCPErrorNDITransform.coeff(2, 3));
-		dAngleError = sqrt(
-				EulerAngleVector.data()[0] * EulerAngleVector.data()[0]
-						+ EulerAngleVector.data()[1]
-								* EulerAngleVector.data()[1]
-						+ EulerAngleVector.data()[2]
-								* EulerAngleVector.data()[2]) / M_PI * 180.0;
-		ROS_INFO("Position Error: %f mm, Angle Error: %f deg", dPositionError,
-				dAngleError);
-		if (dPositionError < 0.3 && dAngleError < 0.3) {
-			ROS_INFO("NDI Feedback Move succeed");
-			pushButton_NDIFeedbackMove->setEnabled(true);
-			dtGetDataTimer_->start(NDI_TIME_INTERVAL);
-			checkBox_UseTCPMarkerTransform->setChecked(true);
-			bUseTCPMarkerTransform_ = true;
-			break;
-		}
-
-		// Obtain current TCP position of KUKA robot
-		AxisFeedback = dtController_.getFeedbackAxis();
-		dtLastAxis_.set(AxisFeedback);
-		pdtPlannar_->getModel().Axis2Frame(AxisFeedback, FrameFeedback);
-		RotationPart = createRotationMatrix(FrameFeedback.C / 180.0 * M_PI,
-				FrameFeedback.B / 180.0 * M_PI, FrameFeedback.A / 180.0 * M_PI);
-		TranslationPart = Eigen::Affine3d(
-				Eigen::Translation3d(
-						Eigen::Vector3d(FrameFeedback.X, FrameFeedback.Y,
-								FrameFeedback.Z)));
-		CurrentTCPKUKATransform = (TranslationPart * RotationPart).matrix();
-
-		TCPErrorKUKATransform = NDIKUKATransform * TCPErrorNDITransform
-				* NDIKUKATransform.inverse();
-		TargetTCPKUKATransform = TCPErrorKUKATransform
-				* CurrentTCPKUKATransform;
-
-		Rotation = TargetTCPKUKATransform.block(0, 0, 3, 3);
-		EulerAngleVector = Rotation.eulerAngles(2, 1, 0);
-		Quaternion = Euler2Quaternion(EulerAngleVector.data()[2],
-				EulerAngleVector.data()[1], EulerAngleVector.data()[0]);
-		TargetPose.orientation.x = Quaternion.data()[0];
-		TargetPose.orientation.y = Quaternion.data()[1];
-		TargetPose.orientation.z = Quaternion.data()[2];
-		TargetPose.orientation.w = Quaternion.data()[3];
-		TargetPose.position.x = TargetTCPKUKATransform.coeff(0, 3) / 1000.0;
-		TargetPose.position.y = TargetTCPKUKATransform.coeff(1, 3) / 1000.0;
-		TargetPose.position.z = TargetTCPKUKATransform.coeff(2, 3) / 1000.0;
-
-		motion_return_value = PlanAndExecuteTargetMotion(TargetPose, "tip");
-
-		if (motion_return_value == MOTION_PLAN_EXECUTE) {
-
-		} else {
-			pushButton_NDIFeedbackMove->setEnabled(true);
-			dtGetDataTimer_->start(NDI_TIME_INTERVAL);
-			checkBox_UseTCPMarkerTransform->setChecked(true);
-			bUseTCPMarkerTransform_ = true;
-			return;
-		}
-		dtSubWindowWaitForExecution_.exec();
+	if (!getNDIFramesAverage(nFeedbackMoveMarker_, -1, dtMarker, dtDummy, true,
+	NDI_FRAME_COUNT)) {
+		ROS_ERROR("Cannot get marker position data");
+		finishNDIFeedbackMove();
+		return;
+	}
 
-	} while (1);
+	// Marker to NDI Transform
+	EulerAngleVector = Quaternion2Euler(dtMarker.dtRotation.fQx,
+			dtMarker.dtRotation.fQy, dtMarker.dtRotation.fQz,
+			dtMarker.dtRotation.fQ0);
+	RotationPart = createRotationMatrix(EulerAngleVector.data()[2],
+			EulerAngleVector.data()[1], EulerAngleVector.data()[0]);
+	TranslationPart = Eigen::Affine3d(
+			Eigen::Translation3d(
+					Eigen::Vector3d(dtMarker.dtTranslation.fTx,
+							dtMarker.dtTranslation.fTy,
+							dtMarker.dtTranslation.fTz)));
+	CurrentMarkerNDITransform = (TranslationPart * RotationPart).matrix();
+
+	CurrentTCPNDITransform = CurrentMarkerNDITransform * TCPMarkerTransform;
+	TCPErrorNDITransform = TargetTCPNDITransform
+			* CurrentTCPNDITransform.inverse();
+
+	// For error calculation
+	Rotation = TargetTCPNDITransform.block(0, 0, 3, 3);
+	EulerAngleVector = Rotation.eulerAngles(2, 1, 0);
+
+	Rotation = CurrentTCPNDITransform.block(0, 0, 3, 3);
+	EulerAngleVector -= Rotation.eulerAngles(2, 1, 0);
+
+	dPositionError = sqrt(
+			TCPErrorNDITransform.coeff(0, 3)
+					* TCPErrorNDITransform.coeff(0, 3)
+					+ TCPErrorNDITransform.coeff(1, 3)
+							* TCPErrorNDITransform.coeff(1, 3)
+					+ TCPErrorNDITransform.coeff(2, 3)
+							* TCPErrorNDITransform.coeff(2, 3));
+	dAngleError = sqrt(
+			EulerAngleVector.data()[0] * EulerAngleVector.data()[0]
+					+ EulerAngleVector.data()[1]
+							* EulerAngleVector.data()[1]
+					+ EulerAngleVector.data()[2]
+							* EulerAngleVector.data()[2]) / M_PI * 180.0;
+	ROS_INFO("Position Error: %f mm, Angle Error: %f deg", dPositionError,
+			dAngleError);
+	if (dPositionError < 0.3 && dAngleError < 0.3) {
+		ROS_INFO("NDI Feedback Move succeed");
+		finishNDIFeedbackMove();
+		return;
+	}
 
+	// Obtain current TCP position of KUKA robot
+	AxisFeedback = dtController_.getFeedbackAxis();
+	dtLastAxis_.set(AxisFeedback);
+	pdtPlannar_->getModel().Axis2Frame(AxisFeedback, FrameFeedback);
+	RotationPart = createRotationMatrix(FrameFeedback.C / 180.0 * M_PI,
+			FrameFeedback.B / 180.0 * M_PI, FrameFeedback.A / 180.0 * M_PI);
+	TranslationPart = Eigen::Affine3d(
+			Eigen::Translation3d(
+					Eigen::Vector3d(FrameFeedback.X, FrameFeedback.Y,
+							FrameFeedback.Z)));
+	CurrentTCPKUKATransform = (TranslationPart * RotationPart).matrix();
+
+	TCPErrorKUKATransform = NDIKUKATransform * TCPErrorNDITransform
+			* NDIKUKATransform.inverse();
+	TargetTCPKUKATransform = TCPErrorKUKATransform
+			* CurrentTCPKUKATransform;
+
+	Rotation = TargetTCPKUKATransform.block(0, 0, 3, 3);
+	EulerAngleVector = Rotation.eulerAngles(2, 1, 0);
+	Quaternion = Euler2Quaternion(EulerAngleVector.data()[2],
+			EulerAngleVector.data()[1], EulerAngleVector.data()[0]);
+	TargetPose.orientation.x = Quaternion.data()[0];
+	TargetPose.orientation.y = Quaternion.data()[1];
+	TargetPose.orientation.z = Quaternion.data()[2];
+	TargetPose.orientation.w = Quaternion.data()[3];
+	TargetPose.position.x = TargetTCPKUKATransform.coeff(0, 3) / 1000.0;
+	TargetPose.position.y = TargetTCPKUKATransform.coeff(1, 3) / 1000.0;
+	TargetPose.position.z = TargetTCPKUKATransform.coeff(2, 3) / 1000.0;
+
+	Frame TargetFrame(TargetTCPKUKATransform.coeff(0, 3),
+			TargetTCPKUKATransform.coeff(1, 3),
+			TargetTCPKUKATransform.coeff(2, 3),
+			EulerAngleVector.data()[0] / M_PI * 180.0,
+			EulerAngleVector.data()[1] / M_PI * 180.0,
+			EulerAngleVector.data()[2] / M_PI * 180.0);
+	PlanAndExecuteTargetMotion(TargetPose, "tip", "ndiFeedbackMoveExecuted",
+			&TargetFrame);
+}
+void Interface::ndiFeedbackMoveExecuted(int motion_return_value) {
+	if (motion_return_value != MOTION_PLAN_EXECUTE) {
+		finishNDIFeedbackMove();
+		return;
+	}
+	ndiFeedbackMoveStep();
+}
+void Interface::finishNDIFeedbackMove() {
+	pushButton_NDIFeedbackMove->setEnabled(true);
+	dtGetDataTimer_->start(NDI_TIME_INTERVAL);
 	checkBox_UseTCPMarkerTransform->setChecked(true);
 	bUseTCPMarkerTransform_ = true;
 }
@@ -693,40 +745,65 @@ void Interface::ABC2PointCalibrate() {
 	checkBox_UseTCPMarkerTransform->setEnabled(true);
 	bUseTCPMarkerTransform_ = true;
 
-	int nMarker = ASCIIToHex(
+	nABC2PointMarker_ = ASCIIToHex(
 			(char*) (comboBox_Marker->currentText().toStdString().c_str()), 2);
-	int nIndicator = ASCIIToHex(
+	nABC2PointIndicator_ = ASCIIToHex(
 			(char*) (comboBox_Indicator->currentText().toStdString().c_str()),
 			2);
 
 	Axis AxisFeedback;
 	Frame FrameFeedback;
-	QuatTransformation dtMarker, dtIndicator, dtDummy;
 
 	// Obtain current state of KUKA robot
 	AxisFeedback = dtController_.getFeedbackAxis();
 	dtLastAxis_.set(AxisFeedback);
 	pdtPlannar_->getModel().Axis2Frame_flange(AxisFeedback, FrameFeedback);
 	// Derive Ra and Ta of KUKA
-	Eigen::Matrix3d RotationA = createRotationMatrix(
+	dtABC2PointRotationA_ = createRotationMatrix(
 			FrameFeedback.C / 180.0 * M_PI, FrameFeedback.B / 180.0 * M_PI,
 			FrameFeedback.A / 180.0 * M_PI).rotation();
-	Eigen::Vector3d TranslationA(FrameFeedback.X,
+	dtABC2PointTranslationA_ = Eigen::Vector3d(FrameFeedback.X,
 			FrameFeedback.Y, FrameFeedback.Z);
-	bool bTracking = false;
 
 	//----------------------------------------------------------------------------------------------
 	//Move the needle point of KUKA to where the indicator pointed (positive part of tool's X axis)
-	// To check whether the NDI can track both the marker of KUKA and indicator or not
 	ROS_INFO("Please indicate a point on the x direction of the needle");
+	nABC2PointPhase_ = 1;
+	ABC2PointStep();
+
+#else
+	dtTCPFlangeRotationMatrix_.data()[0] = -0.019601;
+	dtTCPFlangeRotationMatrix_.data()[1] = -0.012737;
+	dtTCPFlangeRotationMatrix_.data()[2] = -0.999727;
+	dtTCPFlangeRotationMatrix_.data()[3] = -0.165045;
+	dtTCPFlangeRotationMatrix_.data()[4] = -0.986159;
+	dtTCPFlangeRotationMatrix_.data()[5] = 0.015800;
+	dtTCPFlangeRotationMatrix_.data()[6] = -0.986091;
+	dtTCPFlangeRotationMatrix_.data()[7] = 0.165310;
+	dtTCPFlangeRotationMatrix_.data()[8] = 0.017227;
+	finishABC2PointCalibrate();
+#endif
+}
+void Interface::ABC2PointStep() {
+	Axis AxisFeedback;
+	Frame FrameFeedback;
+	QuatTransformation dtMarker, dtIndicator;
+	bool bTracking = false;
+	// The marker is tracked too for the point on the xy plane
+	int nMarker = nABC2PointPhase_ == 1 ? -1 : nABC2PointMarker_;
+
 	do {
+		// To check whether the NDI can track both the marker of KUKA and indicator or not
 		bTracking = false;
 		do {
 			dtSubWindowWaitForIndicatorPlaced_.exec();
 			getSystemTransformData(false);
 			if (dtSubWindowWaitForIndicatorPlaced_.nReturnValue_ == INDICATOR_OK) {
-				if (pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.ulFlags
-						!= TRANSFORM_VALID) {
+				if ((nMarker >= 0
+						&& pdtNDIHandles_[nMarker].dtXfrms.ulFlags
+								!= TRANSFORM_VALID)
+						|| pdtNDIHandles_[nABC2PointIndicator_].dtXfrms.ulFlags
+								!= TRANSFORM_VALID) {
 					ROS_ERROR("NDI failed to track Marker or Point Indicator");
 					bTracking = false;
 				} else {
@@ -741,8 +818,8 @@ void Interface::ABC2PointCalibrate() {
 		}while (!bTracking);
 
 		// Derive the average NDI position of the needle point indicator
-		if (!getNDIFramesAverage(-1, nIndicator, dtDummy, dtIndicator, false,
-						NDI_FRAME_COUNT)) {
+		if (!getNDIFramesAverage(nMarker, nABC2PointIndicator_, dtMarker,
+						dtIndicator, false, NDI_FRAME_COUNT)) {
 			ROS_ERROR("Cannot get tool position data");
 			dtGetDataTimer_->start(NDI_TIME_INTERVAL);
 			pushButton_CalculateTCPFlangeRotation->setEnabled(true);
@@ -766,83 +843,46 @@ void Interface::ABC2PointCalibrate() {
 		lineEdit_KUKA_B->setText(QString::number(FrameFeedback.B));
 		lineEdit_KUKA_C->setText(QString::number(FrameFeedback.C));
 		// Let KUKA move to the position that the needle point indicator pointed
+	}while (!startNDIFeedbackParallelMove("ABC2PointMoved"));
+}
+void Interface::ABC2PointMoved(bool success) {
+	// Indicate the point again
+	if (!success) {
+		ABC2PointStep();
+		return;
+	}
 
-	}while (!ndiFeedbackParallelMove());
+	Axis AxisFeedback;
+	Frame FrameFeedback;
 
-	//----------------------------------------------------------------------------------------------
-	// Derive Tb
 	AxisFeedback = dtController_.getFeedbackAxis();
 	dtLastAxis_.set(AxisFeedback);
 	pdtPlannar_->getModel().Axis2Frame_flange(AxisFeedback, FrameFeedback);
-	Eigen::Vector3d TranslationB(FrameFeedback.X,
-			FrameFeedback.Y, FrameFeedback.Z);
-
-	//----------------------------------------------------------------------------------------------
-	//Move the needle point of KUKA to where the indicator pointed (positive part of tool's XY plane)
-	ROS_INFO("Please indicate a point on the xy plane of the needle");
-	do {
-		bTracking = false;
-		do {
-			dtSubWindowWaitForIndicatorPlaced_.exec();
-			getSystemTransformData(false);
-			if (dtSubWindowWaitForIndicatorPlaced_.nReturnValue_ == INDICATOR_OK) {
-				if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.ulFlags
-						!= TRANSFORM_VALID
-						|| pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.ulFlags
-						!= TRANSFORM_VALID) {
-					ROS_ERROR("NDI failed to track Marker or Point Indicator");
-					bTracking = false;
-				} else {
-					bTracking = true;
-				}
-			} else {
-				ROS_INFO("ABC 2-Point Calibration canceled");
-				dtGetDataTimer_->start(NDI_TIME_INTERVAL);
-				pushButton_CalculateTCPFlangeRotation->setEnabled(true);
-				return;
-			}
-		}while (!bTracking);
-
-		// Derive the NDI position of the needle point indicator
-		if (!getNDIFramesAverage(nMarker, nIndicator, dtMarker, dtIndicator,
-						false, NDI_FRAME_COUNT)) {
-			ROS_ERROR("Cannot get tool position data");
-			dtGetDataTimer_->start(NDI_TIME_INTERVAL);
-			pushButton_CalculateTCPFlangeRotation->setEnabled(true);
-			return;
-		}
-		lineEdit_NDI_X->setText(
-				QString::number(dtIndicator.dtTranslation.fTx));
-		lineEdit_NDI_Y->setText(
-				QString::number(dtIndicator.dtTranslation.fTy));
-		lineEdit_NDI_Z->setText(
-				QString::number(dtIndicator.dtTranslation.fTz));
 
-		// Obtain current state of KUKA robot
-		AxisFeedback = dtController_.getFeedbackAxis();
-		dtLastAxis_.set(AxisFeedback);
-		pdtPlannar_->getModel().Axis2Frame(AxisFeedback, FrameFeedback);
-
-		// Set the target KUKA ABC pose to the current KUKA ABC pose
-		lineEdit_KUKA_A->setText(QString::number(FrameFeedback.A));
-		lineEdit_KUKA_B->setText(QString::number(FrameFeedback.B));
-		lineEdit_KUKA_C->setText(QString::number(FrameFeedback.C));
-		// Let KUKA move to the position that the needle point indicator pointed
-	}while (!ndiFeedbackParallelMove());
+	if (nABC2PointPhase_ == 1) {
+		//----------------------------------------------------------------------------------------------
+		// Derive Tb
+		dtABC2PointTranslationB_ = Eigen::Vector3d(FrameFeedback.X,
+				FrameFeedback.Y, FrameFeedback.Z);
+
+		//----------------------------------------------------------------------------------------------
+		//Move the needle point of KUKA to where the indicator pointed (positive part of tool's XY plane)
+		ROS_INFO("Please indicate a point on the xy plane of the needle");
+		nABC2PointPhase_ = 2;
+		ABC2PointStep();
+		return;
+	}
 
 	//----------------------------------------------------------------------------------------------
 	// Derive Tc
-	AxisFeedback = dtController_.getFeedbackAxis();
-	dtLastAxis_.set(AxisFeedback);
-	pdtPlannar_->getModel().Axis2Frame_flange(AxisFeedback, FrameFeedback);
 	Eigen::Vector3d TranslationC(FrameFeedback.X,
 			FrameFeedback.Y, FrameFeedback.Z);
 
 	// Rotation matrix of Flange to TCP
-	Eigen::Vector3d TransBA(TranslationB - TranslationA);
+	Eigen::Vector3d TransBA(dtABC2PointTranslationB_ - dtABC2PointTranslationA_);
 	Eigen::Vector3d ToolUnitX(TransBA / TransBA.norm());
 
-	Eigen::Vector3d TransCA(TranslationC - TranslationA);
+	Eigen::Vector3d TransCA(TranslationC - dtABC2PointTranslationA_);
 	Eigen::Vector3d ToolUnitC(TransCA / TransCA.norm());
 	Eigen::Vector3d ToolUnitY(ToolUnitC - ToolUnitC.dot(ToolUnitX) * ToolUnitX);
 	ToolUnitY.normalize();
@@ -865,7 +905,7 @@ void Interface::ABC2PointCalibrate() {
 	RaR.col(1) = RotationCol2;
 	RaR.col(2) = RotationCol3;
 
-	Eigen::Matrix3d TCPToFlange = RotationA.inverse() * RaR;
+	Eigen::Matrix3d TCPToFlange = dtABC2PointRotationA_.inverse() * RaR;
 	dtTCPFlangeRotationMatrix_ = TCPToFlange;
 
 	ROS_INFO(
@@ -887,18 +927,9 @@ void Interface::ABC2PointCalibrate() {
 			EulerAngleVector.data()[0], EulerAngleVector.data()[1],
 			EulerAngleVector.data()[2]);
 
-#else
-	dtTCPFlangeRotationMatrix_.data()[0] = -0.019601;
-	dtTCPFlangeRotationMatrix_.data()[1] = -0.012737;
-	dtTCPFlangeRotationMatrix_.data()[2] = -0.999727;
-	dtTCPFlangeRotationMatrix_.data()[3] = -0.165045;
-	dtTCPFlangeRotationMatrix_.data()[4] = -0.986159;
-	dtTCPFlangeRotationMatrix_.data()[5] = 0.015800;
-	dtTCPFlangeRotationMatrix_.data()[6] = -0.986091;
-	dtTCPFlangeRotationMatrix_.data()[7] = 0.165310;
-	dtTCPFlangeRotationMatrix_.data()[8] = 0.017227;
-#endif
-
+	finishABC2PointCalibrate();
+}
+void Interface::finishABC2PointCalibrate() {
 	dtGetDataTimer_->start(NDI_TIME_INTERVAL);
 	pushButton_CalculateTCPFlangeRotation->setEnabled(true);
 	ROS_INFO("Needle direction is successfully calibrated");
@@ -1025,7 +1056,7 @@ void Interface::calculateNDIKUKATransform() {
 	int nMarker = ASCIIToHex(
 			(char*) (comboBox_Marker->currentText().toStdString().c_str()), 2);
 
-	if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.ulFlags
+	if (pdtNDIHandles_[nMarker].dtXfrms.ulFlags
 			!= TRANSFORM_VALID) {
 		ROS_ERROR("NDI failed to track Marker");
 		dtGetDataTimer_->start(NDI_TIME_INTERVAL);
@@ -1061,19 +1092,108 @@ void Interface::calculateNDIKUKATransform() {
 
 	Axis AxisFeedback;
 	Frame FrameFeedback;
-
-	geometry_msgs::Pose initial_pose, target_pose;
 	Eigen::Vector3d EulerAngleVector;
+	Eigen::Vector4d q;
 
-	std::vector<Eigen::Vector3d> vecdtNDIPosition(75);
-	std::vector<Eigen::Vector3d> vecdtKUKAPosition(75);
+	// Obtain current state of KUKA robot
+	AxisFeedback = dtController_.getFeedbackAxis();
+	dtLastAxis_.set(AxisFeedback);
+	pdtPlannar_->getModel().Axis2Frame(AxisFeedback, FrameFeedback);
 
-	std::vector<double> Translation(3);
+	EulerAngleVector.data()[0] = FrameFeedback.A / 180.0 * M_PI;
+	EulerAngleVector.data()[1] = FrameFeedback.B / 180.0 * M_PI;
+	EulerAngleVector.data()[2] = FrameFeedback.C / 180.0 * M_PI;
+
+	q = Euler2Quaternion(EulerAngleVector.data()[2], EulerAngleVector.data()[1],
+			EulerAngleVector.data()[0]);
+	dtNDIKUKATransformPose_.orientation.x = q.data()[0];
+	dtNDIKUKATransformPose_.orientation.y = q.data()[1];
+	dtNDIKUKATransformPose_.orientation.z = q.data()[2];
+	dtNDIKUKATransformPose_.orientation.w = q.data()[3];
+
+	dtNDIKUKATransformPose_.position.x = FrameFeedback.X / 1000.0;
+	dtNDIKUKATransformPose_.position.y = FrameFeedback.Y / 1000.0;
+	dtNDIKUKATransformPose_.position.z = FrameFeedback.Z / 1000.0;
+
+	dNDIKUKATransformDistance_ = lineEdit_incrDistance->text().toDouble();
+	nNDIKUKATransformMarker_ = nMarker;
+	vecdtNDIKUKATransformNDI_.clear();
+	vecdtNDIKUKATransformKUKA_.clear();
+	// We iterate KUKA positions to obtain corresponding NDI positions
+	nNDIKUKATransformPosition_ = 0;
+	calculateNDIKUKATransformStep();
+
+#else
+	dtNDIKUKARotationMatrix_.data()[0] = 0.048885;
+	dtNDIKUKARotationMatrix_.data()[1] = 0.116951;
+	dtNDIKUKARotationMatrix_.data()[2] = -0.991934;
+	dtNDIKUKARotationMatrix_.data()[3] = -0.934143;
+	dtNDIKUKARotationMatrix_.data()[4] = 0.356877;
+	dtNDIKUKARotationMatrix_.data()[5] = -0.003961;
+	dtNDIKUKARotationMatrix_.data()[6] = 0.353535;
+	dtNDIKUKARotationMatrix_.data()[7] = 0.926802;
+	dtNDIKUKARotationMatrix_.data()[8] = 0.126695;
+
+	/*0.048885, -0.934143, 0.353535
+0.116951, 0.356877, 0.926802
+-0.991934, -0.003961, 0.126695
+
+836.268213 mm, 1160.435967 mm, 740.464462 mm
+*/
+
+	dtNDIKUKATranslationVector_.data()[0] = 836.268213;
+	dtNDIKUKATranslationVector_.data()[1] = 1160.435967;
+	dtNDIKUKATranslationVector_.data()[2] = 740.464462;
+
+	/* [ INFO] [1464875668.418977364]: NDI and KUKA frame rotation matrix:
+	 0.067906, -0.862463, 0.501543
+	 0.105537, 0.506093, 0.855998
+	 -0.992094, -0.005196, 0.125388
+
+	 [ INFO] [1464875668.419024658]: NDI and KUKA frame translation vector:
+	 1.055570 m, 1.155677 m, 0.717713 m */
+
+	finishCalculateNDIKUKATransform();
+#endif
+}
+void Interface::calculateNDIKUKATransformStep() {
+	if (nNDIKUKATransformPosition_ == 8) {
+		calculateNDIKUKATransformResult();
+		return;
+	}
+
+	int incrX = (nNDIKUKATransformPosition_ >> 2) & 1;
+	int incrY = (nNDIKUKATransformPosition_ >> 1) & 1;
+	int incrZ = nNDIKUKATransformPosition_ & 1;
+	geometry_msgs::Pose target_pose = dtNDIKUKATransformPose_;
+	target_pose.position.x += incrX * dNDIKUKATransformDistance_ / 1000.0;
+	target_pose.position.y += incrY * dNDIKUKATransformDistance_ / 1000.0;
+	target_pose.position.z += incrZ * dNDIKUKATransformDistance_ / 1000.0;
+
+	PlanAndExecuteTargetMotion(target_pose, "tip",
+			"calculateNDIKUKATransformMoved");
+}
+void Interface::calculateNDIKUKATransformMoved(int motion_return_value) {
+	if (motion_return_value == MOTION_PLAN_FAIL) {
+		// Skip the position
+		nNDIKUKATransformPosition_++;
+		calculateNDIKUKATransformStep();
+		return;
+	} else if (motion_return_value != MOTION_PLAN_EXECUTE) {
+		pushButton_CalculateNDIKUKATransform->setEnabled(true);
+		dtGetDataTimer_->start(NDI_TIME_INTERVAL);
+		return;
+	}
+	nNDIKUKATransformPosition_++;
+
+	Axis AxisFeedback;
+	Frame FrameFeedback;
+	Eigen::Vector3d EulerAngleVector;
+	Eigen::Vector3d KUKAPosition, NDIPosition;
 	Eigen::Affine3d RotationPart, TranslationPart;
 	Eigen::Matrix4d CurrentFlangeKUKATransform;
 	Eigen::Matrix4d CurrentMarkerKUKATransform;
 	Eigen::Matrix4d MarkerFlangeTransform;
-	Eigen::Vector4d q;
 	QuatTransformation dtMarker, dtDummy;
 
 	RotationPart = Eigen::Affine3d::Identity();
@@ -1081,127 +1201,64 @@ void Interface::calculateNDIKUKATransform() {
 			Eigen::Translation3d(dtMarkerFlangeTranslationVector_));
 	MarkerFlangeTransform = (TranslationPart * RotationPart).matrix();
 
-	// Obtain current state of KUKA robot
+	// Obtain the current flange position of KUKA
 	AxisFeedback = dtController_.getFeedbackAxis();
 	dtLastAxis_.set(AxisFeedback);
-	pdtPlannar_->getModel().Axis2Frame(AxisFeedback, FrameFeedback);
+	pdtPlannar_->getModel().Axis2Frame_flange(AxisFeedback, FrameFeedback);
 
 	EulerAngleVector.data()[0] = FrameFeedback.A / 180.0 * M_PI;
 	EulerAngleVector.data()[1] = FrameFeedback.B / 180.0 * M_PI;
 	EulerAngleVector.data()[2] = FrameFeedback.C / 180.0 * M_PI;
+	RotationPart = createRotationMatrix(EulerAngleVector.data()[2],
+			EulerAngleVector.data()[1], EulerAngleVector.data()[0]);
+	TranslationPart = Eigen::Affine3d(
+			Eigen::Translation3d(
+					Eigen::Vector3d(FrameFeedback.X, FrameFeedback.Y,
+							FrameFeedback.Z)));
+	CurrentFlangeKUKATransform = (TranslationPart * RotationPart).matrix();
+
+	// Transform the flange position to marker position
+	CurrentMarkerKUKATransform = CurrentFlangeKUKATransform
+			* MarkerFlangeTransform;
+	KUKAPosition = CurrentMarkerKUKATransform.block(0, 3, 3, 1);
+
+	if (!getNDIFramesAverage(nNDIKUKATransformMarker_, -1, dtMarker, dtDummy,
+			false, NDI_FRAME_COUNT)) {
+		ROS_ERROR("Cannot get NDI Marker position data");
+		calculateNDIKUKATransformStep();
+		return;
+	}
 
-	q = Euler2Quaternion(EulerAngleVector.data()[2], EulerAngleVector.data()[1],
-			EulerAngleVector.data()[0]);
-	initial_pose.orientation.x = q.data()[0];
-	initial_pose.orientation.y = q.data()[1];
-	initial_pose.orientation.z = q.data()[2];
-	initial_pose.orientation.w = q.data()[3];
-
-	initial_pose.position.x = FrameFeedback.X / 1000.0;
-	initial_pose.position.y = FrameFeedback.Y / 1000.0;
-	initial_pose.position.z = FrameFeedback.Z / 1000.0;
-
-	target_pose.orientation.x = initial_pose.orientation.x;
-	target_pose.orientation.y = initial_pose.orientation.y;
-	target_pose.orientation.z = initial_pose.orientation.z;
-	target_pose.orientation.w = initial_pose.orientation.w;
-
-	double incrDistance = lineEdit_incrDistance->text().toDouble();
-	int posCount = 0;
-	// We iterate KUKA positions to obtain corresponding NDI positions
-	for (int incrX = 0; incrX <= 1; incrX++) {
-		for (int incrY = 0; incrY <= 1; incrY++) {
-			for (int incrZ = 0; incrZ <= 1; incrZ++) {
-				target_pose.position.x = initial_pose.position.x
-						+ incrX * incrDistance / 1000.0;
-				target_pose.position.y = initial_pose.position.y
-						+ incrY * incrDistance / 1000.0;
-				target_pose.position.z = initial_pose.position.z
-						+ incrZ * incrDistance / 1000.0;
-
-				int motion_return_value = PlanAndExecuteTargetMotion(
-						target_pose, "tip");
-				if (motion_return_value == MOTION_PLAN_EXECUTE) {
-					ROS_INFO("Motion plan execute");
-				} else if (motion_return_value == MOTION_PLAN_FAIL) {
-					continue;
-				} else {
-					pushButton_CalculateNDIKUKATransform->setEnabled(true);
-					dtGetDataTimer_->start(NDI_TIME_INTERVAL);
-					return;
-				}
-
-				dtSubWindowWaitForExecution_.exec();
-
-				// Obtain the current flange position of KUKA
-				AxisFeedback = dtController_.getFeedbackAxis();
-				dtLastAxis_.set(AxisFeedback);
-				pdtPlannar_->getModel().Axis2Frame_flange(AxisFeedback,
-						FrameFeedback);
-
-				EulerAngleVector.data()[0] = FrameFeedback.A / 180.0 * M_PI;
-				EulerAngleVector.data()[1] = FrameFeedback.B / 180.0 * M_PI;
-				EulerAngleVector.data()[2] = FrameFeedback.C / 180.0 * M_PI;
-				Translation[0] = FrameFeedback.X;
-				Translation[1] = FrameFeedback.Y;
-				Translation[2] = FrameFeedback.Z;
-				RotationPart = createRotationMatrix(EulerAngleVector.data()[2],
-						EulerAngleVector.data()[1], EulerAngleVector.data()[0]);
-				TranslationPart = Eigen::Affine3d(
-						Eigen::Translation3d(
-								Eigen::Vector3d(Translation[0], Translation[1],
-										Translation[2])));
-				CurrentFlangeKUKATransform =
-						(TranslationPart * RotationPart).matrix();
-
-				// Transform the flange position to marker position
-				CurrentMarkerKUKATransform = CurrentFlangeKUKATransform
-						* MarkerFlangeTransform;
-				vecdtKUKAPosition[posCount][0] =
-						CurrentMarkerKUKATransform.coeff(0, 3);
-				vecdtKUKAPosition[posCount][1] =
-						CurrentMarkerKUKATransform.coeff(1, 3);
-				vecdtKUKAPosition[posCount][2] =
-						CurrentMarkerKUKATransform.coeff(2, 3);
-
-				if (!getNDIFramesAverage(nMarker, -1, dtMarker, dtDummy, false,
-				NDI_FRAME_COUNT)) {
-					ROS_ERROR("Cannot get NDI Marker position data");
-					continue;
-				}
-
-				vecdtNDIPosition[posCount][0] = dtMarker.dtTranslation.fTx;
-				vecdtNDIPosition[posCount][1] = dtMarker.dtTranslation.fTy;
-				vecdtNDIPosition[posCount][2] = dtMarker.dtTranslation.fTz;
-				//TODO: This is for preventing the wrong NDI posiiton data
-				if (vecdtNDIPosition[posCount][0] > 5000
-						|| vecdtNDIPosition[posCount][1] > 5000
-						|| vecdtNDIPosition[posCount][2] > 5000
-						|| vecdtNDIPosition[posCount][0] < -5000
-						|| vecdtNDIPosition[posCount][1] < -5000
-						|| vecdtNDIPosition[posCount][2] < -5000) {
-					ROS_ERROR("NDI measured data error");
-					continue;
-				}
-				ROS_INFO("%dth KUKA position: %f, %f, %f", posCount + 1,
-						vecdtKUKAPosition[posCount][0],
-						vecdtKUKAPosition[posCount][1],
-						vecdtKUKAPosition[posCount][2]);
-				ROS_INFO("%dth NDI position: %f, %f, %f", posCount + 1,
-						vecdtNDIPosition[posCount][0],
-						vecdtNDIPosition[posCount][1],
-						vecdtNDIPosition[posCount][2]);
-				posCount++;
-			}
-		}
+	NDIPosition = Eigen::Vector3d(dtMarker.dtTranslation.fTx,
+			dtMarker.dtTranslation.fTy, dtMarker.dtTranslation.fTz);
+	//TODO: This is for preventing the wrong NDI posiiton data
+	if (NDIPosition[0] > 5000 || NDIPosition[1] > 5000 || NDIPosition[2] > 5000
+			|| NDIPosition[0] < -5000 || NDIPosition[1] < -5000
+			|| NDIPosition[2] < -5000) {
+		ROS_ERROR("NDI measured data error");
+		calculateNDIKUKATransformStep();
+		return;
 	}
+	vecdtNDIKUKATransformKUKA_.push_back(KUKAPosition);
+	vecdtNDIKUKATransformNDI_.push_back(NDIPosition);
+	ROS_INFO("%dth KUKA position: %f, %f, %f",
+			(int) vecdtNDIKUKATransformKUKA_.size(), KUKAPosition[0],
+			KUKAPosition[1], KUKAPosition[2]);
+	ROS_INFO("%dth NDI position: %f, %f, %f",
+			(int) vecdtNDIKUKATransformNDI_.size(), NDIPosition[0],
+			NDIPosition[1], NDIPosition[2]);
+
+	calculateNDIKUKATransformStep();
+}
+void Interface::calculateNDIKUKATransformResult() {
+	int posCount = vecdtNDIKUKATransformKUKA_.size();
 
 	Eigen::Vector3d dtKUKAAveragePosition(0, 0, 0);
 	Eigen::Vector3d dtNDIAveragePosition(0, 0, 0);
 
 	for (int i = 0; i < posCount; i++) {
-		dtKUKAAveragePosition += vecdtKUKAPosition[i];
-		dtNDIAveragePosition += vecdtNDIPosition[i];
+		dtKUKAAveragePosition += vecdtNDIKUKATransformKUKA_[i];
+		dtNDIAveragePosition += vecdtNDIKUKATransformNDI_[i];
 	}
 	dtKUKAAveragePosition /= posCount;
 	dtNDIAveragePosition /= posCount;
@@ -1209,8 +1266,8 @@ void Interface::calculateNDIKUKATransform() {
 	Eigen::Matrix3d dtCovarianceMatrix;
 	dtCovarianceMatrix = Eigen::Matrix3d::Zero();
 	for (int i = 0; i < posCount; i++) {
-		dtCovarianceMatrix += (vecdtKUKAPosition[i] - dtKUKAAveragePosition)
-				* ((vecdtNDIPosition[i] - dtNDIAveragePosition).transpose());
+		dtCovarianceMatrix += (vecdtNDIKUKATransformKUKA_[i] - dtKUKAAveragePosition)
+				* ((vecdtNDIKUKATransformNDI_[i] - dtNDIAveragePosition).transpose());
 	}
 	dtCovarianceMatrix /= posCount;
 
@@ -1245,54 +1302,26 @@ void Interface::calculateNDIKUKATransform() {
 	dtNDIKUKARotationMatrix_ = dtRotationMatrix;
 	dtNDIKUKATranslationVector_ = dtTranslation;
 
-	ROS_INFO(
-			"NDI to KUKA frame rotation matrix: \n%f, %f, %f \n%f, %f, %f \n%f, %f, %f\n",
-			dtNDIKUKARotationMatrix_.data()[0],
-			dtNDIKUKARotationMatrix_.data()[3],
-			dtNDIKUKARotationMatrix_.data()[6],
-			dtNDIKUKARotationMatrix_.data()[1],
-			dtNDIKUKARotationMatrix_.data()[4],
-			dtNDIKUKARotationMatrix_.data()[7],
-			dtNDIKUKARotationMatrix_.data()[2],
-			dtNDIKUKARotationMatrix_.data()[5],
-			dtNDIKUKARotationMatrix_.data()[8]);
-
-	ROS_INFO("NDI to KUKA frame translation vector: \n%f mm, %f mm, %f mm\n",
-			dtNDIKUKATranslationVector_.data()[0],
-			dtNDIKUKATranslationVector_.data()[1],
-			dtNDIKUKATranslationVector_.data()[2]);
-
-#else
-	dtNDIKUKARotationMatrix_.data()[0] = 0.048885;
-	dtNDIKUKARotationMatrix_.data()[1] = 0.116951;
-	dtNDIKUKARotationMatrix_.data()[2] = -0.991934;
-	dtNDIKUKARotationMatrix_.data()[3] = -0.934143;
-	dtNDIKUKARotationMatrix_.data()[4] = 0.356877;
-	dtNDIKUKARotationMatrix_.data()[5] = -0.003961;
-	dtNDIKUKARotationMatrix_.data()[6] = 0.353535;
-	dtNDIKUKARotationMatrix_.data()[7] = 0.926802;
-	dtNDIKUKARotationMatrix_.data()[8] = 0.126695;
-
-	/*0.048885, -0.934143, 0.353535
-0.116951, 0.356877, 0.926802
--0.991934, -0.003961, 0.126695
-
-836.268213 mm, 1160.435967 mm, 740.464462 mm
-*/
-
-	dtNDIKUKATranslationVector_.data()[0] = 836.268213;
-	dtNDIKUKATranslationVector_.data()[1] = 1160.435967;
-	dtNDIKUKATranslationVector_.data()[2] = 740.464462;
-
-	/* [ INFO] [1464875668.418977364]: NDI and KUKA frame rotation matrix:
-	 0.067906, -0.862463, 0.501543
-	 0.105537, 0.506093, 0.855998
-	 -0.992094, -0.005196, 0.125388
+	ROS_INFO(
+			"NDI to KUKA frame rotation matrix: \n%f, %f, %f \n%f, %f, %f \n%f, %f, %f\n",
+			dtNDIKUKARotationMatrix_.data()[0],
+			dtNDIKUKARotationMatrix_.data()[3],
+			dtNDIKUKARotationMatrix_.data()[6],
+			dtNDIKUKARotationMatrix_.data()[1],
+			dtNDIKUKARotationMatrix_.data()[4],
+			dtNDIKUKARotationMatrix_.data()[7],
+			dtNDIKUKARotationMatrix_.data()[2],
+			dtNDIKUKARotationMatrix_.data()[5],
+			dtNDIKUKARotationMatrix_.data()[8]);
 
-	 [ INFO] [1464875668.419024658]: NDI and KUKA frame translation vector:
-	 1.055570 m, 1.155677 m, 0.717713 m */
+	ROS_INFO("NDI to KUKA frame translation vector: \n%f mm, %f mm, %f mm\n",
+			dtNDIKUKATranslationVector_.data()[0],
+			dtNDIKUKATranslationVector_.data()[1],
+			dtNDIKUKATranslationVector_.data()[2]);
 
-#endif
+	finishCalculateNDIKUKATransform();
+}
+void Interface::finishCalculateNDIKUKATransform() {
 	pushButton_CalculateNDIKUKATransform->setEnabled(true);
 	pushButton_NDIFeedbackMove->setEnabled(true);
 	dtGetDataTimer_->start(NDI_TIME_INTERVAL);
@@ -1332,15 +1361,15 @@ bool Interface::getNDIFramesAverage(int nMarker, int nIndicator,
 		}
 
 		if (nIndicator != -1 && nMarker != -1) {
-			if (pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.ulFlags
+			if (pdtNDIHandles_[nIndicator].dtXfrms.ulFlags
 					== TRANSFORM_VALID
-					&& pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.ulFlags
+					&& pdtNDIHandles_[nMarker].dtXfrms.ulFlags
 							== TRANSFORM_VALID) {
 
 				vecdtIndicator[nFrameCount].dtTranslation =
-						pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.dtTranslation;
+						pdtNDIHandles_[nIndicator].dtXfrms.dtTranslation;
 				vecdtMarker[nFrameCount].dtTranslation =
-						pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.dtTranslation;
+						pdtNDIHandles_[nMarker].dtXfrms.dtTranslation;
 
 				dtIndicator.dtTranslation.fTx +=
 						vecdtIndicator[nFrameCount].dtTranslation.fTx;
@@ -1358,9 +1387,9 @@ bool Interface::getNDIFramesAverage(int nMarker, int nIndicator,
 
 				if (bCalculateABC) {
 					vecdtIndicator[nFrameCount].dtRotation =
-							pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.dtRotation;
+							pdtNDIHandles_[nIndicator].dtXfrms.dtRotation;
 					vecdtMarker[nFrameCount].dtRotation =
-							pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.dtRotation;
+							pdtNDIHandles_[nMarker].dtXfrms.dtRotation;
 
 					IndicatorEulerAngleVector += Quaternion2Euler(
 							vecdtIndicator[nFrameCount].dtRotation.fQx,
@@ -1381,11 +1410,11 @@ bool Interface::getNDIFramesAverage(int nMarker, int nIndicator,
 				nFrameCount++;
 			}
 		} else if (nIndicator == -1 && nMarker != -1) {
-			if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.ulFlags
+			if (pdtNDIHandles_[nMarker].dtXfrms.ulFlags
 					== TRANSFORM_VALID) {
 
 				vecdtMarker[nFrameCount].dtTranslation =
-						pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.dtTranslation;
+						pdtNDIHandles_[nMarker].dtXfrms.dtTranslation;
 
 				dtMarker.dtTranslation.fTx +=
 						vecdtMarker[nFrameCount].dtTranslation.fTx;
@@ -1396,7 +1425,7 @@ bool Interface::getNDIFramesAverage(int nMarker, int nIndicator,
 
 				if (bCalculateABC) {
 					vecdtMarker[nFrameCount].dtRotation =
-							pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.dtRotation;
+							pdtNDIHandles_[nMarker].dtXfrms.dtRotation;
 					MarkerEulerAngleVector += Quaternion2Euler(
 							vecdtMarker[nFrameCount].dtRotation.fQx,
 							vecdtMarker[nFrameCount].dtRotation.fQy,
@@ -1411,10 +1440,10 @@ bool Interface::getNDIFramesAverage(int nMarker, int nIndicator,
 				nFrameCount++;
 			}
 		} else if (nIndicator != -1 && nMarker == -1) {
-			if (pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.ulFlags
+			if (pdtNDIHandles_[nIndicator].dtXfrms.ulFlags
 					== TRANSFORM_VALID) {
 				vecdtIndicator[nFrameCount].dtTranslation =
-						pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.dtTranslation;
+						pdtNDIHandles_[nIndicator].dtXfrms.dtTranslation;
 
 				dtIndicator.dtTranslation.fTx +=
 						vecdtIndicator[nFrameCount].dtTranslation.fTx;
@@ -1425,7 +1454,7 @@ bool Interface::getNDIFramesAverage(int nMarker, int nIndicator,
 
 				if (bCalculateABC) {
 					vecdtIndicator[nFrameCount].dtRotation =
-							pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.dtRotation;
+							pdtNDIHandles_[nIndicator].dtXfrms.dtRotation;
 					IndicatorEulerAngleVector += Quaternion2Euler(
 							vecdtIndicator[nFrameCount].dtRotation.fQx,
 							vecdtIndicator[nFrameCount].dtRotation.fQy,
@@ -1521,9 +1550,9 @@ void Interface::calculateTCPMarkerTransform() {
 		dtSubWindowWaitForIndicatorPlaced_.exec();
 		getSystemTransformData(false);
 		if (dtSubWindowWaitForIndicatorPlaced_.nReturnValue_ == INDICATOR_OK) {
-			if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.ulFlags
+			if (pdtNDIHandles_[nMarker].dtXfrms.ulFlags
 					!= TRANSFORM_VALID
-					|| pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.ulFlags
+					|| pdtNDIHandles_[nIndicator].dtXfrms.ulFlags
 					!= TRANSFORM_VALID) {
 				ROS_ERROR("NDI failed to track Marker or Point Indicator");
 				bTracking = false;
@@ -1550,9 +1579,9 @@ void Interface::calculateTCPMarkerTransform() {
 			dtMarker.dtRotation.fQ0);
 
 	dtIndicator.dtRotation =
-	pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.dtRotation;
+	pdtNDIHandles_[nMarker].dtXfrms.dtRotation;
 	dtMarker.dtRotation =
-	pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.dtRotation;
+	pdtNDIHandles_[nMarker].dtXfrms.dtRotation;
 
 	QuatInverseXfrm(&dtMarker, &dtMarkerInverse);
 	QuatCombineXfrms(&dtIndicator, &dtMarkerInverse, &dtTCPMarkerTransform_);
@@ -1576,7 +1605,7 @@ void Interface::calculateTCPMarkerTransform() {
 		dtSubWindowWaitForIndicatorPlaced_.exec();
 		getSystemTransformData(false);
 		if (dtSubWindowWaitForIndicatorPlaced_.nReturnValue_ == INDICATOR_OK) {
-			if (pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.ulFlags
+			if (pdtNDIHandles_[nIndicator].dtXfrms.ulFlags
 					!= TRANSFORM_VALID) {
 				ROS_ERROR("NDI failed to track Point Indicator");
 				bTracking = false;
@@ -1616,7 +1645,7 @@ void Interface::calculateTCPMarkerTransform() {
 		dtSubWindowWaitForIndicatorPlaced_.exec();
 		getSystemTransformData(false);
 		if (dtSubWindowWaitForIndicatorPlaced_.nReturnValue_ == INDICATOR_OK) {
-			if (pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.ulFlags
+			if (pdtNDIHandles_[nIndicator].dtXfrms.ulFlags
 					!= TRANSFORM_VALID) {
 				ROS_ERROR("NDI failed to track Point Indicator");
 				bTracking = false;
@@ -1772,7 +1801,10 @@ void Interface::calculateTCPMarkerTransform() {
 
 	vecbCalibrationToDoList_[Interface::TCPMarkerTransform] = true;
 }
-bool Interface::ndiFeedbackParallelMove() {
+void Interface::ndiFeedbackParallelMove() {
+	startNDIFeedbackParallelMove(NULL);
+}
+bool Interface::startNDIFeedbackParallelMove(const char* continuation) {
 	// TODO: After calibration, we need to change URDF file to save these settings
 	if (lineEdit_NDI_X->text().isEmpty() || lineEdit_NDI_Y->text().isEmpty()
 			|| lineEdit_NDI_Z->text().isEmpty()
@@ -1794,10 +1826,7 @@ bool Interface::ndiFeedbackParallelMove() {
 
 	int nMarker = ASCIIToHex(
 			(char*) (comboBox_Marker->currentText().toStdString().c_str()), 2);
-	int nIndicator = ASCIIToHex(
-			(char*) (comboBox_Indicator->currentText().toStdString().c_str()),
-			2);
-	if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.ulFlags
+	if (pdtNDIHandles_[nMarker].dtXfrms.ulFlags
 			!= TRANSFORM_VALID) {
 		ROS_ERROR("NDI failed to track Marker");
 		return false;
@@ -1815,29 +1844,25 @@ bool Interface::ndiFeedbackParallelMove() {
 	Axis AxisFeedback;
 	Frame FrameFeedback;
 
-	std::vector<double> NDI_reference_point(6);
-	std::vector<double> KUKA_position(3);
-
-	Eigen::Vector3d NDI_delta_position;
-	Eigen::Vector3d KUKA_delta_position;
-
 	geometry_msgs::Pose target_pose;
 	Eigen::Vector3d EulerAngleVector;
 	Eigen::Vector4d q;
-	QuatTransformation dtMarker, dtDummy;
 
+	pcParallelMoveContinuation_ = continuation;
+	nParallelMoveMarker_ = nMarker;
 // Pos for reference point in NDI frame
-	NDI_reference_point[0] = lineEdit_NDI_X->text().toDouble();
-	NDI_reference_point[1] = lineEdit_NDI_Y->text().toDouble();
-	NDI_reference_point[2] = lineEdit_NDI_Z->text().toDouble();
-	NDI_reference_point[3] = lineEdit_KUKA_A->text().toDouble() / 180.0 * M_PI;
-	NDI_reference_point[4] = lineEdit_KUKA_B->text().toDouble() / 180.0 * M_PI;
-	NDI_reference_point[5] = lineEdit_KUKA_C->text().toDouble() / 180.0 * M_PI;
+	dtParallelMoveReference_ = Eigen::Vector3d(
+			lineEdit_NDI_X->text().toDouble(),
+			lineEdit_NDI_Y->text().toDouble(),
+			lineEdit_NDI_Z->text().toDouble());
 
 // Rotate KUKA to specified ABC pos
-	EulerAngleVector.data()[0] = NDI_reference_point[3];
-	EulerAngleVector.data()[1] = NDI_reference_point[4];
-	EulerAngleVector.data()[2] = NDI_reference_point[5];
+	EulerAngleVector.data()[0] = lineEdit_KUKA_A->text().toDouble() / 180.0
+			* M_PI;
+	EulerAngleVector.data()[1] = lineEdit_KUKA_B->text().toDouble() / 180.0
+			* M_PI;
+	EulerAngleVector.data()[2] = lineEdit_KUKA_C->text().toDouble() / 180.0
+			* M_PI;
 
 	q = Euler2Quaternion(EulerAngleVector.data()[2], EulerAngleVector.data()[1],
 			EulerAngleVector.data()[0]);
@@ -1853,16 +1878,21 @@ bool Interface::ndiFeedbackParallelMove() {
 	target_pose.position.y = FrameFeedback.Y / 1000.0;
 	target_pose.position.z = FrameFeedback.Z / 1000.0;
 
-	int motion_return_value = PlanAndExecuteTargetMotion(target_pose, "tip");
-	if (motion_return_value == MOTION_PLAN_EXECUTE) {
-		ROS_INFO("Motion plan execute");
-	} else {
-		pushButton_NDIFeedbackParallelMove->setEnabled(true);
-		dtGetDataTimer_->start(NDI_TIME_INTERVAL);
-		return false;
+	PlanAndExecuteTargetMotion(target_pose, "tip",
+			"ndiFeedbackParallelMoveRotated");
+	return true;
+}
+void Interface::ndiFeedbackParallelMoveRotated(int motion_return_value) {
+	if (motion_return_value != MOTION_PLAN_EXECUTE) {
+		finishNDIFeedbackParallelMove(false);
+		return;
 	}
 
-	dtSubWindowWaitForExecution_.exec();
+	Axis AxisFeedback;
+	Frame FrameFeedback;
+	Eigen::Vector3d EulerAngleVector;
+	Eigen::Vector4d q;
+
 // Then move KUKA to specified XYZ reference point in NDI frame
 	AxisFeedback = dtController_.getFeedbackAxis();
 	dtLastAxis_.set(AxisFeedback);
@@ -1873,24 +1903,36 @@ bool Interface::ndiFeedbackParallelMove() {
 
 	q = Euler2Quaternion(EulerAngleVector.data()[2], EulerAngleVector.data()[1],
 			EulerAngleVector.data()[0]);
-	target_pose.orientation.x = q.data()[0];
-	target_pose.orientation.y = q.data()[1];
-	target_pose.orientation.z = q.data()[2];
-	target_pose.orientation.w = q.data()[3];
+	dtParallelMovePose_.orientation.x = q.data()[0];
+	dtParallelMovePose_.orientation.y = q.data()[1];
+	dtParallelMovePose_.orientation.z = q.data()[2];
+	dtParallelMovePose_.orientation.w = q.data()[3];
+
+	nParallelMoveIterationCount_ = 0;
+	pdParallelMoveError_[0] = 0;
+	pdParallelMoveError_[1] = 0;
+	ndiFeedbackParallelMoveStep();
+}
+void Interface::ndiFeedbackParallelMoveStep() {
+	Axis AxisFeedback;
+	Frame FrameFeedback;
 
-	if (!getNDIFramesAverage(nMarker, -1, dtMarker, dtDummy, false,
+	Eigen::Vector3d NDI_delta_position;
+	Eigen::Vector3d KUKA_delta_position;
+	QuatTransformation dtMarker, dtDummy;
+
+	if (!getNDIFramesAverage(nParallelMoveMarker_, -1, dtMarker, dtDummy, false,
 	NDI_FRAME_COUNT)) {
 		ROS_ERROR("Cannot get tool position data");
-		pushButton_NDIFeedbackParallelMove->setEnabled(true);
-		dtGetDataTimer_->start(NDI_TIME_INTERVAL);
-		return false;
+		finishNDIFeedbackParallelMove(false);
+		return;
 	}
 
-	NDI_delta_position.data()[0] = NDI_reference_point[0]
+	NDI_delta_position.data()[0] = dtParallelMoveReference_.data()[0]
 			- dtMarker.dtTranslation.fTx;
-	NDI_delta_position.data()[1] = NDI_reference_point[1]
+	NDI_delta_position.data()[1] = dtParallelMoveReference_.data()[1]
 			- dtMarker.dtTranslation.fTy;
-	NDI_delta_position.data()[2] = NDI_reference_point[2]
+	NDI_delta_position.data()[2] = dtParallelMoveReference_.data()[2]
 			- dtMarker.dtTranslation.fTz;
 
 	KUKA_delta_position = dtNDIKUKARotationMatrix_ * NDI_delta_position;
@@ -1899,94 +1941,62 @@ bool Interface::ndiFeedbackParallelMove() {
 	ROS_INFO("Delta KUKA position: %f, %f, %f", KUKA_delta_position.data()[0],
 			KUKA_delta_position.data()[1], KUKA_delta_position.data()[2]);
 
-	int nIterationCount = 0;
-	std::vector<double> distance_error(2, 0);
-
-	while (sqrt(
-			NDI_delta_position.data()[0] * NDI_delta_position.data()[0]
-					+ NDI_delta_position.data()[1]
-							* NDI_delta_position.data()[1]
-					+ NDI_delta_position.data()[2]
-							* NDI_delta_position.data()[2])
-			> dParallelMoveThreshold_) {
-
-		AxisFeedback = dtController_.getFeedbackAxis();
-		dtLastAxis_.set(AxisFeedback);
-		pdtPlannar_->getModel().Axis2Frame(AxisFeedback, FrameFeedback);
-		target_pose.position.x = (FrameFeedback.X
-				+ KUKA_delta_position.data()[0]) / 1000.0;
-		target_pose.position.y = (FrameFeedback.Y
-				+ KUKA_delta_position.data()[1]) / 1000.0;
-		target_pose.position.z = (FrameFeedback.Z
-				+ KUKA_delta_position.data()[2]) / 1000.0;
-
-		motion_return_value = PlanAndExecuteTargetMotion(target_pose, "tip");
-		if (motion_return_value == MOTION_PLAN_EXECUTE) {
-			ROS_INFO("Motion plan execute");
-		} else {
-			pushButton_NDIFeedbackParallelMove->setEnabled(true);
-			dtGetDataTimer_->start(NDI_TIME_INTERVAL);
-			dParallelMoveThreshold_ = MINIMUM_PARALLEL_MOVE_THRESHOLD;
-			return false;
-		}
-
-		dtSubWindowWaitForExecution_.exec();
-
-		if (!getNDIFramesAverage(nMarker, -1, dtMarker, dtDummy, false,
-		NDI_FRAME_COUNT)) {
-			ROS_ERROR("Cannot get tool position data");
-			pushButton_NDIFeedbackParallelMove->setEnabled(true);
-			dtGetDataTimer_->start(NDI_TIME_INTERVAL);
-			dParallelMoveThreshold_ = MINIMUM_PARALLEL_MOVE_THRESHOLD;
-			return false;
-		}
-
-		NDI_delta_position.data()[0] = NDI_reference_point[0]
-				- dtMarker.dtTranslation.fTx;
-		NDI_delta_position.data()[1] = NDI_reference_point[1]
-				- dtMarker.dtTranslation.fTy;
-		NDI_delta_position.data()[2] = NDI_reference_point[2]
-				- dtMarker.dtTranslation.fTz;
-
-		KUKA_delta_position = dtNDIKUKARotationMatrix_ * NDI_delta_position;
-
-		ROS_INFO("Delta NDI position: %f, %f, %f", NDI_delta_position.data()[0],
-				NDI_delta_position.data()[1], NDI_delta_position.data()[2]);
-		ROS_INFO("Delta KUKA position: %f, %f, %f",
-				KUKA_delta_position.data()[0], KUKA_delta_position.data()[1],
-				KUKA_delta_position.data()[2]);
-
-
-
-		// If the distance error is still going down, don't count the iteration.
-		// Count the iteration only when the distance error starts to diverge
-		distance_error[0] = distance_error[1];
-		distance_error[1] = sqrt(
-				NDI_delta_position.data()[0]
-						* NDI_delta_position.data()[0]
-						+ NDI_delta_position.data()[1]
-								* NDI_delta_position.data()[1]
-						+ NDI_delta_position.data()[2]
-								* NDI_delta_position.data()[2]);
-		ROS_INFO("NDI measured error: %f mm", distance_error[1]);
-		// To check whether the last distance error exists
-		if(distance_error[0] != 0 && distance_error[1] - distance_error[0] > 0) {
-			nIterationCount++;
-		}
+	// If the distance error is still going down, don't count the iteration.
+	// Count the iteration only when the distance error starts to diverge
+	pdParallelMoveError_[0] = pdParallelMoveError_[1];
+	pdParallelMoveError_[1] = NDI_delta_position.norm();
+	ROS_INFO("NDI measured error: %f mm", pdParallelMoveError_[1]);
+	// To check whether the last distance error exists
+	if (pdParallelMoveError_[0] != 0
+			&& pdParallelMoveError_[1] - pdParallelMoveError_[0] > 0) {
+		nParallelMoveIterationCount_++;
+	}
 
-		if(nIterationCount >= 4) {
-			dParallelMoveThreshold_ += 0.05;
-			nIterationCount = 0;
-			ROS_INFO("Threshold changed to %f", dParallelMoveThreshold_);
-		}
+	if (nParallelMoveIterationCount_ >= 4) {
+		dParallelMoveThreshold_ += 0.05;
+		nParallelMoveIterationCount_ = 0;
+		ROS_INFO("Threshold changed to %f", dParallelMoveThreshold_);
+	}
 
+	if (pdParallelMoveError_[1] <= dParallelMoveThreshold_) {
+		ROS_INFO("NDI Feedback Move succeed");
+		finishNDIFeedbackParallelMove(true);
+		return;
 	}
 
+	AxisFeedback = dtController_.getFeedbackAxis();
+	dtLastAxis_.set(AxisFeedback);
+	pdtPlannar_->getModel().Axis2Frame(AxisFeedback, FrameFeedback);
+	geometry_msgs::Pose target_pose = dtParallelMovePose_;
+	target_pose.position.x = (FrameFeedback.X
+			+ KUKA_delta_position.data()[0]) / 1000.0;
+	target_pose.position.y = (FrameFeedback.Y
+			+ KUKA_delta_position.data()[1]) / 1000.0;
+	target_pose.position.z = (FrameFeedback.Z
+			+ KUKA_delta_position.data()[2]) / 1000.0;
+
+	Frame TargetFrame(FrameFeedback, KUKA_delta_position.data()[0],
+			KUKA_delta_position.data()[1], KUKA_delta_position.data()[2]);
+	PlanAndExecuteTargetMotion(target_pose, "tip",
+			"ndiFeedbackParallelMoveExecuted", &TargetFrame);
+}
+void Interface::ndiFeedbackParallelMoveExecuted(int motion_return_value) {
+	if (motion_return_value != MOTION_PLAN_EXECUTE) {
+		finishNDIFeedbackParallelMove(false);
+		return;
+	}
+	ndiFeedbackParallelMoveStep();
+}
+void Interface::finishNDIFeedbackParallelMove(bool success) {
 	dtGetDataTimer_->start(NDI_TIME_INTERVAL);
 	pushButton_NDIFeedbackParallelMove->setEnabled(true);
 	dParallelMoveThreshold_ = MINIMUM_PARALLEL_MOVE_THRESHOLD;
-	ROS_INFO("NDI Feedback Move succeed");
-	return true;
+
+	const char* continuation = pcParallelMoveContinuation_;
+	pcParallelMoveContinuation_ = NULL;
+	if (continuation != NULL)
+		QMetaObject::invokeMethod(this, continuation, Qt::QueuedConnection,
+				Q_ARG(bool, success));
 }
 //Calculate robotation matrix between NDI frame and KUKA frame
 void Interface::calculateRotationMatrix() {
@@ -2008,7 +2018,7 @@ void Interface::calculateRotationMatrix() {
 	int nIndicator = ASCIIToHex(
 			(char*) (comboBox_Indicator->currentText().toStdString().c_str()),
 			2);
-	if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.ulFlags
+	if (pdtNDIHandles_[nMarker].dtXfrms.ulFlags
 			!= TRANSFORM_VALID) {
 		ROS_ERROR("NDI failed to track Marker");
 		return;
@@ -2020,30 +2030,28 @@ void Interface::calculateRotationMatrix() {
 	Axis AxisFeedback;
 	Frame FrameFeedback;
 
-	// move x, y, z independently so that we could calculate each column of the rotation matrix separately
-	std::vector<double> Kuka_position_x(4), Kuka_position_y(4), Kuka_position_z(
-			4);
-	std::vector<double> NDI_position_x(4), NDI_position_y(4), NDI_position_z(4);
-
-	geometry_msgs::Pose target_pose;
 	Eigen::Vector3d EulerAngleVector;
 	Eigen::Vector4d q;
 
+	// move x, y, z independently so that we could calculate each column of the rotation matrix separately
+	vecdtRotationMatrixKUKA_.clear();
+	vecdtRotationMatrixNDI_.clear();
+	nRotationMatrixMarker_ = nMarker;
+
 	AxisFeedback = dtController_.getFeedbackAxis();
 	dtLastAxis_.set(AxisFeedback);
 	pdtPlannar_->getModel().Axis2Frame(AxisFeedback, FrameFeedback);
-	Kuka_position_x[0] = FrameFeedback.X;
-	Kuka_position_y[0] = FrameFeedback.Y;
-	Kuka_position_z[0] = FrameFeedback.Z;
+	vecdtRotationMatrixKUKA_.push_back(
+			Eigen::Vector3d(FrameFeedback.X, FrameFeedback.Y, FrameFeedback.Z));
 	EulerAngleVector.data()[0] = FrameFeedback.A / 180.0 * M_PI;
 	EulerAngleVector.data()[1] = FrameFeedback.B / 180.0 * M_PI;
 	EulerAngleVector.data()[2] = FrameFeedback.C / 180.0 * M_PI;
 	q = Euler2Quaternion(EulerAngleVector.data()[2], EulerAngleVector.data()[1],
 			EulerAngleVector.data()[0]);
-	target_pose.orientation.x = q.data()[0];
-	target_pose.orientation.y = q.data()[1];
-	target_pose.orientation.z = q.data()[2];
-	target_pose.orientation.w = q.data()[3];
+	dtRotationMatrixPose_.orientation.x = q.data()[0];
+	dtRotationMatrixPose_.orientation.y = q.data()[1];
+	dtRotationMatrixPose_.orientation.z = q.data()[2];
+	dtRotationMatrixPose_.orientation.w = q.data()[3];
 
 	QuatTransformation dtMarker, dtDummy;
 	if (!getNDIFramesAverage(nMarker, -1, dtMarker, dtDummy, false,
@@ -2053,119 +2061,88 @@ void Interface::calculateRotationMatrix() {
 		dtGetDataTimer_->start(NDI_TIME_INTERVAL);
 		return;
 	}
-	NDI_position_x[0] = dtMarker.dtTranslation.fTx;
-	NDI_position_y[0] = dtMarker.dtTranslation.fTy;
-	NDI_position_z[0] = dtMarker.dtTranslation.fTz;
+	vecdtRotationMatrixNDI_.push_back(
+			Eigen::Vector3d(dtMarker.dtTranslation.fTx,
+					dtMarker.dtTranslation.fTy, dtMarker.dtTranslation.fTz));
 
-	// --------------------------------------------------------
-	// Pose 1
-	// --------------------------------------------------------
-	target_pose.position.x = (Kuka_position_x[0]
-			+ lineEdit_dX->text().toDouble()) / 1000.0;
-	target_pose.position.y = Kuka_position_y[0] / 1000.0;
-	target_pose.position.z = Kuka_position_z[0] / 1000.0;
-
-	int motion_return_value = PlanAndExecuteTargetMotion(target_pose, "tip");
-	if (motion_return_value == MOTION_PLAN_EXECUTE) {
-		ROS_INFO("Motion plan execute");
-	} else {
-		pushButton_CalculateNDIKUKARotation->setEnabled(true);
-		dtGetDataTimer_->start(NDI_TIME_INTERVAL);
-		return;
-	}
+	nRotationMatrixPose_ = 1;
+	calculateRotationMatrixStep();
+#else
+	dtNDIKUKARotationMatrix_.data()[0] = 0.050280;
+	dtNDIKUKARotationMatrix_.data()[1] = 0.134701;
+	dtNDIKUKARotationMatrix_.data()[2] = -0.992092;
+	dtNDIKUKARotationMatrix_.data()[3] = -0.937355;
+	dtNDIKUKARotationMatrix_.data()[4] = 0.391280;
+	dtNDIKUKARotationMatrix_.data()[5] = 0.002654;
+	dtNDIKUKARotationMatrix_.data()[6] = 0.353481;
+	dtNDIKUKARotationMatrix_.data()[7] = 0.877706;
+	dtNDIKUKARotationMatrix_.data()[8] = 0.115206;
 
-	dtSubWindowWaitForExecution_.exec();
-	// Derive NDI position
-	if (!getNDIFramesAverage(nMarker, -1, dtMarker, dtDummy, false,
-					NDI_FRAME_COUNT)) {
-		ROS_ERROR("Cannot get tool position data");
-		pushButton_CalculateNDIKUKARotation->setEnabled(true);
-		dtGetDataTimer_->start(NDI_TIME_INTERVAL);
-		return;
-	}
-	// Derive KUKA position
-	NDI_position_x[1] = dtMarker.dtTranslation.fTx;
-	NDI_position_y[1] = dtMarker.dtTranslation.fTy;
-	NDI_position_z[1] = dtMarker.dtTranslation.fTz;
+	/*0.050280, -0.937355, 0.353481
+	 0.134701, 0.391280, 0.877706
+	 -0.992092, 0.002654, 0.115206
+	 * */
 
-	AxisFeedback = dtController_.getFeedbackAxis();
-	dtLastAxis_.set(AxisFeedback);
-	pdtPlannar_->getModel().Axis2Frame(AxisFeedback, FrameFeedback);
-	Kuka_position_x[1] = FrameFeedback.X;
-	Kuka_position_y[1] = FrameFeedback.Y;
-	Kuka_position_z[1] = FrameFeedback.Z;
+	/* 0.069839, -0.864405, 0.506806
+	 0.105046, 0.504057, 0.856554
+	 -0.993359, -0.006206, 0.121104
+	 * */
+	finishCalculateRotationMatrix();
+#endif
+}
+void Interface::calculateRotationMatrixStep() {
 	// --------------------------------------------------------
-	// Pose 2
+	// Pose 1, 2 and 3: x, y and z are moved from pose 0
 	// --------------------------------------------------------
-	target_pose.position.x = Kuka_position_x[0] / 1000.0;
-	target_pose.position.y = (Kuka_position_y[0]
-			+ lineEdit_dY->text().toDouble()) / 1000.0;
-	target_pose.position.z = Kuka_position_z[0] / 1000.0;
-
-	motion_return_value = PlanAndExecuteTargetMotion(target_pose, "tip");
-	if (motion_return_value == MOTION_PLAN_EXECUTE) {
-		ROS_INFO("Motion plan execute");
-	} else {
+	geometry_msgs::Pose target_pose = dtRotationMatrixPose_;
+	Eigen::Vector3d position = vecdtRotationMatrixKUKA_[0];
+	if (nRotationMatrixPose_ == 1)
+		position.data()[0] += lineEdit_dX->text().toDouble();
+	else if (nRotationMatrixPose_ == 2)
+		position.data()[1] += lineEdit_dY->text().toDouble();
+	else
+		position.data()[2] += lineEdit_dZ->text().toDouble();
+	target_pose.position.x = position.data()[0] / 1000.0;
+	target_pose.position.y = position.data()[1] / 1000.0;
+	target_pose.position.z = position.data()[2] / 1000.0;
+
+	PlanAndExecuteTargetMotion(target_pose, "tip",
+			"calculateRotationMatrixMoved");
+}
+void Interface::calculateRotationMatrixMoved(int motion_return_value) {
+	if (motion_return_value != MOTION_PLAN_EXECUTE) {
 		pushButton_CalculateNDIKUKARotation->setEnabled(true);
 		dtGetDataTimer_->start(NDI_TIME_INTERVAL);
 		return;
 	}
 
-	dtSubWindowWaitForExecution_.exec();
+	Axis AxisFeedback;
+	Frame FrameFeedback;
+	QuatTransformation dtMarker, dtDummy;
 
-	if (!getNDIFramesAverage(nMarker, -1, dtMarker, dtDummy, false,
-					NDI_FRAME_COUNT)) {
+	// Derive NDI position
+	if (!getNDIFramesAverage(nRotationMatrixMarker_, -1, dtMarker, dtDummy,
+					false, NDI_FRAME_COUNT)) {
 		ROS_ERROR("Cannot get tool position data");
 		pushButton_CalculateNDIKUKARotation->setEnabled(true);
 		dtGetDataTimer_->start(NDI_TIME_INTERVAL);
 		return;
 	}
-	NDI_position_x[2] = dtMarker.dtTranslation.fTx;
-	NDI_position_y[2] = dtMarker.dtTranslation.fTy;
-	NDI_position_z[2] = dtMarker.dtTranslation.fTz;
+	vecdtRotationMatrixNDI_.push_back(
+			Eigen::Vector3d(dtMarker.dtTranslation.fTx,
+					dtMarker.dtTranslation.fTy, dtMarker.dtTranslation.fTz));
 
+	// Derive KUKA position
 	AxisFeedback = dtController_.getFeedbackAxis();
 	dtLastAxis_.set(AxisFeedback);
 	pdtPlannar_->getModel().Axis2Frame(AxisFeedback, FrameFeedback);
-	Kuka_position_x[2] = FrameFeedback.X;
-	Kuka_position_y[2] = FrameFeedback.Y;
-	Kuka_position_z[2] = FrameFeedback.Z;
-	// --------------------------------------------------------
-	// Pose 3
-	// --------------------------------------------------------
-	target_pose.position.x = Kuka_position_x[0] / 1000.0;
-	target_pose.position.y = Kuka_position_y[0] / 1000.0;
-	target_pose.position.z = (Kuka_position_z[0]
-			+ lineEdit_dZ->text().toDouble()) / 1000.0;
-
-	motion_return_value = PlanAndExecuteTargetMotion(target_pose, "tip");
-	if (motion_return_value == MOTION_PLAN_EXECUTE) {
-		ROS_INFO("Motion plan execute");
-	} else {
-		pushButton_CalculateNDIKUKARotation->setEnabled(true);
-		dtGetDataTimer_->start(NDI_TIME_INTERVAL);
-		return;
-	}
-
-	dtSubWindowWaitForExecution_.exec();
+	vecdtRotationMatrixKUKA_.push_back(
+			Eigen::Vector3d(FrameFeedback.X, FrameFeedback.Y, FrameFeedback.Z));
 
-	if (!getNDIFramesAverage(nMarker, -1, dtMarker, dtDummy, false,
-					NDI_FRAME_COUNT)) {
-		ROS_ERROR("Cannot get tool position data");
-		pushButton_CalculateNDIKUKARotation->setEnabled(true);
-		dtGetDataTimer_->start(NDI_TIME_INTERVAL);
+	if (++nRotationMatrixPose_ <= 3) {
+		calculateRotationMatrixStep();
 		return;
 	}
-	NDI_position_x[3] = dtMarker.dtTranslation.fTx;
-	NDI_position_y[3] = dtMarker.dtTranslation.fTy;
-	NDI_position_z[3] = dtMarker.dtTranslation.fTz;
-
-	AxisFeedback = dtController_.getFeedbackAxis();
-	dtLastAxis_.set(AxisFeedback);
-	pdtPlannar_->getModel().Axis2Frame(AxisFeedback, FrameFeedback);
-	Kuka_position_x[3] = FrameFeedback.X;
-	Kuka_position_y[3] = FrameFeedback.Y;
-	Kuka_position_z[3] = FrameFeedback.Z;
 
 	std::vector<Eigen::Vector3d> delta_NDI_position(6);
 	std::vector<Eigen::Vector3d> delta_KUKA_position(6);
@@ -2175,18 +2152,10 @@ void Interface::calculateRotationMatrix() {
 	int nPairCount = 0;
 	for (int i = 0; i < 3; i++) {
 		for (int j = i + 1; j <= 3; j++) {
-			delta_NDI_position[nPairCount].data()[0] = NDI_position_x[j]
-			- NDI_position_x[i];
-			delta_NDI_position[nPairCount].data()[1] = NDI_position_y[j]
-			- NDI_position_y[i];
-			delta_NDI_position[nPairCount].data()[2] = NDI_position_z[j]
-			- NDI_position_z[i];
-			delta_KUKA_position[nPairCount].data()[0] = Kuka_position_x[j]
-			- Kuka_position_x[i];
-			delta_KUKA_position[nPairCount].data()[1] = Kuka_position_y[j]
-			- Kuka_position_y[i];
-			delta_KUKA_position[nPairCount].data()[2] = Kuka_position_z[j]
-			- Kuka_position_z[i];
+			delta_NDI_position[nPairCount] = vecdtRotationMatrixNDI_[j]
+					- vecdtRotationMatrixNDI_[i];
+			delta_KUKA_position[nPairCount] = vecdtRotationMatrixKUKA_[j]
+					- vecdtRotationMatrixKUKA_[i];
 			nPairCount++;
 		}
 	}
@@ -2216,27 +2185,9 @@ void Interface::calculateRotationMatrix() {
 			dtNDIKUKARotationMatrix_.data()[8]);
 
 	dtGetDataTimer_->start(NDI_TIME_INTERVAL);
-#else
-	dtNDIKUKARotationMatrix_.data()[0] = 0.050280;
-	dtNDIKUKARotationMatrix_.data()[1] = 0.134701;
-	dtNDIKUKARotationMatrix_.data()[2] = -0.992092;
-	dtNDIKUKARotationMatrix_.data()[3] = -0.937355;
-	dtNDIKUKARotationMatrix_.data()[4] = 0.391280;
-	dtNDIKUKARotationMatrix_.data()[5] = 0.002654;
-	dtNDIKUKARotationMatrix_.data()[6] = 0.353481;
-	dtNDIKUKARotationMatrix_.data()[7] = 0.877706;
-	dtNDIKUKARotationMatrix_.data()[8] = 0.115206;
-
-	/*0.050280, -0.937355, 0.353481
-	 0.134701, 0.391280, 0.877706
-	 -0.992092, 0.002654, 0.115206
-	 * */
-
-	/* 0.069839, -0.864405, 0.506806
-	 0.105046, 0.504057, 0.856554
-	 -0.993359, -0.006206, 0.121104
-	 * */
-#endif
+	finishCalculateRotationMatrix();
+}
+void Interface::finishCalculateRotationMatrix() {
 	pushButton_CalculateNDIKUKARotation->setEnabled(true);
 	pushButton_NDIFeedbackParallelMove->setEnabled(true);
 	pushButton_CalculateTCPMarkerTransform->setEnabled(true);
@@ -2581,6 +2532,9 @@ int Interface::startTracking() {
 		 */
 		bIsTracking_ = true;
 		bStopTracking_ = false;
+		pdtNDITracker_->setReplyOption(radioButton_BXMode->isChecked(),
+				checkBox_0x0800->isChecked());
+		pdtNDITracker_->startAcquisition();
 
 		pushButton_StartTracking->setAccessibleName(QString("Stop Tracking"));
 		checkBox_HandleEnable->setEnabled(false);
@@ -2611,6 +2565,8 @@ int Interface::startTracking() {
  This routine stops the tracking procedure.
  *****************************************************************/
 int Interface::stopTracking() {
+	/* the serial port is back to this thread once the acquisition stops */
+	pdtNDITracker_->stopAcquisition();
 	if (pdtCommandHandling_->StopTracking()) {
 		/*
 		 * set the variable that will stop the thread.
@@ -2631,8 +2587,64 @@ int Interface::stopTracking() {
 		return 1;
 	} /* if */
 
+	pdtNDITracker_->startAcquisition();
 	return 0;
 } /* stopTracking */
+/*****************************************************************
+ Name:				restartTracking
+
+ Inputs:
+ None.
+
+ Return Value:
+ None.
+
+ Description:
+ This routine is called when the acquisition stopped because a
+ new port has become occupied. We do the following:
+ 1) Stop tracking
+ 2) Activate Ports
+ 3) Start Tracking
+ *****************************************************************/
+void Interface::restartTracking() {
+	pdtNDITracker_->stopAcquisition();
+	if (pdtCommandHandling_->StopTracking() && activatePorts()
+			&& pdtCommandHandling_->StartTracking()) {
+		pdtNDITracker_->startAcquisition();
+	} else {
+		ROS_ERROR("New occupied port is not available");
+		bStopTracking_ = true;
+		bIsTracking_ = false;
+	}
+} /* restartTracking */
+/*****************************************************************
+ Name:				getNDISample
+
+ Inputs:
+ double dTimeout - longest wait for a new sample, in seconds
+
+ Return Value:
+ bool - true if a new sample is copied, false otherwise
+
+ Description:
+ This routine copies the latest sample of the acquisition thread,
+ if newer than the last one used, to the handle data used by the
+ display and the calibration routines.
+ *****************************************************************/
+bool Interface::getNDISample(double dTimeout) {
+	NDISample dtSample;
+
+	if (!pdtNDITracker_->waitForSample(dtSample, ulNDISampleCount_, dTimeout))
+		return false;
+	ulNDISampleCount_ = dtSample.index + 1;
+	for (int i = 0; i < dtSample.toolCount; i++) {
+		pdtNDIHandles_[dtSample.tool[i].handle].dtXfrms =
+				dtSample.tool[i].transform;
+		pdtNDIHandles_[dtSample.tool[i].handle].dtHandleInfo =
+				dtSample.tool[i].status;
+	}
+	return true;
+} /* getNDISample */
 
 long Interface::getSystemTransformData() {
 	char pszTemp[256];
@@ -2649,35 +2661,12 @@ long Interface::getSystemTransformData() {
 	nTrackingMode_ = radioButton_TXMode->isChecked() ? 0 : 1;
 
 	/*
-	 * if tracking mode is 0, we are asking for TX data, else we are
-	 * asking for BX data.
-	 */
-	if (nTrackingMode_ == 0) {
-		if (!pdtCommandHandling_->GetTXTransforms(
-				bUse0x0800Option_ ? true : false))
-			return 0;
-	} /* if */
-	else if (nTrackingMode_ == 1) {
-		if (!pdtCommandHandling_->GetBXTransforms(
-				bUse0x0800Option_ ? true : false))
-			return 0;
-	} /* else if */
-
-	/*
-	 * if a new port has become occupied we do the following:
-	 * 1) Stop tracking
-	 * 2) Activate Ports
-	 * 3) Start Tracking
+	 * if tracking mode is 0, the acquisition thread asks for TX data,
+	 * else it asks for BX data.
 	 */
-	if (pdtCommandHandling_->dtSystemInformation_.nPortOccupied) {
-		if (pdtCommandHandling_->StopTracking() && activatePorts()
-				&& pdtCommandHandling_->StartTracking()) {
-		} else {
-			ROS_ERROR("New occupied port is not available");
-			bStopTracking_ = true;
-			bIsTracking_ = false;
-		}
-	} /* if */
+	pdtNDITracker_->setReplyOption(nTrackingMode_ == 1, bUse0x0800Option_);
+	if (!getNDISample(0.0))
+		return 0;
 //-----------------------------------------------------------
 // This is only for Point Indicator
 //-----------------------------------------------------------
@@ -2688,9 +2677,9 @@ long Interface::getSystemTransformData() {
 
 	q = Euler2Quaternion(0.0, 0.0, 0.0);
 	Original.dtRotation =
-			pdtCommandHandling_->pdtHandleInformation_[nActiveTool].dtXfrms.dtRotation;
+			pdtNDIHandles_[nActiveTool].dtXfrms.dtRotation;
 	Original.dtTranslation =
-			pdtCommandHandling_->pdtHandleInformation_[nActiveTool].dtXfrms.dtTranslation;
+			pdtNDIHandles_[nActiveTool].dtXfrms.dtTranslation;
 
 	OriginaltoNew.dtRotation.fQx = q.data()[0];
 	OriginaltoNew.dtRotation.fQy = q.data()[1];
@@ -2703,9 +2692,9 @@ long Interface::getSystemTransformData() {
 
 	QuatCombineXfrms(&OriginaltoNew, &Original, &New);
 
-	pdtCommandHandling_->pdtHandleInformation_[nActiveTool].dtXfrms.dtRotation =
+	pdtNDIHandles_[nActiveTool].dtXfrms.dtRotation =
 			New.dtRotation;
-	pdtCommandHandling_->pdtHandleInformation_[nActiveTool].dtXfrms.dtTranslation =
+	pdtNDIHandles_[nActiveTool].dtXfrms.dtTranslation =
 			New.dtTranslation;
 
 //---------------------------------------------------------------
@@ -2715,41 +2704,41 @@ long Interface::getSystemTransformData() {
 	int nIndicator = ASCIIToHex(
 			(char*) (comboBox_Indicator->currentText().toStdString().c_str()),
 			2);
-	if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtHandleInfo.nInitialized
+	if (pdtNDIHandles_[nMarker].dtHandleInfo.nInitialized
 			> 0
 			&& pdtCommandHandling_->pdtHandleInformation_[nMarker].pchrToolType[1]
 					!= '8') {
 		/* only update the frame if the handle isn't disabled*/
-		if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.ulFlags
+		if (pdtNDIHandles_[nMarker].dtXfrms.ulFlags
 				== TRANSFORM_VALID
-				|| pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.ulFlags
+				|| pdtNDIHandles_[nMarker].dtXfrms.ulFlags
 						== TRANSFORM_MISSING) {
 			strFrameNumber_ =
 					boost::lexical_cast<std::string>(
-							pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.ulFrameNumber);
+							pdtNDIHandles_[nMarker].dtXfrms.ulFrameNumber);
 			lineEdit_Frame->setText(QString(strFrameNumber_.c_str()));
 		}/* if */
 
-		if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.ulFlags
+		if (pdtNDIHandles_[nMarker].dtXfrms.ulFlags
 				== TRANSFORM_VALID) {
 
 			if (bUseTCPMarkerTransform_) {
 				dtMarkerTransform.dtRotation =
-						pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.dtRotation;
+						pdtNDIHandles_[nMarker].dtXfrms.dtRotation;
 				dtMarkerTransform.dtTranslation =
-						pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.dtTranslation;
+						pdtNDIHandles_[nMarker].dtXfrms.dtTranslation;
 				QuatCombineXfrms(&dtTCPMarkerTransform_, &dtMarkerTransform,
 						&dtNeedleTransform);
 				// Update the Marker port data
-				pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.dtRotation =
+				pdtNDIHandles_[nMarker].dtXfrms.dtRotation =
 						dtNeedleTransform.dtRotation;
-				pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.dtTranslation =
+				pdtNDIHandles_[nMarker].dtXfrms.dtTranslation =
 						dtNeedleTransform.dtTranslation;
 			} else {
 				dtNeedleTransform.dtRotation =
-						pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.dtRotation;
+						pdtNDIHandles_[nMarker].dtXfrms.dtRotation;
 				dtNeedleTransform.dtTranslation =
-						pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.dtTranslation;
+						pdtNDIHandles_[nMarker].dtXfrms.dtTranslation;
 			}
 
 			sprintf(pszTemp, "%.2f", dtNeedleTransform.dtTranslation.fTx);
@@ -2767,55 +2756,55 @@ long Interface::getSystemTransformData() {
 			sprintf(pszTemp, "%.4f", dtNeedleTransform.dtRotation.fQz);
 			lineEdit_Qz->setText(QString(pszTemp));
 			sprintf(pszTemp, "%.4f",
-					pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.fError);
+					pdtNDIHandles_[nMarker].dtXfrms.fError);
 			lineEdit_Error->setText(QString(pszTemp));
 
-			if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtHandleInfo.nPartiallyOutOfVolume)
+			if (pdtNDIHandles_[nMarker].dtHandleInfo.nPartiallyOutOfVolume)
 				lineEdit_Status->setText(QString("POOV"));
-			else if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtHandleInfo.nOutOfVolume)
+			else if (pdtNDIHandles_[nMarker].dtHandleInfo.nOutOfVolume)
 				lineEdit_Status->setText(QString("OOV"));
 			else
 				lineEdit_Status->setText(QString("OK"));
 		}/* if */
 		else {
-			if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.ulFlags
+			if (pdtNDIHandles_[nMarker].dtXfrms.ulFlags
 					== TRANSFORM_MISSING) {
 				lineEdit_Status->setText(QString("MISSING"));
 			} else {
 				lineEdit_Status->setText(QString("DISABLED"));
 			}
 
-			if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtHandleInfo.nPartiallyOutOfVolume)
+			if (pdtNDIHandles_[nMarker].dtHandleInfo.nPartiallyOutOfVolume)
 				lineEdit_Status->setText(QString("POOV"));
-			else if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtHandleInfo.nOutOfVolume)
+			else if (pdtNDIHandles_[nMarker].dtHandleInfo.nOutOfVolume)
 				lineEdit_Status->setText(QString("OOV"));
 			else
 				lineEdit_Status->setText(QString("---"));
 		}/* else */
 	}/* if */
 
-	if (pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtHandleInfo.nInitialized
+	if (pdtNDIHandles_[nIndicator].dtHandleInfo.nInitialized
 			> 0
 			&& pdtCommandHandling_->pdtHandleInformation_[nIndicator].pchrToolType[1]
 					!= '8') {
 		/* only update the frame if the handle isn't disabled*/
-		if (pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.ulFlags
+		if (pdtNDIHandles_[nIndicator].dtXfrms.ulFlags
 				== TRANSFORM_VALID
-				|| pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.ulFlags
+				|| pdtNDIHandles_[nIndicator].dtXfrms.ulFlags
 						== TRANSFORM_MISSING) {
 			strFrameNumber_ =
 					boost::lexical_cast<std::string>(
-							pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.ulFrameNumber);
+							pdtNDIHandles_[nIndicator].dtXfrms.ulFrameNumber);
 			lineEdit_Frame->setText(QString(strFrameNumber_.c_str()));
 		}/* if */
 
-		if (pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.ulFlags
+		if (pdtNDIHandles_[nIndicator].dtXfrms.ulFlags
 				== TRANSFORM_VALID) {
 
 			dtNeedleTransform.dtRotation =
-					pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.dtRotation;
+					pdtNDIHandles_[nIndicator].dtXfrms.dtRotation;
 			dtNeedleTransform.dtTranslation =
-					pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.dtTranslation;
+					pdtNDIHandles_[nIndicator].dtXfrms.dtTranslation;
 
 			sprintf(pszTemp, "%.2f", dtNeedleTransform.dtTranslation.fTx);
 			lineEdit_Tx_2->setText(QString(pszTemp));
@@ -2832,27 +2821,27 @@ long Interface::getSystemTransformData() {
 			sprintf(pszTemp, "%.4f", dtNeedleTransform.dtRotation.fQz);
 			lineEdit_Qz_2->setText(QString(pszTemp));
 			sprintf(pszTemp, "%.4f",
-					pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.fError);
+					pdtNDIHandles_[nIndicator].dtXfrms.fError);
 			lineEdit_Error_2->setText(QString(pszTemp));
 
-			if (pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtHandleInfo.nPartiallyOutOfVolume)
+			if (pdtNDIHandles_[nIndicator].dtHandleInfo.nPartiallyOutOfVolume)
 				lineEdit_Status_2->setText(QString("POOV"));
-			else if (pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtHandleInfo.nOutOfVolume)
+			else if (pdtNDIHandles_[nIndicator].dtHandleInfo.nOutOfVolume)
 				lineEdit_Status_2->setText(QString("OOV"));
 			else
 				lineEdit_Status_2->setText(QString("OK"));
 		}/* if */
 		else {
-			if (pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.ulFlags
+			if (pdtNDIHandles_[nIndicator].dtXfrms.ulFlags
 					== TRANSFORM_MISSING) {
 				lineEdit_Status_2->setText(QString("MISSING"));
 			} else {
 				lineEdit_Status_2->setText(QString("DISABLED"));
 			}
 
-			if (pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtHandleInfo.nPartiallyOutOfVolume)
+			if (pdtNDIHandles_[nIndicator].dtHandleInfo.nPartiallyOutOfVolume)
 				lineEdit_Status->setText(QString("POOV"));
-			else if (pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtHandleInfo.nOutOfVolume)
+			else if (pdtNDIHandles_[nIndicator].dtHandleInfo.nOutOfVolume)
 				lineEdit_Status_2->setText(QString("OOV"));
 			else
 				lineEdit_Status_2->setText(QString("---"));
@@ -2919,35 +2908,12 @@ long Interface::getSystemTransformData(bool bUpdateGUI) {
 	nTrackingMode_ = radioButton_TXMode->isChecked() ? 0 : 1;
 
 	/*
-	 * if tracking mode is 0, we are asking for TX data, else we are
-	 * asking for BX data.
-	 */
-	if (nTrackingMode_ == 0) {
-		if (!pdtCommandHandling_->GetTXTransforms(
-				bUse0x0800Option_ ? true : false))
-			return 0;
-	} /* if */
-	else if (nTrackingMode_ == 1) {
-		if (!pdtCommandHandling_->GetBXTransforms(
-				bUse0x0800Option_ ? true : false))
-			return 0;
-	} /* else if */
-
-	/*
-	 * if a new port has become occupied we do the following:
-	 * 1) Stop tracking
-	 * 2) Activate Ports
-	 * 3) Start Tracking
+	 * if tracking mode is 0, the acquisition thread asks for TX data,
+	 * else it asks for BX data.
 	 */
-	if (pdtCommandHandling_->dtSystemInformation_.nPortOccupied) {
-		if (pdtCommandHandling_->StopTracking() && activatePorts()
-				&& pdtCommandHandling_->StartTracking()) {
-		} else {
-			ROS_ERROR("New occupied port is not available");
-			bStopTracking_ = true;
-			bIsTracking_ = false;
-		}
-	} /* if */
+	pdtNDITracker_->setReplyOption(nTrackingMode_ == 1, bUse0x0800Option_);
+	if (!getNDISample(NDI_SAMPLE_TIMEOUT))
+		return 0;
 //-----------------------------------------------------------
 // This is only for Point Indicator
 //-----------------------------------------------------------
@@ -2958,9 +2924,9 @@ long Interface::getSystemTransformData(bool bUpdateGUI) {
 
 	q = Euler2Quaternion(0.0, 0.0, 0.0);
 	Original.dtRotation =
-			pdtCommandHandling_->pdtHandleInformation_[nActiveTool].dtXfrms.dtRotation;
+			pdtNDIHandles_[nActiveTool].dtXfrms.dtRotation;
 	Original.dtTranslation =
-			pdtCommandHandling_->pdtHandleInformation_[nActiveTool].dtXfrms.dtTranslation;
+			pdtNDIHandles_[nActiveTool].dtXfrms.dtTranslation;
 
 	OriginaltoNew.dtRotation.fQx = q.data()[0];
 	OriginaltoNew.dtRotation.fQy = q.data()[1];
@@ -2973,9 +2939,9 @@ long Interface::getSystemTransformData(bool bUpdateGUI) {
 
 	QuatCombineXfrms(&OriginaltoNew, &Original, &New);
 
-	pdtCommandHandling_->pdtHandleInformation_[nActiveTool].dtXfrms.dtRotation =
+	pdtNDIHandles_[nActiveTool].dtXfrms.dtRotation =
 			New.dtRotation;
-	pdtCommandHandling_->pdtHandleInformation_[nActiveTool].dtXfrms.dtTranslation =
+	pdtNDIHandles_[nActiveTool].dtXfrms.dtTranslation =
 			New.dtTranslation;
 
 //---------------------------------------------------------------
@@ -2985,41 +2951,41 @@ long Interface::getSystemTransformData(bool bUpdateGUI) {
 	int nIndicator = ASCIIToHex(
 			(char*) (comboBox_Indicator->currentText().toStdString().c_str()),
 			2);
-	if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtHandleInfo.nInitialized
+	if (pdtNDIHandles_[nMarker].dtHandleInfo.nInitialized
 			> 0
 			&& pdtCommandHandling_->pdtHandleInformation_[nMarker].pchrToolType[1]
 					!= '8') {
 		/* only update the frame if the handle isn't disabled*/
-		if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.ulFlags
+		if (pdtNDIHandles_[nMarker].dtXfrms.ulFlags
 				== TRANSFORM_VALID
-				|| pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.ulFlags
+				|| pdtNDIHandles_[nMarker].dtXfrms.ulFlags
 						== TRANSFORM_MISSING) {
 			strFrameNumber_ =
 					boost::lexical_cast<std::string>(
-							pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.ulFrameNumber);
+							pdtNDIHandles_[nMarker].dtXfrms.ulFrameNumber);
 			lineEdit_Frame->setText(QString(strFrameNumber_.c_str()));
 		}/* if */
 
-		if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.ulFlags
+		if (pdtNDIHandles_[nMarker].dtXfrms.ulFlags
 				== TRANSFORM_VALID) {
 
 			if (bUseTCPMarkerTransform_) {
 				dtMarkerTransform.dtRotation =
-						pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.dtRotation;
+						pdtNDIHandles_[nMarker].dtXfrms.dtRotation;
 				dtMarkerTransform.dtTranslation =
-						pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.dtTranslation;
+						pdtNDIHandles_[nMarker].dtXfrms.dtTranslation;
 				QuatCombineXfrms(&dtTCPMarkerTransform_, &dtMarkerTransform,
 						&dtNeedleTransform);
 				// Update the Marker port data
-				pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.dtRotation =
+				pdtNDIHandles_[nMarker].dtXfrms.dtRotation =
 						dtNeedleTransform.dtRotation;
-				pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.dtTranslation =
+				pdtNDIHandles_[nMarker].dtXfrms.dtTranslation =
 						dtNeedleTransform.dtTranslation;
 			} else {
 				dtNeedleTransform.dtRotation =
-						pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.dtRotation;
+						pdtNDIHandles_[nMarker].dtXfrms.dtRotation;
 				dtNeedleTransform.dtTranslation =
-						pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.dtTranslation;
+						pdtNDIHandles_[nMarker].dtXfrms.dtTranslation;
 			}
 
 			if (bUpdateGUI) {
@@ -3038,12 +3004,12 @@ long Interface::getSystemTransformData(bool bUpdateGUI) {
 				sprintf(pszTemp, "%.4f", dtNeedleTransform.dtRotation.fQz);
 				lineEdit_Qz->setText(QString(pszTemp));
 				sprintf(pszTemp, "%.4f",
-						pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.fError);
+						pdtNDIHandles_[nMarker].dtXfrms.fError);
 				lineEdit_Error->setText(QString(pszTemp));
 
-				if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtHandleInfo.nPartiallyOutOfVolume)
+				if (pdtNDIHandles_[nMarker].dtHandleInfo.nPartiallyOutOfVolume)
 					lineEdit_Status->setText(QString("POOV"));
-				else if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtHandleInfo.nOutOfVolume)
+				else if (pdtNDIHandles_[nMarker].dtHandleInfo.nOutOfVolume)
 					lineEdit_Status->setText(QString("OOV"));
 				else
 					lineEdit_Status->setText(QString("OK"));
@@ -3051,16 +3017,16 @@ long Interface::getSystemTransformData(bool bUpdateGUI) {
 		}/* if */
 		else {
 			if (bUpdateGUI) {
-				if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtXfrms.ulFlags
+				if (pdtNDIHandles_[nMarker].dtXfrms.ulFlags
 						== TRANSFORM_MISSING) {
 					lineEdit_Status->setText(QString("MISSING"));
 				} else {
 					lineEdit_Status->setText(QString("DISABLED"));
 				}
 
-				if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtHandleInfo.nPartiallyOutOfVolume)
+				if (pdtNDIHandles_[nMarker].dtHandleInfo.nPartiallyOutOfVolume)
 					lineEdit_Status->setText(QString("POOV"));
-				else if (pdtCommandHandling_->pdtHandleInformation_[nMarker].dtHandleInfo.nOutOfVolume)
+				else if (pdtNDIHandles_[nMarker].dtHandleInfo.nOutOfVolume)
 					lineEdit_Status->setText(QString("OOV"));
 				else
 					lineEdit_Status->setText(QString("---"));
@@ -3068,28 +3034,28 @@ long Interface::getSystemTransformData(bool bUpdateGUI) {
 		}/* else */
 	}/* if */
 
-	if (pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtHandleInfo.nInitialized
+	if (pdtNDIHandles_[nIndicator].dtHandleInfo.nInitialized
 			> 0
 			&& pdtCommandHandling_->pdtHandleInformation_[nIndicator].pchrToolType[1]
 					!= '8') {
 		/* only update the frame if the handle isn't disabled*/
-		if (pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.ulFlags
+		if (pdtNDIHandles_[nIndicator].dtXfrms.ulFlags
 				== TRANSFORM_VALID
-				|| pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.ulFlags
+				|| pdtNDIHandles_[nIndicator].dtXfrms.ulFlags
 						== TRANSFORM_MISSING) {
 			strFrameNumber_ =
 					boost::lexical_cast<std::string>(
-							pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.ulFrameNumber);
+							pdtNDIHandles_[nIndicator].dtXfrms.ulFrameNumber);
 			lineEdit_Frame->setText(QString(strFrameNumber_.c_str()));
 		}/* if */
 
-		if (pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.ulFlags
+		if (pdtNDIHandles_[nIndicator].dtXfrms.ulFlags
 				== TRANSFORM_VALID) {
 
 			dtNeedleTransform.dtRotation =
-					pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.dtRotation;
+					pdtNDIHandles_[nIndicator].dtXfrms.dtRotation;
 			dtNeedleTransform.dtTranslation =
-					pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.dtTranslation;
+					pdtNDIHandles_[nIndicator].dtXfrms.dtTranslation;
 
 			if (bUpdateGUI) {
 				sprintf(pszTemp, "%.2f", dtNeedleTransform.dtTranslation.fTx);
@@ -3107,12 +3073,12 @@ long Interface::getSystemTransformData(bool bUpdateGUI) {
 				sprintf(pszTemp, "%.4f", dtNeedleTransform.dtRotation.fQz);
 				lineEdit_Qz_2->setText(QString(pszTemp));
 				sprintf(pszTemp, "%.4f",
-						pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.fError);
+						pdtNDIHandles_[nIndicator].dtXfrms.fError);
 				lineEdit_Error_2->setText(QString(pszTemp));
 
-				if (pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtHandleInfo.nPartiallyOutOfVolume)
+				if (pdtNDIHandles_[nIndicator].dtHandleInfo.nPartiallyOutOfVolume)
 					lineEdit_Status_2->setText(QString("POOV"));
-				else if (pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtHandleInfo.nOutOfVolume)
+				else if (pdtNDIHandles_[nIndicator].dtHandleInfo.nOutOfVolume)
 					lineEdit_Status_2->setText(QString("OOV"));
 				else
 					lineEdit_Status_2->setText(QString("OK"));
@@ -3120,16 +3086,16 @@ long Interface::getSystemTransformData(bool bUpdateGUI) {
 		}/* if */
 		else {
 			if (bUpdateGUI) {
-				if (pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtXfrms.ulFlags
+				if (pdtNDIHandles_[nIndicator].dtXfrms.ulFlags
 						== TRANSFORM_MISSING) {
 					lineEdit_Status_2->setText(QString("MISSING"));
 				} else {
 					lineEdit_Status_2->setText(QString("DISABLED"));
 				}
 
-				if (pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtHandleInfo.nPartiallyOutOfVolume)
+				if (pdtNDIHandles_[nIndicator].dtHandleInfo.nPartiallyOutOfVolume)
 					lineEdit_Status->setText(QString("POOV"));
-				else if (pdtCommandHandling_->pdtHandleInformation_[nIndicator].dtHandleInfo.nOutOfVolume)
+				else if (pdtNDIHandles_[nIndicator].dtHandleInfo.nOutOfVolume)
 					lineEdit_Status_2->setText(QString("OOV"));
 				else
 					lineEdit_Status_2->setText(QString("---"));
@@ -3771,7 +3737,8 @@ void Interface::manipulateCollisionObject() {
 
 	QListWidgetItem* collision_item = new QListWidgetItem;
 
-	moveit_msgs::PlanningScene planning_scene;
+	// Published as one diff, acknowledged before the list is updated
+	SceneTransaction collision_transaction("world");
 
 	geometry_msgs::Pose::_orientation_type collision_quaternion;
 	std::vector<double> collision_euler_angle;
@@ -3853,11 +3820,9 @@ void Interface::manipulateCollisionObject() {
 		collision_object.header.stamp = ros::Time::now();
 		collision_object.header.seq = nCollisionOperationCount_++;
 
-		planning_scene.world.collision_objects.clear();
-		planning_scene.world.collision_objects.push_back(collision_object);
-
-		planning_scene.is_diff = true;
-		dtPlanningSceneDiffPublisher_.publish(planning_scene);
+		collision_transaction.add(collision_object);
+		if (!dtController_.commitScene(collision_transaction))
+			ROS_WARN("Adding collision object is not acknowledged");
 
 		collision_item->setText(lineEdit_CollisionID->text());
 		listWidget_CurrentCollisionObject->insertItem(1, collision_item);
@@ -3865,15 +3830,10 @@ void Interface::manipulateCollisionObject() {
 	} else if (operation_index == 1) {
 		ROS_INFO("Remove collision object");
 
-		collision_object.operation = collision_object.REMOVE;
-		collision_object.id =
-				listWidget_CurrentCollisionObject->currentItem()->text().toStdString();
-
-		planning_scene.world.collision_objects.clear();
-		planning_scene.world.collision_objects.push_back(collision_object);
-		planning_scene.is_diff = true;
-
-		dtPlanningSceneDiffPublisher_.publish(planning_scene);
+		collision_transaction.remove(
+				listWidget_CurrentCollisionObject->currentItem()->text().toStdString());
+		if (!dtController_.commitScene(collision_transaction))
+			ROS_WARN("Removing collision object is not acknowledged");
 
 		listWidget_CurrentCollisionObject->removeItemWidget(
 				listWidget_CurrentCollisionObject->currentItem());
@@ -3903,11 +3863,7 @@ void Interface::visualizeJointPlan() {
 	target_joints["joint5"] = lineEdit_Joint5->text().toDouble() / 180.0 * M_PI;
 	target_joints["joint6"] = lineEdit_Joint6->text().toDouble() / 180.0 * M_PI;
 
-	if (!dtController_.planTargetMotion(target_joints)) {
-		ROS_ERROR("Motion plan failed");
-		return;
-	}
-	pushButton_ExecutePlan->setEnabled(true);
+	planAsync(target_joints, pushButton_ExecutePlan);
 }
 void Interface::visualizePosePlan() {
 
@@ -3942,11 +3898,7 @@ void Interface::visualizePosePlan() {
 	target_pose.orientation.z = Quaternion.data()[2];
 	target_pose.orientation.w = Quaternion.data()[3];
 
-	if (!dtController_.planTargetMotion(target_pose, "tip")) {
-		ROS_ERROR("Motion plan failed");
-		return;
-	}
-	pushButton_ExecutePlan->setEnabled(true);
+	planAsync(target_pose, pushButton_ExecutePlan);
 }
 void Interface::visualizeIncrPosePlan() {
 
@@ -3986,11 +3938,7 @@ void Interface::visualizeIncrPosePlan() {
 	target_pose.orientation.z = Quarternion.data()[2];
 	target_pose.orientation.w = Quarternion.data()[3];
 
-	if (!dtController_.planTargetMotion(target_pose, "tip")) {
-		ROS_ERROR("Motion plan failed");
-		return;
-	}
-	pushButton_ExecutePlan->setEnabled(true);
+	planAsync(target_pose, pushButton_ExecutePlan);
 }
 void Interface::addWaypoints() {
 	if (lineEdit_TransX->text().isEmpty() || lineEdit_TransY->text().isEmpty()
@@ -4117,13 +4065,45 @@ void Interface::rotateAroundAxis() {
 	target_pose.position.y = vector_rotate.data[1] / 1000.0;
 	target_pose.position.z = vector_rotate.data[2] / 1000.0;
 
-	if (!dtController_.planTargetMotion(target_pose, "tip")) {
-		ROS_ERROR("motion plan failed");
+	planAsync(target_pose, pushButton_ExecuteRotatePlan);
+
+}
+void Interface::planAsync(std::map<std::string, double> target_joints,
+		QPushButton* button) {
+	MotionPlanPtr executing_plan = dtController_.getExecutingPlan();
+	if (pdtPendingPlan_)
+		pdtPendingPlan_->cancel();
+	pdtPendingPlan_ = dtController_.planAsync(target_joints,
+			GUI_PLAN_DEADLINE, executing_plan);
+	pdtPendingPlanButton_ = button;
+	button->setEnabled(false);
+}
+void Interface::planAsync(geometry_msgs::Pose target_pose,
+		QPushButton* button) {
+	MotionPlanPtr executing_plan = dtController_.getExecutingPlan();
+	if (pdtPendingPlan_)
+		pdtPendingPlan_->cancel();
+	pdtPendingPlan_ = dtController_.planAsync(target_pose, "tip",
+			GUI_PLAN_DEADLINE, executing_plan);
+	pdtPendingPlanButton_ = button;
+	button->setEnabled(false);
+}
+void Interface::planFinished(PlanHandle handle) {
+	if (handle == pdtTargetMotionPlan_) {
+		targetMotionPlanned(handle);
 		return;
 	}
-
-	pushButton_ExecuteRotatePlan->setEnabled(true);
-
+	// Cancelled plans are ignored
+	if (handle != pdtPendingPlan_)
+		return;
+	pdtPendingPlan_.reset();
+	if (handle->getStatus() != PlanRequest::Succeeded) {
+		ROS_ERROR("Motion plan %s",
+				PlanRequest::getStatusName(handle->getStatus()));
+		return;
+	}
+	dtController_.setMotionPlan(handle->getMotionPlan());
+	pdtPendingPlanButton_->setEnabled(true);
 }
 void Interface::executeMotionPlan() {
 
@@ -4132,29 +4112,12 @@ void Interface::executeMotionPlan() {
 	}
 }
 
-void Interface::newFeedbackReceived(Feedback* feedback) {
-
-	Axis AxisFeedback;
-	AxisFeedback = feedback->getAxis();
-
-	nJointStatePublishCount_++;
-	dtJointState_.header.seq = nJointStatePublishCount_;
-	dtJointState_.position[0] = AxisFeedback.A1 / 180.0 * M_PI;
-	dtJointState_.position[1] = AxisFeedback.A2 / 180.0 * M_PI;
-	dtJointState_.position[2] = AxisFeedback.A3 / 180.0 * M_PI;
-	dtJointState_.position[3] = AxisFeedback.A4 / 180.0 * M_PI;
-	dtJointState_.position[4] = AxisFeedback.A5 / 180.0 * M_PI;
-	dtJointState_.position[5] = AxisFeedback.A6 / 180.0 * M_PI;
-	dtJointState_.header.stamp = ros::Time::now();
-	dtJointStatePublisher_.publish(dtJointState_);
-}
-void Interface::visualizeMotionPlan(
-		moveit::planning_interface::MoveGroup::Plan motion_plan) {
+void Interface::visualizeMotionPlan(MotionPlanPtr plan) {
 
 	ROS_INFO("Visualizing plan");
 
-	dtDisplayTrajectory_.trajectory_start = motion_plan.start_state_;
-	dtDisplayTrajectory_.trajectory.push_back(motion_plan.trajectory_);
+	dtDisplayTrajectory_.trajectory_start = plan->start_state_;
+	dtDisplayTrajectory_.trajectory.push_back(plan->trajectory_);
 
 	dtDisplayPublisher_.publish(dtDisplayTrajectory_);
 }
@@ -4177,6 +4140,14 @@ void Interface::visualizeExecutePlanCb() {
 	ROS_INFO("Interface: visualize and execute plan callback");
 	emit visualizeExecutePlan();
 }
+void Interface::toggleServoCb() {
+	ROS_INFO("Interface: toggle servo mode callback");
+	emit toggleServo();
+}
+void Interface::cartesianPathCb() {
+	ROS_INFO("Interface: Cartesian path callback");
+	emit cartesianPath();
+}
 void Interface::endEffectorPosCb(
 		const InteractiveMarkerFeedbackConstPtr &feedback) {
 	lineEdit_TransX->setText(
@@ -4233,6 +4204,16 @@ void visualizeExecutePlanCb_global(
 	ROS_INFO("Global: visualize and execute plan");
 	kuka_interface->visualizeExecutePlanCb();
 }
+void toggleServoCb_global(const InteractiveMarkerFeedbackConstPtr &feedback) {
+	// The Workaround of the MenuHandler insert function problem
+	ROS_INFO("Global: toggle servo mode");
+	kuka_interface->toggleServoCb();
+}
+void cartesianPathCb_global(const InteractiveMarkerFeedbackConstPtr &feedback) {
+	// The Workaround of the MenuHandler insert function problem
+	ROS_INFO("Global: Cartesian path");
+	kuka_interface->cartesianPathCb();
+}
 
 // Menu Interaction related
 Marker Interface::makeBox(InteractiveMarker &msg) {
@@ -4287,6 +4268,11 @@ void Interface::initMenu() {
 	vecdtMenuEntry_.push_back(
 			dtMenuHandler_.insert("Visualize and Execute motion plan",
 					visualizeExecutePlanCb_global));
+	vecdtMenuEntry_.push_back(
+			dtMenuHandler_.insert("Servo mode on / off", toggleServoCb_global));
+	vecdtMenuEntry_.push_back(
+			dtMenuHandler_.insert("Plan and execute Cartesian path",
+					cartesianPathCb_global));
 }
 
 // Functions for Sing Command Tab
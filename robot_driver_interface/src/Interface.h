@@ -27,11 +27,16 @@
 #include "WaitForIndicatorPlaced.h"
 #include "EulerQuaternionConversion.h"
 #include "controller.h"
+#include "tracker.h"
 
-#define NDI_TIME_INTERVAL 2000
+// Interval of displaying the latest NDI sample, in ms
+#define NDI_TIME_INTERVAL 100
+// Longest wait for a new NDI sample, in seconds
+#define NDI_SAMPLE_TIMEOUT 1.0
 #define NDI_FRAME_COUNT 30
-#define MAX_MOVE_ANGLE 3
 #define MINIMUM_PARALLEL_MOVE_THRESHOLD 0.1
+// Deadline of plans requested from the GUI, in seconds
+#define GUI_PLAN_DEADLINE 10.0
 
 #define USE_FIXED_NDI_KUKA_ROTATION
 #define USE_FIXED_MARKER_FLANGE_TRANSLATION
@@ -62,6 +67,8 @@ public:
 			const control_msgs::FollowJointTrajectoryActionGoalConstPtr& feedback);
 	void addWaypointsCb();
 	void visualizeExecutePlanCb();
+	void toggleServoCb();
+	void cartesianPathCb();
 	void endEffectorPosCb(const InteractiveMarkerFeedbackConstPtr &feedback);
 
 	void setAlignment();
@@ -70,12 +77,25 @@ public:
 	int activatePorts();
 	void XYZNPointMethod(std::vector<Frame> &KUKAFrames,
 			Eigen::Vector3d &TCPTranslation);
-	int PlanAndExecuteTargetMotion(geometry_msgs::Pose target_pose,
-			std::string end_effector_link);
+// Plan and execute the motion to target_pose, without blocking the GUI: the
+// user decides on the plan if any axis moves more than MAX_MOVE_ANGLE, and
+// the slot named continuation, taking an int, is invoked when the motion is
+// complete (MOTION_PLAN_EXECUTE), or with MOTION_PLAN_FAIL or
+// MOTION_PLAN_CANCEL
+// if small_target is not NULL and it is close enough, the robot servos to it
+// without MoveIt planning, see Plannar::solveServoToFrame
+	void PlanAndExecuteTargetMotion(geometry_msgs::Pose target_pose,
+			std::string end_effector_link, const char* continuation,
+			Frame* small_target = NULL);
+// Asynchronous planning, from the end of the executing motion if any,
+// button is enabled by planFinished if the plan succeeds
+	void planAsync(std::map<std::string, double> target_joints,
+			QPushButton* button);
+	void planAsync(geometry_msgs::Pose target_pose, QPushButton* button);
 public slots:
-	void newFeedbackReceived(Feedback* feedback);
+	void planFinished(PlanHandle handle);
 	void shutdown();
-	void visualizeMotionPlan(MotionPlan motion_plan);
+	void visualizeMotionPlan(MotionPlanPtr plan);
 	void visualizeJointPlan();
 	void visualizePosePlan();
 	void visualizeIncrPosePlan();
@@ -99,7 +119,7 @@ public slots:
 	void on_terminate_buf_button_clicked();
 	void on_convert_button_clicked();
 	void calculateRotationMatrix();
-	bool ndiFeedbackParallelMove();
+	void ndiFeedbackParallelMove();
 	void ndiFeedbackMove();
 	void calculateTCPMarkerTransform();
 	void calculateNDIKUKATransform();
@@ -111,6 +131,19 @@ public slots:
 	void closeDialogWindow();
 	void copyCurrentTCPState();
 	void copyCurrentTCPXYZKUKAABC();
+	// Steps of PlanAndExecuteTargetMotion
+	void targetMotionDecided();
+	void targetMotionExecuted();
+	// Steps of the calibration routines, continued when a motion is done
+	void ndiFeedbackMoveExecuted(int motion_return_value);
+	void ndiFeedbackParallelMoveRotated(int motion_return_value);
+	void ndiFeedbackParallelMoveExecuted(int motion_return_value);
+	void ABC2PointStep();
+	void ABC2PointMoved(bool success);
+	void calculateNDIKUKATransformStep();
+	void calculateNDIKUKATransformMoved(int motion_return_value);
+	void calculateRotationMatrixStep();
+	void calculateRotationMatrixMoved(int motion_return_value);
 	//NDI related
 	bool getNDIFramesAverage(int nMarker, int nNeedle,
 			QuatTransformation& dtMarker, QuatTransformation& dtNDINeedlePoint,
@@ -121,6 +154,7 @@ public slots:
 	void trackingButton();
 	int startTracking();
 	int stopTracking();
+	void restartTracking();
 	long getSystemTransformData(bool bUpdateGUI);
 	long getSystemTransformData();
 	long comPortTimeout();
@@ -149,9 +183,13 @@ signals:
 // Send trajectory to controller object
 	void addWaypointsSignal();
 	void visualizeExecutePlan();
+	void toggleServo();
+	void cartesianPath();
 	void executeMotionPlan_signal();
 	void endEffectorPos(const InteractiveMarkerFeedbackConstPtr &feedback);
 	void changeMotionCompleteDelayTime(double delay_time);
+	// Direct PTP motion of Plannar, on the thread of Plannar
+	void servoToAxis(Axis target);
 
 private:
 	boost::shared_ptr<ros::NodeHandle> pdtNodeHandle_;
@@ -163,11 +201,6 @@ private:
 	ros::Publisher dtDisplayPublisher_;
 	moveit_msgs::DisplayTrajectory dtDisplayTrajectory_;
 
-// Joints state publisher and subscriber
-	ros::Publisher dtJointStatePublisher_;
-	sensor_msgs::JointState dtJointState_;
-	int nJointStatePublishCount_;
-
 // Interactive Marker related
 	ros::Subscriber dtInteractiveMarkerSubsriber_;
 	interactive_markers::MenuHandler dtMenuHandler_;
@@ -178,8 +211,7 @@ private:
 // Pointer to Plannar object
 	boost::shared_ptr<Plannar> pdtPlannar_;
 
-// Publisher for planning scene
-	ros::Publisher dtPlanningSceneDiffPublisher_;
+// Counter of collision objects added
 	int nCollisionOperationCount_;
 
 // counter for displaying robot state
@@ -229,6 +261,16 @@ private:
 	bool bStopTracking_; /* flag that tells the thread to stop tracking */
 	bool bIsTracking_; /* flag that specifies if we are tracking */
 
+	// Thread acquiring the NDI samples while tracking
+	boost::shared_ptr<NDITracker> pdtNDITracker_;
+	// Transforms and status of the latest sample used, by port handle
+	HandleInformation pdtNDIHandles_[NO_HANDLES];
+	// Samples acquired when the latest one was used
+	unsigned long ulNDISampleCount_;
+	// Copy the NDI sample newer than ulNDISampleCount_ to pdtNDIHandles_
+	// if return false, no new sample within timeout (in seconds)
+	bool getNDISample(double timeout);
+
 	COMPortSettings dtSubWindowCOMPortSettings_;
 	NewAlertFlagsDlg dtSubWindowNewAlertFlags_;
 	SystemFeaturesDlg dtSubWindowSystemFeatures_;
@@ -245,6 +287,23 @@ private:
 
 	Controller dtController_;
 	QThread* dtControllerThread_;
+	// Latest plan requested from the GUI, an older one is cancelled
+	PlanHandle pdtPendingPlan_;
+	QPushButton* pdtPendingPlanButton_;
+
+	// Motion of PlanAndExecuteTargetMotion, the plan is NULL unless planning
+	PlanHandle pdtTargetMotionPlan_;
+	geometry_msgs::Pose dtTargetMotionPose_;
+	std::string strTargetMotionLink_;
+	// Slot invoked when the motion is done, NULL if no motion is pending
+	const char* pcTargetMotionContinuation_;
+	// Waiting for dtSubWindowWaitForExecution_ to be closed
+	bool bTargetMotionExecuting_;
+	void planTargetMotion();
+	void targetMotionPlanned(PlanHandle handle);
+	void executeTargetMotion(double delay_time);
+	void waitForTargetMotion();
+	void finishTargetMotion(int motion_return_value);
 
 	Frame dtFrameFeedback_;
 
@@ -275,11 +334,67 @@ private:
 	bool bTCPMarkerFlip_;
 
 	double dParallelMoveThreshold_;
+
+//------------------------------------------------------------------------------------------------------------------
+// State of the calibration routines between their motions
+//------------------------------------------------------------------------------------------------------------------
+	// ndiFeedbackMove: target TCP in NDI frame
+	int nFeedbackMoveMarker_;
+	Eigen::Matrix3d dtFeedbackMoveRotationMatrix_;
+	Eigen::Vector3d dtFeedbackMoveTranslationVector_;
+	void ndiFeedbackMoveStep();
+	void finishNDIFeedbackMove();
+
+	// ndiFeedbackParallelMove: reference point in NDI frame, the slot named
+	// continuation, taking a bool, is invoked when done if not NULL
+	// if return false, the move has not started and continuation is not
+	// invoked
+	bool startNDIFeedbackParallelMove(const char* continuation);
+	void ndiFeedbackParallelMoveStep();
+	void finishNDIFeedbackParallelMove(bool success);
+	const char* pcParallelMoveContinuation_;
+	int nParallelMoveMarker_;
+	Eigen::Vector3d dtParallelMoveReference_;
+	geometry_msgs::Pose dtParallelMovePose_;
+	int nParallelMoveIterationCount_;
+	double pdParallelMoveError_[2];
+
+	// ABC2PointCalibrate: 1 for the point on the x direction, 2 for the
+	// point on the xy plane
+	int nABC2PointPhase_;
+	int nABC2PointMarker_;
+	int nABC2PointIndicator_;
+	Eigen::Matrix3d dtABC2PointRotationA_;
+	Eigen::Vector3d dtABC2PointTranslationA_;
+	Eigen::Vector3d dtABC2PointTranslationB_;
+	void finishABC2PointCalibrate();
+
+	// calculateNDIKUKATransform: index of the 8 positions, bits are the
+	// increments of x, y and z
+	int nNDIKUKATransformPosition_;
+	int nNDIKUKATransformMarker_;
+	double dNDIKUKATransformDistance_;
+	geometry_msgs::Pose dtNDIKUKATransformPose_;
+	std::vector<Eigen::Vector3d> vecdtNDIKUKATransformNDI_;
+	std::vector<Eigen::Vector3d> vecdtNDIKUKATransformKUKA_;
+	void calculateNDIKUKATransformResult();
+	void finishCalculateNDIKUKATransform();
+
+	// calculateRotationMatrix: pose 0 is the initial one, then x, y and z are
+	// moved in turn
+	int nRotationMatrixPose_;
+	int nRotationMatrixMarker_;
+	geometry_msgs::Pose dtRotationMatrixPose_;
+	std::vector<Eigen::Vector3d> vecdtRotationMatrixNDI_;
+	std::vector<Eigen::Vector3d> vecdtRotationMatrixKUKA_;
+	void finishCalculateRotationMatrix();
 };
 
 void addWaypointsCb_global(const InteractiveMarkerFeedbackConstPtr &feedback);
 void visualizeExecutePlanCb_global(
 		const InteractiveMarkerFeedbackConstPtr &feedback);
+void toggleServoCb_global(const InteractiveMarkerFeedbackConstPtr &feedback);
+void cartesianPathCb_global(const InteractiveMarkerFeedbackConstPtr &feedback);
 extern boost::shared_ptr<Interface> kuka_interface;
 
 #endif /* ROBOT_DRIVER_INTERFACE_SRC_INTERFACE_H_ */
@@ -0,0 +1,285 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Benchmark of Cartesian path planning (CartesianPlanner, Descartes)
+ *   against OMPL (MoveGroup of move_group) on the same needle insertion
+ *   tasks: from a random valid state, move the tip straight along its Z
+ *   axis by --depth.
+ *   For every planner it reports
+ *       - successes and mean planning time
+ *       - mean of the largest distance of the tip from the line, in mm
+ *       - mean of the largest angle between tool Z and the line, in deg
+ *       - mean joint travel (sum of |dq|), in rad
+ *   measured on the waypoints by forward kinematics of the robot model.
+ *   OMPL only has the goal pose, so its paths leave the line; this is what
+ *   the Cartesian mode is for.
+ *   Tasks are random but the same for every run (fixed seed). Needs
+ *   move_group running, e.g.
+ *       rosrun robot_driver_interface cartesian_benchmark
+ *           --benchmark_out=cartesian.json
+ *   Options:
+ *       --benchmark_out=<file>      : JSON output
+ *       --tasks=<n>                 : number of tasks, 20
+ *       --depth=<m>                 : insertion depth, 0.05
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+#include <ros/ros.h>
+#include <moveit/move_group_interface/move_group.h>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/robot_state/conversions.h>
+#include <moveit_msgs/GetStateValidity.h>
+
+#include "common/cartesian.h"
+
+#ifndef BENCHMARK_GIT_REVISION
+#define BENCHMARK_GIT_REVISION "unknown"
+#endif
+
+// Seed of random start states
+#define BENCHMARK_SEED 20160526
+// Random states tried for each task until one is valid
+#define BENCHMARK_START_ATTEMPTS 100
+// Planning time of OMPL, in seconds
+#define BENCHMARK_OMPL_TIME 5.0
+
+// --------------------------------------------------------------------------
+// Measures of one planner over all tasks
+// --------------------------------------------------------------------------
+struct PlannerResult {
+	PlannerResult(const std::string& n) :
+			name(n), tasks(0), successes(0), time(0.0), deviation(0.0), angle(
+					0.0), travel(0.0) {
+	}
+	std::string name;
+	int tasks;
+	int successes;
+	// Sums over successes, divided by report
+	double time;
+	double deviation;
+	double angle;
+	double travel;
+};
+
+// Largest distance from segment a-b and largest angle from its direction
+// of the tip on trajectory, and joint travel
+static void measure(robot_state::RobotState& state, const std::string& tip,
+		const trajectory_msgs::JointTrajectory& trajectory,
+		const Eigen::Vector3d& a, const Eigen::Vector3d& b, double& deviation,
+		double& angle, double& travel) {
+	Eigen::Vector3d direction = (b - a).normalized();
+	deviation = angle = travel = 0.0;
+	for (size_t i = 0; i < trajectory.points.size(); i++) {
+		state.setVariablePositions(trajectory.joint_names,
+				trajectory.points[i].positions);
+		const Eigen::Affine3d& pose = state.getGlobalLinkTransform(tip);
+		double s = std::max(0.0,
+				std::min((b - a).norm(), (pose.translation() - a).dot(direction)));
+		deviation = std::max(deviation,
+				(pose.translation() - (a + s * direction)).norm());
+		double c = pose.rotation().col(2).dot(direction);
+		angle = std::max(angle, acos(std::max(-1.0, std::min(1.0, c))));
+		if (i > 0)
+			for (size_t k = 0; k < trajectory.points[i].positions.size(); k++)
+				travel += fabs(
+						trajectory.points[i].positions[k]
+								- trajectory.points[i - 1].positions[k]);
+	}
+}
+
+static void add(PlannerResult& result, bool success, double time,
+		robot_state::RobotState& state, const std::string& tip,
+		const trajectory_msgs::JointTrajectory& trajectory,
+		const Eigen::Affine3d& start, const Eigen::Affine3d& end) {
+	result.tasks++;
+	if (!success)
+		return;
+	double deviation, angle, travel;
+	measure(state, tip, trajectory, start.translation(), end.translation(),
+			deviation, angle, travel);
+	result.successes++;
+	result.time += time;
+	result.deviation += deviation;
+	result.angle += angle;
+	result.travel += travel;
+}
+
+static double mean(double sum, int n) {
+	return n == 0 ? 0.0 : sum / n;
+}
+
+static bool writeJSON(const std::string& filename, const char* executable,
+		int tasks, double depth, std::vector<PlannerResult>& results) {
+	std::ofstream out(filename.c_str());
+	if (!out) {
+		std::cout << "cartesian_benchmark: Cannot open " << filename
+				<< std::endl;
+		return false;
+	}
+	char date[64], host[256];
+	time_t now = time(NULL);
+	strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&now));
+	if (gethostname(host, sizeof(host)) != 0)
+		strcpy(host, "unknown");
+
+	out << "{\n  \"context\": {\n";
+	out << "    \"date\": \"" << date << "\",\n";
+	out << "    \"host_name\": \"" << host << "\",\n";
+	out << "    \"executable\": \"" << executable << "\",\n";
+	out << "    \"git_revision\": \"" << BENCHMARK_GIT_REVISION << "\",\n";
+	out << "    \"seed\": " << BENCHMARK_SEED << ",\n";
+	out << "    \"tasks\": " << tasks << ",\n";
+	out << "    \"depth\": " << depth << "\n";
+	out << "  },\n  \"benchmarks\": [\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		const PlannerResult& r = results[i];
+		out << "    {\n";
+		out << "      \"name\": \"" << r.name << "\",\n";
+		out << "      \"tasks\": " << r.tasks << ",\n";
+		out << "      \"successes\": " << r.successes << ",\n";
+		out << "      \"real_time\": " << mean(r.time, r.successes) << ",\n";
+		out << "      \"time_unit\": \"s\",\n";
+		out << "      \"deviation_mm\": "
+				<< mean(r.deviation, r.successes) * 1000.0 << ",\n";
+		out << "      \"axis_angle_deg\": "
+				<< mean(r.angle, r.successes) / M_PI * 180.0 << ",\n";
+		out << "      \"joint_travel_rad\": " << mean(r.travel, r.successes)
+				<< "\n";
+		out << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n}\n";
+	return out.good();
+}
+
+int main(int argc, char *argv[]) {
+	std::string out;
+	int tasks = 20;
+	double depth = 0.05;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg.find("--benchmark_out=") == 0)
+			out = arg.substr(16);
+		else if (arg.find("--tasks=") == 0)
+			tasks = atoi(arg.substr(8).c_str());
+		else if (arg.find("--depth=") == 0)
+			depth = atof(arg.substr(8).c_str());
+	}
+
+	ros::init(argc, argv, "cartesian_benchmark");
+	ros::NodeHandle node_handle;
+	ros::AsyncSpinner spinner(1);
+	spinner.start();
+
+	const std::string group_name = "manipulator";
+	const std::string tip = "tip";
+	moveit::planning_interface::MoveGroup move_group(group_name);
+	move_group.setPlannerId("LBKPIECEkConfigDefault");
+	move_group.setPlanningTime(BENCHMARK_OMPL_TIME);
+	robot_model_loader::RobotModelLoader loader("robot_description");
+	robot_model::RobotModelPtr robot_model = loader.getModel();
+	CartesianPlanner cartesian;
+	if (!robot_model
+			|| !cartesian.initialize(group_name, move_group.getPlanningFrame(),
+					tip)) {
+		std::cout << "cartesian_benchmark: Robot model invalid" << std::endl;
+		return 1;
+	}
+	const robot_model::JointModelGroup* group = robot_model->getJointModelGroup(
+			group_name);
+	ros::ServiceClient validity = node_handle.serviceClient<
+			moveit_msgs::GetStateValidity>("check_state_validity");
+	random_numbers::RandomNumberGenerator rng(BENCHMARK_SEED);
+	robot_state::RobotState state(robot_model);
+	state.setToDefaultValues();
+
+	std::vector<PlannerResult> results;
+	results.push_back(PlannerResult("Descartes_DensePlanner"));
+	results.push_back(PlannerResult("OMPL_LBKPIECE"));
+	for (int n = 0; n < tasks; n++) {
+		// Valid random start state
+		moveit_msgs::GetStateValidity srv;
+		srv.request.group_name = group_name;
+		bool valid = false;
+		for (int k = 0; k < BENCHMARK_START_ATTEMPTS && !valid; k++) {
+			state.setToRandomPositions(group, rng);
+			moveit::core::robotStateToRobotStateMsg(state,
+					srv.request.robot_state);
+			valid = validity.call(srv) && srv.response.valid;
+		}
+		if (!valid) {
+			std::cout << "cartesian_benchmark: No valid start for task " << n
+					<< std::endl;
+			continue;
+		}
+		std::vector<double> start_joints;
+		state.copyJointGroupPositions(group, start_joints);
+		robot_state::RobotState start_state(state);
+		Eigen::Affine3d start = state.getGlobalLinkTransform(tip);
+		Eigen::Affine3d end = start * Eigen::Translation3d(0.0, 0.0, depth);
+
+		// Descartes
+		trajectory_msgs::JointTrajectory trajectory;
+		CartesianPlanner::TrajectoryVec path;
+		ros::WallTime begin = ros::WallTime::now();
+		bool success = cartesian.makeLinePath(start_joints, start, end, path)
+				&& cartesian.plan(path, group->getVariableNames(), trajectory);
+		add(results[0], success, (ros::WallTime::now() - begin).toSec(),
+				state, tip, trajectory, start, end);
+
+		// OMPL
+		geometry_msgs::Pose target;
+		Eigen::Quaterniond q(end.rotation());
+		target.position.x = end.translation().x();
+		target.position.y = end.translation().y();
+		target.position.z = end.translation().z();
+		target.orientation.x = q.x();
+		target.orientation.y = q.y();
+		target.orientation.z = q.z();
+		target.orientation.w = q.w();
+		moveit::planning_interface::MoveGroup::Plan plan;
+		move_group.setStartState(start_state);
+		move_group.setPoseTarget(target, tip);
+		begin = ros::WallTime::now();
+		success = move_group.plan(plan);
+		add(results[1], success, (ros::WallTime::now() - begin).toSec(),
+				state, tip, plan.trajectory_.joint_trajectory, start, end);
+	}
+
+	std::cout << std::left << std::setw(28) << "Planner" << std::right
+			<< std::setw(10) << "Success" << std::setw(12) << "Time (s)"
+			<< std::setw(16) << "Deviation (mm)" << std::setw(14)
+			<< "Angle (deg)" << std::setw(14) << "Travel (rad)" << std::endl;
+	for (size_t i = 0; i < results.size(); i++) {
+		const PlannerResult& r = results[i];
+		std::ostringstream success;
+		success << r.successes << "/" << r.tasks;
+		std::cout << std::left << std::setw(28) << r.name << std::right
+				<< std::setw(10) << success.str() << std::setw(12)
+				<< mean(r.time, r.successes) << std::setw(16)
+				<< mean(r.deviation, r.successes) * 1000.0 << std::setw(14)
+				<< mean(r.angle, r.successes) / M_PI * 180.0 << std::setw(14)
+				<< mean(r.travel, r.successes) << std::endl;
+	}
+
+	bool ok = out.empty() || writeJSON(out, argv[0], tasks, depth, results);
+	ros::shutdown();
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,203 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ */
+
+#include "analyticik.h"
+
+#include <cmath>
+
+// Tolerance for singular configurations (wrist above A1, A5 near zero)
+#define ANALYTICIK_EPS 1e-9
+
+// Axis-angle shortcuts, conventions of URDF: RPY(r, p, y) = Rz(y) Ry(p) Rx(r)
+static inline Eigen::Matrix3d rotX(double angle) {
+	return Eigen::AngleAxisd(angle, Eigen::Vector3d::UnitX()).toRotationMatrix();
+}
+static inline Eigen::Matrix3d rotY(double angle) {
+	return Eigen::AngleAxisd(angle, Eigen::Vector3d::UnitY()).toRotationMatrix();
+}
+static inline Eigen::Matrix3d rotZ(double angle) {
+	return Eigen::AngleAxisd(angle, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+}
+
+KR6Geometry::KR6Geometry() {
+	d1 = 0.4;
+	a1 = 0.025;
+	a2 = 0.315;
+	a3 = 0.365;
+	b3 = 0.035;
+	d6 = 0.08;
+
+	// identical to <limit> of kuka_kr6_description.urdf
+	const double lo[6] = { -2.967059728, -3.316125579, -2.094395102,
+			-3.228859116, -2.094395102, -6.108652382 };
+	const double up[6] = { 2.967059728, 0.785398163, 2.722713633, 3.228859116,
+			2.094395102, 6.108652382 };
+	for (int i = 0; i < 6; i++) {
+		lower[i] = lo[i];
+		upper[i] = up[i];
+	}
+}
+
+AnalyticIK::AnalyticIK(const KR6Geometry& g) :
+		geometry_(g) {
+	tool_.setIdentity();
+	toolInverse_.setIdentity();
+	// flange_joint: rpy = (pi, 0, pi/2)
+	R6f_ = rotZ(M_PI_2) * rotX(M_PI);
+}
+
+void AnalyticIK::setTool(const Eigen::Affine3d& tool) {
+	tool_ = tool;
+	toolInverse_ = tool.inverse();
+}
+
+const KR6Geometry& AnalyticIK::getGeometry() const {
+	return geometry_;
+}
+
+int AnalyticIK::solve(const Eigen::Affine3d& tip,
+		std::vector<IKSolution>& sols) const {
+	return solveFlange(tip * toolInverse_, sols);
+}
+
+int AnalyticIK::solveFlange(const Eigen::Affine3d& flange,
+		std::vector<IKSolution>& sols) const {
+	const KR6Geometry& g = geometry_;
+	size_t first = sols.size();
+
+	// Wrist center, d6 behind the flange along its z axis
+	Eigen::Matrix3d Rf = flange.linear();
+	Eigen::Vector3d w = flange.translation() - g.d6 * Rf.col(2);
+	Eigen::Matrix3d R6 = Rf * R6f_.transpose();
+
+	// A1: the arm plane contains the wrist center
+	//  - joint1 is flipped (rpy = pi, 0, 0), azimuth of the arm is -A1
+	double phi;
+	if (sqrt(w.x() * w.x() + w.y() * w.y()) < ANALYTICIK_EPS)
+		phi = 0.0; // wrist center above A1, any A1 works
+	else
+		phi = atan2(w.y(), w.x());
+	double q1Candidates[2] = { normalize(-phi), normalize(-phi + M_PI) };
+
+	// Forearm from A3 to wrist center, polar form
+	double L = sqrt(g.a3 * g.a3 + g.b3 * g.b3);
+	double delta = atan2(g.b3, g.a3);
+
+	for (int i = 0; i < 2; i++) {
+		double q1 = q1Candidates[i];
+		// signed distance of wrist center from A1 along the arm direction
+		double r = w.x() * cos(q1) - w.y() * sin(q1);
+		// target of the planar two-link problem, in frame of link1
+		double tx = r - g.a1;
+		double tz = g.d1 - w.z();
+		double k = (tx * tx + tz * tz - g.a2 * g.a2 - L * L)
+				/ (2.0 * g.a2 * L);
+		if (k > 1.0 + ANALYTICIK_EPS || k < -1.0 - ANALYTICIK_EPS)
+			continue;
+		if (k > 1.0)
+			k = 1.0;
+		if (k < -1.0)
+			k = -1.0;
+		double beta = acos(k);
+
+		for (int j = 0; j < 2; j++) {
+			double q3 = normalize(delta + (j == 0 ? beta : -beta));
+			// vector from A2 to wrist center in frame of link2
+			double px = g.a2 + g.a3 * cos(q3) + g.b3 * sin(q3);
+			double pz = g.a3 * sin(q3) - g.b3 * cos(q3);
+			double q2 = normalize(atan2(tz, tx) - atan2(pz, px));
+
+			double q[6] = { q1, q2, q3, 0.0, 0.0, 0.0 };
+			solveWrist(R6, q, sols);
+		}
+	}
+	return sols.size() - first;
+}
+
+void AnalyticIK::solveWrist(const Eigen::Matrix3d& R6, double q[6],
+		std::vector<IKSolution>& sols) const {
+	// R6 = R3 * Ry(-pi/2) Rz(A4) Ry(pi/2) Rz(A5) Ry(-pi/2) Rz(A6)
+	//    = R3 * Rx(-A4) Rz(A5) Rx(-A6) Ry(-pi/2)
+	Eigen::Matrix3d M = rotationArm(q[0], q[1], q[2]).transpose() * R6
+			* rotY(M_PI_2);
+
+	// M = Rx(a) Rz(b) Rx(c), a = -A4, b = A5, c = -A6
+	//  - atan2 instead of acos(M00) keeps precision when A5 is near zero
+	double sb = sqrt(M(1, 0) * M(1, 0) + M(2, 0) * M(2, 0));
+	double b = atan2(sb, M(0, 0));
+	double a, c;
+	if (sb < ANALYTICIK_EPS) {
+		// A4 and A6 are aligned, only A4 + A6 is determined, A4 = 0 chosen
+		a = 0.0;
+		c = atan2(M(2, 1), M(1, 1));
+	} else {
+		a = atan2(M(2, 0), M(1, 0));
+		c = atan2(M(0, 2), -M(0, 1));
+	}
+
+	IKSolution sol;
+	sol.q[0] = q[0];
+	sol.q[1] = q[1];
+	sol.q[2] = q[2];
+	sol.q[3] = normalize(-a);
+	sol.q[4] = b;
+	sol.q[5] = normalize(-c);
+	checkLimits(sol);
+	sols.push_back(sol);
+
+	// Flipped wrist: Rx(a + pi) Rz(-b) Rx(c + pi) is the same rotation
+	sol.q[3] = normalize(-a + M_PI);
+	sol.q[4] = -b;
+	sol.q[5] = normalize(-c + M_PI);
+	checkLimits(sol);
+	sols.push_back(sol);
+}
+
+Eigen::Matrix3d AnalyticIK::rotationArm(double q1, double q2,
+		double q3) const {
+	return rotX(M_PI) * rotZ(q1) * rotX(M_PI_2) * rotZ(q2 + q3);
+}
+
+Eigen::Affine3d AnalyticIK::forwardFlange(const double q[6]) const {
+	const KR6Geometry& g = geometry_;
+	Eigen::Affine3d T = Eigen::Affine3d::Identity();
+	T.translate(Eigen::Vector3d(0, 0, g.d1));
+	T.rotate(rotX(M_PI) * rotZ(q[0]));
+	T.translate(Eigen::Vector3d(g.a1, 0, 0));
+	T.rotate(rotX(M_PI_2) * rotZ(q[1]));
+	T.translate(Eigen::Vector3d(g.a2, 0, 0));
+	T.rotate(rotZ(q[2]));
+	T.translate(Eigen::Vector3d(g.a3, -g.b3, 0));
+	T.rotate(rotY(-M_PI_2) * rotZ(q[3]));
+	T.rotate(rotY(M_PI_2) * rotZ(q[4]));
+	T.rotate(rotY(-M_PI_2) * rotZ(q[5]));
+	T.translate(Eigen::Vector3d(0, 0, -g.d6));
+	T.rotate(R6f_);
+	return T;
+}
+
+Eigen::Affine3d AnalyticIK::forward(const double q[6]) const {
+	return forwardFlange(q) * tool_;
+}
+
+double AnalyticIK::normalize(double angle) {
+	while (angle > M_PI)
+		angle -= 2.0 * M_PI;
+	while (angle <= -M_PI)
+		angle += 2.0 * M_PI;
+	return angle;
+}
+
+void AnalyticIK::checkLimits(IKSolution& sol) const {
+	sol.inLimits = true;
+	for (int i = 0; i < 6; i++)
+		if (sol.q[i] < geometry_.lower[i] || sol.q[i] > geometry_.upper[i])
+			sol.inLimits = false;
+}
@@ -0,0 +1,117 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Header file for AnalyticIK, closed-form inverse kinematics of KUKA KR6
+ *   R700 sixx. The axes of A4, A5 and A6 intersect in one point (spherical
+ *   wrist), so the position of the wrist center only depends on A1, A2, A3
+ *   and the orientation of the flange only depends on A4, A5, A6 after that.
+ *       - A1      : azimuth of wrist center, front or back (2 branches)
+ *       - A2, A3  : planar two-link problem, elbow up or down (2 branches)
+ *       - A4 - A6 : ZYZ-like decomposition, wrist flipped or not (2 branches)
+ *   Up to 8 solutions are returned. Geometry is taken from the URDF joint
+ *   origins of kuka_kr6, the frame conventions are exactly those of KDL
+ *   chain base_link -> flange, so solutions are interchangeable with LMA.
+ *
+ */
+
+#ifndef MY_ANALYTICIK_H
+#define MY_ANALYTICIK_H
+
+#include <vector>
+#include <Eigen/Dense>
+#include <Eigen/Geometry>
+
+// --------------------------------------------------------------------------
+// Data structure: KR6Geometry
+//  - link lengths (in m) and joint limits (in rad) of KUKA KR6 R700 sixx
+//  - default values are those of kuka_kr6_description.urdf
+// --------------------------------------------------------------------------
+struct KR6Geometry {
+	// height of A2 above base_link
+	double d1;
+	// offset of A2 from A1 along the arm
+	double a1;
+	// length of upper arm, A2 to A3
+	double a2;
+	// length of forearm, A3 to wrist center, along the arm
+	double a3;
+	// offset of forearm, A3 to wrist center, perpendicular to the arm
+	double b3;
+	// distance from wrist center to flange
+	double d6;
+	// joint limits
+	double lower[6];
+	double upper[6];
+
+	// Default constructor, with values of KR6 R700 sixx
+	KR6Geometry();
+};
+
+// --------------------------------------------------------------------------
+// Data structure: IKSolution
+//  - one joint configuration (in rad) reaching the target
+//  - inLimits is false if any joint is outside of KR6Geometry limits
+// --------------------------------------------------------------------------
+struct IKSolution {
+	double q[6];
+	bool inLimits;
+};
+
+// --------------------------------------------------------------------------
+// AnalyticIK class
+// --------------------------------------------------------------------------
+class AnalyticIK {
+public:
+	// Constructor with robot geometry, tool is set to identity (flange)
+	AnalyticIK(const KR6Geometry& g = KR6Geometry());
+
+	// Set method: transformation from flange to tool tip
+	void setTool(const Eigen::Affine3d& tool);
+
+	// Get method: geometry_
+	const KR6Geometry& getGeometry() const;
+
+	// All solutions for the tool tip frame, appended to sols
+	//  - returns the number of solutions found, 0 if out of reach
+	//  - solutions are in order: front/back, elbow up/down, wrist no flip/flip
+	int solve(const Eigen::Affine3d& tip, std::vector<IKSolution>& sols) const;
+
+	// All solutions for the flange frame, appended to sols
+	int solveFlange(const Eigen::Affine3d& flange,
+			std::vector<IKSolution>& sols) const;
+
+	// Forward kinematics, from joint angles (in rad) to flange frame
+	Eigen::Affine3d forwardFlange(const double q[6]) const;
+
+	// Forward kinematics, from joint angles (in rad) to tool tip frame
+	Eigen::Affine3d forward(const double q[6]) const;
+
+private:
+	// Solve A4, A5, A6 with A1, A2, A3 in q, add the two wrist solutions
+	void solveWrist(const Eigen::Matrix3d& R6, double q[6],
+			std::vector<IKSolution>& sols) const;
+
+	// Rotation of link3 frame with respect to base_link
+	Eigen::Matrix3d rotationArm(double q1, double q2, double q3) const;
+
+	// Normalize an angle into (-pi, pi]
+	static double normalize(double angle);
+
+	// Mark solution out of limits
+	void checkLimits(IKSolution& sol) const;
+
+	KR6Geometry geometry_;
+	// flange to tip, and its inverse
+	Eigen::Affine3d tool_;
+	Eigen::Affine3d toolInverse_;
+	// fixed rotation from link6 to flange
+	Eigen::Matrix3d R6f_;
+};
+
+#endif
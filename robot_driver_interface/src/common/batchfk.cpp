@@ -0,0 +1,182 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ */
+
+#include "batchfk.h"
+
+#include <iostream>
+#include <cmath>
+
+void FrameBatch::resize(int n) {
+	x.resize(n);
+	y.resize(n);
+	z.resize(n);
+	for (int i = 0; i < 9; i++)
+		r[i].resize(n);
+}
+
+int FrameBatch::size() const {
+	return x.size();
+}
+
+void FrameBatch::getRPY(int i, double& roll, double& pitch,
+		double& yaw) const {
+	// Identical to KDL::Rotation::GetRPY
+	double epsilon = 1E-12;
+	pitch = atan2(-r[6](i), sqrt(r[0](i) * r[0](i) + r[3](i) * r[3](i)));
+	if (fabs(pitch) > (M_PI / 2.0 - epsilon)) {
+		yaw = atan2(-r[1](i), r[4](i));
+		roll = 0.0;
+	} else {
+		roll = atan2(r[7](i), r[8](i));
+		yaw = atan2(r[3](i), r[0](i));
+	}
+}
+
+BatchFK::BatchFK() :
+		joints_(0), hasMiddle_(false) {
+}
+
+bool BatchFK::setChain(const KDL::Chain& chain, unsigned int middle) {
+	steps_.clear();
+	joints_ = 0;
+	hasMiddle_ = (middle > 0);
+
+	for (unsigned int s = 0; s < chain.getNrOfSegments(); s++) {
+		const KDL::Segment& segment = chain.getSegment(s);
+		const KDL::Joint& joint = segment.getJoint();
+		KDL::Frame tip = segment.pose(0.0);
+
+		Step step;
+		if (joint.getType() == KDL::Joint::None) {
+			step.joint = -1;
+			for (int i = 0; i < 9; i++)
+				step.A[i] = step.B[i] = step.K[i] = 0.0;
+			for (int i = 0; i < 3; i++)
+				step.origin[i] = 0.0;
+		} else if (joint.getType() == KDL::Joint::RotAxis
+				|| joint.getType() == KDL::Joint::RotX
+				|| joint.getType() == KDL::Joint::RotY
+				|| joint.getType() == KDL::Joint::RotZ) {
+			step.joint = joints_++;
+			KDL::Vector a = joint.JointAxis();
+			KDL::Vector o = joint.JointOrigin();
+			double n = sqrt(a.x() * a.x() + a.y() * a.y() + a.z() * a.z());
+			double u[3] = { a.x() / n, a.y() / n, a.z() / n };
+			// Rodrigues: Rot(u, q) = u u' + cos(q) (I - u u') + sin(q) [u]x
+			for (int i = 0; i < 3; i++)
+				for (int j = 0; j < 3; j++) {
+					step.A[3 * i + j] = u[i] * u[j];
+					step.B[3 * i + j] = (i == j ? 1.0 : 0.0) - u[i] * u[j];
+				}
+			step.K[0] = 0.0;
+			step.K[1] = -u[2];
+			step.K[2] = u[1];
+			step.K[3] = u[2];
+			step.K[4] = 0.0;
+			step.K[5] = -u[0];
+			step.K[6] = -u[1];
+			step.K[7] = u[0];
+			step.K[8] = 0.0;
+			for (int i = 0; i < 3; i++)
+				step.origin[i] = o(i);
+		} else {
+			std::cout << "BatchFK::setChain: Only rotational joints supported"
+					<< std::endl;
+			steps_.clear();
+			joints_ = 0;
+			return false;
+		}
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++)
+				step.M[3 * i + j] = tip.M(i, j);
+			step.v[i] = tip.p(i) - step.origin[i];
+		}
+		step.middle = (hasMiddle_ && s + 1 == middle);
+		steps_.push_back(step);
+	}
+	return true;
+}
+
+int BatchFK::getNrOfJoints() const {
+	return joints_;
+}
+
+void BatchFK::compute(const Eigen::ArrayXXd& q, FrameBatch& tip,
+		FrameBatch* middle) const {
+	int n = q.rows();
+	tip.resize(n);
+	if (middle != NULL)
+		middle->resize(n);
+
+	// Accumulated frame, starts from identity
+	Eigen::ArrayXd* R = tip.r;
+	Eigen::ArrayXd* p[3] = { &tip.x, &tip.y, &tip.z };
+	for (int i = 0; i < 9; i++)
+		R[i].setConstant(i % 4 == 0 ? 1.0 : 0.0);
+	for (int i = 0; i < 3; i++)
+		p[i]->setZero();
+
+	// Work arrays, allocated once per call
+	Eigen::ArrayXd c(n), s(n), J[9], S[9], t[3], N[9];
+	for (int i = 0; i < 9; i++) {
+		J[i].resize(n);
+		S[i].resize(n);
+		N[i].resize(n);
+	}
+	for (int i = 0; i < 3; i++)
+		t[i].resize(n);
+
+	for (size_t k = 0; k < steps_.size(); k++) {
+		const Step& step = steps_[k];
+		if (step.joint < 0) {
+			// fixed segment: R = R * M, p = p + R * v
+			for (int i = 0; i < 3; i++)
+				*p[i] += R[3 * i] * step.v[0] + R[3 * i + 1] * step.v[1]
+						+ R[3 * i + 2] * step.v[2];
+			for (int i = 0; i < 3; i++)
+				for (int j = 0; j < 3; j++)
+					N[3 * i + j] = R[3 * i] * step.M[j]
+							+ R[3 * i + 1] * step.M[3 + j]
+							+ R[3 * i + 2] * step.M[6 + j];
+		} else {
+			c = q.col(step.joint).cos();
+			s = q.col(step.joint).sin();
+			for (int i = 0; i < 9; i++)
+				J[i] = step.A[i] + c * step.B[i] + s * step.K[i];
+			// segment: S = J * M, t = J * v + origin
+			for (int i = 0; i < 3; i++) {
+				for (int j = 0; j < 3; j++)
+					S[3 * i + j] = J[3 * i] * step.M[j]
+							+ J[3 * i + 1] * step.M[3 + j]
+							+ J[3 * i + 2] * step.M[6 + j];
+				t[i] = J[3 * i] * step.v[0] + J[3 * i + 1] * step.v[1]
+						+ J[3 * i + 2] * step.v[2] + step.origin[i];
+			}
+			// accumulate: p = p + R * t, R = R * S
+			for (int i = 0; i < 3; i++)
+				*p[i] += R[3 * i] * t[0] + R[3 * i + 1] * t[1]
+						+ R[3 * i + 2] * t[2];
+			for (int i = 0; i < 3; i++)
+				for (int j = 0; j < 3; j++)
+					N[3 * i + j] = R[3 * i] * S[j] + R[3 * i + 1] * S[3 + j]
+							+ R[3 * i + 2] * S[6 + j];
+		}
+		for (int i = 0; i < 9; i++)
+			R[i].swap(N[i]);
+
+		if (step.middle && middle != NULL) {
+			middle->x = tip.x;
+			middle->y = tip.y;
+			middle->z = tip.z;
+			for (int i = 0; i < 9; i++)
+				middle->r[i] = R[i];
+		}
+	}
+}
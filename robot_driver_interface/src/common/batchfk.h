@@ -0,0 +1,97 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Header file for BatchFK, forward kinematics of many joint configurations
+ *   at once. The segments of a KDL::Chain are read once, each one reduced to
+ *   a joint axis, a joint origin and a constant frame to tip. Configurations
+ *   are stored in structure-of-arrays layout (one array per joint, one lane
+ *   per configuration), so every step of the chain is an element-wise Eigen
+ *   array expression that is vectorized by the compiler (SSE2 by default,
+ *   AVX if enabled by -mavx).
+ *   Results are identical to KDL::ChainFkSolverPos_recursive.
+ *
+ */
+
+#ifndef MY_BATCHFK_H
+#define MY_BATCHFK_H
+
+#include <vector>
+#include <Eigen/Dense>
+#include <kdl/chain.hpp>
+#include <kdl/frames.hpp>
+
+// --------------------------------------------------------------------------
+// Data structure: FrameBatch
+//  - N frames in structure-of-arrays layout
+//  - x, y, z: position (in m)
+//  - r[3 * i + j]: element (i, j) of rotation matrix
+// --------------------------------------------------------------------------
+struct FrameBatch {
+	Eigen::ArrayXd x;
+	Eigen::ArrayXd y;
+	Eigen::ArrayXd z;
+	Eigen::ArrayXd r[9];
+
+	// Resize all arrays to n frames
+	void resize(int n);
+
+	// Number of frames
+	int size() const;
+
+	// Roll, pitch, yaw of frame i, same as KDL::Rotation::GetRPY
+	void getRPY(int i, double& roll, double& pitch, double& yaw) const;
+};
+
+// --------------------------------------------------------------------------
+// BatchFK class
+// --------------------------------------------------------------------------
+class BatchFK {
+public:
+	// Empty solver, setChain should be called before compute
+	BatchFK();
+
+	// Read segments of chain, fixed segments are merged into their parent
+	//  - frame after the first `middle` segments is also available by compute,
+	//      e.g. flange of a chain from base_link to tip, 0 if not needed
+	//  - returns false if chain has other than rotational or fixed joints
+	bool setChain(const KDL::Chain& chain, unsigned int middle = 0);
+
+	// Number of joints of the chain
+	int getNrOfJoints() const;
+
+	// Forward kinematics of all rows of q
+	//  - q: N x joints, column j holds joint j of every configuration (in rad)
+	//  - tip: frames at the end of the chain
+	//  - middle: frames after `middle` segments, ignored if NULL
+	void compute(const Eigen::ArrayXXd& q, FrameBatch& tip,
+			FrameBatch* middle = NULL) const;
+
+private:
+	// One segment: pose(q) = [Rot(axis, q), origin - Rot(axis, q) * origin] * f_tip
+	struct Step {
+		// index of joint in q, -1 if fixed
+		int joint;
+		// Rot(axis, q) = A + cos(q) * B + sin(q) * K
+		double A[9];
+		double B[9];
+		double K[9];
+		double origin[3];
+		// constant part: rotation of f_tip and f_tip.p - origin
+		double M[9];
+		double v[3];
+		// frame is copied to middle after this step
+		bool middle;
+	};
+
+	std::vector<Step> steps_;
+	int joints_;
+	bool hasMiddle_;
+};
+
+#endif
@@ -0,0 +1,145 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ */
+
+#include "cartesian.h"
+
+#include <cmath>
+#include <iostream>
+#include <ros/ros.h>
+
+CartesianPlanner::CartesianPlanner() :
+		valid_(false), step_(CARTESIAN_DEFAULT_STEP), orientIncrement_(
+				CARTESIAN_DEFAULT_ORIENT_INCREMENT), speed_(
+				CARTESIAN_DEFAULT_SPEED) {
+}
+
+bool CartesianPlanner::initialize(const std::string& group_name,
+		const std::string& world_frame, const std::string& tcp_frame,
+		const std::string& robot_description) {
+	model_.reset(new descartes_moveit::MoveitStateAdapter);
+	valid_ = model_->initialize(robot_description, group_name, world_frame,
+			tcp_frame) && planner_.initialize(model_);
+	if (!valid_)
+		std::cout << "CartesianPlanner::initialize: Failed to load " << group_name
+				<< " of " << robot_description << std::endl;
+	return valid_;
+}
+
+bool CartesianPlanner::isValid() {
+	return valid_;
+}
+
+bool CartesianPlanner::makeLinePath(const std::vector<double>& start_joints,
+		const Eigen::Affine3d& start, const Eigen::Affine3d& end,
+		TrajectoryVec& path) {
+	path.clear();
+	double length = (end.translation() - start.translation()).norm();
+	int n = (int) ceil(length / step_);
+	if (n < 1)
+		return false;
+	// Each point is reached in the time of its spacing at speed_
+	descartes_core::TimingConstraint timing(length / n / speed_);
+
+	path.push_back(
+			descartes_core::TrajectoryPtPtr(
+					new descartes_trajectory::JointTrajectoryPt(start_joints)));
+	Eigen::Quaterniond q_start(start.rotation());
+	Eigen::Quaterniond q_end(end.rotation());
+	for (int i = 1; i <= n; i++) {
+		double t = (double) i / n;
+		Eigen::Affine3d pose = Eigen::Translation3d(
+				(1.0 - t) * start.translation() + t * end.translation())
+				* q_start.slerp(t, q_end);
+		path.push_back(
+				descartes_core::TrajectoryPtPtr(
+						new descartes_trajectory::AxialSymmetricPt(pose,
+								orientIncrement_,
+								descartes_trajectory::AxialSymmetricPt::Z_AXIS,
+								timing)));
+	}
+	return true;
+}
+
+bool CartesianPlanner::plan(const TrajectoryVec& path,
+		const std::vector<std::string>& joint_names,
+		trajectory_msgs::JointTrajectory& trajectory) {
+	if (!valid_ || path.empty())
+		return false;
+	if (!planner_.planPath(path)) {
+		ROS_INFO("CartesianPlanner: No joint path for %d points",
+				(int) path.size());
+		return false;
+	}
+	TrajectoryVec result;
+	if (!planner_.getPath(result))
+		return false;
+
+	trajectory.joint_names = joint_names;
+	trajectory.points.clear();
+	std::vector<double> seed;
+	double time = 0.0;
+	for (size_t i = 0; i < result.size(); i++) {
+		trajectory_msgs::JointTrajectoryPoint point;
+		if (!result[i]->getNominalJointPose(seed, *model_, point.positions))
+			return false;
+		if (i > 0)
+			time += result[i]->getTiming().upper;
+		point.time_from_start = ros::Duration(time);
+		trajectory.points.push_back(point);
+		seed = point.positions;
+	}
+	return true;
+}
+
+// --------------------------------------------------------------------------
+// Settings
+// --------------------------------------------------------------------------
+bool CartesianPlanner::setStep(double step) {
+	if (step <= 0.0) {
+		std::cout << "CartesianPlanner::setStep: Step should be positive"
+				<< std::endl;
+		return false;
+	}
+	step_ = step;
+	return true;
+}
+
+bool CartesianPlanner::setOrientIncrement(double orient_increment) {
+	if (orient_increment <= 0.0) {
+		std::cout
+				<< "CartesianPlanner::setOrientIncrement: Increment should be positive"
+				<< std::endl;
+		return false;
+	}
+	orientIncrement_ = orient_increment;
+	return true;
+}
+
+bool CartesianPlanner::setSpeed(double speed) {
+	if (speed <= 0.0) {
+		std::cout << "CartesianPlanner::setSpeed: Speed should be positive"
+				<< std::endl;
+		return false;
+	}
+	speed_ = speed;
+	return true;
+}
+
+double CartesianPlanner::getStep() {
+	return step_;
+}
+
+double CartesianPlanner::getOrientIncrement() {
+	return orientIncrement_;
+}
+
+double CartesianPlanner::getSpeed() {
+	return speed_;
+}
@@ -0,0 +1,100 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Header file for CartesianPlanner, used by Controller to plan tool paths
+ *   that must be followed in Cartesian space, e.g. needle insertion, which
+ *   OMPL only treats as a goal pose.
+ *   A straight line is sampled every step into Descartes points:
+ *       - the first point is the start state, fixed in joint space, so the
+ *         path keeps the configuration of the robot
+ *       - the other points are AxialSymmetricPt, free about the tool Z axis
+ *         (the needle axis) in orient_increment steps, which gives the
+ *         DensePlanner room to avoid joint limits and wrist flips
+ *   The DensePlanner picks the joint path of least joint motion, the result
+ *   is timed by the point spacing and the tool speed.
+ *   The trajectory is dense enough to be sent point by point as LIN motions,
+ *   see Plannar::executeCartesianTrajectory.
+ *
+ */
+
+#ifndef MY_CARTESIAN_H
+#define MY_CARTESIAN_H
+
+#include <string>
+#include <vector>
+#include <Eigen/Geometry>
+
+#include <descartes_moveit/moveit_state_adapter.h>
+#include <descartes_trajectory/axial_symmetric_pt.h>
+#include <descartes_trajectory/cart_trajectory_pt.h>
+#include <descartes_trajectory/joint_trajectory_pt.h>
+#include <descartes_planner/dense_planner.h>
+#include <trajectory_msgs/JointTrajectory.h>
+
+// Distance between points of a path, in m
+#define CARTESIAN_DEFAULT_STEP 0.002
+// Sampling of the rotation about the tool axis, in rad
+#define CARTESIAN_DEFAULT_ORIENT_INCREMENT (M_PI / 36.0)
+// Speed of the tool along a path, in m/s
+#define CARTESIAN_DEFAULT_SPEED 0.01
+
+// --------------------------------------------------------------------------
+// CartesianPlanner class
+// --------------------------------------------------------------------------
+class CartesianPlanner {
+public:
+	typedef std::vector<descartes_core::TrajectoryPtPtr> TrajectoryVec;
+
+	CartesianPlanner();
+
+	// Load the robot model and IK of group for Descartes
+	//  - world_frame is the frame of the poses, the planning frame
+	//  - tcp_frame is the link following the path, "tip"
+	// if return false, the model could not be loaded, nothing can be planned
+	bool initialize(const std::string& group_name,
+			const std::string& world_frame, const std::string& tcp_frame,
+			const std::string& robot_description = "robot_description");
+	// True if initialize succeeded
+	bool isValid();
+
+	// Straight line from start to end, starting at start_joints
+	// orientation is interpolated, rotation about tool Z is free
+	// if return false, path is shorter than step and is left empty
+	bool makeLinePath(const std::vector<double>& start_joints,
+			const Eigen::Affine3d& start, const Eigen::Affine3d& end,
+			TrajectoryVec& path);
+
+	// Plan path with the DensePlanner, trajectory has joints joint_names
+	// if return false, some point has no IK solution or no joint path
+	// connects them
+	bool plan(const TrajectoryVec& path,
+			const std::vector<std::string>& joint_names,
+			trajectory_msgs::JointTrajectory& trajectory);
+
+	// Set methods: step_, orientIncrement_, speed_
+	// if return false, value is not positive and nothing is changed
+	bool setStep(double step);
+	bool setOrientIncrement(double orient_increment);
+	bool setSpeed(double speed);
+	// Get methods: step_, orientIncrement_, speed_
+	double getStep();
+	double getOrientIncrement();
+	double getSpeed();
+
+private:
+	descartes_core::RobotModelPtr model_;
+	descartes_planner::DensePlanner planner_;
+	bool valid_;
+
+	double step_;
+	double orientIncrement_;
+	double speed_;
+};
+
+#endif
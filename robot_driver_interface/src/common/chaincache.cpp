@@ -0,0 +1,160 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ */
+
+#include "chaincache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// Format of cache file
+#define CHAINCACHE_MAGIC "KDLCHAIN"
+#define CHAINCACHE_VERSION 1
+// Longest name accepted when reading, guards against corrupted files
+#define CHAINCACHE_MAX_NAME 1024
+
+uint64_t hashURDF(const std::string& xml) {
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < xml.size(); i++) {
+		hash ^= (unsigned char) xml[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// --------------------------------------------------------------------------
+// Writing
+// --------------------------------------------------------------------------
+static bool writeString(FILE* fp, const std::string& s) {
+	uint32_t len = s.size();
+	return fwrite(&len, sizeof(len), 1, fp) == 1
+			&& (len == 0 || fwrite(s.data(), 1, len, fp) == len);
+}
+
+static bool writeVector(FILE* fp, const KDL::Vector& v) {
+	double d[3] = { v(0), v(1), v(2) };
+	return fwrite(d, sizeof(double), 3, fp) == 3;
+}
+
+static bool writeChain(FILE* fp, const KDL::Chain& chain) {
+	uint32_t n = chain.getNrOfSegments();
+	if (fwrite(&n, sizeof(n), 1, fp) != 1)
+		return false;
+	for (uint32_t i = 0; i < n; i++) {
+		const KDL::Segment& segment = chain.getSegment(i);
+		const KDL::Joint& joint = segment.getJoint();
+		const KDL::Frame& f_tip = segment.getFrameToTip();
+		int32_t type = joint.getType();
+		double M[9];
+		for (int k = 0; k < 9; k++)
+			M[k] = f_tip.M(k / 3, k % 3);
+		if (!writeString(fp, segment.getName())
+				|| !writeString(fp, joint.getName())
+				|| fwrite(&type, sizeof(type), 1, fp) != 1
+				|| !writeVector(fp, joint.JointOrigin())
+				|| !writeVector(fp, joint.JointAxis())
+				|| !writeVector(fp, f_tip.p)
+				|| fwrite(M, sizeof(double), 9, fp) != 9)
+			return false;
+	}
+	return true;
+}
+
+bool writeChainCache(const std::string& filename, uint64_t hash,
+		const KDL::Chain& chain, const KDL::Chain& chain_flange) {
+	FILE* fp = fopen(filename.c_str(), "wb");
+	if (fp == NULL) {
+		std::cout << "writeChainCache: Cannot open " << filename << std::endl;
+		return false;
+	}
+	uint32_t version = CHAINCACHE_VERSION;
+	bool ok = fwrite(CHAINCACHE_MAGIC, 1, 8, fp) == 8
+			&& fwrite(&version, sizeof(version), 1, fp) == 1
+			&& fwrite(&hash, sizeof(hash), 1, fp) == 1 && writeChain(fp, chain)
+			&& writeChain(fp, chain_flange);
+	ok = (fclose(fp) == 0) && ok;
+	if (!ok)
+		std::cout << "writeChainCache: Failed to write " << filename
+				<< std::endl;
+	return ok;
+}
+
+// --------------------------------------------------------------------------
+// Reading
+// --------------------------------------------------------------------------
+static bool readString(FILE* fp, std::string& s) {
+	uint32_t len;
+	if (fread(&len, sizeof(len), 1, fp) != 1 || len > CHAINCACHE_MAX_NAME)
+		return false;
+	s.resize(len);
+	return len == 0 || fread(&s[0], 1, len, fp) == len;
+}
+
+static bool readVector(FILE* fp, KDL::Vector& v) {
+	double d[3];
+	if (fread(d, sizeof(double), 3, fp) != 3)
+		return false;
+	v = KDL::Vector(d[0], d[1], d[2]);
+	return true;
+}
+
+static bool readChain(FILE* fp, KDL::Chain& chain) {
+	uint32_t n;
+	if (fread(&n, sizeof(n), 1, fp) != 1)
+		return false;
+	for (uint32_t i = 0; i < n; i++) {
+		std::string segment_name, joint_name;
+		int32_t type;
+		KDL::Vector origin, axis, p;
+		double M[9];
+		if (!readString(fp, segment_name) || !readString(fp, joint_name)
+				|| fread(&type, sizeof(type), 1, fp) != 1
+				|| type < KDL::Joint::RotAxis || type > KDL::Joint::None
+				|| !readVector(fp, origin) || !readVector(fp, axis)
+				|| !readVector(fp, p) || fread(M, sizeof(double), 9, fp) != 9)
+			return false;
+
+		// Joints along an arbitrary axis keep origin and axis, as built by
+		// kdl_parser, the others are defined by type only
+		KDL::Joint::JointType joint_type = (KDL::Joint::JointType) type;
+		KDL::Joint joint =
+				(joint_type == KDL::Joint::RotAxis
+						|| joint_type == KDL::Joint::TransAxis) ?
+						KDL::Joint(joint_name, origin, axis, joint_type) :
+						KDL::Joint(joint_name, joint_type);
+		KDL::Rotation R(M[0], M[1], M[2], M[3], M[4], M[5], M[6], M[7], M[8]);
+		chain.addSegment(KDL::Segment(segment_name, joint, KDL::Frame(R, p)));
+	}
+	return true;
+}
+
+bool readChainCache(const std::string& filename, uint64_t hash,
+		KDL::Chain& chain, KDL::Chain& chain_flange) {
+	FILE* fp = fopen(filename.c_str(), "rb");
+	if (fp == NULL)
+		return false;
+	char magic[8];
+	uint32_t version;
+	uint64_t file_hash;
+	KDL::Chain tip, flange;
+	bool ok = fread(magic, 1, 8, fp) == 8
+			&& memcmp(magic, CHAINCACHE_MAGIC, 8) == 0
+			&& fread(&version, sizeof(version), 1, fp) == 1
+			&& version == CHAINCACHE_VERSION
+			&& fread(&file_hash, sizeof(file_hash), 1, fp) == 1
+			&& file_hash == hash && readChain(fp, tip)
+			&& readChain(fp, flange);
+	fclose(fp);
+	if (!ok)
+		return false;
+	chain = tip;
+	chain_flange = flange;
+	return true;
+}
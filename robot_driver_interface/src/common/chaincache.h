@@ -0,0 +1,42 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Header file for the cache of KDL chains extracted from URDF.
+ *   Parsing the URDF with kdl_parser at every start is skipped by storing
+ *   the chains Model needs (root -> tip and root -> flange) in a compact
+ *   binary file, keyed by the hash of the URDF text:
+ *       "KDLCHAIN", version, URDF hash, chain to tip, chain to flange
+ *   Each chain is a list of segments: name, joint (name, type, origin, axis)
+ *   and frame to tip. Inertia is not stored, it is not used by Model.
+ *   A cache of another URDF is ignored, and rewritten by Model.
+ *
+ */
+
+#ifndef MY_CHAINCACHE_H
+#define MY_CHAINCACHE_H
+
+#include <string>
+#include <stdint.h>
+#include <kdl/chain.hpp>
+
+// 64 bit FNV-1a hash of URDF text
+uint64_t hashURDF(const std::string& xml);
+
+// Write chains of URDF with hash to filename
+// if return false, the file could not be written
+bool writeChainCache(const std::string& filename, uint64_t hash,
+		const KDL::Chain& chain, const KDL::Chain& chain_flange);
+
+// Read chains of URDF with hash from filename
+// if return false, the file is missing, invalid or of another URDF, and
+// chain and chain_flange are not changed
+bool readChainCache(const std::string& filename, uint64_t hash,
+		KDL::Chain& chain, KDL::Chain& chain_flange);
+
+#endif
@@ -0,0 +1,21 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ */
+
+#include "fixedkinematics.h"
+
+// Definitions of constexpr segment data, required when odr-used
+constexpr double KR6R700Sixx::Segment<0>::T[12];
+constexpr double KR6R700Sixx::Segment<1>::T[12];
+constexpr double KR6R700Sixx::Segment<2>::T[12];
+constexpr double KR6R700Sixx::Segment<3>::T[12];
+constexpr double KR6R700Sixx::Segment<4>::T[12];
+constexpr double KR6R700Sixx::Segment<5>::T[12];
+constexpr double KR6R700Sixx::Segment<6>::T[12];
+constexpr double KR6R700SixxNeedle::Segment<7>::T[12];
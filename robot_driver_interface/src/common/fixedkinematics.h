@@ -0,0 +1,210 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Header file for FixedKinematics, forward kinematics and Jacobian of a
+ *   robot known at compile time. A robot type lists its segments as
+ *   constexpr data (URDF joint origin as rotation and translation, and
+ *   whether a revolute joint about local Z follows). FixedKinematics walks
+ *   the segments by template recursion, so the whole chain is unrolled by
+ *   the compiler with every constant in place: no virtual call, no heap
+ *   allocation, no loop over a KDL::Chain.
+ *   Robot types defined here:
+ *       - KR6R700Sixx      : base_link -> flange, kuka_kr6_description.urdf
+ *       - KR6R700SixxNeedle: base_link -> tip, kuka_kr6_needle.urdf
+ *   Other robots still use the URDF and KDL at runtime, see Model.
+ *
+ */
+
+#ifndef MY_FIXEDKINEMATICS_H
+#define MY_FIXEDKINEMATICS_H
+
+#include <cmath>
+
+// --------------------------------------------------------------------------
+// Robot type: KR6R700Sixx
+//  - Segment<I>::T: rotation (row major) and translation (in m) of joint
+//      origin I, T = { r00, r01, r02, r10, r11, r12, r20, r21, r22, x, y, z }
+//  - Segment<I>::Joint: index of revolute joint about Z after the origin,
+//      -1 for a fixed joint
+// --------------------------------------------------------------------------
+struct KR6R700Sixx {
+	static const int Segments = 7;
+	static const int Joints = 6;
+	template<int I> struct Segment;
+};
+
+// joint1: rpy = (pi, 0, 0), xyz = (0, 0, 0.4)
+template<> struct KR6R700Sixx::Segment<0> {
+	static const int Joint = 0;
+	static constexpr double T[12] = { 1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0.4 };
+};
+// joint2: rpy = (pi/2, 0, 0), xyz = (0.025, 0, 0)
+template<> struct KR6R700Sixx::Segment<1> {
+	static const int Joint = 1;
+	static constexpr double T[12] = { 1, 0, 0, 0, 0, -1, 0, 1, 0, 0.025, 0, 0 };
+};
+// joint3: rpy = (0, 0, 0), xyz = (0.315, 0, 0)
+template<> struct KR6R700Sixx::Segment<2> {
+	static const int Joint = 2;
+	static constexpr double T[12] = { 1, 0, 0, 0, 1, 0, 0, 0, 1, 0.315, 0, 0 };
+};
+// joint4: rpy = (0, -pi/2, 0), xyz = (0.365, -0.035, 0)
+template<> struct KR6R700Sixx::Segment<3> {
+	static const int Joint = 3;
+	static constexpr double T[12] = { 0, 0, -1, 0, 1, 0, 1, 0, 0, 0.365, -0.035,
+			0 };
+};
+// joint5: rpy = (0, pi/2, 0)
+template<> struct KR6R700Sixx::Segment<4> {
+	static const int Joint = 4;
+	static constexpr double T[12] = { 0, 0, 1, 0, 1, 0, -1, 0, 0, 0, 0, 0 };
+};
+// joint6: rpy = (0, -pi/2, 0)
+template<> struct KR6R700Sixx::Segment<5> {
+	static const int Joint = 5;
+	static constexpr double T[12] = { 0, 0, -1, 0, 1, 0, 1, 0, 0, 0, 0, 0 };
+};
+// flange_joint: rpy = (pi, 0, pi/2), xyz = (0, 0, -0.08)
+template<> struct KR6R700Sixx::Segment<6> {
+	static const int Joint = -1;
+	static constexpr double T[12] = { 0, 1, 0, 1, 0, 0, 0, 0, -1, 0, 0, -0.08 };
+};
+
+// --------------------------------------------------------------------------
+// Robot type: KR6R700SixxNeedle
+//  - KR6R700Sixx with the needle tool of kuka_kr6_needle.urdf
+//  - Flange: number of segments from base_link to flange
+// --------------------------------------------------------------------------
+struct KR6R700SixxNeedle {
+	static const int Segments = 8;
+	static const int Joints = 6;
+	static const int Flange = 7;
+	template<int I> struct Segment: KR6R700Sixx::Segment<I> {
+	};
+};
+
+// tip_joint: rpy = (-2.399379, 1.594174, 0.576253),
+//            xyz = (0.005189830, 0.171790068, 0.026065161)
+template<> struct KR6R700SixxNeedle::Segment<7> {
+	static const int Joint = -1;
+	static constexpr double T[12] = { -0.019600632419349, -0.165044995034568,
+			-0.986091255829196, -0.012737003601006, -0.986159474411374,
+			0.165309587646785, -0.999726754642502, 0.015800020339276,
+			0.017227170668712, 0.005189830, 0.171790068, 0.026065161 };
+};
+
+// --------------------------------------------------------------------------
+// FixedChainStep: segment I to N of Robot, by template recursion
+//  - R (row major) and p are the accumulated frame, updated in place
+//  - if Record, axis (Z) and origin of every joint in base frame are stored
+//      into axes[3 * joint] and origins[3 * joint]
+// --------------------------------------------------------------------------
+template<class Robot, int I, int N, bool Record>
+struct FixedChainStep {
+	static inline void forward(const double* q, double* R, double* p,
+			double* axes, double* origins) {
+		typedef typename Robot::template Segment<I> S;
+
+		// p = p + R * t
+		double p0 = p[0] + R[0] * S::T[9] + R[1] * S::T[10] + R[2] * S::T[11];
+		double p1 = p[1] + R[3] * S::T[9] + R[4] * S::T[10] + R[5] * S::T[11];
+		double p2 = p[2] + R[6] * S::T[9] + R[7] * S::T[10] + R[8] * S::T[11];
+		p[0] = p0;
+		p[1] = p1;
+		p[2] = p2;
+
+		// R = R * M
+		for (int i = 0; i < 3; i++) {
+			double r0 = R[3 * i], r1 = R[3 * i + 1], r2 = R[3 * i + 2];
+			R[3 * i] = r0 * S::T[0] + r1 * S::T[3] + r2 * S::T[6];
+			R[3 * i + 1] = r0 * S::T[1] + r1 * S::T[4] + r2 * S::T[7];
+			R[3 * i + 2] = r0 * S::T[2] + r1 * S::T[5] + r2 * S::T[8];
+		}
+
+		// R = R * Rz(q), Z axis is not changed by the joint
+		if (S::Joint >= 0) {
+			if (Record)
+				for (int i = 0; i < 3; i++) {
+					axes[3 * S::Joint + i] = R[3 * i + 2];
+					origins[3 * S::Joint + i] = p[i];
+				}
+			double c = cos(q[S::Joint]), s = sin(q[S::Joint]);
+			for (int i = 0; i < 3; i++) {
+				double r0 = R[3 * i], r1 = R[3 * i + 1];
+				R[3 * i] = c * r0 + s * r1;
+				R[3 * i + 1] = -s * r0 + c * r1;
+			}
+		}
+		FixedChainStep<Robot, I + 1, N, Record>::forward(q, R, p, axes,
+				origins);
+	}
+};
+
+// End of recursion
+template<class Robot, int N, bool Record>
+struct FixedChainStep<Robot, N, N, Record> {
+	static inline void forward(const double*, double*, double*, double*,
+			double*) {
+	}
+};
+
+// --------------------------------------------------------------------------
+// FixedKinematics class
+//  - q: joint angles (in rad), R: rotation (row major), p: position (in m)
+// --------------------------------------------------------------------------
+template<class Robot>
+class FixedKinematics {
+public:
+	static const int Joints = Robot::Joints;
+
+	// Frame after the first N segments
+	template<int N>
+	static inline void forwardTo(const double* q, double* R, double* p) {
+		setIdentity(R, p);
+		FixedChainStep<Robot, 0, N, false>::forward(q, R, p, 0, 0);
+	}
+
+	// Frame at the end of the chain
+	static inline void forward(const double* q, double* R, double* p) {
+		forwardTo<Robot::Segments>(q, R, p);
+	}
+
+	// Geometric Jacobian at the end of the chain, expressed in base frame
+	//  - J is 6 x Joints, row major, rows: vx, vy, vz, wx, wy, wz
+	//  - frame at the end of the chain is also returned in R and p
+	static inline void jacobian(const double* q, double* J, double* R,
+			double* p) {
+		double axes[3 * Joints], origins[3 * Joints];
+		setIdentity(R, p);
+		FixedChainStep<Robot, 0, Robot::Segments, true>::forward(q, R, p,
+				axes, origins);
+		for (int j = 0; j < Joints; j++) {
+			const double* z = axes + 3 * j;
+			double d0 = p[0] - origins[3 * j];
+			double d1 = p[1] - origins[3 * j + 1];
+			double d2 = p[2] - origins[3 * j + 2];
+			// linear: z x (p - o), angular: z
+			J[0 * Joints + j] = z[1] * d2 - z[2] * d1;
+			J[1 * Joints + j] = z[2] * d0 - z[0] * d2;
+			J[2 * Joints + j] = z[0] * d1 - z[1] * d0;
+			J[3 * Joints + j] = z[0];
+			J[4 * Joints + j] = z[1];
+			J[5 * Joints + j] = z[2];
+		}
+	}
+
+private:
+	static inline void setIdentity(double* R, double* p) {
+		for (int i = 0; i < 9; i++)
+			R[i] = (i % 4 == 0) ? 1.0 : 0.0;
+		p[0] = p[1] = p[2] = 0.0;
+	}
+};
+
+#endif
@@ -9,6 +9,86 @@
  */
 
 #include "geometry.h"
+#include "ikcache.h"
+#include "reachmap.h"
+#include "chaincache.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+// Conversion from KDL::Frame to Eigen::Affine3d
+static Eigen::Affine3d kdlToAffine(const KDL::Frame& k) {
+	Eigen::Affine3d t = Eigen::Affine3d::Identity();
+	for (int i = 0; i < 3; i++) {
+		t.translation()(i) = k.p(i);
+		for (int j = 0; j < 3; j++)
+			t.linear()(i, j) = k.M(i, j);
+	}
+	return t;
+}
+
+// Conversion from Frame (in mm and degrees) to Eigen::Affine3d (in m)
+//  - same as KDL::Rotation::RPY(C, B, A) used by Frame2Axis
+static Eigen::Affine3d frameToAffine(const Frame& f) {
+	Eigen::Affine3d t = Eigen::Affine3d::Identity();
+	t.translation() << f.X / 1000.0, f.Y / 1000.0, f.Z / 1000.0;
+	t.linear() = (Eigen::AngleAxisd(f.A / 180.0 * M_PI,
+			Eigen::Vector3d::UnitZ())
+			* Eigen::AngleAxisd(f.B / 180.0 * M_PI, Eigen::Vector3d::UnitY())
+			* Eigen::AngleAxisd(f.C / 180.0 * M_PI, Eigen::Vector3d::UnitX())).toRotationMatrix();
+	return t;
+}
+
+// Forward kinematics of the needle tool robot, specialized at compile time
+typedef FixedKinematics<KR6R700SixxNeedle> NeedleKinematics;
+
+// Cast rotation (row major) and position (in m) into old format
+//  - same as KDL::Rotation::GetRPY
+static void matrixToFrame(const double* R, const double* p, Frame &f) {
+	f.X = p[0] * 1000.0;
+	f.Y = p[1] * 1000.0;
+	f.Z = p[2] * 1000.0;
+	double r, pp, y;
+	double epsilon = 1E-12;
+	pp = atan2(-R[6], sqrt(R[0] * R[0] + R[3] * R[3]));
+	if (fabs(pp) > (M_PI / 2.0 - epsilon)) {
+		y = atan2(-R[1], R[4]);
+		r = 0.0;
+	} else {
+		r = atan2(R[7], R[8]);
+		y = atan2(R[3], R[0]);
+	}
+	f.C = (float) r * 180.0 / M_PI;
+	f.B = (float) pp * 180.0 / M_PI;
+	f.A = (float) y * 180.0 / M_PI;
+}
+
+// Axis (in degrees) to joint array (in rad)
+static void axisToArray(const Axis &a, double* q) {
+	q[0] = a.A1 / 180.0 * M_PI;
+	q[1] = a.A2 / 180.0 * M_PI;
+	q[2] = a.A3 / 180.0 * M_PI;
+	q[3] = a.A4 / 180.0 * M_PI;
+	q[4] = a.A5 / 180.0 * M_PI;
+	q[5] = a.A6 / 180.0 * M_PI;
+}
+
+// Squared distance between two Axis in joint space (in degrees^2)
+static double axisDistance(const Axis& a, const Axis& b) {
+	return (a.A1 - b.A1) * (a.A1 - b.A1) + (a.A2 - b.A2) * (a.A2 - b.A2)
+			+ (a.A3 - b.A3) * (a.A3 - b.A3) + (a.A4 - b.A4) * (a.A4 - b.A4)
+			+ (a.A5 - b.A5) * (a.A5 - b.A5) + (a.A6 - b.A6) * (a.A6 - b.A6);
+}
+
+// True if every axis is within the software limit switches, the limits
+// AxisSolution::inLimits is computed with
+static bool axisInLimits(const Axis& a) {
+	return a.A1 >= A1_LOWER && a.A1 <= A1_UPPER && a.A2 >= A2_LOWER
+			&& a.A2 <= A2_UPPER && a.A3 >= A3_LOWER && a.A3 <= A3_UPPER
+			&& a.A4 >= A4_LOWER && a.A4 <= A4_UPPER && a.A5 >= A5_LOWER
+			&& a.A5 <= A5_UPPER && a.A6 >= A6_LOWER && a.A6 <= A6_UPPER;
+}
 
 Frame& Frame::operator+(const Frame& right) {
 	X = this->X + right.X;
@@ -81,7 +161,7 @@ Axis::Axis(float a1, float a2, float a3, float a4, float a5, float a6) {
 	A6 = a6;
 }
 
-Axis::Axis(Axis& a) {
+Axis::Axis(const Axis& a) {
 	A1 = a.A1;
 	A2 = a.A2;
 	A3 = a.A3;
@@ -153,60 +233,204 @@ void Pos::printPos() {
 			<< std::setw(16) << T << std::endl;
 }
 
-Model::Model(std::string fn) :
-		filename(fn) {
-	ROS_INFO("Model Constructing...");
-
+KinematicDescription::KinematicDescription(const std::string& fn,
+		const std::string& cache) :
+		filename(fn.empty() ? "robot_description" : fn), urdfHash_(0), fixedValid_(
+				false), analyticValid_(false) {
+	// URDF text, hashed to key the cache
+	std::string xml;
 	valid_ = true;
-	if (!kdl_parser::treeFromFile(filename, tree_)) {
-		std::cout << "Model::Model: Failed to construct kdl tree" << std::endl;
-		valid_ = false;
-	} else {
-		std::cout << "Number of Joints in Tree = " << tree_.getNrOfJoints()
-				<< std::endl;
-
-		// kdl::tree -> kdl::chain
-		std::string rootLink = "base_link";
-		std::string tipLink = "tip";
-		std::string flangeLink = "flange";
-		if (!tree_.getChain(rootLink, tipLink, chain_)) {
+	if (fn.empty()) {
+		if (!ros::param::get("robot_description", xml)) {
 			std::cout
-					<< "Model::Model: Failed to get chain from kdl tree, check root/tip link"
+					<< "Model::Model: Parameter robot_description not found"
 					<< std::endl;
 			valid_ = false;
 		}
-		if (!tree_.getChain(rootLink, flangeLink, chain_flange_)) {
-			std::cout
-					<< "Model::Model: Failed to get chain from kdl tree, check root/rot link"
+	} else {
+		std::ifstream in(fn.c_str());
+		if (!in) {
+			std::cout << "Model::Model: Cannot open " << fn << std::endl;
+			valid_ = false;
+		} else {
+			std::stringstream ss;
+			ss << in.rdbuf();
+			xml = ss.str();
+		}
+	}
+	if (!valid_)
+		return;
+	urdfHash_ = hashURDF(xml);
+
+	if (!cache.empty()
+			&& readChainCache(cache, urdfHash_, chain_, chain_flange_)) {
+		std::cout << "Model::Model: Chains read from " << cache << std::endl;
+	} else {
+		KDL::Tree tree;
+		if (!kdl_parser::treeFromString(xml, tree)) {
+			std::cout << "Model::Model: Failed to construct kdl tree"
 					<< std::endl;
 			valid_ = false;
-		} else
-			std::cout << "Number of Joints in Chain = "
-					<< chain_.getNrOfJoints() << std::endl;
+		} else {
+			std::cout << "Number of Joints in Tree = " << tree.getNrOfJoints()
+					<< std::endl;
+
+			// kdl::tree -> kdl::chain
+			std::string rootLink = "base_link";
+			std::string tipLink = "tip";
+			std::string flangeLink = "flange";
+			if (!tree.getChain(rootLink, tipLink, chain_)) {
+				std::cout
+						<< "Model::Model: Failed to get chain from kdl tree, check root/tip link"
+						<< std::endl;
+				valid_ = false;
+			}
+			if (!tree.getChain(rootLink, flangeLink, chain_flange_)) {
+				std::cout
+						<< "Model::Model: Failed to get chain from kdl tree, check root/rot link"
+						<< std::endl;
+				valid_ = false;
+			}
+		}
+		if (valid_ && !cache.empty())
+			writeChainCache(cache, urdfHash_, chain_, chain_flange_);
 	}
-	setupSolver();
+	if (!valid_)
+		return;
+	std::cout << "Number of Joints in Chain = " << chain_.getNrOfJoints()
+			<< std::endl;
+
+	// Solvers only for checking, each thread has its own in SolverContext
+	KDL::ChainFkSolverPos_recursive fkSolver(chain_);
+	KDL::ChainFkSolverPos_recursive fkSolver_flange(chain_flange_);
+
+	batchFK_.setChain(chain_, chain_flange_.getNrOfSegments());
+
+	// Tool of AnalyticIK: flange -> tip, constant for any joint value
+	KDL::JntArray jnt_q = KDL::JntArray(6);
+	KDL::Frame tipFrame, flangeFrame;
+	fkSolver.JntToCart(jnt_q, tipFrame);
+	fkSolver_flange.JntToCart(jnt_q, flangeFrame);
+	analyticIK_.setTool(kdlToAffine(flangeFrame.Inverse() * tipFrame));
+
+	// AnalyticIK assumes geometry of KR6 R700 sixx, compare with URDF
+	analyticValid_ = true;
+	const double test_q[3][6] = { { 0, 0, 0, 0, 0, 0 }, { 0.3, -1.2, 1.4,
+			-0.5, 0.8, 2.0 }, { -2.0, -2.5, -0.4, 2.5, -1.5, -4.0 } };
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 6; j++)
+			jnt_q(j) = test_q[i][j];
+		fkSolver.JntToCart(jnt_q, tipFrame);
+		Eigen::Affine3d diff = kdlToAffine(tipFrame).inverse()
+				* analyticIK_.forward(test_q[i]);
+		if (diff.translation().norm() > 1e-6
+				|| (diff.linear() - Eigen::Matrix3d::Identity()).norm() > 1e-6)
+			analyticValid_ = false;
+	}
+	if (analyticValid_)
+		std::cout << "Model::setupSolver: AnalyticIK OK" << std::endl;
+	else
+		std::cout
+				<< "Model::setupSolver: AnalyticIK does not match URDF, disabled"
+				<< std::endl;
+
+	// FixedKinematics is only used for the robot it is compiled for
+	fixedValid_ = true;
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 6; j++)
+			jnt_q(j) = test_q[i][j];
+		fkSolver.JntToCart(jnt_q, tipFrame);
+		fkSolver_flange.JntToCart(jnt_q, flangeFrame);
+		double R[9], p[3], Rf[9], pf[3];
+		NeedleKinematics::forward(test_q[i], R, p);
+		NeedleKinematics::forwardTo<KR6R700SixxNeedle::Flange>(
+				test_q[i], Rf, pf);
+		for (int k = 0; k < 9; k++)
+			if (fabs(R[k] - tipFrame.M(k / 3, k % 3)) > 1e-6
+					|| fabs(Rf[k] - flangeFrame.M(k / 3, k % 3)) > 1e-6)
+				fixedValid_ = false;
+		for (int k = 0; k < 3; k++)
+			if (fabs(p[k] - tipFrame.p(k)) > 1e-6
+					|| fabs(pf[k] - flangeFrame.p(k)) > 1e-6)
+				fixedValid_ = false;
+	}
+	if (fixedValid_)
+		std::cout << "Model::setupSolver: FixedKinematics<KR6R700SixxNeedle> OK"
+				<< std::endl;
+	else
+		std::cout << "Model::setupSolver: Unknown robot, KDL forward solver used"
+				<< std::endl;
 }
 
-Model::~Model() {
-	std::cout << "Model Deconstructing..." << std::endl;
+SolverContext::SolverContext(
+		boost::shared_ptr<const KinematicDescription> description) :
+		description_(description) {
+	fkSolver_ = new KDL::ChainFkSolverPos_recursive(description_->chain_);
+	fkSolver_flange_ = new KDL::ChainFkSolverPos_recursive(
+			description_->chain_flange_);
+	ikSolver_ = new KDL::ChainIkSolverPos_LMA(description_->chain_);
+	jacSolver_ = new KDL::ChainJntToJacSolver(description_->chain_);
+}
+
+SolverContext::~SolverContext() {
 	delete ikSolver_;
 	delete fkSolver_;
 	delete fkSolver_flange_;
+	delete jacSolver_;
+}
+
+Model::Model(std::string fn, std::string cache) :
+		description_(new KinematicDescription(fn, cache)), ikBackend_(IK_LMA) {
+	ROS_INFO("Model Constructing...");
+
+	ikCache_ = new IKCache();
+	reachMap_ = new ReachabilityMap();
+
+	valid_ = description_->valid_;
+	fixedValid_ = description_->fixedValid_;
+	analyticValid_ = description_->analyticValid_;
+
+	const double lower[6] = { A1_LOWER, A2_LOWER, A3_LOWER, A4_LOWER,
+			A5_LOWER, A6_LOWER };
+	const double upper[6] = { A1_UPPER, A2_UPPER, A3_UPPER, A4_UPPER,
+			A5_UPPER, A6_UPPER };
+	for (int i = 0; i < 6; i++) {
+		lower_[i] = lower[i];
+		upper_[i] = upper[i];
+	}
+	setupSolver();
+}
+
+Model::~Model() {
+	std::cout << "Model Deconstructing..." << std::endl;
+	delete ikCache_;
+	delete reachMap_;
+	// SolverContext of each thread is deleted by contexts_
 }
 
 void Model::setupSolver() {
 	if (valid_) {
-		fkSolver_ = new KDL::ChainFkSolverPos_recursive(chain_);
-		fkSolver_flange_ = new KDL::ChainFkSolverPos_recursive(chain_flange_);
-		ikSolver_ = new KDL::ChainIkSolverPos_LMA(chain_);
+		solver();
 		std::cout << "Model::setupSolver: OK" << std::endl;
 	} else
 		std::cout << "Model::setupSolver: Failed, chain_ invalid" << std::endl;
 }
 
+SolverContext& Model::solver() {
+	if (!contexts_.hasLocalData())
+		contexts_.setLocalData(new SolverContext(description_));
+	return *contexts_.localData();
+}
+
 bool Model::Axis2Frame(Axis &a, Frame &f) {
 	int ret_val = 0;
-	if (valid_) {
+	if (valid_ && fixedValid_) {
+		double q[6], R[9], p[3];
+		axisToArray(a, q);
+		NeedleKinematics::forward(q, R, p);
+		matrixToFrame(R, p, f);
+		return true;
+	} else if (valid_) {
 		// Init KDL variables
 		KDL::JntArray jnt_q = KDL::JntArray(6);
 		KDL::Frame tipFrame;
@@ -218,7 +442,7 @@ bool Model::Axis2Frame(Axis &a, Frame &f) {
 		jnt_q(5) = a.A6 / 180.0 * M_PI;
 
 		// Forward Solver
-		ret_val = fkSolver_->JntToCart(jnt_q, tipFrame);
+		ret_val = solver().fkSolver_->JntToCart(jnt_q, tipFrame);
 		if (ret_val < 0) {
 			std::cout
 					<< "Model::Axis2Frame: JntToCart error, Frame set to Home value"
@@ -247,7 +471,13 @@ bool Model::Axis2Frame(Axis &a, Frame &f) {
 
 bool Model::Axis2Frame_flange(Axis &a, Frame &f) {
 	int ret_val = 0;
-	if (valid_) {
+	if (valid_ && fixedValid_) {
+		double q[6], R[9], p[3];
+		axisToArray(a, q);
+		NeedleKinematics::forwardTo<KR6R700SixxNeedle::Flange>(q, R, p);
+		matrixToFrame(R, p, f);
+		return true;
+	} else if (valid_) {
 		// Init KDL variables
 		KDL::JntArray jnt_q = KDL::JntArray(6);
 		KDL::Frame tipFrame;
@@ -259,7 +489,7 @@ bool Model::Axis2Frame_flange(Axis &a, Frame &f) {
 		jnt_q(5) = a.A6 / 180.0 * M_PI;
 
 		// Forward Solver
-		ret_val = fkSolver_flange_->JntToCart(jnt_q, tipFrame);
+		ret_val = solver().fkSolver_flange_->JntToCart(jnt_q, tipFrame);
 		if (ret_val < 0) {
 			std::cout
 					<< "Model::Axis2Frame: JntToCart error, Frame set to Home value"
@@ -286,19 +516,108 @@ bool Model::Axis2Frame_flange(Axis &a, Frame &f) {
 	}
 }
 
+// Cast frame i of FrameBatch into old format
+static void batchToFrame(const FrameBatch& b, int i, Frame &f) {
+	f.X = b.x(i) * 1000.0;
+	f.Y = b.y(i) * 1000.0;
+	f.Z = b.z(i) * 1000.0;
+	double r, p, y;
+	b.getRPY(i, r, p, y);
+	f.C = (float) r * 180.0 / M_PI;
+	f.B = (float) p * 180.0 / M_PI;
+	f.A = (float) y * 180.0 / M_PI;
+}
+
+bool Model::Axis2FrameBatch(std::vector<Axis> &a, std::vector<Frame> &f,
+		std::vector<Frame> *f_flange) {
+	f.resize(a.size());
+	if (f_flange != NULL)
+		f_flange->resize(a.size());
+	if (!valid_ || description_->batchFK_.getNrOfJoints() != 6) {
+		std::cout << "Model::Axis2FrameBatch: Failed, solver invalid"
+				<< std::endl;
+		return false;
+	}
+
+	// Structure of arrays: column j holds A(j+1) of every Axis
+	int n = a.size();
+	Eigen::ArrayXXd q(n, 6);
+	for (int i = 0; i < n; i++) {
+		q(i, 0) = a[i].A1;
+		q(i, 1) = a[i].A2;
+		q(i, 2) = a[i].A3;
+		q(i, 3) = a[i].A4;
+		q(i, 4) = a[i].A5;
+		q(i, 5) = a[i].A6;
+	}
+	q *= M_PI / 180.0;
+
+	FrameBatch tip, flange;
+	description_->batchFK_.compute(q, tip, f_flange != NULL ? &flange : NULL);
+	for (int i = 0; i < n; i++)
+		batchToFrame(tip, i, f[i]);
+	if (f_flange != NULL)
+		for (int i = 0; i < n; i++)
+			batchToFrame(flange, i, (*f_flange)[i]);
+	return true;
+}
+
 bool Model::Frame2Axis(Axis &a_init, Frame &f, Axis &a) {
+	return frame2Axis(a_init, f, a, getIKBackend());
+}
+
+bool Model::frame2Axis(Axis &a_init, Frame &f, Axis &a, IKBackend backend) {
 	int ret_val = 0;
-	if (valid_) {
+
+	// Cached solutions are keyed by Status and Turn of a_init, and only
+	// solutions on that branch are stored (see cacheSolution), so the cache
+	// never moves the result to another branch than a_init would
+	Pos p_init;
+	Axis a_cached;
+	IKCache::Result cached = IKCache::Miss;
+	if (valid_ && Axis2Pos(a_init, p_init))
+		cached = ikCache_->lookup(f, p_init.S, p_init.T, a_cached);
+	if (cached == IKCache::ExactHit) {
+		a.set(a_cached);
+		return true;
+	}
+
+	if (valid_ && backend == IK_ANALYTIC) {
+		// Nearest solution to a_init within limits, A4 and A6 turned by
+		// 360 degrees included, so the wrist never spins a full turn
+		std::vector<AxisSolution> sols;
+		Frame2AxisAll(f, sols, true);
+		int best = -1;
+		for (size_t i = 0; i < sols.size(); i++)
+			if (sols[i].inLimits
+					&& (best < 0
+							|| axisDistance(sols[i].A, a_init)
+									< axisDistance(sols[best].A, a_init)))
+				best = i;
+		if (best < 0) {
+			std::cout
+					<< "Model::Frame2Axis: No analytic solution, Axis set to Home value"
+					<< std::endl;
+			a.set();
+			return false;
+		}
+		a.set(sols[best].A);
+		cacheSolution(f, p_init, a);
+		return true;
+	} else if (valid_) {
+		// A near hit of the cache is a warm initial value
+		Axis& a_seed = (cached == IKCache::NearHit) ? a_cached : a_init;
+
 		// Init KDL variables
 		KDL::JntArray jnt_init = KDL::JntArray(6);
 		KDL::JntArray jnt_q = KDL::JntArray(6);
 		KDL::Frame tipFrame;
-		jnt_init(0) = a_init.A1 / 180.0 * M_PI;
-		jnt_init(1) = a_init.A2 / 180.0 * M_PI;
-		jnt_init(2) = a_init.A3 / 180.0 * M_PI;
-		jnt_init(3) = a_init.A4 / 180.0 * M_PI;
-		jnt_init(4) = a_init.A5 / 180.0 * M_PI;
-		jnt_init(5) = a_init.A6 / 180.0 * M_PI;
+		jnt_init(0) = a_seed.A1 / 180.0 * M_PI;
+		jnt_init(1) = a_seed.A2 / 180.0 * M_PI;
+		jnt_init(2) = a_seed.A3 / 180.0 * M_PI;
+		jnt_init(3) = a_seed.A4 / 180.0 * M_PI;
+		jnt_init(4) = a_seed.A5 / 180.0 * M_PI;
+		jnt_init(5) = a_seed.A6 / 180.0 * M_PI;
 		tipFrame.p.data[0] = f.X / 1000.0;
 		tipFrame.p.data[1] = f.Y / 1000.0;
 		tipFrame.p.data[2] = f.Z / 1000.0;
@@ -306,7 +625,7 @@ bool Model::Frame2Axis(Axis &a_init, Frame &f, Axis &a) {
 				(double) (f.B) / 180.0 * M_PI, (double) (f.A) / 180.0 * M_PI);
 
 		// Forward Solver
-		ret_val = ikSolver_->CartToJnt(jnt_init, tipFrame, jnt_q);
+		ret_val = solver().ikSolver_->CartToJnt(jnt_init, tipFrame, jnt_q);
 		if (ret_val < 0) {
 			std::cout
 					<< "Model::Frame2Axis: CartToJnt error, Axis set to Home value"
@@ -323,6 +642,7 @@ bool Model::Frame2Axis(Axis &a_init, Frame &f, Axis &a) {
 		a.A5 = jnt_q.data[4] * 180.0 / M_PI;
 		a.A6 = jnt_q.data[5] * 180.0 / M_PI;
 
+		cacheSolution(f, p_init, a);
 		return true;
 	} else {
 		std::cout << "Model::Frame2Axis: Failed, solver invalid" << std::endl;
@@ -331,10 +651,192 @@ bool Model::Frame2Axis(Axis &a_init, Frame &f, Axis &a) {
 	}
 }
 
+void Model::cacheSolution(Frame &f, Pos &p_init, Axis &a) {
+	Pos p;
+	if (Axis2Pos(a, p) && p.S == p_init.S && p.T == p_init.T)
+		ikCache_->insert(f, p.S, p.T, a);
+}
+
+int Model::Frame2AxisAll(Frame &f, std::vector<AxisSolution> &sols,
+		bool allTurns) {
+	if (!valid_ || !analyticValid_) {
+		std::cout << "Model::Frame2AxisAll: Failed, analytic solver invalid"
+				<< std::endl;
+		return 0;
+	}
+
+	std::vector<IKSolution> ik;
+	Eigen::Affine3d tip = frameToAffine(f);
+	if (description_->analyticIK_.solve(tip, ik) == 0)
+		return 0;
+
+	// Status is determined by the flange position, same for all solutions
+	Eigen::Vector3d flange =
+			description_->analyticIK_.forwardFlange(ik[0].q).translation();
+	Pos p;
+	size_t first = sols.size();
+	for (size_t i = 0; i < ik.size(); i++) {
+		AxisSolution sol;
+		sol.A.set(ik[i].q[0] * 180.0 / M_PI, ik[i].q[1] * 180.0 / M_PI,
+				ik[i].q[2] * 180.0 / M_PI, ik[i].q[3] * 180.0 / M_PI,
+				ik[i].q[4] * 180.0 / M_PI, ik[i].q[5] * 180.0 / M_PI);
+		sol.S = getStatus(p, sol.A, flange.x(), flange.y());
+		sol.T = getTurn(p, sol.A);
+		sol.inLimits = ik[i].inLimits;
+		sols.push_back(sol);
+		if (!allTurns)
+			continue;
+
+		// A4 and A6 may turn by 360 degrees, Status is not affected
+		float a4 = sol.A.A4, a6 = sol.A.A6;
+		for (int k4 = -1; k4 <= 1; k4++)
+			for (int k6 = -1; k6 <= 1; k6++) {
+				if (k4 == 0 && k6 == 0)
+					continue;
+				AxisSolution turn = sol;
+				turn.A.A4 = a4 + 360.0 * k4;
+				turn.A.A6 = a6 + 360.0 * k6;
+				if (turn.A.A4 < A4_LOWER || turn.A.A4 > A4_UPPER
+						|| turn.A.A6 < A6_LOWER || turn.A.A6 > A6_UPPER)
+					continue;
+				// A1 - A3 and A5 are unchanged, A4 and A6 are within limits
+				turn.inLimits = (sol.A.A1 >= A1_LOWER && sol.A.A1 <= A1_UPPER
+						&& sol.A.A2 >= A2_LOWER && sol.A.A2 <= A2_UPPER
+						&& sol.A.A3 >= A3_LOWER && sol.A.A3 <= A3_UPPER
+						&& sol.A.A5 >= A5_LOWER && sol.A.A5 <= A5_UPPER);
+				turn.T = getTurn(p, turn.A);
+				sols.push_back(turn);
+			}
+	}
+	return sols.size() - first;
+}
+
+bool Model::jacobian(const double q[6], Eigen::Matrix<double, 6, 6> &J,
+		Eigen::Affine3d &tip) {
+	if (valid_ && fixedValid_) {
+		double j[36], R[9], p[3];
+		NeedleKinematics::jacobian(q, j, R, p);
+		for (int r = 0; r < 6; r++)
+			for (int c = 0; c < 6; c++)
+				J(r, c) = j[6 * r + c];
+		tip = Eigen::Affine3d::Identity();
+		for (int r = 0; r < 3; r++) {
+			tip.translation()(r) = p[r];
+			for (int c = 0; c < 3; c++)
+				tip.linear()(r, c) = R[3 * r + c];
+		}
+		return true;
+	} else if (valid_) {
+		KDL::JntArray jnt_q = KDL::JntArray(6);
+		for (int i = 0; i < 6; i++)
+			jnt_q(i) = q[i];
+		KDL::Jacobian jac(6);
+		KDL::Frame tipFrame;
+		if (solver().jacSolver_->JntToJac(jnt_q, jac) < 0
+				|| solver().fkSolver_->JntToCart(jnt_q, tipFrame) < 0) {
+			std::cout << "Model::jacobian: JntToJac error" << std::endl;
+			return false;
+		}
+		for (int r = 0; r < 6; r++)
+			for (int c = 0; c < 6; c++)
+				J(r, c) = jac(r, c);
+		tip = kdlToAffine(tipFrame);
+		return true;
+	} else {
+		std::cout << "Model::jacobian: Failed, solver invalid" << std::endl;
+		return false;
+	}
+}
+
+bool Model::jacobian(Axis &a, Eigen::Matrix<double, 6, 6> &J, Frame &f) {
+	double q[6];
+	axisToArray(a, q);
+	Eigen::Affine3d tip;
+	if (!jacobian(q, J, tip))
+		return false;
+	double R[9], p[3];
+	for (int r = 0; r < 3; r++) {
+		p[r] = tip.translation()(r);
+		for (int c = 0; c < 3; c++)
+			R[3 * r + c] = tip.linear()(r, c);
+	}
+	matrixToFrame(R, p, f);
+	return true;
+}
+
+bool Model::differentialIK(Axis &a_init, Frame &f, Axis &a, double damping) {
+	double q[6];
+	axisToArray(a_init, q);
+	Eigen::Affine3d target = frameToAffine(f);
+	Eigen::Matrix<double, 6, 6> J;
+	Eigen::Affine3d tip;
+	Eigen::Matrix<double, 6, 1> error;
+	bool converged = false;
+	for (int n = 0; n < DIFFIK_MAX_ITERATIONS; n++) {
+		if (!jacobian(q, J, tip)) {
+			a.set(a_init);
+			return false;
+		}
+
+		// Position error (in m) and rotation vector of target * tip^-1
+		error.head<3>() = target.translation() - tip.translation();
+		Eigen::AngleAxisd rotation(target.linear() * tip.linear().transpose());
+		error.tail<3>() = rotation.angle() * rotation.axis();
+		if (error.head<3>().norm() * 1000.0 < DIFFIK_POSITION_TOLERANCE
+				&& error.tail<3>().norm() / M_PI * 180.0
+						< DIFFIK_ANGLE_TOLERANCE) {
+			converged = true;
+			break;
+		}
+
+		// Damped least squares, well-conditioned near singularities
+		Eigen::Matrix<double, 6, 6> JJt = J * J.transpose();
+		JJt.diagonal().array() += damping * damping;
+		Eigen::Matrix<double, 6, 1> dq = J.transpose() * JJt.ldlt().solve(error);
+
+		for (int i = 0; i < 6; i++) {
+			q[i] += dq(i);
+			if (q[i] < lower_[i] / 180.0 * M_PI)
+				q[i] = lower_[i] / 180.0 * M_PI;
+			if (q[i] > upper_[i] / 180.0 * M_PI)
+				q[i] = upper_[i] / 180.0 * M_PI;
+		}
+	}
+
+	a.set(q[0] * 180.0 / M_PI, q[1] * 180.0 / M_PI, q[2] * 180.0 / M_PI,
+			q[3] * 180.0 / M_PI, q[4] * 180.0 / M_PI, q[5] * 180.0 / M_PI);
+	if (!converged)
+		std::cout << "Model::differentialIK: Not converged, position error "
+				<< error.head<3>().norm() * 1000.0 << " mm, angle error "
+				<< error.tail<3>().norm() / M_PI * 180.0 << " deg"
+				<< std::endl;
+	return converged;
+}
+
+bool Model::setJointLimits(int joint, double lower, double upper) {
+	if (joint < 0 || joint > 5 || lower >= upper) {
+		std::cout << "Model::setJointLimits: Joint or limits invalid"
+				<< std::endl;
+		return false;
+	}
+	lower_[joint] = lower;
+	upper_[joint] = upper;
+	return true;
+}
+
 bool Model::Axis2Pos(Axis &a, Pos &p) {
 	int ret_val1 = 0;
 	int ret_val2 = 0;
-	if (valid_) {
+	if (valid_ && fixedValid_) {
+		double q[6], R[9], pp[3], Rf[9], pf[3];
+		axisToArray(a, q);
+		NeedleKinematics::forward(q, R, pp);
+		NeedleKinematics::forwardTo<KR6R700SixxNeedle::Flange>(q, Rf, pf);
+		matrixToFrame(R, pp, p.F);
+		getStatus(p, a, pf[0], pf[1]);
+		getTurn(p, a);
+		return true;
+	} else if (valid_) {
 		// Init KDL variables
 		KDL::JntArray jnt_q = KDL::JntArray(6);
 		KDL::Frame tipFrame, rotFrame;
@@ -346,8 +848,8 @@ bool Model::Axis2Pos(Axis &a, Pos &p) {
 		jnt_q(5) = a.A6 / 180.0 * M_PI;
 
 		// Forward Solver
-		ret_val1 = fkSolver_->JntToCart(jnt_q, tipFrame);
-		ret_val2 = fkSolver_flange_->JntToCart(jnt_q, rotFrame);
+		ret_val1 = solver().fkSolver_->JntToCart(jnt_q, tipFrame);
+		ret_val2 = solver().fkSolver_flange_->JntToCart(jnt_q, rotFrame);
 
 		if (ret_val1 < 0 || ret_val2 < 0) {
 			std::cout
@@ -381,7 +883,28 @@ bool Model::Axis2Pos(Axis &a, Pos &p) {
 }
 
 bool Model::Pos2Axis(Axis &a_init, Pos &p, Axis &a) {
-	if (valid_)
+	if (valid_ && analyticValid_) {
+		if (ikCache_->lookup(p.F, p.S, p.T, a) == IKCache::ExactHit)
+			return true;
+		std::vector<AxisSolution> sols;
+		Frame2AxisAll(p.F, sols, true);
+		bool exact;
+		int best = selectSolution(sols, p, a_init, exact);
+		if (best < 0) {
+			std::cout
+					<< "Model::Pos2Axis: Pos unreachable, Axis set to Home value"
+					<< std::endl;
+			a.set();
+			return false;
+		}
+		if (!exact)
+			std::cout << "Model::Pos2Axis: No solution with S = " << p.S
+					<< ", T = " << p.T << ", nearest one chosen" << std::endl;
+		a.set(sols[best].A);
+		if (exact)
+			ikCache_->insert(p.F, p.S, p.T, a);
+		return true;
+	} else if (valid_)
 		return Frame2Axis(a_init, p.F, a);
 	else {
 		std::cout << "Model::Pos2Axis: Failed, solver invalid" << std::endl;
@@ -389,6 +912,77 @@ bool Model::Pos2Axis(Axis &a_init, Pos &p, Axis &a) {
 	}
 }
 
+int Model::Pos2AxisBatch(Axis &a_init, std::vector<Pos> &p,
+		std::vector<Axis> &a) {
+	a.resize(p.size());
+	if (!valid_) {
+		std::cout << "Model::Pos2AxisBatch: Failed, solver invalid"
+				<< std::endl;
+		return 0;
+	}
+
+	int count = 0;
+	Axis seed(a_init);
+	std::vector<AxisSolution> sols;
+	sols.reserve(64);
+	for (size_t i = 0; i < p.size(); i++) {
+		if (!analyticValid_) {
+			if (Frame2Axis(seed, p[i].F, a[i])) {
+				seed.set(a[i]);
+				count++;
+			}
+			continue;
+		}
+		sols.clear();
+		Frame2AxisAll(p[i].F, sols, true);
+		bool exact;
+		int best = selectSolution(sols, p[i], seed, exact);
+		if (best < 0) {
+			a[i].set();
+			continue;
+		}
+		a[i].set(sols[best].A);
+		seed.set(a[i]);
+		count++;
+	}
+	return count;
+}
+
+bool Model::isReachable(Pos &p) {
+	if (valid_ && analyticValid_) {
+		std::vector<AxisSolution> sols;
+		Frame2AxisAll(p.F, sols, true);
+		for (size_t i = 0; i < sols.size(); i++)
+			if (sols[i].inLimits && sols[i].S == p.S && sols[i].T == p.T)
+				return true;
+		return false;
+	}
+	// KDL finds one solution only, Status and Turn cannot be chosen, but
+	// the limits are checked as for the analytic solutions
+	Axis a_init, a;
+	return Pos2Axis(a_init, p, a) && axisInLimits(a);
+}
+
+int Model::selectSolution(std::vector<AxisSolution> &sols, Pos &p,
+		Axis &a_init, bool &exact) {
+	int best = -1;
+	exact = false;
+	for (size_t i = 0; i < sols.size(); i++) {
+		if (!sols[i].inLimits)
+			continue;
+		bool match = (sols[i].S == p.S && sols[i].T == p.T);
+		if (exact && !match)
+			continue;
+		if (best < 0 || (match && !exact)
+				|| axisDistance(sols[i].A, a_init)
+						< axisDistance(sols[best].A, a_init)) {
+			best = i;
+			exact = match;
+		}
+	}
+	return best;
+}
+
 int Model::getStatus(Pos& p, Axis &a, double x, double y) {
 	int b0, b1, b2;
 	double s1_temp = atan2(y, x);
@@ -425,3 +1019,40 @@ int Model::getTurn(Pos& p, Axis &a) {
 	p.T = t;
 	return t;
 }
+
+bool Model::setIKBackend(IKBackend backend) {
+	if (backend == IK_ANALYTIC && !analyticValid_) {
+		std::cout << "Model::setIKBackend: AnalyticIK invalid, IK_LMA kept"
+				<< std::endl;
+		return false;
+	}
+	ikBackend_.fetchAndStoreOrdered(backend);
+	ikCache_->clear();
+	std::cout << "Model::setIKBackend: "
+			<< (backend == IK_ANALYTIC ? "IK_ANALYTIC" : "IK_LMA") << std::endl;
+	return true;
+}
+
+Model::IKBackend Model::getIKBackend() {
+	return (IKBackend) ikBackend_.fetchAndAddOrdered(0);
+}
+
+IKCache& Model::getIKCache() {
+	return *ikCache_;
+}
+
+bool Model::loadReachabilityMap(const std::string& fn) {
+	return reachMap_->load(fn, description_->urdfHash_);
+}
+
+ReachabilityMap& Model::getReachabilityMap() {
+	return *reachMap_;
+}
+
+std::string Model::getFilename() {
+	return description_->filename;
+}
+
+uint64_t Model::getURDFHash() {
+	return description_->urdfHash_;
+}
@@ -22,11 +22,23 @@
 #include <string>
 #include <iomanip>
 #include <cmath>
+#include <vector>
 #include <kdl_parser/kdl_parser.hpp>
 #include <kdl/chainfksolverpos_recursive.hpp>
 #include <kdl/chainiksolverpos_lma.hpp>
+#include <kdl/chainjnttojacsolver.hpp>
 #include <kdl/frames.hpp>
 #include <ros/ros.h>
+#include <boost/shared_ptr.hpp>
+#include <QAtomicInt>
+#include <QThreadStorage>
+
+#include "analyticik.h"
+#include "batchfk.h"
+#include "fixedkinematics.h"
+
+class IKCache;
+class ReachabilityMap;
 // --------------------------------------------------------------------------
 // Default value for robot position (in mm), $H_POS
 // --------------------------------------------------------------------------
@@ -73,6 +85,18 @@
 // --------------------------------------------------------------------------
 #define STATUS_A3_THRESHOLD 5.477368729
 
+// --------------------------------------------------------------------------
+// Differential inverse kinematics, see Model::differentialIK
+// DIFFIK_DEFAULT_DAMPING   : lambda of damped least squares (m, rad)
+// DIFFIK_MAX_ITERATIONS    : Jacobian steps before giving up
+// DIFFIK_POSITION_TOLERANCE: converged position error (in mm)
+// DIFFIK_ANGLE_TOLERANCE   : converged orientation error (in degrees)
+// --------------------------------------------------------------------------
+#define DIFFIK_DEFAULT_DAMPING 0.001
+#define DIFFIK_MAX_ITERATIONS 20
+#define DIFFIK_POSITION_TOLERANCE 0.001
+#define DIFFIK_ANGLE_TOLERANCE 0.001
+
 // --------------------------------------------------------------------------
 // Data structure: Frame
 //  - corresponds to FRAME in KRL
@@ -147,7 +171,7 @@ struct Axis {
 			float a6 = DEFAULT_A6);
 
 	// Copy constructor for Axis
-	Axis(Axis& a);
+	Axis(const Axis& a);
 
 	// Operator + support for Axis, adds up two Axis
 	void operator+(const Axis& right);
@@ -194,6 +218,90 @@ struct Pos {
 	void printPos();
 };
 
+// --------------------------------------------------------------------------
+// Data structure: AxisSolution
+//  - one solution of inverse kinematics, see Model::Frame2AxisAll
+//  - S and T are the Status and Turn of A, as given by Model::getStatus
+//      and Model::getTurn
+//  - inLimits is false if any axis is outside of software limit switches
+// --------------------------------------------------------------------------
+struct AxisSolution {
+	Axis A;
+	int S;
+	int T;
+	bool inLimits;
+};
+
+// --------------------------------------------------------------------------
+// Data structure: KinematicDescription
+//  - everything of a robot that is read from URDF once and never changed
+//  - shared by all threads through boost::shared_ptr<const ...>, so it is
+//      safe to read concurrently without lock
+//  - solvers with internal state (KDL) are in SolverContext instead
+// --------------------------------------------------------------------------
+struct KinematicDescription {
+	// Read URDF, build chains and check analytic/fixed solvers
+	//  - URDF from file fn, or from ROS parameter "robot_description" if fn
+	//      is empty
+	//  - if cache is not empty, chains are read from this file instead of
+	//      parsing URDF, when it is written for the same URDF (see
+	//      chaincache.h), otherwise it is rewritten after parsing
+	KinematicDescription(const std::string& fn, const std::string& cache);
+
+	// Path and filename for URDF description, "robot_description" if read
+	// from the parameter
+	std::string filename;
+
+	// Hash of URDF text, see hashURDF
+	uint64_t urdfHash_;
+
+	// True if KDL::Chain is successfully parsed or read from cache
+	bool valid_;
+
+	// KDL::Chain from root to tip
+	KDL::Chain chain_;
+
+	// KDL::Chain from root to intersetion point of A4, A5 and A6
+	// for calculating Pos.S
+	KDL::Chain chain_flange_;
+
+	// True if FixedKinematics<KR6R700SixxNeedle> agrees with chain_ and
+	// chain_flange_, then it is used instead of KDL forward solvers
+	bool fixedValid_;
+
+	// Vectorized forward solver of chain_, flange frame in the middle
+	BatchFK batchFK_;
+
+	// Close-form solver, tool taken from chain_flange_ and chain_
+	AnalyticIK analyticIK_;
+	// True if analyticIK_ agrees with chain_ and chain_flange_
+	bool analyticValid_;
+};
+
+// --------------------------------------------------------------------------
+// Data structure: SolverContext
+//  - KDL solvers of one thread, cheap to construct
+//  - KDL solvers keep internal buffers and must not be shared by threads
+//  - holds a reference of KinematicDescription, the chains they point to
+//      live as long as the solvers
+// --------------------------------------------------------------------------
+struct SolverContext {
+	// Two forward solver are set up
+	// fkSolver_       : recursive solver, from root to tip
+	// fkSolver_flange_: recursive solver, from root to flange
+	//                                                 (for calculating Pos.S)
+	// ikSolver_       : LMA solver
+	// jacSolver_      : Jacobian solver, from root to tip
+	SolverContext(boost::shared_ptr<const KinematicDescription> description);
+	~SolverContext();
+
+	boost::shared_ptr<const KinematicDescription> description_;
+	KDL::ChainFkSolverPos_recursive* fkSolver_;
+	KDL::ChainFkSolverPos_recursive* fkSolver_flange_;
+	KDL::ChainIkSolverPos_LMA* ikSolver_;
+	KDL::ChainJntToJacSolver* jacSolver_;
+};
+
 // --------------------------------------------------------------------------
 // Data structure: Model
 //  - Geometry of a robot with URDF description file
@@ -202,28 +310,40 @@ struct Pos {
 //  - DH parameters could be found on KUKA smartPAD:
 //      Menu/Configuration/Safety configuration/Machine data, press "View"
 //  - kdl_parser and orocos_kdl library is utilized
-//  - Note that inverse kinematics is iteratively calculated rather than close-form
-//      expressed, could be inaccurate, and the result is dependent on initial value.
+//  - If the URDF is the KR6 R700 sixx with needle tool, forward kinematics is
+//      done by FixedKinematics<KR6R700SixxNeedle>, compiled for this robot,
+//      otherwise by KDL at runtime.
+//  - Inverse kinematics has two backends, see setIKBackend:
+//    * IK_LMA     : iteratively calculated by KDL, could be inaccurate, and the
+//                   result is dependent on initial value.
+//    * IK_ANALYTIC: close-form solution of AnalyticIK, exact, all solutions
+//                   available, the one nearest to initial value is chosen.
+//                   Only valid for KR6 R700 sixx, checked against the URDF.
+//  - Model can be used by several threads at the same time (GUI, Plannar):
+//    * URDF description is immutable and shared, see KinematicDescription
+//    * every thread gets its own KDL solvers on first use, see SolverContext
+//    * IKCache is locked internally
+//    * IKBackend is atomic, switching it clears IKCache
 // --------------------------------------------------------------------------
 class Model {
 public:
+	enum IKBackend {
+		IK_LMA, IK_ANALYTIC
+	};
+
 	// Default constructor for Model
-	// Default URDF file path = ../robot/kuka_kr6_description.urdf
-	// KDL::Tree and KDL::Chain are constructed here
-	Model(
-			std::string fn =
-					"/home/lxt12/Kuka_interface/src/kuka_kr6/robots/kuka_kr6_needle.urdf");
+	// URDF is read from file fn, or from ROS parameter "robot_description"
+	// if fn is empty
+	// KDL::Chain is parsed here, or read from cache file if it is not empty
+	// and written for the same URDF, see KinematicDescription
+	Model(std::string fn = "", std::string cache = "");
 
 	// Deconstructor for Model
-	// Delete pointer contents: forward and inverse solver
+	// Solvers of each thread are deleted when the thread finishes
 	~Model();
 
-	// Setup forward and inverse solver
-	// Two forward solver are set up
-	// fkSolver_    : recursive solver, from root to tip
-	// fkSolver_rot_: recursive solver, from root to intersection of A4, A5 and A6
-	//                                                      (for calculating Pos.S)
-	// ikSolver_    : LMA solver
+	// Setup forward and inverse solver of the calling thread
+	// Called automatically on first use in a thread
 	void setupSolver();
 
 	// Convertion from Axis to Frame
@@ -231,12 +351,51 @@ public:
 	// if return false, something went wrong
 	bool Axis2Frame(Axis &a, Frame &f);
 	bool Axis2Frame_flange(Axis &a, Frame &f);
+	// Convertion from a series of Axis to Frame at once, e.g. a trajectory
+	// vectorized by BatchFK, results are the same as Axis2Frame
+	// output f is resized to the size of a
+	// if f_flange is not NULL, it is filled as Axis2Frame_flange
+	// if return false, something went wrong
+	bool Axis2FrameBatch(std::vector<Axis> &a, std::vector<Frame> &f,
+			std::vector<Frame> *f_flange = NULL);
 	// Convertion from Frame to Axis
 	// output is passed through reference Axis &a
 	// Axis &a_init used as initial point for iteration
 	// if return false, something went wrong
 	bool Frame2Axis(Axis &a_init, Frame &f, Axis &a);
 
+	// All solutions of inverse kinematics for Frame &f, by AnalyticIK
+	// (up to 8, the LMA backend is never used here)
+	// each solution is tagged with Status and Turn
+	// if allTurns is true, A4 and A6 +/- 360 degrees within limits are added,
+	// so that every reachable Turn is present
+	// returns number of solutions, 0 if unreachable or analytic solver invalid
+	int Frame2AxisAll(Frame &f, std::vector<AxisSolution> &sols,
+			bool allTurns = false);
+
+	// Geometric Jacobian at Axis &a, reference point at tip, in base frame
+	// rows: vx, vy, vz (in m/rad), wx, wy, wz (in rad/rad)
+	// tip Frame of Axis &a is passed through reference parameter &f
+	// if return false, something went wrong
+	bool jacobian(Axis &a, Eigen::Matrix<double, 6, 6> &J, Frame &f);
+
+	// Differential inverse kinematics for small corrective moves
+	//  - damped least squares steps from Axis &a_init toward Frame &f:
+	//      dq = J^T * (J * J^T + damping^2 * I)^-1 * error
+	//  - every step is clamped to joint limits, see setJointLimits
+	//  - stays on the branch of a_init, Status and Turn are not changed
+	//  - converged when errors are below DIFFIK_POSITION_TOLERANCE and
+	//      DIFFIK_ANGLE_TOLERANCE, within DIFFIK_MAX_ITERATIONS steps
+	// output is passed through reference Axis &a, the last step if failed
+	// if return false, not converged (far away, singular or out of limits)
+	bool differentialIK(Axis &a_init, Frame &f, Axis &a, double damping =
+			DIFFIK_DEFAULT_DAMPING);
+
+	// Set method: limits of joint (0 to 5) for differentialIK (in degrees)
+	// default limits are A1_LOWER ... A6_UPPER
+	// if return false, joint or limits invalid and nothing is changed
+	bool setJointLimits(int joint, double lower, double upper);
+
 	// Converstion from Axis to Pos
 	// output is passed through reference parameter &p
 	// if return false, something went wrong
@@ -244,12 +403,22 @@ public:
 
 	// Conversion from Pos to Axis
 	// output is passed through reference Axis &a
-	// Axis &a_init used as initial point for iteration
-	// this function inherit from Frame2Axis
-	// status and turn are redundant parameter
+	// with AnalyticIK, the solution whose Status and Turn equal p.S and p.T
+	// is chosen, if there is none, the solution nearest to Axis &a_init
+	// without AnalyticIK, inherit from Frame2Axis, status and turn ignored
 	// if return false, something went wrong
 	bool Pos2Axis(Axis &a_init, Pos &p, Axis &a);
 
+	// Conversion from a series of Pos to Axis, as Pos2Axis
+	// each result is the initial point of the next Pos
+	// output a is resized to the size of p
+	// returns number of Pos converted, Axis of unreachable Pos are Home value
+	int Pos2AxisBatch(Axis &a_init, std::vector<Pos> &p, std::vector<Axis> &a);
+
+	// True if Pos &p is reachable within limits with its Status and Turn
+	// exact with AnalyticIK, otherwise Pos2Axis succeeds within limits
+	bool isReachable(Pos &p);
+
 	// Calculate Turn from Axis &a, save to Pos &p
 	// Turn = bit0 + bit1 + bit2 + bit3 + bit4 + bit5;
 	// bit(X-1) is set true if A(X) is less than 0
@@ -265,28 +434,75 @@ public:
 	// More information see KUKA_KSS_8_2_SI.pdf, p284
 	int getStatus(Pos &p, Axis &a, double x, double y);
 
-private:
+	// Set method: backend for Frame2Axis and Pos2Axis
+	// if IK_ANALYTIC is requested but AnalyticIK is invalid, IK_LMA is kept
+	// if return false, backend is not changed
+	// ikCache_ is cleared, results of the previous backend are not served
+	bool setIKBackend(IKBackend backend);
+	// Get method: ikBackend_
+	IKBackend getIKBackend();
+
+	// Get method: ikCache_, for hit/miss counters and quantum
+	// Results are cached by Frame, Status and Turn of the solution, Frame2Axis
+	// looks up Status and Turn of the initial value
+	IKCache& getIKCache();
+
+	// Memory-map a precomputed ReachabilityMap of this URDF
+	// if return false, the map is missing or of another URDF, and
+	// getReachabilityMap has no information (nothing unreachable)
+	bool loadReachabilityMap(const std::string& fn);
+	// Get method: reachMap_, for O(1) reachability and dexterity of Frame
+	ReachabilityMap& getReachabilityMap();
+
+	// Get method: path and filename of URDF description
+	std::string getFilename();
+	// Get method: hash of URDF text, see hashURDF
+	uint64_t getURDFHash();
 
-	// True if KDL::Tree and KDL::Chain is successfully parsed
+private:
+	// Solvers of the calling thread, created on first use
+	SolverContext& solver();
+
+	// Frame2Axis with given backend
+	bool frame2Axis(Axis &a_init, Frame &f, Axis &a, IKBackend backend);
+	// Store solution a of Frame &f in ikCache_, keyed by its Status and
+	// Turn, only if they are those of p_init (Pos of the initial value)
+	void cacheSolution(Frame &f, Pos &p_init, Axis &a);
+
+	// Jacobian and tip frame (in m) at joint values q (in rad)
+	bool jacobian(const double q[6], Eigen::Matrix<double, 6, 6> &J,
+			Eigen::Affine3d &tip);
+
+	// Immutable description, copied from Model construction
+	boost::shared_ptr<const KinematicDescription> description_;
+	// Shortcuts of description_, never changed after construction
 	bool valid_;
+	bool fixedValid_;
+	bool analyticValid_;
 
-	// KDL::Tree from root to tip
-	KDL::Tree tree_;
+	// Solvers of each thread
+	QThreadStorage<SolverContext*> contexts_;
 
-	// KDL::Chain from root to tip
-	KDL::Chain chain_;
+	// Choose solution of Pos &p among sols, see Pos2Axis
+	// returns index in sols, -1 if none is within limits
+	// exact is set true if Status and Turn are matched
+	int selectSolution(std::vector<AxisSolution> &sols, Pos &p, Axis &a_init,
+			bool &exact);
 
-	// KDL::Chain from root to intersetion point of A4, A5 and A6
-	// for calculating Pos.S
-	KDL::Chain chain_flange_;
+	// Joint limits of differentialIK (in degrees)
+	//  - set from one thread before use, read only afterwards
+	double lower_[6];
+	double upper_[6];
 
-	// Path and filename for URDF description
-	std::string filename;
+	// Current backend of Frame2Axis and Pos2Axis, an IKBackend
+	//  - may be set by one thread while others convert
+	QAtomicInt ikBackend_;
 
-	// Solver pointers for conversion between Axis, Frame, Pos
-	KDL::ChainFkSolverPos_recursive* fkSolver_;
-	KDL::ChainFkSolverPos_recursive* fkSolver_flange_;
-	KDL::ChainIkSolverPos_LMA* ikSolver_;
+	// Cache of Frame2Axis and Pos2Axis results, shared by all threads
+	IKCache* ikCache_;
+
+	// Precomputed workspace, read only after loadReachabilityMap
+	ReachabilityMap* reachMap_;
 };
 
 #endif
@@ -0,0 +1,152 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ */
+
+#include "ikcache.h"
+
+#include <QMutexLocker>
+
+bool IKCache::Key::operator<(const Key& right) const {
+	for (int i = 0; i < 6; i++)
+		if (v[i] != right.v[i])
+			return v[i] < right.v[i];
+	if (s != right.s)
+		return s < right.s;
+	return t < right.t;
+}
+
+IKCache::IKCache(size_t capacity, double quantum_position,
+		double quantum_angle) :
+		capacity_(capacity), quantumPosition_(quantum_position), quantumAngle_(
+				quantum_angle), exactHits_(0), nearHits_(0), misses_(0) {
+}
+
+IKCache::Key IKCache::makeKey(Frame &f, int s, int t) {
+	Key key;
+	key.v[0] = (long) floor(f.X / quantumPosition_ + 0.5);
+	key.v[1] = (long) floor(f.Y / quantumPosition_ + 0.5);
+	key.v[2] = (long) floor(f.Z / quantumPosition_ + 0.5);
+	key.v[3] = (long) floor(f.A / quantumAngle_ + 0.5);
+	key.v[4] = (long) floor(f.B / quantumAngle_ + 0.5);
+	key.v[5] = (long) floor(f.C / quantumAngle_ + 0.5);
+	key.s = s;
+	key.t = t;
+	return key;
+}
+
+IKCache::Result IKCache::lookup(Frame &f, int s, int t, Axis &a) {
+	QMutexLocker locker(&mutex_);
+	std::map<Key, std::list<Entry>::iterator>::iterator it = index_.find(
+			makeKey(f, s, t));
+	if (it == index_.end()) {
+		misses_++;
+		return Miss;
+	}
+
+	// Move to front as most recently used, iterators stay valid
+	entries_.splice(entries_.begin(), entries_, it->second);
+	Entry& entry = entries_.front();
+	a.set(entry.axis);
+	if (entry.frame.X == f.X && entry.frame.Y == f.Y && entry.frame.Z == f.Z
+			&& entry.frame.A == f.A && entry.frame.B == f.B
+			&& entry.frame.C == f.C) {
+		exactHits_++;
+		return ExactHit;
+	}
+	nearHits_++;
+	return NearHit;
+}
+
+void IKCache::insert(Frame &f, int s, int t, Axis &a) {
+	QMutexLocker locker(&mutex_);
+	if (capacity_ == 0)
+		return;
+	Key key = makeKey(f, s, t);
+	std::map<Key, std::list<Entry>::iterator>::iterator it = index_.find(key);
+	if (it != index_.end()) {
+		// Replace the old solution of this key
+		it->second->frame.set(f);
+		it->second->axis.set(a);
+		entries_.splice(entries_.begin(), entries_, it->second);
+		return;
+	}
+
+	Entry entry;
+	entry.key = key;
+	entry.frame.set(f);
+	entry.axis.set(a);
+	entries_.push_front(entry);
+	index_[key] = entries_.begin();
+	trim();
+}
+
+void IKCache::trim() {
+	while (entries_.size() > capacity_) {
+		index_.erase(entries_.back().key);
+		entries_.pop_back();
+	}
+}
+
+void IKCache::clear() {
+	QMutexLocker locker(&mutex_);
+	entries_.clear();
+	index_.clear();
+}
+
+bool IKCache::setQuantum(double quantum_position, double quantum_angle) {
+	if (quantum_position <= 0.0 || quantum_angle <= 0.0) {
+		std::cout << "IKCache::setQuantum: Quantum should be positive"
+				<< std::endl;
+		return false;
+	}
+	QMutexLocker locker(&mutex_);
+	quantumPosition_ = quantum_position;
+	quantumAngle_ = quantum_angle;
+	entries_.clear();
+	index_.clear();
+	return true;
+}
+
+void IKCache::setCapacity(size_t capacity) {
+	QMutexLocker locker(&mutex_);
+	capacity_ = capacity;
+	trim();
+}
+
+size_t IKCache::getCapacity() {
+	QMutexLocker locker(&mutex_);
+	return capacity_;
+}
+
+unsigned long IKCache::getExactHits() {
+	QMutexLocker locker(&mutex_);
+	return exactHits_;
+}
+
+unsigned long IKCache::getNearHits() {
+	QMutexLocker locker(&mutex_);
+	return nearHits_;
+}
+
+unsigned long IKCache::getMisses() {
+	QMutexLocker locker(&mutex_);
+	return misses_;
+}
+
+size_t IKCache::getSize() {
+	QMutexLocker locker(&mutex_);
+	return entries_.size();
+}
+
+void IKCache::resetCounters() {
+	QMutexLocker locker(&mutex_);
+	exactHits_ = 0;
+	nearHits_ = 0;
+	misses_ = 0;
+}
@@ -0,0 +1,115 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Header file for IKCache, a bounded LRU cache of inverse kinematics
+ *   results used by Model. Calibration poses, NDI feedback moves and pose
+ *   targets from the GUI are solved again and again for the same frames.
+ *   Key of an entry is the target Frame quantized by a position quantum
+ *   (in mm) and an angle quantum (in degrees), plus Status and Turn of the
+ *   requested branch (-1 if not requested).
+ *       - exact hit : the stored Frame is the same, stored Axis is returned
+ *       - near hit  : only the quantized key is the same, stored Axis is a
+ *                     warm initial value for the iterative solver
+ *   All methods lock a QMutex, Model is used by GUI and Plannar threads.
+ *
+ */
+
+#ifndef MY_IKCACHE_H
+#define MY_IKCACHE_H
+
+#include <list>
+#include <map>
+#include <utility>
+#include <QMutex>
+
+#include "geometry.h"
+
+// Default number of entries and quanta
+#define IKCACHE_DEFAULT_CAPACITY 1024
+#define IKCACHE_DEFAULT_QUANTUM_POSITION 0.05
+#define IKCACHE_DEFAULT_QUANTUM_ANGLE 0.05
+
+// --------------------------------------------------------------------------
+// IKCache class
+// --------------------------------------------------------------------------
+class IKCache {
+public:
+	enum Result {
+		Miss, NearHit, ExactHit
+	};
+
+	// Constructor with capacity and quanta (in mm and degrees)
+	IKCache(size_t capacity = IKCACHE_DEFAULT_CAPACITY,
+			double quantum_position = IKCACHE_DEFAULT_QUANTUM_POSITION,
+			double quantum_angle = IKCACHE_DEFAULT_QUANTUM_ANGLE);
+
+	// Look up Frame &f with Status s and Turn t (-1 if any)
+	// on hit, the stored Axis is copied to a and the entry becomes the most
+	// recently used one
+	Result lookup(Frame &f, int s, int t, Axis &a);
+
+	// Store the solution a of Frame &f with Status s and Turn t
+	// the least recently used entry is dropped if the cache is full
+	void insert(Frame &f, int s, int t, Axis &a);
+
+	// Drop all entries, counters are kept
+	void clear();
+
+	// Set method: quanta, in mm and degrees, all entries are dropped
+	// if return false, quanta are not positive and nothing is changed
+	bool setQuantum(double quantum_position, double quantum_angle);
+
+	// Set method: capacity_, least recently used entries are dropped
+	void setCapacity(size_t capacity);
+	// Get method: capacity_
+	size_t getCapacity();
+
+	// Get methods: counters since construction or resetCounters
+	unsigned long getExactHits();
+	unsigned long getNearHits();
+	unsigned long getMisses();
+	// Number of entries
+	size_t getSize();
+
+	// Set all counters to zero
+	void resetCounters();
+
+private:
+	// Quantized Frame plus branch
+	struct Key {
+		long v[6];
+		int s;
+		int t;
+		bool operator<(const Key& right) const;
+	};
+	struct Entry {
+		Key key;
+		Frame frame;
+		Axis axis;
+	};
+
+	Key makeKey(Frame &f, int s, int t);
+
+	// Drop least recently used entries until size is within capacity
+	void trim();
+
+	QMutex mutex_;
+	size_t capacity_;
+	double quantumPosition_;
+	double quantumAngle_;
+	// most recently used at the front
+	std::list<Entry> entries_;
+	std::map<Key, std::list<Entry>::iterator> index_;
+
+	unsigned long exactHits_;
+	unsigned long nearHits_;
+	unsigned long misses_;
+};
+
+#endif
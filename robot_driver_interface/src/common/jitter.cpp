@@ -0,0 +1,230 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ */
+
+#include "jitter.h"
+
+#include <algorithm>
+#include <vector>
+#include <cmath>
+#include <sstream>
+
+// KRC period longer than this is taken as a reset of the KRC timer, in ms
+#define JITTER_KRC_DISCONTINUITY 10000
+
+JitterMonitor::JitterMonitor() :
+		nh_("~"), mutex_(QMutex::Recursive) {
+	ros::param::param<int>("~jitter_window", windowSize_, 1000);
+	ros::param::param<double>("~jitter_period_p99_ms", thresholdP99_, 20.0);
+	ros::param::param<double>("~jitter_period_max_ms", thresholdMax_, 50.0);
+	ros::param::param<int>("~jitter_missed_ticks", thresholdMissed_, 0);
+	ros::param::param<double>("~jitter_drift_ms", thresholdDrift_, 100.0);
+	ros::param::param<double>("~jitter_silence_ms", thresholdSilence_, 100.0);
+	if (windowSize_ < 2)
+		windowSize_ = 2;
+
+	publisher_ = nh_.advertise<diagnostic_msgs::DiagnosticArray>(
+			"/diagnostics", 1);
+	reset();
+	timer_ = nh_.createWallTimer(ros::WallDuration(JITTER_PUBLISH_INTERVAL),
+			&JitterMonitor::timerCallback, this);
+}
+
+void JitterMonitor::reset() {
+	QMutexLocker locker(&mutex_);
+	krcPeriods_.clear();
+	hostPeriods_.clear();
+	started_ = false;
+	lastSeq_ = 0;
+	lastKRCTime_ = 0;
+	lastHostTime_ = 0.0;
+	firstHostTime_ = 0.0;
+	krcElapsed_ = 0.0;
+	feedbackCount_ = 0;
+	missedTicks_ = 0;
+	missedTicksPublished_ = 0;
+}
+
+void JitterMonitor::update(Feedback* fb) {
+	double now = fb->getRecvTime();
+	if (now <= 0.0)
+		now = hostTime();
+
+	QMutexLocker locker(&mutex_);
+	if (!started_) {
+		started_ = true;
+		lastSeq_ = fb->getSeq();
+		lastKRCTime_ = fb->getTime();
+		lastHostTime_ = now;
+		firstHostTime_ = now;
+		feedbackCount_ = 1;
+		return;
+	}
+	feedbackCount_++;
+
+	// Seq increases by one per feedback, a gap means ticks were lost
+	int gap = fb->getSeq() - lastSeq_;
+	if (gap > 1)
+		missedTicks_ += gap - 1;
+	else if (gap < 0) {
+		// KRC restarted its counter, start over
+		ROS_WARN("JitterMonitor: Seq restarted from %d to %d", lastSeq_,
+				fb->getSeq());
+		reset();
+		update(fb);
+		return;
+	}
+
+	double krcPeriod = std::fabs((double) (fb->getTime() - lastKRCTime_));
+	double hostPeriod = (now - lastHostTime_) * 1000.0;
+	if (krcPeriod < JITTER_KRC_DISCONTINUITY) {
+		push(krcPeriods_, krcPeriod);
+		krcElapsed_ += krcPeriod;
+	} else
+		// no way to tell the elapsed KRC time, keep drift consistent
+		krcElapsed_ += hostPeriod;
+	push(hostPeriods_, hostPeriod);
+
+	lastSeq_ = fb->getSeq();
+	lastKRCTime_ = fb->getTime();
+	lastHostTime_ = now;
+}
+
+void JitterMonitor::timerCallback(const ros::WallTimerEvent& event) {
+	QMutexLocker locker(&mutex_);
+	if (started_)
+		publish(hostTime());
+}
+
+void JitterMonitor::push(std::deque<double>& window, double period) {
+	window.push_back(period);
+	while ((int) window.size() > windowSize_)
+		window.pop_front();
+}
+
+JitterStats JitterMonitor::computeStats(const std::deque<double>& window) {
+	JitterStats stats;
+	stats.count_ = window.size();
+	if (window.empty()) {
+		stats.min_ = stats.p50_ = stats.p99_ = stats.max_ = stats.mean_ = 0.0;
+		return stats;
+	}
+
+	std::vector<double> sorted(window.begin(), window.end());
+	std::sort(sorted.begin(), sorted.end());
+	int n = sorted.size();
+	double sum = 0.0;
+	for (int i = 0; i < n; i++)
+		sum += sorted[i];
+
+	// nearest-rank percentiles
+	stats.min_ = sorted[0];
+	stats.p50_ = sorted[(int) std::ceil(0.50 * n) - 1];
+	stats.p99_ = sorted[(int) std::ceil(0.99 * n) - 1];
+	stats.max_ = sorted[n - 1];
+	stats.mean_ = sum / n;
+	return stats;
+}
+
+JitterStats JitterMonitor::getKRCStats() {
+	QMutexLocker locker(&mutex_);
+	return computeStats(krcPeriods_);
+}
+
+JitterStats JitterMonitor::getHostStats() {
+	QMutexLocker locker(&mutex_);
+	return computeStats(hostPeriods_);
+}
+
+int JitterMonitor::getMissedTicks() {
+	QMutexLocker locker(&mutex_);
+	return missedTicks_;
+}
+
+double JitterMonitor::getDrift() {
+	QMutexLocker locker(&mutex_);
+	if (!started_)
+		return 0.0;
+	return (lastHostTime_ - firstHostTime_) * 1000.0 - krcElapsed_;
+}
+
+// Append a key-value pair to a DiagnosticStatus
+static void addValue(diagnostic_msgs::DiagnosticStatus& status,
+		const std::string& key, double value) {
+	std::ostringstream ss;
+	ss << value;
+	diagnostic_msgs::KeyValue kv;
+	kv.key = key;
+	kv.value = ss.str();
+	status.values.push_back(kv);
+}
+
+void JitterMonitor::publish(double now) {
+	JitterStats krc = getKRCStats();
+	JitterStats host = getHostStats();
+	double drift = getDrift();
+	int missed = missedTicks_ - missedTicksPublished_;
+	double silence = (now - lastHostTime_) * 1000.0;
+
+	diagnostic_msgs::DiagnosticStatus status;
+	status.name = "robot_driver_interface: KRC control loop";
+	status.hardware_id = "KRC4";
+	status.level = diagnostic_msgs::DiagnosticStatus::OK;
+
+	std::string warning;
+	if (host.p99_ > thresholdP99_)
+		warning += "period p99 too long; ";
+	if (host.max_ > thresholdMax_)
+		warning += "period max too long; ";
+	if (missed > thresholdMissed_)
+		warning += "ticks missed; ";
+	if (std::fabs(drift) > thresholdDrift_)
+		warning += "clock drift; ";
+	if (silence > thresholdSilence_) {
+		// The failure the statistics cannot show, nothing to measure
+		status.level = diagnostic_msgs::DiagnosticStatus::ERROR;
+		std::ostringstream ss;
+		ss << "no feedback for " << (int) silence << " ms";
+		status.message = ss.str();
+		ROS_ERROR("JitterMonitor: %s", status.message.c_str());
+	} else if (warning.empty())
+		status.message = "OK";
+	else {
+		status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+		status.message = warning.substr(0, warning.size() - 2);
+		ROS_WARN(
+				"JitterMonitor: %s (p99 %.2f ms, max %.2f ms, missed %d, drift %.2f ms)",
+				status.message.c_str(), host.p99_, host.max_, missed, drift);
+	}
+
+	addValue(status, "Window", host.count_);
+	addValue(status, "KRC period min (ms)", krc.min_);
+	addValue(status, "KRC period p50 (ms)", krc.p50_);
+	addValue(status, "KRC period p99 (ms)", krc.p99_);
+	addValue(status, "KRC period max (ms)", krc.max_);
+	addValue(status, "Host period min (ms)", host.min_);
+	addValue(status, "Host period p50 (ms)", host.p50_);
+	addValue(status, "Host period p99 (ms)", host.p99_);
+	addValue(status, "Host period max (ms)", host.max_);
+	addValue(status, "Missed ticks (last interval)", missed);
+	addValue(status, "Missed ticks (total)", missedTicks_);
+	addValue(status, "Feedback count", feedbackCount_);
+	addValue(status, "Time since last feedback (ms)", silence);
+	addValue(status, "Clock drift (ms)", drift);
+	double elapsed = (now - firstHostTime_) * 1000.0;
+	addValue(status, "Clock drift rate (ppm)",
+			elapsed > 0.0 ? drift / elapsed * 1.0e6 : 0.0);
+
+	diagnostic_msgs::DiagnosticArray array;
+	array.header.stamp = ros::Time::now();
+	array.status.push_back(status);
+	publisher_.publish(array);
+
+	missedTicksPublished_ = missedTicks_;
+}
@@ -0,0 +1,134 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Header file for JitterMonitor, timing statistics of the control loop.
+ *   Every Feedback received by Plannar is passed to JitterMonitor, the period
+ *   between two feedbacks is measured on two clocks:
+ *       - KRC clock : Time field of Feedback, in ms
+ *       - host clock: hostTime() when the Feedback is received, in ms
+ *   Over a rolling window of the latest feedbacks, min/p50/p99/max of both
+ *   periods are computed. Gaps in the Seq field are counted as missed ticks,
+ *   and the host clock is compared with the KRC clock to estimate drift.
+ *   Statistics are published as diagnostic_msgs/DiagnosticArray on
+ *   /diagnostics once a second, with level WARN if a threshold is crossed.
+ *   Publishing is driven by a timer of the ROS spinner thread, not by the
+ *   feedbacks, so feedbacks that stop arriving are reported as well (level
+ *   ERROR). update() and the timer share the statistics under mutex_.
+ *
+ *   Thresholds are read from ROS parameters (private namespace):
+ *       - ~jitter_window        : number of periods in the window, 1000
+ *       - ~jitter_period_p99_ms : p99 of host period, 20.0
+ *       - ~jitter_period_max_ms : max of host period, 50.0
+ *       - ~jitter_missed_ticks  : missed ticks in the last second, 0
+ *       - ~jitter_drift_ms      : host vs KRC clock drift, 100.0
+ *       - ~jitter_silence_ms    : time since the last feedback, 100.0
+ *
+ */
+
+#ifndef MY_JITTER_H
+#define MY_JITTER_H
+
+#include <deque>
+#include <string>
+
+#include <QMutex>
+
+#include <ros/ros.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+
+#include "message.h"
+
+// Interval between two diagnostics messages, in second
+#define JITTER_PUBLISH_INTERVAL 1.0
+
+// --------------------------------------------------------------------------
+// Data structure: JitterStats
+//  - statistics of one window of periods, in ms
+// --------------------------------------------------------------------------
+struct JitterStats {
+	double min_;
+	double p50_;
+	double p99_;
+	double max_;
+	double mean_;
+	int count_;
+};
+
+// --------------------------------------------------------------------------
+// JitterMonitor class
+// --------------------------------------------------------------------------
+class JitterMonitor {
+public:
+	// Read thresholds from ROS parameters, advertise /diagnostics and start
+	// the timer publishing every JITTER_PUBLISH_INTERVAL
+	JitterMonitor();
+
+	// Add one feedback to the statistics
+	void update(Feedback* fb);
+
+	// Clear all statistics, e.g. when the connection to KRC is rebuilt
+	void reset();
+
+	// Get method: statistics of KRC period over current window
+	JitterStats getKRCStats();
+	// Get method: statistics of host period over current window
+	JitterStats getHostStats();
+	// Get method: total number of missed ticks since reset
+	int getMissedTicks();
+	// Get method: host clock minus KRC clock since the first feedback, in ms
+	double getDrift();
+
+private:
+	// Compute statistics of a window of periods
+	static JitterStats computeStats(const std::deque<double>& window);
+
+	// Push a period into a window, drop the oldest one if window is full
+	void push(std::deque<double>& window, double period);
+
+	// Called by timer_, publish unless no feedback was ever received
+	void timerCallback(const ros::WallTimerEvent& event);
+
+	// Compose and publish a DiagnosticArray
+	void publish(double now);
+
+	ros::NodeHandle nh_;
+	ros::Publisher publisher_;
+	ros::WallTimer timer_;
+	// Recursive, update() resets and restarts itself if Seq restarts
+	QMutex mutex_;
+
+	// parameters
+	int windowSize_;
+	double thresholdP99_;
+	double thresholdMax_;
+	int thresholdMissed_;
+	double thresholdDrift_;
+	double thresholdSilence_;
+
+	// periods in ms, newest at the back
+	std::deque<double> krcPeriods_;
+	std::deque<double> hostPeriods_;
+
+	// state of the previous feedback
+	bool started_;
+	int lastSeq_;
+	int lastKRCTime_;
+	double lastHostTime_;
+	// reference for drift, taken at the first feedback
+	double firstHostTime_;
+	// KRC time accumulated since the first feedback, in ms
+	double krcElapsed_;
+
+	int feedbackCount_;
+	int missedTicks_;
+	// missedTicks_ when last diagnostics published
+	int missedTicksPublished_;
+};
+
+#endif
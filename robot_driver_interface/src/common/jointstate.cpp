@@ -0,0 +1,162 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ */
+
+#include "jointstate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+// Change of the KRC Time field taken as a restart of the KRC clock, in ms
+#define JOINT_STATE_KRC_DISCONTINUITY 10000
+
+JointStatePublisher::JointStatePublisher() :
+		stop_(false), sequence_(0), started_(false), lastKRCTime_(0), lastHostTime_(
+				0.0), krcClock_(0.0), offset_(0.0) {
+	double rate;
+	ros::param::param<double>("~joint_state_rate", rate,
+			JOINT_STATE_DEFAULT_RATE);
+	rate_ = JOINT_STATE_DEFAULT_RATE;
+	setRate(rate);
+	ros::param::param<bool>("~joint_state_velocity", velocity_, false);
+
+	for (int i = 0; i < JOINT_STATE_JOINTS; i++) {
+		std::ostringstream name;
+		name << "joint" << i + 1;
+		names_.push_back(name.str());
+		lastPosition_[i] = 0.0;
+	}
+	publisher_ = nh_.advertise<sensor_msgs::JointState>("/joint_states", 10,
+			true);
+}
+
+JointStatePublisher::~JointStatePublisher() {
+	stop();
+}
+
+void JointStatePublisher::update(Feedback* fb) {
+	double now = fb->getRecvTime();
+	if (now <= 0.0)
+		now = hostTime();
+	// ROS time the feedback was received
+	double received = ros::Time::now().toSec() - (hostTime() - now);
+	Axis axis = fb->getAxis();
+	double position[JOINT_STATE_JOINTS] = { axis.A1, axis.A2, axis.A3, axis.A4,
+			axis.A5, axis.A6 };
+	for (int i = 0; i < JOINT_STATE_JOINTS; i++)
+		position[i] = position[i] / 180.0 * M_PI;
+
+	double period = 0.0;
+	int krc_period = abs(fb->getTime() - lastKRCTime_);
+	if (!started_) {
+		started_ = true;
+		krcClock_ = 0.0;
+		offset_ = received;
+	} else {
+		// KRC clock restarted, keep the stamps continuous on the host clock
+		period = krc_period < JOINT_STATE_KRC_DISCONTINUITY ?
+				krc_period / 1000.0 : now - lastHostTime_;
+		krcClock_ += period;
+		// Latency only adds to received, the smallest offset is the best
+		offset_ = std::min(offset_ + JOINT_STATE_DRIFT * period,
+				received - krcClock_);
+	}
+	lastKRCTime_ = fb->getTime();
+	lastHostTime_ = now;
+
+	sequence_.fetchAndAddOrdered(1);
+	for (int i = 0; i < JOINT_STATE_JOINTS; i++) {
+		snapshot_.position[i] = position[i];
+		snapshot_.velocity[i] =
+				period > 0.0 ? (position[i] - lastPosition_[i]) / period : 0.0;
+		lastPosition_[i] = position[i];
+	}
+	snapshot_.stamp = krcClock_ + offset_;
+	snapshot_.seq = fb->getSeq();
+	sequence_.fetchAndAddOrdered(1);
+}
+
+bool JointStatePublisher::read(JointStateSample& sample) {
+	int sequence;
+	return read(sample, sequence);
+}
+
+bool JointStatePublisher::read(JointStateSample& sample, int& sequence) {
+	for (;;) {
+		int before = sequence_.fetchAndAddOrdered(0);
+		if (before == 0)
+			return false;
+		if (before & 1) {
+			// The writer is in the middle of update
+			QThread::yieldCurrentThread();
+			continue;
+		}
+		sample = snapshot_;
+		if (sequence_.fetchAndAddOrdered(0) == before) {
+			sequence = before;
+			return true;
+		}
+	}
+}
+
+void JointStatePublisher::run() {
+	sensor_msgs::JointState joint_state;
+	joint_state.name = names_;
+	joint_state.position.resize(JOINT_STATE_JOINTS);
+	if (velocity_)
+		joint_state.velocity.resize(JOINT_STATE_JOINTS);
+
+	double rate = rate_;
+	ros::WallRate loop(rate);
+	ROS_INFO("JointStatePublisher: Publishing at %.1f Hz", rate);
+	// Sequence of the snapshot published last, 0 before the first feedback
+	int published = 0;
+	while (!stop_ && ros::ok()) {
+		JointStateSample sample;
+		int sequence;
+		// Without a new feedback, e.g. the KRC stopped sending, the old state
+		// is not published again with its old stamp
+		if (read(sample, sequence) && sequence != published) {
+			published = sequence;
+			for (int i = 0; i < JOINT_STATE_JOINTS; i++) {
+				joint_state.position[i] = sample.position[i];
+				if (velocity_)
+					joint_state.velocity[i] = sample.velocity[i];
+			}
+			joint_state.header.stamp = ros::Time(sample.stamp);
+			publisher_.publish(joint_state);
+		}
+		if (rate != rate_) {
+			rate = rate_;
+			loop = ros::WallRate(rate);
+		}
+		loop.sleep();
+	}
+}
+
+void JointStatePublisher::stop() {
+	stop_ = true;
+	wait();
+}
+
+bool JointStatePublisher::setRate(double rate) {
+	if (rate <= 0.0) {
+		std::cout << "JointStatePublisher::setRate: Rate should be positive"
+				<< std::endl;
+		return false;
+	}
+	rate_ = rate;
+	return true;
+}
+
+double JointStatePublisher::getRate() {
+	return rate_;
+}
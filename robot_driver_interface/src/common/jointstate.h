@@ -0,0 +1,121 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Header file for JointStatePublisher, the thread publishing the joint
+ *   states of KRC4 on /joint_states for robot_state_publisher and MoveIt.
+ *   Every Feedback processed by Plannar is written to a snapshot guarded by
+ *   a sequence counter (seqlock): the writer makes the counter odd while it
+ *   writes, the publisher thread copies the snapshot and retries if the
+ *   counter was odd or changed. Neither side ever blocks, so the publishing
+ *   rate does not depend on the load of the Plannar or GUI event loops.
+ *   Time stamps come from the KRC clock (Time field of Feedback): the KRC
+ *   time is mapped to ROS time by the smallest offset seen between receipt
+ *   and KRC time, i.e. the feedback of least latency, relaxed slowly so the
+ *   offset follows clock drift.
+ *
+ *   Parameters (private namespace):
+ *       - ~joint_state_rate     : publishing rate in Hz, 100.0, each
+ *                                 feedback is published once at most
+ *       - ~joint_state_velocity : publish velocities estimated from two
+ *                                 consecutive feedbacks, false
+ *
+ */
+
+#ifndef MY_JOINTSTATE_H
+#define MY_JOINTSTATE_H
+
+#include <string>
+#include <vector>
+#include <QAtomicInt>
+#include <QThread>
+
+#include <ros/ros.h>
+#include <sensor_msgs/JointState.h>
+
+#include "message.h"
+
+// Publishing rate of joint states, in Hz
+#define JOINT_STATE_DEFAULT_RATE 100.0
+// Joints of KRC4, A1 to A6
+#define JOINT_STATE_JOINTS 6
+// Largest drift of the KRC clock from the host clock, in s per s
+#define JOINT_STATE_DRIFT 1e-3
+
+// --------------------------------------------------------------------------
+// Data structure: JointStateSample
+//  - joint state of one Feedback, in rad, rad/s and s
+// --------------------------------------------------------------------------
+struct JointStateSample {
+	double position[JOINT_STATE_JOINTS];
+	double velocity[JOINT_STATE_JOINTS];
+	// KRC time mapped to ROS time
+	double stamp;
+	// Seq field of the Feedback
+	int seq;
+};
+
+// --------------------------------------------------------------------------
+// JointStatePublisher class
+// --------------------------------------------------------------------------
+class JointStatePublisher: public QThread {
+public:
+	// Read parameters and advertise /joint_states, the thread is started
+	// by start
+	JointStatePublisher();
+	~JointStatePublisher();
+
+	// Write the joint state of fb to the snapshot, only called by one
+	// thread, the thread of Plannar
+	void update(Feedback* fb);
+
+	// Copy the latest snapshot to sample
+	// if return false, no feedback has been received yet
+	bool read(JointStateSample& sample);
+	// Same, sequence is the counter of the copied snapshot, it changes with
+	// every feedback
+	bool read(JointStateSample& sample, int& sequence);
+
+	// Stop the thread and wait for it
+	void stop();
+
+	// Set method: rate_, in Hz
+	// if return false, rate is not positive and nothing is changed
+	bool setRate(double rate);
+	// Get method: rate_
+	double getRate();
+
+protected:
+	// Publish the latest snapshot at rate_ until stop, unless it was
+	// published already
+	void run();
+
+private:
+	ros::NodeHandle nh_;
+	ros::Publisher publisher_;
+	std::vector<std::string> names_;
+	volatile double rate_;
+	bool velocity_;
+	volatile bool stop_;
+
+	// Seqlock: odd while the snapshot is written, number of writes * 2
+	QAtomicInt sequence_;
+	JointStateSample snapshot_;
+
+	// State of the writer
+	bool started_;
+	int lastKRCTime_;
+	double lastHostTime_;
+	// KRC time accumulated since the first feedback, in s
+	double krcClock_;
+	// ROS time minus krcClock_, in s
+	double offset_;
+	double lastPosition_[JOINT_STATE_JOINTS];
+};
+
+#endif
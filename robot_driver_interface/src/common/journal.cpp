@@ -0,0 +1,247 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ */
+
+#include "journal.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <cstddef>
+
+CommandJournal::CommandJournal(const std::string& filename) :
+		filename_(filename), fd_(-1), valid_(false), header_(NULL), records_(
+				NULL), next_(1), dirtyFirst_(0), pageSize_(
+				sysconf(_SC_PAGESIZE)), lastStamp_(0) {
+	ROS_INFO("CommandJournal Constructing...");
+
+	recovery_.clean_ = true;
+	recovery_.lastStamp_ = 0;
+
+	size_t length = sizeof(JournalRecord) * JOURNAL_CAPACITY;
+	fd_ = open(filename_.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd_ < 0) {
+		ROS_ERROR("CommandJournal: Cannot open %s, journal disabled",
+				filename_.c_str());
+		return;
+	}
+	struct stat st;
+	bool created = (fstat(fd_, &st) == 0 && st.st_size == 0);
+	if (ftruncate(fd_, length) != 0) {
+		ROS_ERROR("CommandJournal: Cannot resize %s, journal disabled",
+				filename_.c_str());
+		close(fd_);
+		fd_ = -1;
+		return;
+	}
+	void* addr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd_,
+			0);
+	if (addr == MAP_FAILED) {
+		ROS_ERROR("CommandJournal: Cannot map %s, journal disabled",
+				filename_.c_str());
+		close(fd_);
+		fd_ = -1;
+		return;
+	}
+	header_ = (Header*) addr;
+	records_ = (JournalRecord*) addr;
+	valid_ = true;
+
+	if (created || header_->magic_ != JOURNAL_MAGIC
+			|| header_->version_ != JOURNAL_VERSION
+			|| header_->capacity_ != JOURNAL_CAPACITY) {
+		ROS_INFO("CommandJournal: New journal %s", filename_.c_str());
+		header_->magic_ = JOURNAL_MAGIC;
+		header_->version_ = JOURNAL_VERSION;
+		header_->capacity_ = JOURNAL_CAPACITY;
+		header_->epoch_ = 0;
+		wrap();
+	} else {
+		recover();
+		ROS_INFO(
+				"CommandJournal: Recovered %s, last stamp %d, %d command(s) pending, %s shutdown",
+				filename_.c_str(), recovery_.lastStamp_,
+				(int) recovery_.pending_.size(),
+				recovery_.clean_ ? "clean" : "unclean");
+		// The previous run is consumed, continue in a new epoch
+		lastStamp_ = recovery_.lastStamp_;
+		wrap();
+	}
+	commit();
+}
+
+CommandJournal::~CommandJournal() {
+	std::cout << "CommandJournal Deconstructing..." << std::endl;
+	if (!valid_)
+		return;
+	record(JournalRecord::Closed, NULL);
+	commit();
+	munmap(records_, sizeof(JournalRecord) * JOURNAL_CAPACITY);
+	close(fd_);
+}
+
+void CommandJournal::record(JournalRecord::Event event, Command* cmd, int seq,
+		int front, int last) {
+	if (!valid_)
+		return;
+
+	JournalRecord rec;
+	memset(&rec, 0, sizeof(rec));
+	rec.event_ = event;
+	rec.seq_ = seq;
+	rec.buffer_front_ = front;
+	rec.buffer_last_ = last;
+	rec.time_ = ros::WallTime::now().toSec();
+	if (cmd != NULL) {
+		rec.stamp_ = cmd->getStamp();
+		rec.type_ = cmd->getType();
+		rec.style_ = cmd->getStyle();
+		rec.other_type_ = cmd->getOtherType();
+		rec.end_ = cmd->getEnd();
+		rec.approx_ = cmd->getApprox();
+		rec.pos_s_ = cmd->getPosS();
+		rec.pos_t_ = cmd->getPosT();
+		if (rec.end_ == COMMAND_END_AXIS) {
+			Axis& a = cmd->getAxis();
+			rec.target_[0] = a.A1;
+			rec.target_[1] = a.A2;
+			rec.target_[2] = a.A3;
+			rec.target_[3] = a.A4;
+			rec.target_[4] = a.A5;
+			rec.target_[5] = a.A6;
+		} else {
+			Frame& f = cmd->getFrame();
+			rec.target_[0] = f.X;
+			rec.target_[1] = f.Y;
+			rec.target_[2] = f.Z;
+			rec.target_[3] = f.A;
+			rec.target_[4] = f.B;
+			rec.target_[5] = f.C;
+		}
+		if (rec.stamp_ > lastStamp_)
+			lastStamp_ = rec.stamp_;
+	} else
+		rec.stamp_ = lastStamp_;
+
+	append(rec);
+
+	// Keep track of the commands that KRL may hold, copied to a new epoch
+	if (cmd != NULL) {
+		if (event == JournalRecord::Sent || event == JournalRecord::Acked
+				|| event == JournalRecord::Buffered)
+			inflight_[rec.stamp_] = rec;
+		else if (event == JournalRecord::Executed
+				|| event == JournalRecord::Error)
+			inflight_.erase(rec.stamp_);
+	}
+}
+
+void CommandJournal::append(JournalRecord& rec) {
+	if (next_ >= JOURNAL_CAPACITY)
+		wrap();
+	rec.epoch_ = header_->epoch_;
+	rec.checksum_ = checksum(rec);
+	records_[next_] = rec;
+	if (dirtyFirst_ == 0)
+		dirtyFirst_ = next_;
+	next_++;
+}
+
+void CommandJournal::commit() {
+	if (!valid_ || dirtyFirst_ == 0)
+		return;
+	flush(dirtyFirst_, next_ - 1);
+	dirtyFirst_ = 0;
+}
+
+void CommandJournal::flush(uint32_t first, uint32_t last) {
+	// msync needs an address aligned to a page
+	size_t begin = sizeof(JournalRecord) * first;
+	size_t end = sizeof(JournalRecord) * (last + 1);
+	begin -= begin % pageSize_;
+	if (msync((char*) records_ + begin, end - begin, MS_SYNC) != 0)
+		ROS_WARN("CommandJournal: Flushing %s failed", filename_.c_str());
+}
+
+void CommandJournal::wrap() {
+	// The end of the old epoch is committed before the new one starts
+	commit();
+	header_->epoch_++;
+	next_ = 1;
+	flush(0, 0);
+
+	JournalRecord rec;
+	memset(&rec, 0, sizeof(rec));
+	rec.event_ = JournalRecord::Checkpoint;
+	rec.stamp_ = lastStamp_;
+	rec.seq_ = -1;
+	rec.buffer_front_ = -1;
+	rec.buffer_last_ = -1;
+	rec.time_ = ros::WallTime::now().toSec();
+	append(rec);
+
+	// Commands still in flight are carried over to the new epoch
+	std::map<int, JournalRecord>::iterator it;
+	for (it = inflight_.begin(); it != inflight_.end(); it++)
+		append(it->second);
+}
+
+void CommandJournal::recover() {
+	inflight_.clear();
+	recovery_.clean_ = false;
+	recovery_.lastStamp_ = 0;
+	recovery_.pending_.clear();
+
+	for (next_ = 1; next_ < JOURNAL_CAPACITY; next_++) {
+		JournalRecord& rec = records_[next_];
+		if (rec.epoch_ != header_->epoch_ || rec.checksum_ != checksum(rec))
+			break;
+		if (rec.stamp_ > recovery_.lastStamp_)
+			recovery_.lastStamp_ = rec.stamp_;
+		switch (rec.event_) {
+		case JournalRecord::Sent:
+		case JournalRecord::Acked:
+		case JournalRecord::Buffered:
+			inflight_[rec.stamp_] = rec;
+			break;
+		case JournalRecord::Executed:
+		case JournalRecord::Error:
+			inflight_.erase(rec.stamp_);
+			break;
+		default:
+			break;
+		}
+		recovery_.clean_ = (rec.event_ == JournalRecord::Closed);
+	}
+
+	std::map<int, JournalRecord>::iterator it;
+	for (it = inflight_.begin(); it != inflight_.end(); it++)
+		recovery_.pending_.push_back(it->second);
+}
+
+uint32_t CommandJournal::checksum(const JournalRecord& rec) {
+	// FNV-1a over every byte in front of checksum_
+	const unsigned char* p = (const unsigned char*) &rec;
+	uint32_t h = 2166136261u;
+	for (size_t i = 0; i < offsetof(JournalRecord, checksum_); i++) {
+		h ^= p[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+JournalRecovery& CommandJournal::getRecovery() {
+	return recovery_;
+}
+
+bool CommandJournal::isValid() {
+	return valid_;
+}
@@ -0,0 +1,168 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Header file for CommandJournal, a crash-safe record of the CommandList.
+ *   Every Command appended by Plannar and every state transition of it
+ *   (sent, acknowledged, buffered in KRL, executed, error) is appended to
+ *   a memory-mapped file as a fixed-size record.
+ *   Records are written straight into the mapping, so they survive a crash
+ *   of the process without any system call on the hot path. The records
+ *   written since the last commit() are flushed together (group commit)
+ *   with one synchronous msync, which also covers a crash of the operating
+ *   system. Plannar commits once per feedback, after the feedback and the
+ *   commands it released are recorded, so at most one feedback period of
+ *   transitions is lost.
+ *   When Plannar restarts, the journal is scanned to recover the last stamp
+ *   and the commands still held in the KRL buffer, so stamping resumes and
+ *   the CommandList iterators are resynchronized with the first feedback.
+ *
+ */
+
+#ifndef MY_JOURNAL_H
+#define MY_JOURNAL_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <stdint.h>
+
+#include "message.h"
+
+// Number of records the journal file holds before wrapping around
+#define JOURNAL_CAPACITY 65536
+// Identifier of a journal file, "KJNL"
+#define JOURNAL_MAGIC 0x4b4a4e4c
+#define JOURNAL_VERSION 2
+
+// --------------------------------------------------------------------------
+// Data structure: JournalRecord
+//  - one state transition of one Command, fixed size
+//  - epoch_ equals the epoch of the file header for records of the current
+//      generation, older records left behind a wrap-around are ignored
+//  - checksum_ covers all other fields, a torn record is detected by it
+// --------------------------------------------------------------------------
+struct JournalRecord {
+	enum Event {
+		Created = 0,  // appended to CommandList
+		Sent = 1,     // handed to TCPThread
+		Acked = 2,    // Result/Stamp received with Success="1"
+		Buffered = 3, // passed by BufLast, stored in KRL buffer
+		Executed = 4, // passed by BufFront, left KRL buffer
+		Error = 5,    // marked as ERROR by KRL or by queue management
+		Checkpoint = 6, // written at the beginning of every epoch
+		Closed = 7    // written when Plannar shuts down properly
+	};
+
+	uint32_t epoch_;
+	int32_t stamp_;
+	int16_t event_;
+	int16_t type_;
+	int16_t style_;
+	int16_t other_type_;
+	// COMMAND_END_FRAME, COMMAND_END_POS or COMMAND_END_AXIS
+	int16_t end_;
+	int16_t approx_;
+	// Status and Turn of a Pos end point
+	int16_t pos_s_;
+	int16_t pos_t_;
+	int32_t seq_;
+	// End point: A1-A6 for Axis, X, Y, Z, A, B, C for Frame and Pos
+	float target_[6];
+	double time_;
+	int32_t buffer_front_;
+	int32_t buffer_last_;
+	uint32_t checksum_;
+};
+
+// --------------------------------------------------------------------------
+// Data structure: JournalRecovery
+//  - information recovered from the journal of a previous run
+// --------------------------------------------------------------------------
+struct JournalRecovery {
+	// true if the previous run wrote a Closed record
+	bool clean_;
+	// greatest stamp found in the journal, 0 if nothing recorded
+	int lastStamp_;
+	// Commands buffered in KRL but not yet executed, in stamp order
+	//  - also after a clean shutdown, KRL keeps executing its buffer
+	std::vector<JournalRecord> pending_;
+};
+
+// --------------------------------------------------------------------------
+// CommandJournal class
+// --------------------------------------------------------------------------
+class CommandJournal {
+public:
+	// Open (or create) the journal file and recover the previous run
+	// If the file cannot be mapped, the journal is disabled and all
+	// record() calls are ignored
+	CommandJournal(const std::string& filename);
+
+	// Write a Closed record and unmap the file
+	~CommandJournal();
+
+	// Append one transition of Command *cmd
+	//  - seq, front and last are taken from the feedback that caused it,
+	//      -1 if not caused by a feedback
+	void record(JournalRecord::Event event, Command* cmd, int seq = -1,
+			int front = -1, int last = -1);
+
+	// Flush the records written since the last commit synchronously
+	void commit();
+
+	// Get method: recovery_
+	JournalRecovery& getRecovery();
+
+	// If the journal file is successfully mapped
+	bool isValid();
+
+private:
+	// File header, occupies the first record slot of the file
+	struct Header {
+		uint32_t magic_;
+		uint32_t version_;
+		uint32_t capacity_;
+		uint32_t epoch_;
+	};
+
+	// Scan the current epoch of the file, fill recovery_ and find the next
+	// writing position
+	void recover();
+
+	// Append a record to the mapping, wrap around when capacity is reached
+	// and add it to the records to commit
+	void append(JournalRecord& rec);
+	// Flush the pages of records [first, last] synchronously
+	void flush(uint32_t first, uint32_t last);
+
+	// Start a new epoch from the beginning of the file
+	void wrap();
+
+	static uint32_t checksum(const JournalRecord& rec);
+
+	std::string filename_;
+	int fd_;
+	bool valid_;
+	Header* header_;
+	JournalRecord* records_;
+	// index of the next record to be written
+	uint32_t next_;
+	// records written and not committed yet, [dirtyFirst_, next_), none if
+	// dirtyFirst_ is 0
+	uint32_t dirtyFirst_;
+	// size of a page of memory, msync works on whole pages
+	long pageSize_;
+	// last stamp written to the journal, copied to every Checkpoint
+	int lastStamp_;
+	// Commands sent to KRL and neither executed nor rejected yet, by stamp
+	std::map<int, JournalRecord> inflight_;
+	JournalRecovery recovery_;
+};
+
+#endif
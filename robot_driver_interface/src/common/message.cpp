@@ -9,6 +9,23 @@
  */
 
 #include "message.h"
+#include <time.h>
+
+double hostTime() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1.0e-9;
+}
+
+CommandTrace::CommandTrace() {
+	for (int i = 0; i < StageCount; i++)
+		time_[i] = 0.0;
+}
+
+void CommandTrace::mark(Stage stage) {
+	if (time_[stage] == 0.0)
+		time_[stage] = hostTime();
+}
 
 // Motion Command: PTP, LIN
 Command::Command(Type type, Style style, Frame &f, int st, Approx approx) :
@@ -378,6 +395,7 @@ void Command::constructCommand() {
 		std::cout << "Command::constructCommand: Command invalid" << std::endl;
 		return;
 	}
+	trace_.mark(CommandTrace::Created);
 	doc_ = new QDomDocument();
 
 	eleCommand = doc_->createElement("Command");
@@ -458,6 +476,7 @@ void Command::constructCommand() {
 	eleCommand.appendChild(eleOther);
 
 	msg_ = doc_->toString(-1);
+	trace_.mark(CommandTrace::Serialized);
 }
 
 void Command::printCommandFormated() {
@@ -508,6 +527,10 @@ Command::Type Command::getType() {
 	return type_;
 }
 
+Command::Style Command::getStyle() {
+	return style_;
+}
+
 Command::OtherType Command::getOtherType() {
 	return other_type_;
 }
@@ -520,18 +543,38 @@ Axis& Command::getAxis() {
 	return axis_;
 }
 
+int Command::getEnd() {
+	return end_;
+}
+
+Command::Approx Command::getApprox() {
+	return approx_;
+}
+
+int Command::getPosS() {
+	return pos_s_;
+}
+
+int Command::getPosT() {
+	return pos_t_;
+}
+
 bool Command::getEmergent() {
 	return emergent_;
 }
 
+CommandTrace& Command::getTrace() {
+	return trace_;
+}
+
 Feedback::Feedback() :
-		frame_(), axis_(), pos_() {
+		frame_(), axis_(), pos_(), recv_time_(0.0) {
 	parsedOK_ = false;
 	setOK_ = false;
 }
 
 Feedback::Feedback(const char *filename) :
-		frame_(), axis_() {
+		frame_(), axis_(), recv_time_(hostTime()) {
 	QFile file(filename);
 	if (!file.open(QIODevice::ReadOnly)) {
 		setOK_ = false;
@@ -550,7 +593,7 @@ Feedback::Feedback(const char *filename) :
 }
 
 Feedback::Feedback(const QString &qs, bool& isParsed) :
-		frame_(), axis_() {
+		frame_(), axis_(), recv_time_(hostTime()) {
 	if (!doc_.setContent(qs)) {
 		setOK_ = false;
 		//std::cout << "Feedback::Feedback: Cannot set document" << std::endl;
@@ -729,6 +772,10 @@ int Feedback::getTime() {
 	return time_;
 }
 
+double Feedback::getRecvTime() {
+	return recv_time_;
+}
+
 Pos& Feedback::getPos() {
 	return pos_;
 }
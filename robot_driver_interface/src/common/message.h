@@ -316,6 +316,47 @@
 // With one space indent between elements and nodes
 #define INDENT_SPACE 1
 
+// --------------------------------------------------------------------------
+// Host monotonic clock, in seconds
+//  - used to time stamp Commands and Feedbacks on PC side
+// --------------------------------------------------------------------------
+double hostTime();
+
+// --------------------------------------------------------------------------
+// Data structure: CommandTrace
+//  - lifecycle of a Command on the host monotonic clock (in seconds)
+//  - 0.0 if the stage has not been reached (yet)
+//  - stages set by Command itself: Created, Serialized
+//  - stages set by Plannar: Written, Acked, Buffered, BufFront, Left
+// --------------------------------------------------------------------------
+struct CommandTrace {
+	enum Stage {
+		// Command constructed
+		Created = 0,
+		// XML message constructed
+		Serialized,
+		// handed to TCPThread for writing
+		Written,
+		// Result/Stamp of the Command received
+		Acked,
+		// passed by KRL BufLast, stored in KRL buffer
+		Buffered,
+		// became KRL BufFront
+		BufFront,
+		// passed by KRL BufFront, left KRL buffer
+		Left,
+		StageCount
+	};
+
+	double time_[StageCount];
+
+	// All stages unset
+	CommandTrace();
+
+	// Record the current hostTime() for stage, only the first call counts
+	void mark(Stage stage);
+};
+
 // --------------------------------------------------------------------------
 // Command class
 // --------------------------------------------------------------------------
@@ -451,14 +492,26 @@ public:
 	State getState();
 	// Get method: type_
 	Type getType();
+	// Get method: style_
+	Style getStyle();
 	// Get method: other_type_
 	OtherType getOtherType();
 	// Get method: frame_
 	Frame& getFrame();
 	// Get method: axis_
 	Axis& getAxis();
+	// Get method: end_, COMMAND_END_FRAME, COMMAND_END_POS or COMMAND_END_AXIS
+	int getEnd();
+	// Get method: approx_
+	Approx getApprox();
+	// Get method: pos_s_
+	int getPosS();
+	// Get method: pos_t_
+	int getPosT();
 	// Get method: emergent_
 	bool getEmergent();
+	// Get method: trace_
+	CommandTrace& getTrace();
 
 	// print a Command in well format: not supported yet
 	void printCommandFormated();
@@ -519,6 +572,9 @@ private:
 	// A Command as text, without any indent
 	QString msg_;
 
+	// Lifecycle of the Command, for timing analysis
+	CommandTrace trace_;
+
 	// QDomDocument and QDom Element for constructing an XML file
 	QDomDocument* doc_;
 	QDomElement eleCommand;
@@ -619,6 +675,8 @@ public:
 	int getHour();
 	// Get method: time_
 	int getTime();
+	// Get method: recv_time_
+	double getRecvTime();
 
 private:
 	// no indent in msg_, plain text
@@ -649,6 +707,8 @@ private:
 	bool buffer_full_;
 	bool buffer_empty_;
 	std::string text_;
+	// hostTime() when the Feedback is received and parsed
+	double recv_time_;
 };
 
 #endif
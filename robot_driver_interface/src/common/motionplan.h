@@ -0,0 +1,24 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Header file for MotionPlanPtr, the motion plan handed between threads
+ *   by Interface, Controller and Plannar. Signals pass the pointer and the
+ *   plan itself is never copied or modified after it is shared.
+ *
+ */
+
+#ifndef MY_MOTIONPLAN_H
+#define MY_MOTIONPLAN_H
+
+#include <boost/shared_ptr.hpp>
+#include <moveit/move_group_interface/move_group.h>
+
+typedef boost::shared_ptr<const moveit::planning_interface::MoveGroup::Plan> MotionPlanPtr;
+
+#endif
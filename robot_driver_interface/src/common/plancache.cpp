@@ -0,0 +1,364 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ */
+
+#include "plancache.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <QMutexLocker>
+#include <ros/ros.h>
+#include <ros/serialization.h>
+
+// Format of cache file
+#define PLANCACHE_MAGIC "KR6PLANS"
+#define PLANCACHE_VERSION 1
+// Longest vector, name and message accepted when reading, guards against
+// corrupted files
+#define PLANCACHE_MAX_VALUES 64
+#define PLANCACHE_MAX_NAME 1024
+#define PLANCACHE_MAX_MESSAGE (16 * 1024 * 1024)
+
+bool PlanCache::Key::operator<(const Key& right) const {
+	if (revision != right.revision)
+		return revision < right.revision;
+	if (start != right.start)
+		return start < right.start;
+	if (goal != right.goal)
+		return goal < right.goal;
+	return link < right.link;
+}
+
+PlanCache::PlanCache(size_t capacity, double quantum_joint,
+		double quantum_position, double quantum_quaternion) :
+		capacity_(capacity), quantumJoint_(quantum_joint), quantumPosition_(
+				quantum_position), quantumQuaternion_(quantum_quaternion), hits_(
+				0), misses_(0), rejected_(0), timeSaved_(0.0) {
+}
+
+long PlanCache::quantize(double v, double quantum) {
+	return (long) floor(v / quantum + 0.5);
+}
+
+PlanCache::Key PlanCache::makeKey(const std::vector<double>& start,
+		const std::map<std::string, double>& target_joints,
+		uint64_t revision) {
+	Key key;
+	for (size_t i = 0; i < start.size(); i++)
+		key.start.push_back(quantize(start[i], quantumJoint_));
+	for (std::map<std::string, double>::const_iterator it =
+			target_joints.begin(); it != target_joints.end(); ++it)
+		key.goal.push_back(quantize(it->second, quantumJoint_));
+	key.revision = revision;
+	return key;
+}
+
+PlanCache::Key PlanCache::makeKey(const std::vector<double>& start,
+		const geometry_msgs::Pose& target_pose,
+		const std::string& end_effector_link, uint64_t revision) {
+	Key key;
+	for (size_t i = 0; i < start.size(); i++)
+		key.start.push_back(quantize(start[i], quantumJoint_));
+	key.goal.push_back(quantize(target_pose.position.x, quantumPosition_));
+	key.goal.push_back(quantize(target_pose.position.y, quantumPosition_));
+	key.goal.push_back(quantize(target_pose.position.z, quantumPosition_));
+	// q and -q are the same orientation
+	double sign = target_pose.orientation.w < 0.0 ? -1.0 : 1.0;
+	key.goal.push_back(
+			quantize(sign * target_pose.orientation.x, quantumQuaternion_));
+	key.goal.push_back(
+			quantize(sign * target_pose.orientation.y, quantumQuaternion_));
+	key.goal.push_back(
+			quantize(sign * target_pose.orientation.z, quantumQuaternion_));
+	key.goal.push_back(
+			quantize(sign * target_pose.orientation.w, quantumQuaternion_));
+	key.link = end_effector_link;
+	key.revision = revision;
+	return key;
+}
+
+bool PlanCache::lookup(const Key& key, MotionPlan& plan) {
+	QMutexLocker locker(&mutex_);
+	std::map<Key, std::list<Entry>::iterator>::iterator it = index_.find(key);
+	if (it == index_.end()) {
+		misses_++;
+		return false;
+	}
+	plan = it->second->plan;
+	return true;
+}
+
+void PlanCache::accept(const Key& key, double check_time) {
+	QMutexLocker locker(&mutex_);
+	std::map<Key, std::list<Entry>::iterator>::iterator it = index_.find(key);
+	if (it == index_.end())
+		return;
+	hits_++;
+	timeSaved_ += it->second->planningTime - check_time;
+	// Move to front as most recently used, iterators stay valid
+	entries_.splice(entries_.begin(), entries_, it->second);
+}
+
+void PlanCache::reject(const Key& key) {
+	QMutexLocker locker(&mutex_);
+	std::map<Key, std::list<Entry>::iterator>::iterator it = index_.find(key);
+	if (it == index_.end())
+		return;
+	rejected_++;
+	entries_.erase(it->second);
+	index_.erase(it);
+}
+
+void PlanCache::insert(const Key& key, const MotionPlan& plan,
+		double planning_time) {
+	QMutexLocker locker(&mutex_);
+	if (capacity_ == 0)
+		return;
+	std::map<Key, std::list<Entry>::iterator>::iterator it = index_.find(key);
+	if (it != index_.end()) {
+		// Replace the old plan of this key
+		it->second->plan = plan;
+		it->second->planningTime = planning_time;
+		entries_.splice(entries_.begin(), entries_, it->second);
+		return;
+	}
+
+	Entry entry;
+	entry.key = key;
+	entry.plan = plan;
+	entry.planningTime = planning_time;
+	entries_.push_front(entry);
+	index_[key] = entries_.begin();
+	trim();
+}
+
+void PlanCache::trim() {
+	while (entries_.size() > capacity_) {
+		index_.erase(entries_.back().key);
+		entries_.pop_back();
+	}
+}
+
+void PlanCache::clear() {
+	QMutexLocker locker(&mutex_);
+	entries_.clear();
+	index_.clear();
+}
+
+// --------------------------------------------------------------------------
+// File
+// --------------------------------------------------------------------------
+static bool writeValues(FILE* fp, const std::vector<long>& v) {
+	uint32_t n = v.size();
+	if (fwrite(&n, sizeof(n), 1, fp) != 1)
+		return false;
+	for (uint32_t i = 0; i < n; i++) {
+		int64_t value = v[i];
+		if (fwrite(&value, sizeof(value), 1, fp) != 1)
+			return false;
+	}
+	return true;
+}
+
+static bool readValues(FILE* fp, std::vector<long>& v) {
+	uint32_t n;
+	if (fread(&n, sizeof(n), 1, fp) != 1 || n > PLANCACHE_MAX_VALUES)
+		return false;
+	v.resize(n);
+	for (uint32_t i = 0; i < n; i++) {
+		int64_t value;
+		if (fread(&value, sizeof(value), 1, fp) != 1)
+			return false;
+		v[i] = (long) value;
+	}
+	return true;
+}
+
+static bool writeString(FILE* fp, const std::string& s) {
+	uint32_t len = s.size();
+	return fwrite(&len, sizeof(len), 1, fp) == 1
+			&& (len == 0 || fwrite(s.data(), 1, len, fp) == len);
+}
+
+static bool readString(FILE* fp, std::string& s) {
+	uint32_t len;
+	if (fread(&len, sizeof(len), 1, fp) != 1 || len > PLANCACHE_MAX_NAME)
+		return false;
+	s.resize(len);
+	return len == 0 || fread(&s[0], 1, len, fp) == len;
+}
+
+// ROS message, serialized and prefixed by its length
+template<class M>
+static bool writeMessage(FILE* fp, const M& message) {
+	uint32_t len = ros::serialization::serializationLength(message);
+	std::vector<uint8_t> buffer(len);
+	ros::serialization::OStream stream(buffer.empty() ? NULL : &buffer[0],
+			len);
+	ros::serialization::serialize(stream, message);
+	return fwrite(&len, sizeof(len), 1, fp) == 1
+			&& (len == 0 || fwrite(&buffer[0], 1, len, fp) == len);
+}
+
+template<class M>
+static bool readMessage(FILE* fp, M& message) {
+	uint32_t len;
+	if (fread(&len, sizeof(len), 1, fp) != 1 || len > PLANCACHE_MAX_MESSAGE)
+		return false;
+	std::vector<uint8_t> buffer(len);
+	if (len != 0 && fread(&buffer[0], 1, len, fp) != len)
+		return false;
+	ros::serialization::IStream stream(buffer.empty() ? NULL : &buffer[0],
+			len);
+	try {
+		ros::serialization::deserialize(stream, message);
+	} catch (ros::serialization::StreamOverrunException& e) {
+		return false;
+	}
+	return true;
+}
+
+bool PlanCache::save(const std::string& filename) {
+	QMutexLocker locker(&mutex_);
+	// Written to a temporary file first, a crash never leaves half a cache
+	std::string tmp = filename + ".tmp";
+	FILE* fp = fopen(tmp.c_str(), "wb");
+	if (fp == NULL) {
+		std::cout << "PlanCache::save: Cannot open " << tmp << std::endl;
+		return false;
+	}
+	uint32_t version = PLANCACHE_VERSION;
+	uint32_t n = entries_.size();
+	bool ok = fwrite(PLANCACHE_MAGIC, 1, 8, fp) == 8
+			&& fwrite(&version, sizeof(version), 1, fp) == 1
+			&& fwrite(&n, sizeof(n), 1, fp) == 1;
+	// Least recently used first, so load restores the order
+	for (std::list<Entry>::reverse_iterator it = entries_.rbegin();
+			ok && it != entries_.rend(); ++it)
+		ok = writeValues(fp, it->key.start) && writeValues(fp, it->key.goal)
+				&& writeString(fp, it->key.link)
+				&& fwrite(&it->key.revision, sizeof(uint64_t), 1, fp) == 1
+				&& fwrite(&it->planningTime, sizeof(double), 1, fp) == 1
+				&& writeMessage(fp, it->plan.start_state_)
+				&& writeMessage(fp, it->plan.trajectory_);
+	ok = (fclose(fp) == 0) && ok;
+	if (!ok || rename(tmp.c_str(), filename.c_str()) != 0) {
+		std::cout << "PlanCache::save: Failed to write " << filename
+				<< std::endl;
+		remove(tmp.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool PlanCache::load(const std::string& filename) {
+	FILE* fp = fopen(filename.c_str(), "rb");
+	if (fp == NULL)
+		return false;
+	char magic[8];
+	uint32_t version, n;
+	bool ok = fread(magic, 1, 8, fp) == 8
+			&& memcmp(magic, PLANCACHE_MAGIC, 8) == 0
+			&& fread(&version, sizeof(version), 1, fp) == 1
+			&& version == PLANCACHE_VERSION
+			&& fread(&n, sizeof(n), 1, fp) == 1;
+	std::list<Entry> entries;
+	for (uint32_t i = 0; ok && i < n; i++) {
+		Entry entry;
+		ok = readValues(fp, entry.key.start) && readValues(fp, entry.key.goal)
+				&& readString(fp, entry.key.link)
+				&& fread(&entry.key.revision, sizeof(uint64_t), 1, fp) == 1
+				&& fread(&entry.planningTime, sizeof(double), 1, fp) == 1
+				&& readMessage(fp, entry.plan.start_state_)
+				&& readMessage(fp, entry.plan.trajectory_);
+		if (ok) {
+			entry.plan.planning_time_ = entry.planningTime;
+			entries.push_front(entry);
+		}
+	}
+	fclose(fp);
+	if (!ok) {
+		std::cout << "PlanCache::load: Invalid file " << filename << std::endl;
+		return false;
+	}
+
+	QMutexLocker locker(&mutex_);
+	entries_.swap(entries);
+	index_.clear();
+	for (std::list<Entry>::iterator it = entries_.begin();
+			it != entries_.end(); ++it)
+		index_[it->key] = it;
+	trim();
+	std::cout << "PlanCache::load: " << entries_.size() << " plans read from "
+			<< filename << std::endl;
+	return true;
+}
+
+// --------------------------------------------------------------------------
+// Settings and counters
+// --------------------------------------------------------------------------
+void PlanCache::setCapacity(size_t capacity) {
+	QMutexLocker locker(&mutex_);
+	capacity_ = capacity;
+	trim();
+}
+
+size_t PlanCache::getCapacity() {
+	QMutexLocker locker(&mutex_);
+	return capacity_;
+}
+
+unsigned long PlanCache::getHits() {
+	QMutexLocker locker(&mutex_);
+	return hits_;
+}
+
+unsigned long PlanCache::getMisses() {
+	QMutexLocker locker(&mutex_);
+	return misses_;
+}
+
+unsigned long PlanCache::getRejected() {
+	QMutexLocker locker(&mutex_);
+	return rejected_;
+}
+
+double PlanCache::getHitRate() {
+	QMutexLocker locker(&mutex_);
+	unsigned long lookups = hits_ + misses_ + rejected_;
+	return lookups == 0 ? 0.0 : (double) hits_ / lookups;
+}
+
+double PlanCache::getTimeSaved() {
+	QMutexLocker locker(&mutex_);
+	return timeSaved_;
+}
+
+size_t PlanCache::getSize() {
+	QMutexLocker locker(&mutex_);
+	return entries_.size();
+}
+
+void PlanCache::resetCounters() {
+	QMutexLocker locker(&mutex_);
+	hits_ = misses_ = rejected_ = 0;
+	timeSaved_ = 0.0;
+}
+
+void PlanCache::report() {
+	QMutexLocker locker(&mutex_);
+	unsigned long lookups = hits_ + misses_ + rejected_;
+	ROS_INFO(
+			"PlanCache: %lu hits, %lu misses, %lu rejected, hit rate %.1f%%, %.2f s planning saved, %lu plans",
+			hits_, misses_, rejected_,
+			lookups == 0 ? 0.0 : 100.0 * hits_ / lookups, timeSaved_,
+			(unsigned long) entries_.size());
+}
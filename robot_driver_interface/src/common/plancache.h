@@ -0,0 +1,159 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Header file for PlanCache, a bounded LRU cache of motion plans used by
+ *   Controller. Home, calibration stations and the needle container are
+ *   planned for again and again from the same start states.
+ *   Key of an entry is
+ *       - start joint values, quantized by a joint quantum (in rad)
+ *       - goal: joint values quantized by the joint quantum, or pose
+ *         quantized by a position quantum (in m) and a quaternion quantum,
+ *         plus the end effector link
+ *       - revision of the planning scene, see Controller::getSceneRevision
+ *   A cached plan is only a candidate, Controller checks it against the
+ *   current scene and calls accept (hit) or reject (entry dropped).
+ *   Counters give the hit rate and the planning time saved, i.e. planning
+ *   time of the stored plans minus the time spent checking them.
+ *   The cache can be saved to and loaded from a file, plans are stored as
+ *   serialized ROS messages:
+ *       "KR6PLANS", version, number of entries, entries
+ *   All methods lock a QMutex.
+ *
+ */
+
+#ifndef MY_PLANCACHE_H
+#define MY_PLANCACHE_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <QMutex>
+
+#include <moveit/move_group_interface/move_group.h>
+#include <geometry_msgs/Pose.h>
+
+// Default number of entries and quanta
+#define PLANCACHE_DEFAULT_CAPACITY 64
+#define PLANCACHE_DEFAULT_QUANTUM_JOINT 0.002
+#define PLANCACHE_DEFAULT_QUANTUM_POSITION 0.0005
+#define PLANCACHE_DEFAULT_QUANTUM_QUATERNION 0.0005
+
+// --------------------------------------------------------------------------
+// PlanCache class
+// --------------------------------------------------------------------------
+class PlanCache {
+public:
+	typedef moveit::planning_interface::MoveGroup::Plan MotionPlan;
+
+	// Quantized start, goal and scene revision
+	struct Key {
+		std::vector<long> start;
+		std::vector<long> goal;
+		// empty for joint goals
+		std::string link;
+		uint64_t revision;
+		bool operator<(const Key& right) const;
+	};
+
+	// Constructor with capacity and quanta (in rad, m and quaternion units)
+	PlanCache(size_t capacity = PLANCACHE_DEFAULT_CAPACITY,
+			double quantum_joint = PLANCACHE_DEFAULT_QUANTUM_JOINT,
+			double quantum_position = PLANCACHE_DEFAULT_QUANTUM_POSITION,
+			double quantum_quaternion = PLANCACHE_DEFAULT_QUANTUM_QUATERNION);
+
+	// Key of a joint goal, joints are ordered by name
+	Key makeKey(const std::vector<double>& start,
+			const std::map<std::string, double>& target_joints,
+			uint64_t revision);
+	// Key of a pose goal of end_effector_link
+	Key makeKey(const std::vector<double>& start,
+			const geometry_msgs::Pose& target_pose,
+			const std::string& end_effector_link, uint64_t revision);
+
+	// Look up key
+	// if return true, the stored plan is copied to plan, a candidate to be
+	// checked and passed to accept or reject
+	// if return false, a miss is counted
+	bool lookup(const Key& key, MotionPlan& plan);
+
+	// Count a hit of key, the entry becomes the most recently used one
+	// check_time is the time in seconds spent checking the plan
+	void accept(const Key& key, double check_time);
+
+	// Count a rejected plan of key, the entry is dropped
+	void reject(const Key& key);
+
+	// Store plan of key, planned in planning_time seconds
+	// the least recently used entry is dropped if the cache is full
+	void insert(const Key& key, const MotionPlan& plan, double planning_time);
+
+	// Drop all entries, counters are kept
+	void clear();
+
+	// Write all entries to filename
+	// if return false, the file could not be written
+	bool save(const std::string& filename);
+
+	// Replace all entries by those of filename, counters are kept
+	// if return false, the file is missing or invalid, and nothing changed
+	bool load(const std::string& filename);
+
+	// Set method: capacity_, least recently used entries are dropped
+	void setCapacity(size_t capacity);
+	// Get method: capacity_
+	size_t getCapacity();
+
+	// Get methods: counters since construction or resetCounters
+	unsigned long getHits();
+	unsigned long getMisses();
+	unsigned long getRejected();
+	// hits / (hits + misses + rejected), 0.0 before the first lookup
+	double getHitRate();
+	// Planning time saved by hits, in seconds
+	double getTimeSaved();
+	// Number of entries
+	size_t getSize();
+
+	// Set all counters to zero
+	void resetCounters();
+
+	// Print counters by ROS_INFO
+	void report();
+
+private:
+	struct Entry {
+		Key key;
+		MotionPlan plan;
+		double planningTime;
+	};
+
+	// Round v by quantum
+	static long quantize(double v, double quantum);
+
+	// Drop least recently used entries until size is within capacity
+	void trim();
+
+	QMutex mutex_;
+	size_t capacity_;
+	double quantumJoint_;
+	double quantumPosition_;
+	double quantumQuaternion_;
+	// most recently used at the front
+	std::list<Entry> entries_;
+	std::map<Key, std::list<Entry>::iterator> index_;
+
+	unsigned long hits_;
+	unsigned long misses_;
+	unsigned long rejected_;
+	double timeSaved_;
+};
+
+#endif
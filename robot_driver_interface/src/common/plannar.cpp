@@ -10,12 +10,42 @@
 
 #include "plannar.h"
 
+#include <algorithm>
+#include <QtConcurrentRun>
+
+// File name of the command journal, configurable through "~command_journal"
+static std::string journalFileName() {
+	std::string home = getenv("HOME") ? getenv("HOME") : "/tmp";
+	std::string fn;
+	ros::param::param<std::string>("~command_journal", fn,
+			home + "/.ros/kuka_command_journal");
+	return fn;
+}
+
+// URDF of Model, read from parameter robot_description if empty
+static std::string urdfFileName() {
+	std::string fn;
+	ros::param::param<std::string>("~urdf_file", fn, "");
+	return fn;
+}
+
+// Cache of KDL chains parsed from URDF, see chaincache.h
+static std::string chainCacheFileName() {
+	std::string home = getenv("HOME") ? getenv("HOME") : "/tmp";
+	std::string fn;
+	ros::param::param<std::string>("~kdl_chain_cache", fn,
+			home + "/.ros/kuka_kdl_chain_cache");
+	return fn;
+}
+
 Plannar::Plannar() :
-	tcpThread_(), rosThread_(), robot_(
-				"/home/lxt12/Kuka_interface/src/kuka_kr6/robots/kuka_kr6_needle.urdf") {
+	journal_(journalFileName()), tcpThread_(), rosThread_(), robot_(
+				urdfFileName(), chainCacheFileName()) {
 	ROS_INFO("Plannar Constructing...");
 
-	stamp_ = 0;
+	// Resume stamping where the previous run stopped
+	stamp_ = journal_.getRecovery().lastStamp_;
+	resync_ = true;
 	connect(&tcpThread_, SIGNAL(feedbackReceived(QString)), this,
 			SLOT(feedbackReceived(QString)), Qt::QueuedConnection);
 	connect(this, SIGNAL(sendMessage(QString)), &tcpThread_,
@@ -42,6 +72,9 @@ Plannar::Plannar() :
 	// Assign a new thread to plannar
 	tcpThread_.start();
 
+	// Assign a new thread to joint state publishing
+	jointState_.start();
+
 	lastTime_ = 0;
 	feedbackCount_ = 0;
 	averageTime_ = 0.0;
@@ -50,13 +83,84 @@ Plannar::Plannar() :
 	lastStamp_ = -1;
 	MotionComplete_ = false;
 	delayCounter_ = 0;
+	motionCompleteTime_ = 0.0;
 	motion_complete_delay_ = 180;
 
+	// Speed of the motions not retimed, only sent to undo a retimed speed,
+	// the speed of the KRL program is kept until then
+	double ptp_velocity, ptp_acceleration;
+	ros::param::param<double>("~ptp_velocity", ptp_velocity,
+			PTP_DEFAULT_VELOCITY);
+	ros::param::param<double>("~ptp_acceleration", ptp_acceleration,
+			PTP_DEFAULT_ACCELERATION);
+	ptpVelocity_ = std::min(100.0, std::max(1.0, ptp_velocity));
+	ptpAcceleration_ = std::min(100.0, std::max(1.0, ptp_acceleration));
+	ptpSpeedRetimed_ = ptpSpeedEverRetimed_ = false;
+	ptpPredictedDuration_ = ptpRetimedStart_ = 0.0;
+
 	lastAxis_ = Axis(0, 0, 0, 0, 0, 0);
+
+	ros::param::param<std::string>("~command_trace", traceFile_, "");
+
+	// Inverse kinematics backend of robot_, "lma" or "analytic"
+	std::string ik_backend;
+	ros::param::param<std::string>("~ik_backend", ik_backend, "lma");
+	if (ik_backend == "analytic")
+		robot_.setIKBackend(Model::IK_ANALYTIC);
+
+	// Cache of inverse kinematics results of robot_
+	int ik_cache_size;
+	double ik_cache_quantum_mm, ik_cache_quantum_deg;
+	ros::param::param<int>("~ik_cache_size", ik_cache_size,
+			IKCACHE_DEFAULT_CAPACITY);
+	ros::param::param<double>("~ik_cache_quantum_mm", ik_cache_quantum_mm,
+			IKCACHE_DEFAULT_QUANTUM_POSITION);
+	ros::param::param<double>("~ik_cache_quantum_deg", ik_cache_quantum_deg,
+			IKCACHE_DEFAULT_QUANTUM_ANGLE);
+	robot_.getIKCache().setCapacity(ik_cache_size < 0 ? 0 : ik_cache_size);
+	robot_.getIKCache().setQuantum(ik_cache_quantum_mm, ik_cache_quantum_deg);
+
+	// Precomputed workspace of robot_, see ReachabilityMap
+	std::string reachability_map;
+	ros::param::param<std::string>("~reachability_map", reachability_map, "");
+	if (!reachability_map.empty())
+		robot_.loadReachabilityMap(reachability_map);
+
+	// Servo mode limits
+	servo_ = false;
+	servoVelocityInput_ = false;
+	servoMoving_ = false;
+	servoLastInput_ = servoLastTick_ = 0.0;
+	for (int i = 0; i < 6; i++)
+		servoJointVelocity_[i] = 0.0;
+	ros::param::param<double>("~servo_max_velocity", servoMaxVelocity_,
+			SERVO_DEFAULT_MAX_VELOCITY);
+	ros::param::param<double>("~servo_max_acceleration",
+			servoMaxAcceleration_, SERVO_DEFAULT_MAX_ACCELERATION);
+	ros::param::param<double>("~servo_timeout", servoTimeout_,
+			SERVO_DEFAULT_TIMEOUT);
+	ros::param::param<int>("~servo_depth", servoDepth_, SERVO_DEFAULT_DEPTH);
+	if (servoDepth_ < 1)
+		servoDepth_ = 1;
+
+	// Joint limits for differential IK, from joint_limits.yaml of MoveIt
+	for (int i = 0; i < 6; i++) {
+		std::ostringstream ns;
+		ns << "robot_description_planning/joint_limits/joint" << i + 1 << "/";
+		bool has_position_limits;
+		double min_position, max_position;
+		if (ros::param::get(ns.str() + "has_position_limits",
+				has_position_limits) && has_position_limits
+				&& ros::param::get(ns.str() + "min_position", min_position)
+				&& ros::param::get(ns.str() + "max_position", max_position))
+			robot_.setJointLimits(i, min_position / M_PI * 180.0,
+					max_position / M_PI * 180.0);
+	}
 }
 
 Plannar::~Plannar() {
 	std::cout << "Plannar Deconstructing..." << std::endl;
+	traceExport_.waitForFinished();
 	while (!CommandList.empty()) {
 		Command * cmd = CommandList.front();
 		CommandList.pop_front();
@@ -69,11 +173,15 @@ Plannar::~Plannar() {
 	}
 	std::cout << "TCP thread ends..." << std::endl;
 	tcpThread_.exit();
+	std::cout << "Joint state thread ends..." << std::endl;
+	jointState_.stop();
 	std::cout << "ROS thread ends..." << std::endl;
 	rosThread_.exit();
 }
 
-void Plannar::executeTrajectory(const MotionPlan& motion_plan) {
+void Plannar::executeTrajectory(MotionPlanPtr plan) {
+
+	const MotionPlan& motion_plan = *plan;
 
 	ROS_INFO("Plannar thread %lu", QThread::currentThreadId());
 	Axis a;
@@ -132,6 +240,60 @@ void Plannar::executeTrajectory(const MotionPlan& motion_plan) {
 
 }
 
+void Plannar::appendTrajectory(MotionPlanPtr plan, bool last) {
+
+	const std::vector<trajectory_msgs::JointTrajectoryPoint>& points =
+			plan->trajectory_.joint_trajectory.points;
+	Axis a;
+	for (size_t i = 1; i < points.size(); i++) {
+		a.A1 = points[i].positions[0] / M_PI * 180.0;
+		a.A2 = points[i].positions[1] / M_PI * 180.0;
+		a.A3 = points[i].positions[2] / M_PI * 180.0;
+		a.A4 = points[i].positions[3] / M_PI * 180.0;
+		a.A5 = points[i].positions[4] / M_PI * 180.0;
+		a.A6 = points[i].positions[5] / M_PI * 180.0;
+		motion(Command::PTP, a,
+				last && i + 1 == points.size() ?
+						Command::Approx::NONE : Command::Approx::C_DIS);
+	}
+	ROS_INFO("Plannar: %d points appended%s", (int) points.size() - 1,
+			last ? ", last segment" : "");
+	// Record the last command stamp for knowing when this series of motion complete
+	lastStamp_ = stamp_;
+	MotionComplete_ = false;
+	delayCounter_ = 0;
+}
+
+void Plannar::executeCartesianTrajectory(MotionPlanPtr plan) {
+
+	const std::vector<trajectory_msgs::JointTrajectoryPoint>& points =
+			plan->trajectory_.joint_trajectory.points;
+	if (points.size() < 2)
+		return;
+	std::vector<Axis> axis(points.size() - 1);
+	for (size_t i = 1; i < points.size(); i++)
+		axis[i - 1].set(points[i].positions[0] / M_PI * 180.0,
+				points[i].positions[1] / M_PI * 180.0,
+				points[i].positions[2] / M_PI * 180.0,
+				points[i].positions[3] / M_PI * 180.0,
+				points[i].positions[4] / M_PI * 180.0,
+				points[i].positions[5] / M_PI * 180.0);
+	std::vector<Frame> frames;
+	if (!robot_.Axis2FrameBatch(axis, frames)) {
+		ROS_ERROR("Plannar: Cartesian path conversion failed, nothing was sent");
+		return;
+	}
+	for (size_t i = 0; i < frames.size(); i++)
+		motion(Command::LIN, frames[i],
+				i + 1 == frames.size() ?
+						Command::Approx::NONE : Command::Approx::C_DIS);
+	ROS_INFO("Plannar: %d LIN points sent", (int) frames.size());
+	// Record the last command stamp for knowing when this series of motion complete
+	lastStamp_ = stamp_;
+	MotionComplete_ = false;
+	delayCounter_ = 0;
+}
+
 void Plannar::feedbackReceived(QString qs) {
 	bool isParsed;
 	while (FeedbackList.size() >= QUEUE_MAXLEN) {
@@ -157,6 +319,7 @@ void Plannar::disconnected() {
 }
 
 void Plannar::appendCommandList(Command* cmd) {
+	journal_.record(JournalRecord::Created, cmd);
 	if (cmd->getEmergent() && CommandIterNextSent != CommandList.end()) {
 		CommandList.insert(CommandIterNextSent, 1, cmd);
 		if (CommandIterBufFront == CommandIterNextSent)
@@ -192,6 +355,40 @@ void Plannar::changeMotionCompleteDelayTime(double delay_time) {
 	motion_complete_delay_ = delay_time;
 }
 
+void Plannar::setPTPSpeed(double velocity_percent,
+		double acceleration_percent, double duration) {
+	float velocity = std::min(100.0, std::max(1.0, ceil(velocity_percent)));
+	float acceleration = std::min(100.0,
+			std::max(1.0, ceil(acceleration_percent)));
+	ROS_INFO("Plannar: $VEL_PTP %.0f%%, $ACC_PTP %.0f%% retimed", velocity,
+			acceleration);
+	sendPTPSpeed(velocity, acceleration);
+	ptpSpeedRetimed_ = ptpSpeedEverRetimed_ = true;
+	// Segments of a chained trajectory add up
+	if (ptpPredictedDuration_ <= 0.0)
+		ptpRetimedStart_ = hostTime();
+	ptpPredictedDuration_ += duration;
+}
+
+void Plannar::resetPTPSpeed() {
+	ptpPredictedDuration_ = 0.0;
+	if (!ptpSpeedRetimed_)
+		return;
+	ROS_INFO("Plannar: $VEL_PTP %.0f%%, $ACC_PTP %.0f%%", ptpVelocity_,
+			ptpAcceleration_);
+	sendPTPSpeed(ptpVelocity_, ptpAcceleration_);
+	ptpSpeedRetimed_ = false;
+}
+
+void Plannar::sendPTPSpeed(float velocity, float acceleration) {
+	appendCommandList(
+			new Command(Command::Config, Command::VEL_PTP, velocity,
+					++stamp_));
+	appendCommandList(
+			new Command(Command::Config, Command::ACC_PTP, acceleration,
+					++stamp_));
+}
+
 void Plannar::updateQueueStatus(Feedback* fb) {
 	// for debugging
 //    checkStatusTurn(fb);
@@ -206,6 +403,9 @@ void Plannar::updateQueueStatus(Feedback* fb) {
 	updateFrequencyPerformance(fb);
 	//std::cout << std::endl;
 
+	if (resync_)
+		resyncQueue(fb);
+
 	if (fb->getText() == "STOP immediately")
 		stopRecv(fb);
 	else if (fb->getText() == "PAUSE immediately")
@@ -217,16 +417,32 @@ void Plannar::updateQueueStatus(Feedback* fb) {
 	else
 		updateIterators(fb);
 
+	if (servo_)
+		servoTick(fb);
 	queryNextCommand();
+	// Group commit of the transitions of this feedback
+	journal_.commit();
 	lastAxis_.set(fb->getAxis());
+	jointState_.update(fb);
 //    printFeedbackBasic();
 //    printCommandList();
 	// If the last series of motion is completed
 	emit newFeedback(fb);
 	if (!MotionComplete_ && lastStamp_ == fb->getStamp() && fb->getBufferExtreme() == Feedback::Extreme::Empty && fb->getText() == "Timer Feedback") {
+		if (delayCounter_ == 0)
+			motionCompleteTime_ = hostTime();
 		delayCounter_++;
 		if(delayCounter_ >= motion_complete_delay_) {
 			ROS_INFO("Plannar: Last command complete, stamp is %d", lastStamp_);
+			if (ptpPredictedDuration_ > 0.0) {
+				ROS_INFO(
+						"Plannar: retimed motion executed in %.2f s, %.2f s predicted",
+						motionCompleteTime_ - ptpRetimedStart_,
+						ptpPredictedDuration_);
+				ptpPredictedDuration_ = 0.0;
+			}
+			if (!traceFile_.empty())
+				exportTrace(traceFile_);
 			emit LastCommandComplete();
 			delayCounter_ = 0;
 			MotionComplete_ = true;
@@ -246,10 +462,11 @@ void Plannar::updateCommandIterNextACK(Feedback* fb) {
 			if (fbStamp == (*tp_it)->getStamp()) {
 				if ((*tp_it)->getState() == Command::NOFEEDBACK) {
 					if (fbSuccess)
-						(*tp_it)->setState(Command::BUFFERED);
+						setCommandState(*tp_it, Command::BUFFERED, fb);
 					else
-						(*tp_it)->setState(Command::ERROR);
+						setCommandState(*tp_it, Command::ERROR, fb);
 				}
+				(*tp_it)->getTrace().mark(CommandTrace::Acked);
 				std::cout << "--- Command ACK, stamp: " << fbStamp << std::endl;
 				CommandIterNextACK = tp_it;
 				break;
@@ -266,8 +483,10 @@ void Plannar::updateCommandIterBufFront(Feedback* fb) {
 		stepFront += KRL_BUF_LEN;
 	while (stepFront != 0) {
 		if ((*CommandIterBufFront)->getState() != Command::ERROR
-				&& (*CommandIterBufFront)->getState() != Command::SUCCESS)
+				&& (*CommandIterBufFront)->getState() != Command::SUCCESS) {
 			stepFront--;
+			journalRecord(JournalRecord::Executed, *CommandIterBufFront, fb);
+		}
 		CommandIterBufFront++;
 	}
 	while (((*CommandIterBufFront)->getState() == Command::ERROR
@@ -276,16 +495,18 @@ void Plannar::updateCommandIterBufFront(Feedback* fb) {
 		CommandIterBufFront++;
 
 	KRLBufFront = fb->getBufferFront();
+	if (CommandIterBufFront != CommandList.end())
+		(*CommandIterBufFront)->getTrace().mark(CommandTrace::BufFront);
 }
 
 void Plannar::stopRecv(Feedback* fb) {
 	std::list<Command*>::iterator tp_it = CommandIterBufFront;
 	for (; tp_it != CommandIterNextACK; tp_it++)
-		(*tp_it)->setState(Command::ERROR);
+		setCommandState(*tp_it, Command::ERROR, fb);
 	if (fb->getSuccess())
-		(*CommandIterNextACK)->setState(Command::SUCCESS);
+		setCommandState(*CommandIterNextACK, Command::SUCCESS, fb);
 	else
-		(*CommandIterNextACK)->setState(Command::ERROR);
+		setCommandState(*CommandIterNextACK, Command::ERROR, fb);
 	CommandIterBufLast = CommandIterNextSent;
 	CommandIterNextACK++;
 
@@ -299,9 +520,9 @@ void Plannar::pauseImmRecv(Feedback *fb) {
 
 	// update CommandIterBufLast
 	if (fb->getSuccess())
-		(*CommandIterBufLast)->setState(Command::SUCCESS);
+		setCommandState(*CommandIterBufLast, Command::SUCCESS, fb);
 	else
-		(*CommandIterBufLast)->setState(Command::ERROR);
+		setCommandState(*CommandIterBufLast, Command::ERROR, fb);
 	CommandIterBufLast++;
 
 	updateCommandIterBufFront(fb);
@@ -313,14 +534,14 @@ void Plannar::terminateImmRecv(Feedback* fb) {
 	std::list<Command*>::iterator tp_it = CommandIterBufFront;
 	if (tp_it != CommandIterNextACK) {
 		for (tp_it++; tp_it != CommandIterNextACK; tp_it++)
-			(*tp_it)->setState(Command::ERROR);
+			setCommandState(*tp_it, Command::ERROR, fb);
 	}
 	if (fb->getSuccess())
-		(*CommandIterNextACK)->setState(Command::BUFFERED);
+		setCommandState(*CommandIterNextACK, Command::BUFFERED, fb);
 	else
-		(*CommandIterNextACK)->setState(Command::ERROR);
+		setCommandState(*CommandIterNextACK, Command::ERROR, fb);
 	for (tp_it++; tp_it != CommandList.end(); tp_it++)
-		(*tp_it)->setState(Command::ERROR);
+		setCommandState(*tp_it, Command::ERROR, fb);
 	CommandIterBufLast = CommandList.end();
 	CommandIterNextACK = CommandList.end();
 	CommandIterNextSent = CommandList.end();
@@ -333,11 +554,11 @@ void Plannar::terminateImmRecv(Feedback* fb) {
 void Plannar::terminateBufRecv(Feedback* fb) {
 	std::list<Command*>::iterator tp_it = CommandIterNextACK;
 	for (tp_it++; tp_it != CommandList.end(); tp_it++)
-		(*tp_it)->setState(Command::ERROR);
+		setCommandState(*tp_it, Command::ERROR, fb);
 	if (fb->getSuccess())
-		(*CommandIterNextACK)->setState(Command::BUFFERED);
+		setCommandState(*CommandIterNextACK, Command::BUFFERED, fb);
 	else
-		(*CommandIterNextACK)->setState(Command::ERROR);
+		setCommandState(*CommandIterNextACK, Command::ERROR, fb);
 	CommandIterNextACK = CommandList.end();
 	CommandIterBufLast = CommandList.end();
 
@@ -354,6 +575,8 @@ void Plannar::queryNextCommand() {
 				CommandIterBufLast) < KRL_BUF_THRESHOLD) {
 			std::cout << "+++ Command sent, stamp: "
 					<< (*CommandIterNextSent)->getStamp() << std::endl;
+			journal_.record(JournalRecord::Sent, *CommandIterNextSent);
+			(*CommandIterNextSent)->getTrace().mark(CommandTrace::Written);
 			sendMessage((*CommandIterNextSent)->getMessage());
 			CommandIterNextSent++;
 		} else if (std::distance(CommandIterBufFront, CommandIterBufLast)
@@ -361,6 +584,8 @@ void Plannar::queryNextCommand() {
 				&& (*CommandIterNextSent)->getEmergent()) {
 			std::cout << "+++ Command sent, stamp: "
 					<< (*CommandIterNextSent)->getStamp() << std::endl;
+			journal_.record(JournalRecord::Sent, *CommandIterNextSent);
+			(*CommandIterNextSent)->getTrace().mark(CommandTrace::Written);
 			sendMessage((*CommandIterNextSent)->getMessage());
 			CommandIterNextSent++;
 		}
@@ -380,8 +605,10 @@ void Plannar::updateIterators(Feedback* fb) {
 			stepFront += KRL_BUF_LEN;
 		while (stepLast != 0) {
 			if ((*CommandIterBufLast)->getState() != Command::ERROR
-					&& (*CommandIterBufLast)->getState() != Command::SUCCESS)
+					&& (*CommandIterBufLast)->getState() != Command::SUCCESS) {
 				stepLast--;
+				journalRecord(JournalRecord::Buffered, *CommandIterBufLast, fb);
+			}
 			CommandIterBufLast++;
 		}
 		while (((*CommandIterBufLast)->getState() == Command::ERROR
@@ -390,8 +617,11 @@ void Plannar::updateIterators(Feedback* fb) {
 			CommandIterBufLast++;
 		while (stepFront != 0) {
 			if ((*CommandIterBufFront)->getState() != Command::ERROR
-					&& (*CommandIterBufFront)->getState() != Command::SUCCESS)
+					&& (*CommandIterBufFront)->getState() != Command::SUCCESS) {
 				stepFront--;
+				journalRecord(JournalRecord::Executed, *CommandIterBufFront,
+						fb);
+			}
 			CommandIterBufFront++;
 		}
 		while (((*CommandIterBufFront)->getState() == Command::ERROR
@@ -400,7 +630,94 @@ void Plannar::updateIterators(Feedback* fb) {
 			CommandIterBufFront++;
 		KRLBufFront = fb->getBufferFront();
 		KRLBufLast = fb->getBufferLast();
+		if (CommandIterBufFront != CommandList.end())
+			(*CommandIterBufFront)->getTrace().mark(CommandTrace::BufFront);
+	}
+}
+
+void Plannar::resyncQueue(Feedback* fb) {
+	resync_ = false;
+
+	// Number of commands KRL still holds from a previous run
+	int held = fb->getBufferLast() - fb->getBufferFront();
+	if (held < 0)
+		held += KRL_BUF_LEN;
+
+	std::vector<JournalRecord>& pending = journal_.getRecovery().pending_;
+	if (held != (int) pending.size())
+		ROS_WARN(
+				"Plannar::resyncQueue: KRL holds %d command(s), journal expects %d",
+				held, (int) pending.size());
+
+	// Only the most recent commands can still be in KRL buffer
+	int first = (int) pending.size() - held;
+	if (first < 0)
+		first = 0;
+	for (int i = 0; i < first; i++) {
+		Command* cmd = restoreCommand(pending[i]);
+		journal_.record(JournalRecord::Error, cmd);
+		delete cmd;
+	}
+
+	std::list<Command*>::iterator firstOld = CommandList.begin();
+	for (int i = first; i < (int) pending.size(); i++) {
+		Command* cmd = restoreCommand(pending[i]);
+		cmd->setState(Command::BUFFERED);
+		CommandList.insert(firstOld, cmd);
+	}
+	if (first < (int) pending.size()) {
+		ROS_INFO("Plannar::resyncQueue: %d command(s) restored, stamp %d - %d",
+				(int) pending.size() - first, pending[first].stamp_,
+				pending.back().stamp_);
+		CommandIterBufFront = CommandList.begin();
+		CommandIterBufLast = firstOld;
 	}
+	pending.clear();
+
+	KRLBufFront = fb->getBufferFront();
+	KRLBufLast = fb->getBufferLast();
+}
+
+Command* Plannar::restoreCommand(JournalRecord& rec) {
+	if (rec.type_ == Command::Other)
+		return new Command(Command::Other, Command::OtherType(rec.other_type_),
+				rec.stamp_);
+	// Restored as sent: same style, end point and approximation
+	Command::Style style = Command::Style(rec.style_);
+	Command::Approx approx = Command::Approx(rec.approx_);
+	if (rec.end_ == COMMAND_END_AXIS) {
+		Axis a(rec.target_[0], rec.target_[1], rec.target_[2], rec.target_[3],
+				rec.target_[4], rec.target_[5]);
+		return new Command(Command::Motion, style, a, rec.stamp_, approx);
+	}
+	Frame f(rec.target_[0], rec.target_[1], rec.target_[2], rec.target_[3],
+			rec.target_[4], rec.target_[5]);
+	if (rec.end_ == COMMAND_END_POS) {
+		Pos p(f, rec.pos_s_, rec.pos_t_);
+		return new Command(Command::Motion, style, p, rec.stamp_, approx);
+	}
+	return new Command(Command::Motion, style, f, rec.stamp_, approx);
+}
+
+void Plannar::setCommandState(Command* cmd, Command::State state,
+		Feedback* fb) {
+	cmd->setState(state);
+	if (state == Command::BUFFERED)
+		journalRecord(JournalRecord::Acked, cmd, fb);
+	else if (state == Command::ERROR)
+		journalRecord(JournalRecord::Error, cmd, fb);
+	else if (state == Command::SUCCESS)
+		journalRecord(JournalRecord::Executed, cmd, fb);
+}
+
+void Plannar::journalRecord(JournalRecord::Event event, Command* cmd,
+		Feedback* fb) {
+	if (event == JournalRecord::Buffered)
+		cmd->getTrace().mark(CommandTrace::Buffered);
+	else if (event == JournalRecord::Executed)
+		cmd->getTrace().mark(CommandTrace::Left);
+	journal_.record(event, cmd, fb->getSeq(), fb->getBufferFront(),
+			fb->getBufferLast());
 }
 
 void Plannar::updateFrequencyPerformance(Feedback* fb) {
@@ -419,6 +736,7 @@ void Plannar::updateFrequencyPerformance(Feedback* fb) {
 		// std::cout << " Avg time: " << averageTime_ << " ms";
 
 	}
+	jitter_.update(fb);
 }
 
 void Plannar::printFeedbackBasic() {
@@ -509,6 +827,11 @@ void Plannar::pauseImmediately() {
 
 void Plannar::stop() {
 	appendCommandList(new Command(Command::Other, Command::Stop, ++stamp_));
+	// Buffered configurations of the speed may be dropped, after a retimed
+	// speed was ever sent it is sent again before the next motion
+	if (ptpSpeedEverRetimed_)
+		ptpSpeedRetimed_ = true;
+	ptpPredictedDuration_ = 0.0;
 }
 
 void Plannar::motion(Command::Style style, Frame &f, Command::Approx approx) {
@@ -667,6 +990,163 @@ void Plannar::motion(Command::Style style, Pos &p_end, Pos &p_aux, float degree,
 						++stamp_, approx));
 }
 
+bool Plannar::solveServoToFrame(Axis &a_current, Frame &f, Axis &a) {
+	if (!robot_.differentialIK(a_current, f, a)) {
+		std::cout << "Plannar::solveServoToFrame: Differential IK failed"
+				<< std::endl;
+		return false;
+	}
+	if (fabs(a.A1 - a_current.A1) > MAX_MOVE_ANGLE
+			|| fabs(a.A2 - a_current.A2) > MAX_MOVE_ANGLE
+			|| fabs(a.A3 - a_current.A3) > MAX_MOVE_ANGLE
+			|| fabs(a.A4 - a_current.A4) > MAX_MOVE_ANGLE
+			|| fabs(a.A5 - a_current.A5) > MAX_MOVE_ANGLE
+			|| fabs(a.A6 - a_current.A6) > MAX_MOVE_ANGLE) {
+		std::cout
+				<< "Plannar::solveServoToFrame: Move too large, plan it instead"
+				<< std::endl;
+		return false;
+	}
+	return true;
+}
+
+void Plannar::servoToAxis(Axis a) {
+	resetPTPSpeed();
+	motion(Command::PTP, a, Command::Approx::NONE);
+	// Record the last command stamp for knowing when the motion completes
+	lastStamp_ = stamp_;
+	MotionComplete_ = false;
+	delayCounter_ = 0;
+}
+
+// --------------------------------------------------------------------------
+// Servo mode
+// --------------------------------------------------------------------------
+void Plannar::startServo() {
+	if (servo_)
+		return;
+	ROS_INFO("Plannar: Servo mode on, %.1f deg/s, %.1f deg/s^2, timeout %.2f s",
+			servoMaxVelocity_, servoMaxAcceleration_, servoTimeout_);
+	servo_ = true;
+	servoMoving_ = false;
+	servoLastInput_ = servoLastTick_ = 0.0;
+	// The joint limits of servo mode assume the speed of unretimed motions
+	resetPTPSpeed();
+}
+
+void Plannar::stopServo() {
+	if (!servo_)
+		return;
+	ROS_INFO("Plannar: Servo mode off");
+	if (servoMoving_)
+		stop();
+	servo_ = false;
+	servoMoving_ = false;
+}
+
+void Plannar::setServoTarget(Frame target) {
+	servoTarget_ = target;
+	servoVelocityInput_ = false;
+	servoLastInput_ = hostTime();
+}
+
+void Plannar::setServoVelocity(Frame velocity) {
+	servoVelocity_ = velocity;
+	servoVelocityInput_ = true;
+	servoLastInput_ = hostTime();
+}
+
+void Plannar::servoTick(Feedback* fb) {
+	double now = fb->getRecvTime();
+	if (now <= 0.0)
+		now = hostTime();
+	if (servoLastInput_ <= 0.0)
+		return;
+
+	// Watchdog of the twists, a target is followed until it is reached
+	if (servoVelocityInput_ && now - servoLastInput_ > servoTimeout_) {
+		if (servoMoving_) {
+			ROS_WARN("Plannar: Servo input lost for %.2f s, robot stopped",
+					now - servoLastInput_);
+			stop();
+			servoMoving_ = false;
+		}
+		servoLastTick_ = now;
+		return;
+	}
+	if (!servoMoving_) {
+		// Start from where the robot is
+		servoAxis_.set(fb->getAxis());
+		for (int i = 0; i < 6; i++)
+			servoJointVelocity_[i] = 0.0;
+	}
+	// Keep the KRL buffer shallow, the next step covers the time waited
+	if ((int) std::distance(CommandIterBufFront, CommandList.end())
+			>= servoDepth_)
+		return;
+	double dt = servoLastTick_ > 0.0 ? now - servoLastTick_ : 0.0;
+	servoLastTick_ = now;
+	if (dt <= 0.0)
+		return;
+	// Bounded against lost and bunched feedbacks
+	dt = std::min(std::max(dt, 0.001), 0.1);
+
+	Frame target;
+	if (servoVelocityInput_) {
+		if (!robot_.Axis2Frame(servoAxis_, target))
+			return;
+		// Rotation by the angular velocity during dt, applied to the
+		// rotation matrix as A, B, C rates differ from it
+		KDL::Vector w(servoVelocity_.C / 180.0 * M_PI,
+				servoVelocity_.B / 180.0 * M_PI,
+				servoVelocity_.A / 180.0 * M_PI);
+		KDL::Rotation rotation = KDL::Rotation::Rot(w, w.Norm() * dt)
+				* KDL::Rotation::RPY(target.C / 180.0 * M_PI,
+						target.B / 180.0 * M_PI, target.A / 180.0 * M_PI);
+		double a, b, c;
+		rotation.GetRPY(c, b, a);
+		target.set(target.X + servoVelocity_.X * dt,
+				target.Y + servoVelocity_.Y * dt,
+				target.Z + servoVelocity_.Z * dt, a / M_PI * 180.0,
+				b / M_PI * 180.0, c / M_PI * 180.0);
+	} else
+		target = servoTarget_;
+	// A step toward target even if it is not reached in one solve
+	Axis desired;
+	robot_.differentialIK(servoAxis_, target, desired);
+
+	const float current[6] = { servoAxis_.A1, servoAxis_.A2, servoAxis_.A3,
+			servoAxis_.A4, servoAxis_.A5, servoAxis_.A6 };
+	const float goal[6] = { desired.A1, desired.A2, desired.A3, desired.A4,
+			desired.A5, desired.A6 };
+	double velocity[6], step[6];
+	bool moving = false;
+	for (int i = 0; i < 6; i++) {
+		double error = goal[i] - current[i];
+		// Velocity that reaches goal, slow enough to brake before it
+		double v = error / dt;
+		double v_brake = sqrt(2.0 * servoMaxAcceleration_ * fabs(error));
+		v = std::max(-v_brake, std::min(v_brake, v));
+		v = std::max(-servoMaxVelocity_, std::min(servoMaxVelocity_, v));
+		double dv = servoMaxAcceleration_ * dt;
+		v = std::max(servoJointVelocity_[i] - dv,
+				std::min(servoJointVelocity_[i] + dv, v));
+		velocity[i] = v;
+		step[i] = current[i] + v * dt;
+		if (fabs(v * dt) > 1e-4)
+			moving = true;
+	}
+	Axis next(step[0], step[1], step[2], step[3], step[4], step[5]);
+	if (!moving || !reachableCheck(next))
+		return;
+
+	for (int i = 0; i < 6; i++)
+		servoJointVelocity_[i] = velocity[i];
+	servoAxis_.set(next);
+	motion(Command::PTP, servoAxis_, Command::Approx::C_PTP);
+	servoMoving_ = true;
+}
+
 bool Plannar::reachableCheck(Axis& a) {
 	bool reachable = true;
 	if (a.A1 > A1_UPPER || a.A1 < A1_LOWER)
@@ -684,8 +1164,9 @@ bool Plannar::reachableCheck(Axis& a) {
 
 	return reachable;
 }
-// reachableCheck for Frame and Pos is not accomplished yet
 bool Plannar::reachableCheck(Frame &f) {
+	if (robot_.getReachabilityMap().isUnreachable(f))
+		return false;
 	Axis a_convert;
 	if (robot_.Frame2Axis(lastAxis_, f, a_convert))
 		return reachableCheck(a_convert);
@@ -694,11 +1175,7 @@ bool Plannar::reachableCheck(Frame &f) {
 }
 
 bool Plannar::reachableCheck(Pos &p) {
-	Axis a_convert;
-	if (robot_.Pos2Axis(lastAxis_, p, a_convert))
-		return reachableCheck(a_convert);
-	else
-		return false;
+	return robot_.isReachable(p);
 }
 
 void Plannar::configuration(Command::Param param, float number) {
@@ -717,6 +1194,11 @@ void Plannar::configuration(Command::Param param, float number) {
 	appendCommandList(new Command(Command::Config, param, number, ++stamp_));
 	if (param == Command::ADVANCE)
 		advance_ = number;
+	// Set by hand, the speed of the motions not retimed from now on
+	if (param == Command::VEL_PTP)
+		ptpVelocity_ = number;
+	if (param == Command::ACC_PTP)
+		ptpAcceleration_ = number;
 }
 
 void Plannar::test() {
@@ -949,3 +1431,17 @@ std::list<Command*>::iterator& Plannar::getCommandIterNextSent() {
 int Plannar::getFeedbackCount() {
 	return feedbackCount_;
 }
+
+bool Plannar::exportTrace(const std::string& filename) {
+	if (!traceExport_.isFinished()) {
+		ROS_WARN("Plannar: Trace export still running, %s skipped",
+				filename.c_str());
+		return false;
+	}
+	TraceSnapshot snapshot;
+	takeTraceSnapshot(snapshot, CommandList, FeedbackList);
+	ROS_INFO("Plannar: Exporting trace of %d command(s) to %s",
+			(int) snapshot.commands.size(), filename.c_str());
+	traceExport_ = QtConcurrent::run(&writeChromeTrace, filename, snapshot);
+	return true;
+}
@@ -15,6 +15,9 @@
  *   manages commandList and feedbackList, with a few error handling.
  *   Plannar wraps up some testing functions, could be used to test
  *   communications between controller and KRC4.
+ *   Every change of the CommandList is recorded in a CommandJournal, so
+ *   that a restarted Plannar resumes stamping and resynchronizes with the
+ *   commands still held in the KRL buffer.
  *
  *   Signals:
  *       \sendMessage(QString)       -> self.tcpthread_/
@@ -30,11 +33,6 @@
 #ifndef MY_PLANNAR
 #define MY_PLANNAR
 
-#include <descartes_moveit/moveit_state_adapter.h>
-#include <descartes_trajectory/axial_symmetric_pt.h>
-#include <descartes_trajectory/cart_trajectory_pt.h>
-#include <descartes_planner/dense_planner.h>
-
 #include <ros/ros.h>
 #include <ros/callback_queue.h>
 #include <ros/callback_queue_interface.h>
@@ -58,16 +56,42 @@
 #include <cmath>
 #include <qmath.h>
 #include <iomanip>
+#include <sstream>
 #include <cstdlib>
 #include <ctime>
 #include <QVector>
+#include <QFuture>
 
 #include "message.h"
+#include "motionplan.h"
+#include "journal.h"
+#include "tracing.h"
+#include "jitter.h"
+#include "jointstate.h"
+#include "ikcache.h"
+#include "reachmap.h"
 #include "tcpthread.h"
 #include "ROSThread.h"
 
 #define MOTION_COMPLETE_LARGE_DELAY 180
 #define MOTION_COMPLETE_SMALL_DELAY 60
+// Largest change of any axis (in degrees) that is moved without planning,
+// see servoToFrame
+#define MAX_MOVE_ANGLE 3
+// Defaults of servo mode, see startServo
+//  - joint velocity limit, in deg/s
+#define SERVO_DEFAULT_MAX_VELOCITY 30.0
+//  - joint acceleration limit, in deg/s^2
+#define SERVO_DEFAULT_MAX_ACCELERATION 120.0
+//  - time without input after which the robot is stopped, in seconds
+#define SERVO_DEFAULT_TIMEOUT 0.3
+//  - servo commands in CommandList not yet left the KRL buffer
+#define SERVO_DEFAULT_DEPTH 2
+// $VEL_PTP and $ACC_PTP of the motions not retimed, in percent, see
+// resetPTPSpeed
+#define PTP_DEFAULT_VELOCITY 10.0
+#define PTP_DEFAULT_ACCELERATION 10.0
+
 // --------------------------------------------------------------------------
 // Plannar class
 //  - publicly inherited from QObect, for signal-slot connection between main
@@ -122,9 +146,21 @@ public:
 	void motion(Command::Style style, Pos &p_end, Pos &p_aux, float degree,
 			Command::Approx approx = Command::NONE);
 
+	// Solve a direct PTP motion to a nearby Frame, without sampling-based
+	// planning, the motion is sent by servoToAxis
+	//  - Axis &a is solved by Model::differentialIK from Axis &a_current
+	//  - only if no axis moves more than MAX_MOVE_ANGLE, e.g. sub-millimetre
+	//      corrections of NDI feedback moves
+	//  - no member of Plannar is changed, safe to call from any thread
+	// if return false, the target should be planned
+	bool solveServoToFrame(Axis &a_current, Frame &f, Axis &a);
+
 	// Check if the target is reachable
 	// Robot Model should be initialized before
-	// reachableCheck for Frame and Pos is not accomplished yet
+	// reachableCheck for Frame is rejected in O(1) if the ReachabilityMap of
+	// robot_ knows it unreachable, otherwise (including cells never reached
+	// by sampling) checked by Frame2Axis
+	// reachableCheck for Pos is exact with analytic IK, see Model::isReachable
 	bool reachableCheck(Frame &f);
 	bool reachableCheck(Axis &a);
 	bool reachableCheck(Pos &p);
@@ -213,6 +249,15 @@ public:
 
 	int getFeedbackCount();
 
+	// Export the lifecycle of the latest commands in CommandList, together
+	// with the feedback ticks in FeedbackList, as Chrome trace-event JSON
+	//  - only a bounded snapshot is taken here, the file is written on the
+	//      global QThreadPool
+	//  - also done automatically when a series of motion completes, if the
+	//      ROS parameter "~command_trace" names a file
+	// if return false, the previous export is still being written
+	bool exportTrace(const std::string& filename);
+
 	void robotInterfaceCallback(
 			const control_msgs::FollowJointTrajectoryActionGoalConstPtr& feedback);
 
@@ -222,9 +267,55 @@ public slots:
 	// Called when tcpSocket_ in tcpthread_ is disconencted
 	void disconnected();
 	// Called when Controller emit sendTrajectory() signal
-	void executeTrajectory(const MotionPlan& motion_plan);
+	void executeTrajectory(MotionPlanPtr plan);
+	// Called when Controller emit appendTrajectorySignal() signal
+	// Stream one segment of a chained trajectory after the commands sent
+	//  - the first point of plan is the end of the previous segment
+	//      and is not sent again
+	//  - points are approximated, the motion stops exactly only at the end
+	//      of the last segment
+	void appendTrajectory(MotionPlanPtr plan, bool last);
+	// Called when Controller emit sendCartesianTrajectorySignal() signal
+	// Send a dense Cartesian path as LIN motions to the frames of its points
+	//  - the first point is the current state and is not sent
+	void executeCartesianTrajectory(MotionPlanPtr plan);
 	// Change motion complete waiting time
 	void changeMotionCompleteDelayTime(double delay_time);
+	// Called when Controller emit servoToAxisSignal() signal
+	// Direct PTP motion to Axis a, solved by solveServoToFrame
+	//  - LastCommandComplete is emitted when the motion completes
+	void servoToAxis(Axis a);
+	// Called when Controller emit sendSpeedSignal() signal
+	// Set $VEL_PTP and $ACC_PTP of the retimed motions sent afterwards, in
+	// percent, rounded up and bounded to 1 - 100
+	//  - duration is the time predicted by retiming, in seconds, logged
+	//      with the time measured when the motion completes
+	void setPTPSpeed(double velocity_percent, double acceleration_percent,
+			double duration);
+	// Called when Controller emit resetSpeedSignal() signal
+	// Set $VEL_PTP and $ACC_PTP back to the speed of the motions not
+	// retimed if setPTPSpeed changed it: ROS parameters ~ptp_velocity and
+	// ~ptp_acceleration (percent), or the last values of configuration
+	void resetPTPSpeed();
+	// Servo mode: on every feedback the commanded Axis moves a step toward
+	// the input, the step is sent as an approximated PTP motion
+	//  - the step is solved by Model::differentialIK from the last command,
+	//      limited by the joint velocity and acceleration limits
+	//  - a step is only sent while fewer than the servo depth of commands
+	//      are waiting, so the KRL buffer stays shallow
+	//  - watchdog: if no twist arrives for the servo timeout, the robot is
+	//      stopped by stop() and waits for the next input, a target is
+	//      followed until it is reached
+	// Limits are read from ROS parameters ~servo_max_velocity (deg/s),
+	// ~servo_max_acceleration (deg/s^2), ~servo_timeout (s), ~servo_depth
+	void startServo();
+	void stopServo();
+	// Input of servo mode: the frame the tool moves to
+	void setServoTarget(Frame target);
+	// Input of servo mode: tool velocity, X, Y, Z in mm/s and A, B, C the
+	// angular velocity about Z, Y, X of the base in deg/s (not the rates of
+	// A, B, C), the target is the last command moved by one feedback period
+	void setServoVelocity(Frame velocity);
 signals:
 	// Connected with tcpthread_.sendMessage()
 	// send a message to KRC4
@@ -256,6 +347,11 @@ private:
 	//  - emit displayFeedback(Feedback*) signal
 	void updateQueueStatus(Feedback *fb);
 
+	// Step of servo mode on feedback fb, see startServo
+	void servoTick(Feedback *fb);
+	// Append the configurations of $VEL_PTP and $ACC_PTP
+	void sendPTPSpeed(float velocity, float acceleration);
+
 	// Called when the feedback received is pure timer feedback or normal command feedback
 	//  - modify KRLBufFront and KRLBufLast
 	void updateIterators(Feedback *fb);
@@ -272,6 +368,25 @@ private:
 	//  - If the buffer is empty and no CommandList is all executed, point the iterator to CommandList.end()
 	void updateCommandIterBufFront(Feedback* fb);
 
+	// Called with the first feedback after Plannar is constructed
+	//  - KRLBufFront and KRLBufLast are taken over from the feedback instead of
+	//      being assumed to be 1, so a KRL program left running by a previous
+	//      (crashed) Plannar is followed from where it is
+	//  - commands still held in KRL buffer are restored from the journal as
+	//      BUFFERED placeholders in front of the CommandList
+	void resyncQueue(Feedback* fb);
+
+	// Rebuild a Command from a journal record, used by resyncQueue
+	Command* restoreCommand(JournalRecord& rec);
+
+	// Set the state of a Command and record the transition in journal_
+	//  - BUFFERED is recorded as Acked, ERROR as Error, SUCCESS as Executed
+	void setCommandState(Command* cmd, Command::State state, Feedback* fb);
+
+	// Record a transition of a Command in journal_, with the buffer status of fb
+	//  - the matching stage of the CommandTrace is marked as well
+	void journalRecord(JournalRecord::Event event, Command* cmd, Feedback* fb);
+
 	// Called if the feedback is the feedback of a STOP command
 	//  - modify the iterators accordingly: points all iterators to the first command that is not buffered in KRL
 	void stopRecv(Feedback* fb);
@@ -298,10 +413,12 @@ private:
 	// axisCycles: if cycle < 0, execute inversely
 	void axisCycles(int cycle = 1);
 	// printCommandList information formatedly, including all iterators associated with CommandList
+	//  - see exportTrace for the timing of each command
 	void printCommandList();
 	// printFeedbackBasic, print basic information about the feedback message: buffer & stamp
 	void printFeedbackBasic();
 	// updateFrequencyPerformance, monitor timing issues
+	//  - jitter statistics are published by jitter_ as ROS diagnostics
 	void updateFrequencyPerformance(Feedback *fb);
 
 	// Test functions
@@ -323,6 +440,7 @@ private:
 
 	// stamp to record the sequence of command initiated
 	//  - automatically increase when a command is successfully appended to CommandList
+	//  - continues from the last stamp recorded in journal_ after a restart
 	//  - stamp of the first command appended to CommandList is 1
 	//  - stamp of the last command appended to CommandList is (stamp_ - 1)
 	int stamp_;
@@ -335,6 +453,8 @@ private:
 	// advance_ record the $ADVANCE value of KRL program
 	//  - default value: 3
 	int advance_;
+	// resync_ is true until the first feedback is processed by resyncQueue
+	bool resync_;
 
 	// Record the most recent Axis information
 	//  - act as initial guess for inverse kinematics iteration
@@ -373,12 +493,57 @@ private:
 	int lastTime_;
 	int firstTime_;
 	double averageTime_;
+	// Rolling-window jitter statistics, published on /diagnostics at 1 Hz
+	JitterMonitor jitter_;
+	// Servo mode, see startServo
+	bool servo_;
+	// True if the input is a velocity, false if it is a target frame
+	bool servoVelocityInput_;
+	Frame servoTarget_;
+	Frame servoVelocity_;
+	// Last Axis commanded and its joint velocity, in deg/s
+	Axis servoAxis_;
+	double servoJointVelocity_[6];
+	// Host time of the last input and of the last step
+	double servoLastInput_;
+	double servoLastTick_;
+	// True if commands were sent since the last stop
+	bool servoMoving_;
+	double servoMaxVelocity_;
+	double servoMaxAcceleration_;
+	double servoTimeout_;
+	int servoDepth_;
+	// Joint states of the feedbacks, published on /joint_states by a
+	// thread of its own
+	JointStatePublisher jointState_;
 
 	int lastStamp_;
 	bool MotionComplete_;
 	int delayCounter_;
+	// Host time the last motion was seen complete, before the delay
+	double motionCompleteTime_;
+
+	// Speed of the motions not retimed, see resetPTPSpeed
+	float ptpVelocity_;
+	float ptpAcceleration_;
+	// True if the speed sent may differ from ptpVelocity_, ptpAcceleration_
+	bool ptpSpeedRetimed_;
+	// True once setPTPSpeed has sent a retimed speed
+	bool ptpSpeedEverRetimed_;
+	// Time predicted for the retimed motions since they started, 0 if none
+	double ptpPredictedDuration_;
+	double ptpRetimedStart_;
 
 	double motion_complete_delay_;
+	// Crash-safe journal of CommandList
+	//  - file name from ROS parameter "~command_journal",
+	//      default: $HOME/.ros/kuka_command_journal
+	CommandJournal journal_;
+	// File the trace is exported to when a series of motion completes
+	//  - empty if ROS parameter "~command_trace" is not set
+	std::string traceFile_;
+	// Writing of the last exported trace
+	QFuture<bool> traceExport_;
 	//QThread *tcpThread_;
 	// thread for ros spinning
 	ROSThread rosThread_;
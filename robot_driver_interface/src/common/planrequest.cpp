@@ -0,0 +1,154 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ */
+
+#include "planrequest.h"
+
+#include <QAtomicInt>
+#include <QMutexLocker>
+
+// Identifier of the next request
+static QAtomicInt nextPlanRequestId(1);
+
+PlanRequest::PlanRequest(const std::map<std::string, double>& target_joints,
+		double deadline) :
+		jointGoal_(true), targetJoints_(target_joints) {
+	init(deadline);
+}
+
+PlanRequest::PlanRequest(const geometry_msgs::Pose& target_pose,
+		const std::string& end_effector_link, double deadline) :
+		jointGoal_(false), targetPose_(target_pose), endEffectorLink_(
+				end_effector_link) {
+	init(deadline);
+}
+
+void PlanRequest::init(double deadline) {
+	id_ = nextPlanRequestId.fetchAndAddRelaxed(1);
+	cartesian_ = false;
+	if (deadline > 0.0)
+		deadline_ = ros::WallTime::now() + ros::WallDuration(deadline);
+	cancelled_ = false;
+	status_ = Queued;
+}
+
+void PlanRequest::setStartAfter(MotionPlanPtr motion_plan) {
+	startAfterPlan_ = motion_plan;
+}
+
+void PlanRequest::setCartesian(bool cartesian) {
+	cartesian_ = cartesian;
+}
+
+int PlanRequest::getId() const {
+	return id_;
+}
+
+bool PlanRequest::isJointGoal() const {
+	return jointGoal_;
+}
+
+bool PlanRequest::isCartesian() const {
+	return cartesian_;
+}
+
+const std::map<std::string, double>& PlanRequest::getTargetJoints() const {
+	return targetJoints_;
+}
+
+const geometry_msgs::Pose& PlanRequest::getTargetPose() const {
+	return targetPose_;
+}
+
+const std::string& PlanRequest::getEndEffectorLink() const {
+	return endEffectorLink_;
+}
+
+MotionPlanPtr PlanRequest::getStartAfter() const {
+	return startAfterPlan_;
+}
+
+PlanRequest::Status PlanRequest::getStatus() {
+	QMutexLocker locker(&mutex_);
+	return status_;
+}
+
+bool PlanRequest::isFinished() {
+	QMutexLocker locker(&mutex_);
+	return status_ != Queued && status_ != Running;
+}
+
+MotionPlanPtr PlanRequest::getMotionPlan() {
+	QMutexLocker locker(&mutex_);
+	return motionPlan_;
+}
+
+double PlanRequest::getRemainingTime() const {
+	if (deadline_.isZero())
+		return 0.0;
+	return (deadline_ - ros::WallTime::now()).toSec();
+}
+
+bool PlanRequest::isOverdue() const {
+	return !deadline_.isZero() && ros::WallTime::now() > deadline_;
+}
+
+void PlanRequest::cancel() {
+	cancelled_ = true;
+}
+
+bool PlanRequest::isCancelled() const {
+	return cancelled_;
+}
+
+const volatile bool* PlanRequest::getCancelFlag() const {
+	return &cancelled_;
+}
+
+bool PlanRequest::wait(unsigned long time) {
+	QMutexLocker locker(&mutex_);
+	while (status_ == Queued || status_ == Running)
+		if (!finished_.wait(&mutex_, time))
+			return false;
+	return true;
+}
+
+bool PlanRequest::start() {
+	QMutexLocker locker(&mutex_);
+	if (cancelled_)
+		return false;
+	status_ = Running;
+	return true;
+}
+
+void PlanRequest::finish(Status status, MotionPlanPtr motion_plan) {
+	QMutexLocker locker(&mutex_);
+	status_ = status;
+	if (status == Succeeded)
+		motionPlan_ = motion_plan;
+	finished_.wakeAll();
+}
+
+const char* PlanRequest::getStatusName(Status status) {
+	switch (status) {
+	case Queued:
+		return "QUEUED";
+	case Running:
+		return "RUNNING";
+	case Succeeded:
+		return "SUCCEEDED";
+	case Failed:
+		return "FAILED";
+	case Cancelled:
+		return "CANCELLED";
+	case TimedOut:
+		return "TIMED OUT";
+	}
+	return "UNKNOWN";
+}
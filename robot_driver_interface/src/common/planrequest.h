@@ -0,0 +1,132 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Header file for PlanRequest, the handle of an asynchronous motion plan
+ *   of Controller. Controller::planAsync returns a PlanHandle immediately,
+ *   the plan is made on the planning thread of Controller and the handle
+ *   is delivered by signal Controller::planFinished when it is done.
+ *   The handle works as a future:
+ *       - getStatus / isFinished : poll
+ *       - wait                   : block until finished or a timeout
+ *       - cancel                 : a queued request is never planned, a
+ *                                  running one is terminated if the
+ *                                  planner supports it (portfolio), its
+ *                                  result is discarded otherwise
+ *   A deadline (in seconds from construction, 0 for none) covers queueing
+ *   and planning, the planner is given the time left.
+ *
+ *   Status:
+ *       Queued -> Running -> Succeeded | Failed | Cancelled | TimedOut
+ *
+ */
+
+#ifndef MY_PLANREQUEST_H
+#define MY_PLANREQUEST_H
+
+#include <climits>
+#include <map>
+#include <string>
+#include <boost/shared_ptr.hpp>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <ros/ros.h>
+#include <moveit/move_group_interface/move_group.h>
+#include <geometry_msgs/Pose.h>
+
+#include "motionplan.h"
+
+// --------------------------------------------------------------------------
+// PlanRequest class
+// --------------------------------------------------------------------------
+class PlanRequest {
+public:
+	enum Status {
+		Queued, Running, Succeeded, Failed, Cancelled, TimedOut
+	};
+
+	// Joint goal, deadline in seconds from now, 0 for none
+	PlanRequest(const std::map<std::string, double>& target_joints,
+			double deadline = 0.0);
+	// Pose goal of end_effector_link, deadline in seconds from now, 0 for
+	// none
+	PlanRequest(const geometry_msgs::Pose& target_pose,
+			const std::string& end_effector_link, double deadline = 0.0);
+
+	// Plan from the last point of motion_plan instead of the current state,
+	// e.g. the motion being executed, NULL for the current state
+	void setStartAfter(MotionPlanPtr motion_plan);
+	// Follow a straight line to the pose goal, see CartesianPlanner
+	void setCartesian(bool cartesian);
+
+	// Get methods: goal and start
+	int getId() const;
+	bool isJointGoal() const;
+	bool isCartesian() const;
+	const std::map<std::string, double>& getTargetJoints() const;
+	const geometry_msgs::Pose& getTargetPose() const;
+	const std::string& getEndEffectorLink() const;
+	// NULL if planned from the current state
+	MotionPlanPtr getStartAfter() const;
+
+	// Get method: status_
+	Status getStatus();
+	// True if status is neither Queued nor Running
+	bool isFinished();
+	// The plan, NULL unless status is Succeeded
+	MotionPlanPtr getMotionPlan();
+
+	// Seconds left until deadline, negative if passed, 0 if none
+	double getRemainingTime() const;
+	// True if a deadline is set and passed
+	bool isOverdue() const;
+
+	// Ask to cancel the request
+	void cancel();
+	bool isCancelled() const;
+	// Cancel flag polled by planners that can be terminated
+	const volatile bool* getCancelFlag() const;
+
+	// Wait until the request is finished, or time ms
+	// if return false, time passed before it is finished
+	bool wait(unsigned long time = ULONG_MAX);
+
+	// Used by the planning thread of Controller
+	// Queued -> Running, if return false, the request is cancelled and
+	// should not be planned
+	bool start();
+	// Running -> status, motion_plan is the result if status is Succeeded
+	void finish(Status status, MotionPlanPtr motion_plan);
+
+	// Name of status, for logs
+	static const char* getStatusName(Status status);
+
+private:
+	void init(double deadline);
+
+	int id_;
+	bool jointGoal_;
+	std::map<std::string, double> targetJoints_;
+	geometry_msgs::Pose targetPose_;
+	std::string endEffectorLink_;
+	bool cartesian_;
+	MotionPlanPtr startAfterPlan_;
+	// zero if no deadline
+	ros::WallTime deadline_;
+	volatile bool cancelled_;
+
+	QMutex mutex_;
+	QWaitCondition finished_;
+	Status status_;
+	MotionPlanPtr motionPlan_;
+};
+
+typedef boost::shared_ptr<PlanRequest> PlanHandle;
+
+#endif
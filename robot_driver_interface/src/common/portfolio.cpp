@@ -0,0 +1,307 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ */
+
+#include "portfolio.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <QFuture>
+#include <QList>
+#include <QMutexLocker>
+#include <QThread>
+#include <QWaitCondition>
+#include <QtConcurrentRun>
+#include <moveit/trajectory_processing/iterative_time_parameterization.h>
+
+// Interval of terminating the other planners until they return, in seconds
+// a context terminated just before its solve begins would miss it
+#define PORTFOLIO_TERMINATE_INTERVAL 0.01
+// Interval of polling the cancel flag, in ms
+#define PORTFOLIO_CANCEL_INTERVAL 20
+
+PlannerStatistics::PlannerStatistics() :
+		runs(0), successes(0), wins(0), solveTime(0.0) {
+}
+
+// --------------------------------------------------------------------------
+// Data structure: Run
+//  - one call of plan, candidates are written by solve under mutex and read
+//      by plan after all solves returned
+// --------------------------------------------------------------------------
+struct PlannerPortfolio::Run {
+	struct Candidate {
+		std::string planner;
+		planning_interface::PlanningContextPtr context;
+		bool success;
+		double cost;
+		double time;
+		robot_trajectory::RobotTrajectoryPtr trajectory;
+	};
+	std::vector<Candidate> candidates;
+	QMutex mutex;
+	QWaitCondition condition;
+	int finished;
+	int succeeded;
+	// Set when the run is decided, later plans are not counted
+	bool stop;
+};
+
+PlannerPortfolio::PlannerPortfolio(const robot_model::RobotModelConstPtr& model,
+		const std::string& planning_ns) :
+		policy_(FirstValid), deadline_(PORTFOLIO_DEFAULT_DEADLINE) {
+	pipeline_.reset(
+			new planning_pipeline::PlanningPipeline(model,
+					ros::NodeHandle(planning_ns), "planning_plugin",
+					"request_adapters"));
+	if (!pipeline_->getPlannerManager()) {
+		std::cout << "PlannerPortfolio: Failed to load planner plugin of "
+				<< planning_ns << std::endl;
+		pipeline_.reset();
+	}
+	planners_.push_back("RRTConnectkConfigDefault");
+	planners_.push_back("LBKPIECEkConfigDefault");
+	planners_.push_back("BKPIECEkConfigDefault");
+	planners_.push_back("KPIECEkConfigDefault");
+}
+
+bool PlannerPortfolio::isValid() {
+	return pipeline_.get() != NULL;
+}
+
+bool PlannerPortfolio::plan(const planning_scene::PlanningSceneConstPtr& scene,
+		const moveit_msgs::MotionPlanRequest& request, MotionPlan& plan,
+		const volatile bool* cancel) {
+	if (!pipeline_)
+		return false;
+	std::vector<std::string> planners;
+	Policy policy;
+	double deadline;
+	{
+		QMutexLocker locker(&mutex_);
+		planners = planners_;
+		policy = policy_;
+		deadline = deadline_;
+	}
+	if (request.allowed_planning_time > 0.0)
+		deadline = std::min(deadline, request.allowed_planning_time);
+
+	// Contexts are created here, the planner manager is not reentrant
+	Run run;
+	run.finished = run.succeeded = 0;
+	run.stop = false;
+	const planning_interface::PlannerManagerPtr& manager =
+			pipeline_->getPlannerManager();
+	for (size_t i = 0; i < planners.size(); i++) {
+		moveit_msgs::MotionPlanRequest req = request;
+		req.planner_id = planners[i];
+		req.allowed_planning_time = deadline;
+		req.num_planning_attempts = 1;
+		moveit_msgs::MoveItErrorCodes error_code;
+		Run::Candidate candidate;
+		candidate.planner = planners[i];
+		candidate.success = false;
+		candidate.cost = candidate.time = 0.0;
+		candidate.context = manager->getPlanningContext(scene, req,
+				error_code);
+		if (!candidate.context) {
+			std::cout << "PlannerPortfolio::plan: No context for "
+					<< planners[i] << std::endl;
+			continue;
+		}
+		run.candidates.push_back(candidate);
+	}
+	int n = run.candidates.size();
+	if (n == 0)
+		return false;
+
+	ros::WallTime begin = ros::WallTime::now();
+	QList<QFuture<void> > futures;
+	for (int i = 0; i < n; i++)
+		futures.append(QtConcurrent::run(&PlannerPortfolio::solve, &run, i));
+	{
+		QMutexLocker locker(&run.mutex);
+		while (run.finished < n
+				&& !(policy == FirstValid && run.succeeded > 0)
+				&& !(cancel != NULL && *cancel))
+			run.condition.wait(&run.mutex, PORTFOLIO_CANCEL_INTERVAL);
+		run.stop = true;
+	}
+	for (int i = 0; i < n; i++)
+		while (!futures[i].isFinished()) {
+			run.candidates[i].context->terminate();
+			ros::WallDuration(PORTFOLIO_TERMINATE_INTERVAL).sleep();
+		}
+
+	// Lowest cost of the plans found before the run was decided
+	int best = -1;
+	for (int i = 0; i < n; i++)
+		if (run.candidates[i].success
+				&& (best < 0
+						|| run.candidates[i].cost < run.candidates[best].cost))
+			best = i;
+	{
+		QMutexLocker locker(&mutex_);
+		for (int i = 0; i < n; i++) {
+			PlannerStatistics& statistics =
+					statistics_[run.candidates[i].planner];
+			statistics.runs++;
+			if (run.candidates[i].success) {
+				statistics.successes++;
+				statistics.solveTime += run.candidates[i].time;
+			}
+			if (i == best)
+				statistics.wins++;
+		}
+	}
+	if (cancel != NULL && *cancel) {
+		ROS_INFO("PlannerPortfolio: Cancelled");
+		return false;
+	}
+	if (best < 0) {
+		ROS_INFO("PlannerPortfolio: No plan found by %d planners", n);
+		return false;
+	}
+
+	// Planners return waypoints only
+	robot_trajectory::RobotTrajectory& trajectory =
+			*run.candidates[best].trajectory;
+	trajectory_processing::IterativeParabolicTimeParameterization time_parameterization;
+	time_parameterization.computeTimeStamps(trajectory);
+	plan.start_state_ = request.start_state;
+	trajectory.getRobotTrajectoryMsg(plan.trajectory_);
+	plan.planning_time_ = (ros::WallTime::now() - begin).toSec();
+	ROS_INFO("PlannerPortfolio: %s won, cost %.3f rad, %.3f s",
+			run.candidates[best].planner.c_str(), run.candidates[best].cost,
+			run.candidates[best].time);
+	return true;
+}
+
+void PlannerPortfolio::solve(Run* run, int i) {
+	Run::Candidate& candidate = run->candidates[i];
+	{
+		QMutexLocker locker(&run->mutex);
+		if (run->stop) {
+			run->finished++;
+			run->condition.wakeAll();
+			return;
+		}
+	}
+
+	ros::WallTime begin = ros::WallTime::now();
+	planning_interface::MotionPlanResponse response;
+	bool success = candidate.context->solve(response)
+			&& response.error_code_.val == moveit_msgs::MoveItErrorCodes::SUCCESS
+			&& response.trajectory_;
+	double time = (ros::WallTime::now() - begin).toSec();
+	double cost = success ? trajectoryCost(*response.trajectory_) : 0.0;
+
+	QMutexLocker locker(&run->mutex);
+	if (success && !run->stop) {
+		candidate.success = true;
+		candidate.cost = cost;
+		candidate.time = time;
+		candidate.trajectory = response.trajectory_;
+		run->succeeded++;
+	}
+	run->finished++;
+	run->condition.wakeAll();
+}
+
+double PlannerPortfolio::trajectoryCost(
+		const robot_trajectory::RobotTrajectory& trajectory) {
+	const robot_model::JointModelGroup* group = trajectory.getGroup();
+	if (group == NULL)
+		return 0.0;
+	double travel = 0.0;
+	double length = 0.0;
+	std::vector<double> previous, current;
+	for (size_t i = 0; i < trajectory.getWayPointCount(); i++) {
+		trajectory.getWayPoint(i).copyJointGroupPositions(group, current);
+		if (i > 0) {
+			double squared = 0.0;
+			for (size_t k = 0; k < current.size(); k++) {
+				double dq = fabs(current[k] - previous[k]);
+				travel += dq;
+				squared += dq * dq;
+			}
+			length += sqrt(squared);
+		}
+		previous.swap(current);
+	}
+	return travel + length;
+}
+
+// --------------------------------------------------------------------------
+// Settings and statistics
+// --------------------------------------------------------------------------
+void PlannerPortfolio::setPlanners(const std::vector<std::string>& planners) {
+	if ((int) planners.size() > QThread::idealThreadCount())
+		ROS_WARN(
+				"PlannerPortfolio: %d planners on %d cores, some of them wait",
+				(int) planners.size(), QThread::idealThreadCount());
+	QMutexLocker locker(&mutex_);
+	planners_ = planners;
+}
+
+std::vector<std::string> PlannerPortfolio::getPlanners() {
+	QMutexLocker locker(&mutex_);
+	return planners_;
+}
+
+void PlannerPortfolio::setPolicy(Policy policy) {
+	QMutexLocker locker(&mutex_);
+	policy_ = policy;
+}
+
+PlannerPortfolio::Policy PlannerPortfolio::getPolicy() {
+	QMutexLocker locker(&mutex_);
+	return policy_;
+}
+
+bool PlannerPortfolio::setDeadline(double deadline) {
+	if (deadline <= 0.0) {
+		std::cout << "PlannerPortfolio::setDeadline: Deadline should be positive"
+				<< std::endl;
+		return false;
+	}
+	QMutexLocker locker(&mutex_);
+	deadline_ = deadline;
+	return true;
+}
+
+double PlannerPortfolio::getDeadline() {
+	QMutexLocker locker(&mutex_);
+	return deadline_;
+}
+
+PlannerStatistics PlannerPortfolio::getStatistics(const std::string& planner) {
+	QMutexLocker locker(&mutex_);
+	std::map<std::string, PlannerStatistics>::iterator it = statistics_.find(
+			planner);
+	return it == statistics_.end() ? PlannerStatistics() : it->second;
+}
+
+void PlannerPortfolio::resetStatistics() {
+	QMutexLocker locker(&mutex_);
+	statistics_.clear();
+}
+
+void PlannerPortfolio::report() {
+	QMutexLocker locker(&mutex_);
+	for (std::map<std::string, PlannerStatistics>::iterator it =
+			statistics_.begin(); it != statistics_.end(); ++it) {
+		const PlannerStatistics& s = it->second;
+		ROS_INFO(
+				"PlannerPortfolio: %s: %lu wins, %lu successes, %lu runs, mean solve %.3f s",
+				it->first.c_str(), s.wins, s.successes, s.runs,
+				s.successes == 0 ? 0.0 : s.solveTime / s.successes);
+	}
+}
@@ -0,0 +1,141 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Header file for PlannerPortfolio, used by Controller to run several
+ *   OMPL planners of ompl_planning.yaml concurrently on the same request.
+ *   move_group serves one planning goal at a time, so the planners are run
+ *   in this process: the planner plugin of move_group is loaded through
+ *   its planning pipeline parameters, one PlanningContext is created per
+ *   planner on a snapshot of the planning scene, and the contexts are
+ *   solved on the global QThreadPool, i.e. on separate cores up to
+ *   QThread::idealThreadCount().
+ *   Policies:
+ *       - FirstValid     : first successful plan is taken, other planners
+ *                          are terminated
+ *       - BestAtDeadline : all planners run until they finish or the
+ *                          deadline, the plan of lowest cost is taken
+ *   Cost of a plan is its joint travel (sum of |dq| of every axis, as
+ *   checked by Interface::PlanAndExecuteTargetMotion) plus its path length
+ *   in joint space (sum of |dq|_2), in rad.
+ *   Every run updates per-planner statistics (runs, successes, wins, time),
+ *   logged by report to tune the portfolio.
+ *
+ */
+
+#ifndef MY_PORTFOLIO_H
+#define MY_PORTFOLIO_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <QMutex>
+
+#include <moveit/move_group_interface/move_group.h>
+#include <moveit/planning_pipeline/planning_pipeline.h>
+#include <moveit/planning_scene/planning_scene.h>
+#include <moveit/robot_trajectory/robot_trajectory.h>
+
+// Default deadline of a run, in seconds
+#define PORTFOLIO_DEFAULT_DEADLINE 5.0
+
+// --------------------------------------------------------------------------
+// Data structure: PlannerStatistics
+//  - counters of one planner since construction or resetStatistics
+// --------------------------------------------------------------------------
+struct PlannerStatistics {
+	PlannerStatistics();
+	// Runs the planner took part in
+	unsigned long runs;
+	// Runs the planner found a valid plan before being terminated
+	unsigned long successes;
+	// Runs the plan of the planner was taken
+	unsigned long wins;
+	// Total time of successful solves, in seconds
+	double solveTime;
+};
+
+// --------------------------------------------------------------------------
+// PlannerPortfolio class
+// --------------------------------------------------------------------------
+class PlannerPortfolio {
+public:
+	typedef moveit::planning_interface::MoveGroup::Plan MotionPlan;
+
+	enum Policy {
+		FirstValid, BestAtDeadline
+	};
+
+	// Load the planner plugin of move_group
+	//  - model is the robot model of the planning scene
+	//  - planning_ns is the namespace of planning_plugin and planner
+	//      configs, "/move_group" for move_group.launch
+	PlannerPortfolio(const robot_model::RobotModelConstPtr& model,
+			const std::string& planning_ns = "/move_group");
+
+	// True if the planner plugin is loaded
+	bool isValid();
+
+	// Plan request on scene with all planners of the portfolio
+	//  - the run ends at the deadline, or at allowed_planning_time of
+	//      request if it is positive and shorter
+	//  - if cancel is not NULL, all planners are terminated as soon as
+	//      *cancel is true
+	// the winning plan is time parameterized and copied to plan
+	// if return false, no planner found a plan before the deadline
+	bool plan(const planning_scene::PlanningSceneConstPtr& scene,
+			const moveit_msgs::MotionPlanRequest& request, MotionPlan& plan,
+			const volatile bool* cancel = NULL);
+
+	// Set method: planner configs of ompl_planning.yaml to run
+	void setPlanners(const std::vector<std::string>& planners);
+	// Get method: planners_
+	std::vector<std::string> getPlanners();
+
+	// Set method: policy_
+	void setPolicy(Policy policy);
+	// Get method: policy_
+	Policy getPolicy();
+
+	// Set method: deadline_, in seconds
+	// if return false, deadline is not positive and nothing is changed
+	bool setDeadline(double deadline);
+	// Get method: deadline_
+	double getDeadline();
+
+	// Get method: statistics of planner, zero if it never ran
+	PlannerStatistics getStatistics(const std::string& planner);
+
+	// Set all statistics to zero
+	void resetStatistics();
+
+	// Print statistics of every planner by ROS_INFO
+	void report();
+
+	// Cost of trajectory, see header
+	static double trajectoryCost(
+			const robot_trajectory::RobotTrajectory& trajectory);
+
+private:
+	struct Run;
+
+	// Solve candidate i of run, on a thread of the pool
+	static void solve(Run* run, int i);
+
+	planning_pipeline::PlanningPipelinePtr pipeline_;
+
+	// Guards settings and statistics, plan itself may run concurrently
+	QMutex mutex_;
+	std::vector<std::string> planners_;
+	Policy policy_;
+	double deadline_;
+	std::map<std::string, PlannerStatistics> statistics_;
+};
+
+#endif
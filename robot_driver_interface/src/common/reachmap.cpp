@@ -0,0 +1,259 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ */
+
+#include "reachmap.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Number of samples to find the bounds of workspace
+#define REACHMAP_BOUND_SAMPLES 100000
+
+ReachabilityMap::ReachabilityMap() :
+		fd_(-1), data_(NULL), size_(0), header_(NULL), cells_(NULL) {
+}
+
+ReachabilityMap::~ReachabilityMap() {
+	unload();
+}
+
+bool ReachabilityMap::load(const std::string& filename, uint64_t urdf_hash) {
+	unload();
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		std::cout << "ReachabilityMap::load: Cannot open " << filename
+				<< std::endl;
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0
+			|| (size_t) st.st_size < sizeof(ReachabilityMapHeader)) {
+		std::cout << "ReachabilityMap::load: File too small" << std::endl;
+		close(fd);
+		return false;
+	}
+	void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		std::cout << "ReachabilityMap::load: mmap failed" << std::endl;
+		close(fd);
+		return false;
+	}
+
+	const ReachabilityMapHeader* header =
+			(const ReachabilityMapHeader*) data;
+	uint64_t cells = (uint64_t) header->nx * header->ny * header->nz
+			* header->polarBins * header->azimuthBins;
+	const char* error = NULL;
+	if (memcmp(header->magic, REACHMAP_MAGIC, 8) != 0
+			|| header->version != REACHMAP_VERSION)
+		error = "Not a map file of this version";
+	else if ((uint64_t) st.st_size != sizeof(ReachabilityMapHeader) + cells)
+		error = "File size does not match header";
+	else if (header->urdfHash != urdf_hash)
+		error = "Map of another URDF, regenerate it";
+	if (error != NULL) {
+		std::cout << "ReachabilityMap::load: " << error << std::endl;
+		munmap(data, st.st_size);
+		close(fd);
+		return false;
+	}
+
+	fd_ = fd;
+	data_ = data;
+	size_ = st.st_size;
+	header_ = header;
+	cells_ = (const unsigned char*) data + sizeof(ReachabilityMapHeader);
+	std::cout << "ReachabilityMap::load: " << header->nx << " x " << header->ny
+			<< " x " << header->nz << " voxels of " << header->voxel
+			<< " mm, " << header->polarBins * header->azimuthBins
+			<< " directions" << std::endl;
+	return true;
+}
+
+void ReachabilityMap::unload() {
+	if (data_ != NULL)
+		munmap(data_, size_);
+	if (fd_ >= 0)
+		close(fd_);
+	fd_ = -1;
+	data_ = NULL;
+	size_ = 0;
+	header_ = NULL;
+	cells_ = NULL;
+}
+
+bool ReachabilityMap::isLoaded() const {
+	return header_ != NULL;
+}
+
+const ReachabilityMapHeader* ReachabilityMap::getHeader() const {
+	return header_;
+}
+
+bool ReachabilityMap::cellIndex(const ReachabilityMapHeader& header, Frame &f,
+		uint64_t& index) {
+	long ix = (long) floor((f.X - header.origin[0]) / header.voxel);
+	long iy = (long) floor((f.Y - header.origin[1]) / header.voxel);
+	long iz = (long) floor((f.Z - header.origin[2]) / header.voxel);
+	if (ix < 0 || iy < 0 || iz < 0 || ix >= (long) header.nx
+			|| iy >= (long) header.ny || iz >= (long) header.nz)
+		return false;
+
+	// Approach direction: z axis of Rz(A) * Ry(B) * Rx(C)
+	double a = f.A / 180.0 * M_PI;
+	double b = f.B / 180.0 * M_PI;
+	double c = f.C / 180.0 * M_PI;
+	double zx = cos(a) * sin(b) * cos(c) + sin(a) * sin(c);
+	double zy = sin(a) * sin(b) * cos(c) - cos(a) * sin(c);
+	double zz = cos(b) * cos(c);
+	double polar = acos(std::max(-1.0, std::min(1.0, zz)));
+	double azimuth = atan2(zy, zx) + M_PI;
+	long ip = std::min((long) (polar / M_PI * header.polarBins),
+			(long) header.polarBins - 1);
+	long ia = std::min((long) (azimuth / (2.0 * M_PI) * header.azimuthBins),
+			(long) header.azimuthBins - 1);
+
+	index = ((((uint64_t) iz * header.ny + iy) * header.nx + ix)
+			* header.polarBins + ip) * header.azimuthBins + ia;
+	return true;
+}
+
+int ReachabilityMap::getDexterity(Frame &f) const {
+	uint64_t index;
+	if (header_ == NULL || !cellIndex(*header_, f, index))
+		return -1;
+	return cells_[index];
+}
+
+double ReachabilityMap::getManipulability(Frame &f) const {
+	int dexterity = getDexterity(f);
+	if (dexterity <= 0)
+		return 0.0;
+	return dexterity / 255.0 * header_->maxManipulability;
+}
+
+bool ReachabilityMap::isUnreachable(Frame &f) const {
+	uint64_t index;
+	if (header_ == NULL)
+		return false;
+	// A voxel never reached is unknown, left to inverse kinematics
+	return !cellIndex(*header_, f, index);
+}
+
+bool ReachabilityMap::generate(Model& model, const std::string& filename,
+		double voxel, uint64_t samples, int polar_bins, int azimuth_bins) {
+	if (voxel <= 0.0 || polar_bins <= 0 || azimuth_bins <= 0) {
+		std::cout << "ReachabilityMap::generate: Resolution should be positive"
+				<< std::endl;
+		return false;
+	}
+	const float lower[6] = { A1_LOWER, A2_LOWER, A3_LOWER, A4_LOWER, A5_LOWER,
+			A6_LOWER };
+	const float upper[6] = { A1_UPPER, A2_UPPER, A3_UPPER, A4_UPPER, A5_UPPER,
+			A6_UPPER };
+
+	// Same samples for the same arguments
+	srand(1);
+
+	// Bounds of workspace, padded by one voxel
+	ReachabilityMapHeader header;
+	memset(&header, 0, sizeof(header));
+	double low[3] = { 1e9, 1e9, 1e9 }, high[3] = { -1e9, -1e9, -1e9 };
+	for (int n = 0; n < REACHMAP_BOUND_SAMPLES; n++) {
+		float v[6];
+		for (int i = 0; i < 6; i++)
+			v[i] = lower[i] + (upper[i] - lower[i]) * rand() / (float) RAND_MAX;
+		Axis a(v[0], v[1], v[2], v[3], v[4], v[5]);
+		Frame f;
+		if (!model.Axis2Frame(a, f)) {
+			std::cout << "ReachabilityMap::generate: Failed, model invalid"
+					<< std::endl;
+			return false;
+		}
+		double p[3] = { f.X, f.Y, f.Z };
+		for (int i = 0; i < 3; i++) {
+			low[i] = std::min(low[i], p[i]);
+			high[i] = std::max(high[i], p[i]);
+		}
+	}
+	memcpy(header.magic, REACHMAP_MAGIC, 8);
+	header.version = REACHMAP_VERSION;
+	uint32_t* n[3] = { &header.nx, &header.ny, &header.nz };
+	for (int i = 0; i < 3; i++) {
+		header.origin[i] = low[i] - voxel;
+		*n[i] = (uint32_t) ceil((high[i] - low[i]) / voxel) + 2;
+	}
+	header.polarBins = polar_bins;
+	header.azimuthBins = azimuth_bins;
+	header.voxel = voxel;
+	header.urdfHash = model.getURDFHash();
+	header.samples = samples;
+	uint64_t cells = (uint64_t) header.nx * header.ny * header.nz * polar_bins
+			* azimuth_bins;
+	std::cout << "ReachabilityMap::generate: " << header.nx << " x "
+			<< header.ny << " x " << header.nz << " voxels, " << cells
+			<< " cells, " << samples << " samples" << std::endl;
+
+	// Best manipulability of each cell
+	std::vector<float> best(cells, 0.0f);
+	Eigen::Matrix<double, 6, 6> J;
+	for (uint64_t s = 0; s < samples; s++) {
+		float v[6];
+		for (int i = 0; i < 6; i++)
+			v[i] = lower[i] + (upper[i] - lower[i]) * rand() / (float) RAND_MAX;
+		Axis a(v[0], v[1], v[2], v[3], v[4], v[5]);
+		Frame f;
+		uint64_t index;
+		if (!model.jacobian(a, J, f) || !cellIndex(header, f, index))
+			continue;
+		// Reachable cells are never 0, even at singularities
+		float m = (float) sqrt(std::max(0.0, (J * J.transpose()).determinant()))
+				+ 1e-12f;
+		if (m > best[index])
+			best[index] = m;
+		if (m > header.maxManipulability)
+			header.maxManipulability = m;
+		if ((s + 1) % (samples / 10 + 1) == 0)
+			std::cout << "ReachabilityMap::generate: " << s + 1 << " samples"
+					<< std::endl;
+	}
+
+	// Quantize and write
+	std::vector<unsigned char> data(cells, 0);
+	uint64_t reachable = 0;
+	for (uint64_t i = 0; i < cells; i++)
+		if (best[i] > 0.0f) {
+			data[i] = (unsigned char) std::max(1.0,
+					ceil(best[i] / header.maxManipulability * 255.0));
+			reachable++;
+		}
+	FILE* fp = fopen(filename.c_str(), "wb");
+	if (fp == NULL) {
+		std::cout << "ReachabilityMap::generate: Cannot open " << filename
+				<< std::endl;
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1
+			&& fwrite(&data[0], 1, cells, fp) == cells;
+	ok = (fclose(fp) == 0) && ok;
+	if (!ok) {
+		std::cout << "ReachabilityMap::generate: Failed to write " << filename
+				<< std::endl;
+		return false;
+	}
+	std::cout << "ReachabilityMap::generate: " << reachable
+			<< " reachable cells written to " << filename << std::endl;
+	return true;
+}
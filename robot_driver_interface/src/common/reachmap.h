@@ -0,0 +1,132 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Header file for ReachabilityMap, a precomputed map of the workspace of
+ *   the robot, for O(1) reachability and dexterity queries of Frame.
+ *   Workspace is divided into cubic voxels of tip position, and the approach
+ *   direction (z axis of tip) into polar x azimuth bins. Rotation about the
+ *   approach direction is not binned, A6 covers it.
+ *   Each cell (voxel, bin) holds one byte:
+ *       - 0      : never reached by sampling, unknown
+ *       - 1..255 : reachable, best manipulability sqrt(det(J * J^T)) found
+ *                  in the cell, scaled to the maximum of the whole map
+ *   A cell of 0 may still be reachable, sampling is random and reaches the
+ *   voxels on the boundary of the workspace rarely. Only a position outside
+ *   the map, whose bounds are padded by one voxel, is taken as unreachable.
+ *   The map is generated offline by random sampling of joint space, see
+ *   generate and the reachability_map tool, and written to a binary file
+ *   which is memory-mapped read-only by load.
+ *   The file records a hash of the URDF it is generated from, load refuses
+ *   a map of another URDF, regenerate it whenever the tool changes:
+ *       rosrun robot_driver_interface reachability_map <urdf> <map file>
+ *
+ */
+
+#ifndef MY_REACHMAP_H
+#define MY_REACHMAP_H
+
+#include <string>
+#include <stdint.h>
+
+#include "geometry.h"
+
+// Format of map file
+#define REACHMAP_MAGIC "KR6REACH"
+#define REACHMAP_VERSION 1
+
+// Default resolution and number of joint space samples
+#define REACHMAP_DEFAULT_VOXEL 40.0
+#define REACHMAP_DEFAULT_POLAR_BINS 6
+#define REACHMAP_DEFAULT_AZIMUTH_BINS 12
+#define REACHMAP_DEFAULT_SAMPLES 20000000
+
+// --------------------------------------------------------------------------
+// Data structure: ReachabilityMapHeader
+//  - at the beginning of map file, followed by cells
+//  - cell of voxel (ix, iy, iz) and bin (ip, ia) is at
+//      (((iz * ny + iy) * nx + ix) * polarBins + ip) * azimuthBins + ia
+// --------------------------------------------------------------------------
+struct ReachabilityMapHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t nx, ny, nz;
+	uint32_t polarBins, azimuthBins;
+	// corner of voxel (0, 0, 0) and edge of voxel, in mm
+	double origin[3];
+	double voxel;
+	// manipulability of cell value 255
+	double maxManipulability;
+	// hash of URDF text, see hashURDF
+	uint64_t urdfHash;
+	uint64_t samples;
+};
+
+// --------------------------------------------------------------------------
+// ReachabilityMap class
+// --------------------------------------------------------------------------
+class ReachabilityMap {
+public:
+	ReachabilityMap();
+
+	// Unmap file if loaded
+	~ReachabilityMap();
+
+	// Memory-map a map file, read-only
+	// if return false, file missing, invalid or of another URDF (urdf_hash),
+	// and nothing is loaded
+	bool load(const std::string& filename, uint64_t urdf_hash);
+
+	// Unmap file
+	void unload();
+
+	// True if a map is loaded
+	bool isLoaded() const;
+
+	// Cell of Frame &f
+	// returns -1 if outside the map or not loaded, 0 if never reached by
+	// sampling, 1..255 if reachable, higher is more dexterous
+	int getDexterity(Frame &f) const;
+
+	// Manipulability of Frame &f, scaled back from getDexterity
+	// 0.0 if never reached, outside the map or not loaded
+	double getManipulability(Frame &f) const;
+
+	// True if the position of Frame &f is known to be unreachable: outside
+	// the map
+	// false if the cell may be reachable, even if never reached, or not
+	// loaded (no information)
+	bool isUnreachable(Frame &f) const;
+
+	// Get method: header of the loaded map, NULL if not loaded
+	const ReachabilityMapHeader* getHeader() const;
+
+	// Sample joint space of model within limits and write a map file
+	//  - workspace bounds are found by a first pass of samples
+	//  - voxel in mm, samples is number of random Axis
+	// if return false, model invalid or file could not be written
+	static bool generate(Model& model, const std::string& filename,
+			double voxel = REACHMAP_DEFAULT_VOXEL, uint64_t samples =
+					REACHMAP_DEFAULT_SAMPLES, int polar_bins =
+					REACHMAP_DEFAULT_POLAR_BINS, int azimuth_bins =
+					REACHMAP_DEFAULT_AZIMUTH_BINS);
+
+private:
+	// Index of cell of Frame &f in a map described by header
+	// if return false, outside the map
+	static bool cellIndex(const ReachabilityMapHeader& header, Frame &f,
+			uint64_t& index);
+
+	int fd_;
+	void* data_;
+	size_t size_;
+	const ReachabilityMapHeader* header_;
+	const unsigned char* cells_;
+};
+
+#endif
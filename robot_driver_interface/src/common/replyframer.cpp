@@ -0,0 +1,145 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ */
+
+#include "replyframer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+static const double latencyBounds[REPLY_LATENCY_BUCKETS] = REPLY_LATENCY_BOUNDS;
+
+ReplyLatency::ReplyLatency() :
+		count(0), min(0.0), max(0.0), sum(0.0) {
+	for (int i = 0; i <= REPLY_LATENCY_BUCKETS; i++)
+		bucket[i] = 0;
+}
+
+void ReplyLatency::add(double ms) {
+	min = count == 0 ? ms : std::min(min, ms);
+	max = count == 0 ? ms : std::max(max, ms);
+	sum += ms;
+	count++;
+	int i = 0;
+	while (i < REPLY_LATENCY_BUCKETS && ms >= latencyBounds[i])
+		i++;
+	bucket[i]++;
+}
+
+double ReplyLatency::percentile(double fraction) const {
+	int below = 0;
+	for (int i = 0; i < REPLY_LATENCY_BUCKETS; i++) {
+		below += bucket[i];
+		if (below >= fraction * count)
+			return latencyBounds[i];
+	}
+	return max;
+}
+
+ReplyFramer::ReplyFramer(char* buffer, int capacity) :
+		buffer_(buffer), capacity_(capacity), length_(0) {
+}
+
+void ReplyFramer::begin(QSerialPort& port, const char* command) {
+	port.clear(QSerialPort::Input);
+	length_ = 0;
+	// Name of the command, up to the parameters or the CRC separator
+	command_ = std::string(command, strcspn(command, " :\r"));
+	sent_ = ros::WallTime::now();
+}
+
+int ReplyFramer::read(QSerialPort& port, int timeout) {
+	ros::WallTime end = ros::WallTime::now()
+			+ ros::WallDuration(timeout / 1000.0);
+	for (;;) {
+		// Read what has arrived, without waiting
+		qint64 n = port.read(buffer_ + length_, capacity_ - 1 - length_);
+		if (n < 0) {
+			ROS_ERROR("ReplyFramer: Reading %s failed", command_.c_str());
+			return -1;
+		}
+		length_ += n;
+
+		int frame = frameLength();
+		if (frame < 0) {
+			ROS_ERROR("ReplyFramer: Reply of %s exceeds %d bytes",
+					command_.c_str(), capacity_ - 1);
+			length_ = 0;
+			return -1;
+		}
+		if (frame > 0) {
+			latency_[command_].add(
+					(ros::WallTime::now() - sent_).toSec() * 1000.0);
+			if (length_ > frame)
+				ROS_WARN("ReplyFramer: %d bytes after the reply of %s dropped",
+						length_ - frame, command_.c_str());
+			buffer_[frame] = '\0';
+			length_ = 0;
+			return frame;
+		}
+
+		int remaining = (int) ((end - ros::WallTime::now()).toSec() * 1000.0);
+		if (remaining <= 0 || !port.waitForReadyRead(remaining))
+			return 0;
+	}
+}
+
+int ReplyFramer::frameLength() {
+	const unsigned char* bytes = (const unsigned char*) buffer_;
+	if (length_ > 0 && bytes[0] == 0xc4) {
+		if (length_ < 2)
+			return 0;
+		if (bytes[1] == 0xa5) {
+			if (length_ < 4)
+				return 0;
+			int total = REPLY_BINARY_HEADER + (bytes[2] | (bytes[3] << 8))
+					+ REPLY_BINARY_CRC;
+			if (total > capacity_ - 1)
+				return -1;
+			return length_ >= total ? total : 0;
+		}
+	}
+	const char* end = (const char*) memchr(buffer_, '\r', length_);
+	if (end != NULL)
+		return end - buffer_ + 1;
+	return length_ >= capacity_ - 1 ? -1 : 0;
+}
+
+// --------------------------------------------------------------------------
+// Latency
+// --------------------------------------------------------------------------
+void ReplyFramer::logLatency() {
+	for (std::map<std::string, ReplyLatency>::iterator it = latency_.begin();
+			it != latency_.end(); ++it) {
+		const ReplyLatency& latency = it->second;
+		std::ostringstream histogram;
+		for (int i = 0; i <= REPLY_LATENCY_BUCKETS; i++) {
+			if (i < REPLY_LATENCY_BUCKETS)
+				histogram << " <" << latencyBounds[i] << ":";
+			else
+				histogram << " >=" << latencyBounds[i - 1] << ":";
+			histogram << latency.bucket[i];
+		}
+		ROS_INFO(
+				"ReplyFramer: %s %d replies, mean %.2f ms, min %.2f ms, max %.2f ms, p50 <= %.0f ms, p99 <= %.0f ms,%s",
+				it->first.c_str(), latency.count, latency.sum / latency.count,
+				latency.min, latency.max, latency.percentile(0.5),
+				latency.percentile(0.99), histogram.str().c_str());
+	}
+}
+
+void ReplyFramer::resetLatency() {
+	latency_.clear();
+}
+
+ReplyLatency ReplyFramer::getLatency(const std::string& command) {
+	std::map<std::string, ReplyLatency>::iterator it = latency_.find(command);
+	return it == latency_.end() ? ReplyLatency() : it->second;
+}
@@ -0,0 +1,104 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Header file for ReplyFramer, the reader of NDI replies used by
+ *   CommandHandling. The serial port is read straight into the reply buffer
+ *   of CommandHandling, and the read returns as soon as the reply is
+ *   complete:
+ *       - a binary reply (BX) starts with A5C4, 0xC4 0xA5 on the wire,
+ *         followed by the length of the body (2 bytes, little endian) and
+ *         the header CRC, the reply is header + body + body CRC
+ *       - any other reply is ASCII and ends with a carriage return
+ *   Bytes received before the command is sent are stale (e.g. RESET after
+ *   a serial break) and are discarded by begin.
+ *   The latency from sending a command to its complete reply is kept in a
+ *   histogram per command (TX, BX, PHSR, ...), logged by logLatency.
+ *
+ */
+
+#ifndef MY_REPLYFRAMER_H
+#define MY_REPLYFRAMER_H
+
+#include <map>
+#include <string>
+#include <QtSerialPort/qserialport.h>
+
+#include <ros/ros.h>
+
+// Binary reply: start sequence, length and CRC of the header, in bytes
+#define REPLY_BINARY_HEADER 6
+// Binary reply: CRC of the body, in bytes
+#define REPLY_BINARY_CRC 2
+// Buckets of the latency histogram: upper bounds in ms, and one more
+// bucket for the slower replies
+#define REPLY_LATENCY_BUCKETS 10
+#define REPLY_LATENCY_BOUNDS { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000 }
+
+// --------------------------------------------------------------------------
+// Data structure: ReplyLatency
+//  - latency histogram of one command, in ms
+// --------------------------------------------------------------------------
+struct ReplyLatency {
+	ReplyLatency();
+	// Add a latency of ms
+	void add(double ms);
+	// Upper bound of the bucket of the percentile (0 to 1), in ms, max if
+	// in the bucket of the slower replies
+	double percentile(double fraction) const;
+
+	int count;
+	double min;
+	double max;
+	double sum;
+	int bucket[REPLY_LATENCY_BUCKETS + 1];
+};
+
+// --------------------------------------------------------------------------
+// ReplyFramer class
+// --------------------------------------------------------------------------
+class ReplyFramer {
+public:
+	// Replies are written to buffer, of capacity bytes including the
+	// terminating '\0'
+	ReplyFramer(char* buffer, int capacity);
+
+	// Called before command is written to port: discard stale bytes and
+	// start the latency of command
+	void begin(QSerialPort& port, const char* command);
+
+	// Read port until the reply is complete, written to the buffer and
+	// terminated by '\0'
+	// return length of the reply, 0 if timeout (in ms), -1 if the reply
+	// does not fit in the buffer or port fails
+	int read(QSerialPort& port, int timeout);
+
+	// Log the latency histograms of all commands
+	void logLatency();
+	// Clear the latency histograms
+	void resetLatency();
+	// Get method: latency histogram of command, empty if never replied
+	ReplyLatency getLatency(const std::string& command);
+
+private:
+	// Length of the complete reply at the front of buffer_
+	// return 0 if incomplete, -1 if it does not fit in the buffer
+	int frameLength();
+
+	char* buffer_;
+	int capacity_;
+	// Bytes received of the current reply
+	int length_;
+
+	// Command and time it was sent
+	std::string command_;
+	ros::WallTime sent_;
+	std::map<std::string, ReplyLatency> latency_;
+};
+
+#endif
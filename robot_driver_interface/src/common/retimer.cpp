@@ -0,0 +1,188 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ */
+
+#include "retimer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+// Segments shorter than this are taken as a repeated waypoint, in rad
+#define RETIMER_MIN_LENGTH 1e-9
+
+RetimeResult::RetimeResult() :
+		originalDuration(0.0), duration(0.0), velocityPercent(0.0), accelerationPercent(
+				0.0) {
+}
+
+TrajectoryRetimer::TrajectoryRetimer() :
+		velocityScale_(RETIMER_DEFAULT_VELOCITY_SCALE), accelerationScale_(
+				RETIMER_DEFAULT_ACCELERATION_SCALE) {
+	const double velocity[6] = { RETIMER_MAX_VELOCITY_A1,
+			RETIMER_MAX_VELOCITY_A2, RETIMER_MAX_VELOCITY_A3,
+			RETIMER_MAX_VELOCITY_A4, RETIMER_MAX_VELOCITY_A5,
+			RETIMER_MAX_VELOCITY_A6 };
+	for (int i = 0; i < 6; i++) {
+		maxVelocity_.push_back(velocity[i] / 180.0 * M_PI);
+		maxAcceleration_.push_back(
+				(i < 3 ? RETIMER_MAX_ACCELERATION_A1_A3 :
+							RETIMER_MAX_ACCELERATION_A4_A6) / 180.0 * M_PI);
+	}
+}
+
+// Duration of a trapezoid profile over length, from speed v0 to v1 with
+// peak speed at most v_max and acceleration a
+static double segmentTime(double length, double v0, double v1, double v_max,
+		double a, double& v_peak) {
+	v_peak = std::min(v_max, sqrt(a * length + 0.5 * (v0 * v0 + v1 * v1)));
+	if (v_peak <= 0.0)
+		return 0.0;
+	double d_accelerate = (v_peak * v_peak - v0 * v0) / (2.0 * a);
+	double d_decelerate = (v_peak * v_peak - v1 * v1) / (2.0 * a);
+	double cruise = std::max(0.0, length - d_accelerate - d_decelerate);
+	return (v_peak - v0) / a + (v_peak - v1) / a + cruise / v_peak;
+}
+
+bool TrajectoryRetimer::retime(trajectory_msgs::JointTrajectory& trajectory,
+		RetimeResult& result) {
+	std::vector<trajectory_msgs::JointTrajectoryPoint>& points =
+			trajectory.points;
+	size_t n = points.size();
+	size_t dof = maxVelocity_.size();
+	if (n < 2)
+		return false;
+	for (size_t i = 0; i < n; i++)
+		if (points[i].positions.size() != dof) {
+			std::cout << "TrajectoryRetimer::retime: Point " << i << " has "
+					<< points[i].positions.size() << " joints, limits are set for "
+					<< dof << std::endl;
+			return false;
+		}
+	result.originalDuration = points.back().time_from_start.toSec();
+
+	// Segment k from point k to k + 1: length, direction and the limits of
+	// path speed and acceleration
+	const double infinity = std::numeric_limits<double>::infinity();
+	std::vector<double> length(n - 1), v_max(n - 1, infinity), a_max(n - 1,
+			infinity);
+	std::vector<std::vector<double> > direction(n - 1,
+			std::vector<double>(dof, 0.0));
+	for (size_t k = 0; k + 1 < n; k++) {
+		double squared = 0.0;
+		for (size_t j = 0; j < dof; j++) {
+			direction[k][j] = points[k + 1].positions[j] - points[k].positions[j];
+			squared += direction[k][j] * direction[k][j];
+		}
+		length[k] = sqrt(squared);
+		if (length[k] < RETIMER_MIN_LENGTH) {
+			length[k] = 0.0;
+			continue;
+		}
+		for (size_t j = 0; j < dof; j++) {
+			direction[k][j] /= length[k];
+			double u = fabs(direction[k][j]);
+			if (u < RETIMER_MIN_LENGTH)
+				continue;
+			v_max[k] = std::min(v_max[k], maxVelocity_[j] * velocityScale_ / u);
+			a_max[k] = std::min(a_max[k],
+					maxAcceleration_[j] * accelerationScale_ / u);
+		}
+	}
+
+	// Speed at each waypoint, at rest at both ends
+	std::vector<double> speed(n, 0.0);
+	for (size_t i = 1; i + 1 < n; i++) {
+		if (length[i - 1] == 0.0 || length[i] == 0.0)
+			continue;
+		double turn = 0.0;
+		for (size_t j = 0; j < dof; j++)
+			turn += direction[i - 1][j] * direction[i][j];
+		speed[i] = std::min(v_max[i - 1], v_max[i]) * std::max(0.0, turn);
+	}
+	for (size_t i = 1; i < n; i++)
+		speed[i] = std::min(speed[i],
+				sqrt(speed[i - 1] * speed[i - 1]
+						+ 2.0 * a_max[i - 1] * length[i - 1]));
+	for (size_t i = n - 1; i-- > 0;)
+		speed[i] = std::min(speed[i],
+				sqrt(speed[i + 1] * speed[i + 1] + 2.0 * a_max[i] * length[i]));
+
+	// Timing and peaks
+	double time = 0.0;
+	double velocity_ratio = 0.0, acceleration_ratio = 0.0;
+	points[0].time_from_start = ros::Duration(0.0);
+	for (size_t k = 0; k + 1 < n; k++) {
+		double v_peak = 0.0;
+		if (length[k] > 0.0)
+			time += segmentTime(length[k], speed[k], speed[k + 1], v_max[k],
+					a_max[k], v_peak);
+		points[k + 1].time_from_start = ros::Duration(time);
+		for (size_t j = 0; j < dof; j++) {
+			double u = fabs(direction[k][j]);
+			velocity_ratio = std::max(velocity_ratio,
+					v_peak * u / maxVelocity_[j]);
+			if (v_peak > std::min(speed[k], speed[k + 1]))
+				acceleration_ratio = std::max(acceleration_ratio,
+						a_max[k] * u / maxAcceleration_[j]);
+		}
+	}
+	for (size_t i = 0; i < n; i++) {
+		points[i].velocities.assign(dof, 0.0);
+		points[i].accelerations.clear();
+		if (i == 0 || i + 1 == n)
+			continue;
+		for (size_t j = 0; j < dof; j++)
+			points[i].velocities[j] = speed[i]
+					* 0.5 * (direction[i - 1][j] + direction[i][j]);
+	}
+
+	result.duration = time;
+	result.velocityPercent = velocity_ratio * 100.0;
+	result.accelerationPercent = acceleration_ratio * 100.0;
+	return true;
+}
+
+// --------------------------------------------------------------------------
+// Settings
+// --------------------------------------------------------------------------
+bool TrajectoryRetimer::setJointLimits(int joint, double max_velocity,
+		double max_acceleration) {
+	if (joint < 0 || joint >= (int) maxVelocity_.size() || max_velocity <= 0.0
+			|| max_acceleration <= 0.0) {
+		std::cout << "TrajectoryRetimer::setJointLimits: Invalid limits of joint "
+				<< joint << std::endl;
+		return false;
+	}
+	maxVelocity_[joint] = max_velocity;
+	maxAcceleration_[joint] = max_acceleration;
+	return true;
+}
+
+bool TrajectoryRetimer::setScales(double velocity_scale,
+		double acceleration_scale) {
+	if (velocity_scale <= 0.0 || velocity_scale > 1.0
+			|| acceleration_scale <= 0.0 || acceleration_scale > 1.0) {
+		std::cout << "TrajectoryRetimer::setScales: Scales should be in (0, 1]"
+				<< std::endl;
+		return false;
+	}
+	velocityScale_ = velocity_scale;
+	accelerationScale_ = acceleration_scale;
+	return true;
+}
+
+double TrajectoryRetimer::getVelocityScale() {
+	return velocityScale_;
+}
+
+double TrajectoryRetimer::getAccelerationScale() {
+	return accelerationScale_;
+}
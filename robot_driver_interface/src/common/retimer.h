@@ -0,0 +1,101 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Header file for TrajectoryRetimer, used by Controller to retime a plan
+ *   before it is executed. Plans of MoveIt are timed by joint_limits.yaml,
+ *   where every joint has max_velocity 1 rad/s and no acceleration limit.
+ *   The retimer keeps the waypoints and finds the fastest timing of the
+ *   piecewise linear path through them under per-joint velocity and
+ *   acceleration limits:
+ *       - each segment gets the largest path speed and acceleration that
+ *         keep every joint within its limits
+ *       - the speed at a waypoint is limited by both segments, and by the
+ *         turn between them: full at a straight junction, zero at a
+ *         reversal, since the robot cannot turn at speed
+ *       - forward and backward passes make the waypoint speeds reachable
+ *         by the segment accelerations, starting and ending at rest
+ *       - each segment is then a trapezoid (or triangle) velocity profile
+ *   This is the time-optimal timing of the path with velocities at the
+ *   waypoints only, the corners are blended by KRC (C_DIS).
+ *   The peak joint velocity and acceleration of the result, in percent of
+ *   the robot maxima, are the $VEL_PTP and $ACC_PTP the plan is streamed
+ *   with.
+ *
+ */
+
+#ifndef MY_RETIMER_H
+#define MY_RETIMER_H
+
+#include <vector>
+#include <trajectory_msgs/JointTrajectory.h>
+
+// Maximum axis speeds of KUKA KR6 R700 sixx (data sheet), in deg/s
+#define RETIMER_MAX_VELOCITY_A1 360.0
+#define RETIMER_MAX_VELOCITY_A2 300.0
+#define RETIMER_MAX_VELOCITY_A3 360.0
+#define RETIMER_MAX_VELOCITY_A4 381.0
+#define RETIMER_MAX_VELOCITY_A5 388.0
+#define RETIMER_MAX_VELOCITY_A6 615.0
+// Axis accelerations are not in the data sheet, conservative values for
+// $ACC_PTP 100%, in deg/s^2
+#define RETIMER_MAX_ACCELERATION_A1_A3 500.0
+#define RETIMER_MAX_ACCELERATION_A4_A6 1000.0
+// Fraction of the maxima used by default
+#define RETIMER_DEFAULT_VELOCITY_SCALE 0.3
+#define RETIMER_DEFAULT_ACCELERATION_SCALE 0.3
+
+// --------------------------------------------------------------------------
+// Data structure: RetimeResult
+//  - outcome of one TrajectoryRetimer::retime
+// --------------------------------------------------------------------------
+struct RetimeResult {
+	RetimeResult();
+	// Duration before and after, in seconds
+	double originalDuration;
+	double duration;
+	// Peak joint velocity and acceleration, in percent of the maxima
+	double velocityPercent;
+	double accelerationPercent;
+};
+
+// --------------------------------------------------------------------------
+// TrajectoryRetimer class
+// --------------------------------------------------------------------------
+class TrajectoryRetimer {
+public:
+	// Limits of KR6 R700 sixx, scaled by the default scales
+	TrajectoryRetimer();
+
+	// Retime trajectory in place, see header
+	//  - time_from_start and velocities are replaced, accelerations cleared
+	// if return false, trajectory has no joint limits set or fewer than two
+	// points, and is not changed
+	bool retime(trajectory_msgs::JointTrajectory& trajectory,
+			RetimeResult& result);
+
+	// Set method: robot maxima of joint (0 to 5), in rad/s and rad/s^2
+	// if return false, joint or limits invalid and nothing is changed
+	bool setJointLimits(int joint, double max_velocity,
+			double max_acceleration);
+	// Set method: fractions of the maxima used, in (0, 1]
+	// if return false, a scale is out of range and nothing is changed
+	bool setScales(double velocity_scale, double acceleration_scale);
+	// Get methods: velocityScale_, accelerationScale_
+	double getVelocityScale();
+	double getAccelerationScale();
+
+private:
+	// Robot maxima, in rad/s and rad/s^2
+	std::vector<double> maxVelocity_;
+	std::vector<double> maxAcceleration_;
+	double velocityScale_;
+	double accelerationScale_;
+};
+
+#endif
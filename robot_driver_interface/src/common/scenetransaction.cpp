@@ -0,0 +1,295 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ */
+
+#include "scenetransaction.h"
+
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <set>
+#include <Eigen/Geometry>
+#include <moveit_msgs/GetPlanningScene.h>
+#include <urdf/model.h>
+
+SceneTransaction::SceneTransaction(const std::string& frame_id) :
+		frameId_(frame_id) {
+	diff_.is_diff = true;
+}
+
+void SceneTransaction::add(const std::string& collision_id,
+		const shape_msgs::SolidPrimitive& shape,
+		const geometry_msgs::Pose& pose) {
+	moveit_msgs::CollisionObject object;
+	object.id = collision_id;
+	object.primitives.push_back(shape);
+	object.primitive_poses.push_back(pose);
+	add(object);
+}
+
+void SceneTransaction::add(const moveit_msgs::CollisionObject& object) {
+	diff_.world.collision_objects.push_back(object);
+	moveit_msgs::CollisionObject& added = diff_.world.collision_objects.back();
+	if (added.header.frame_id.empty())
+		added.header.frame_id = frameId_;
+	added.operation = moveit_msgs::CollisionObject::ADD;
+}
+
+void SceneTransaction::move(const std::string& collision_id,
+		const geometry_msgs::Pose& pose) {
+	moveit_msgs::CollisionObject object;
+	object.header.frame_id = frameId_;
+	object.id = collision_id;
+	object.primitive_poses.push_back(pose);
+	object.operation = moveit_msgs::CollisionObject::MOVE;
+	diff_.world.collision_objects.push_back(object);
+}
+
+void SceneTransaction::remove(const std::string& collision_id) {
+	moveit_msgs::CollisionObject object;
+	object.header.frame_id = frameId_;
+	object.id = collision_id;
+	object.operation = moveit_msgs::CollisionObject::REMOVE;
+	diff_.world.collision_objects.push_back(object);
+}
+
+// --------------------------------------------------------------------------
+// Workcell
+// --------------------------------------------------------------------------
+static Eigen::Affine3d toAffine(const urdf::Pose& pose) {
+	return Eigen::Translation3d(pose.position.x, pose.position.y,
+			pose.position.z)
+			* Eigen::Quaterniond(pose.rotation.w, pose.rotation.x,
+					pose.rotation.y, pose.rotation.z);
+}
+
+static geometry_msgs::Pose toPose(const Eigen::Affine3d& affine) {
+	geometry_msgs::Pose pose;
+	Eigen::Quaterniond q(affine.rotation());
+	pose.position.x = affine.translation().x();
+	pose.position.y = affine.translation().y();
+	pose.position.z = affine.translation().z();
+	pose.orientation.x = q.x();
+	pose.orientation.y = q.y();
+	pose.orientation.z = q.z();
+	pose.orientation.w = q.w();
+	return pose;
+}
+
+// Pose of link in the root link, joints at zero
+static Eigen::Affine3d linkPose(const urdf::Link& link) {
+	Eigen::Affine3d pose = Eigen::Affine3d::Identity();
+	const urdf::Link* child = &link;
+	while (child->parent_joint) {
+		pose = toAffine(child->parent_joint->parent_to_joint_origin_transform)
+				* pose;
+		child = child->getParent().get();
+		if (child == NULL)
+			break;
+	}
+	return pose;
+}
+
+// Primitive of geometry, false for meshes
+static bool toPrimitive(const urdf::Geometry& geometry,
+		shape_msgs::SolidPrimitive& shape) {
+	switch (geometry.type) {
+	case urdf::Geometry::BOX: {
+		const urdf::Box& box = static_cast<const urdf::Box&>(geometry);
+		shape.type = shape_msgs::SolidPrimitive::BOX;
+		shape.dimensions.resize(3);
+		shape.dimensions[shape_msgs::SolidPrimitive::BOX_X] = box.dim.x;
+		shape.dimensions[shape_msgs::SolidPrimitive::BOX_Y] = box.dim.y;
+		shape.dimensions[shape_msgs::SolidPrimitive::BOX_Z] = box.dim.z;
+		return true;
+	}
+	case urdf::Geometry::SPHERE: {
+		const urdf::Sphere& sphere = static_cast<const urdf::Sphere&>(geometry);
+		shape.type = shape_msgs::SolidPrimitive::SPHERE;
+		shape.dimensions.resize(1);
+		shape.dimensions[shape_msgs::SolidPrimitive::SPHERE_RADIUS] =
+				sphere.radius;
+		return true;
+	}
+	case urdf::Geometry::CYLINDER: {
+		const urdf::Cylinder& cylinder =
+				static_cast<const urdf::Cylinder&>(geometry);
+		shape.type = shape_msgs::SolidPrimitive::CYLINDER;
+		shape.dimensions.resize(2);
+		shape.dimensions[shape_msgs::SolidPrimitive::CYLINDER_HEIGHT] =
+				cylinder.length;
+		shape.dimensions[shape_msgs::SolidPrimitive::CYLINDER_RADIUS] =
+				cylinder.radius;
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+int SceneTransaction::addURDF(const std::string& urdf_xml,
+		const std::string& robot_xml) {
+	urdf::Model workcell;
+	if (!workcell.initString(urdf_xml)) {
+		std::cout << "SceneTransaction::addURDF: Cannot parse workcell URDF"
+				<< std::endl;
+		return -1;
+	}
+	std::set<std::string> robot_links;
+	urdf::Model robot;
+	if (!robot_xml.empty()) {
+		if (robot.initString(robot_xml))
+			for (std::map<std::string, boost::shared_ptr<urdf::Link> >::const_iterator it =
+					robot.links_.begin(); it != robot.links_.end(); ++it)
+				robot_links.insert(it->first);
+		else
+			std::cout << "SceneTransaction::addURDF: Cannot parse robot URDF, "
+					<< "all links are added" << std::endl;
+	}
+
+	int count = 0;
+	for (std::map<std::string, boost::shared_ptr<urdf::Link> >::const_iterator it =
+			workcell.links_.begin(); it != workcell.links_.end(); ++it) {
+		const urdf::Link& link = *it->second;
+		if (robot_links.count(link.name))
+			continue;
+		std::vector<boost::shared_ptr<urdf::Collision> > collisions =
+				link.collision_array;
+		if (collisions.empty() && link.collision)
+			collisions.push_back(link.collision);
+
+		moveit_msgs::CollisionObject object;
+		object.id = link.name;
+		Eigen::Affine3d pose = linkPose(link);
+		for (size_t i = 0; i < collisions.size(); i++) {
+			shape_msgs::SolidPrimitive shape;
+			if (!collisions[i]->geometry
+					|| !toPrimitive(*collisions[i]->geometry, shape)) {
+				ROS_WARN("SceneTransaction: Mesh of %s skipped",
+						link.name.c_str());
+				continue;
+			}
+			object.primitives.push_back(shape);
+			object.primitive_poses.push_back(
+					toPose(pose * toAffine(collisions[i]->origin)));
+		}
+		if (object.primitives.empty())
+			continue;
+		add(object);
+		count++;
+	}
+	return count;
+}
+
+// --------------------------------------------------------------------------
+// Commit
+// --------------------------------------------------------------------------
+bool SceneTransaction::commit(ros::Publisher& publisher,
+		ros::ServiceClient& client, double timeout) {
+	if (isEmpty())
+		return true;
+	ros::WallTime begin = ros::WallTime::now();
+	ros::WallTime end = begin + ros::WallDuration(timeout > 0.0 ? timeout : 0.0);
+	// A diff published before move_group subscribed is lost
+	while (publisher.getNumSubscribers() == 0 && ros::WallTime::now() < end)
+		ros::WallDuration(SCENE_POLL_INTERVAL).sleep();
+	if (publisher.getNumSubscribers() == 0)
+		ROS_WARN("SceneTransaction: No subscriber of %s",
+				publisher.getTopic().c_str());
+	diff_.is_diff = true;
+	publisher.publish(diff_);
+	if (timeout <= 0.0)
+		return true;
+
+	moveit_msgs::GetPlanningScene srv;
+	srv.request.components.components =
+			moveit_msgs::PlanningSceneComponents::WORLD_OBJECT_NAMES
+					| moveit_msgs::PlanningSceneComponents::WORLD_OBJECT_GEOMETRY;
+	do {
+		if (client.call(srv) && isApplied(srv.response.scene)) {
+			ROS_INFO("SceneTransaction: %d changes applied in %.3f s", size(),
+					(ros::WallTime::now() - begin).toSec());
+			return true;
+		}
+		ros::WallDuration(SCENE_POLL_INTERVAL).sleep();
+	} while (ros::WallTime::now() < end);
+	ROS_WARN("SceneTransaction: %d changes not acknowledged in %.3f s", size(),
+			timeout);
+	return false;
+}
+
+bool SceneTransaction::isApplied(const moveit_msgs::PlanningScene& scene) {
+	// Final state of every object of the diff, NULL if removed
+	std::map<std::string, const moveit_msgs::CollisionObject*> expected;
+	for (size_t i = 0; i < diff_.world.collision_objects.size(); i++) {
+		const moveit_msgs::CollisionObject& object =
+				diff_.world.collision_objects[i];
+		if (object.operation == moveit_msgs::CollisionObject::REMOVE)
+			expected[object.id] = NULL;
+		else
+			expected[object.id] = &object;
+	}
+
+	std::map<std::string, const moveit_msgs::CollisionObject*> present;
+	for (size_t i = 0; i < scene.world.collision_objects.size(); i++)
+		present[scene.world.collision_objects[i].id] =
+				&scene.world.collision_objects[i];
+
+	for (std::map<std::string, const moveit_msgs::CollisionObject*>::iterator it =
+			expected.begin(); it != expected.end(); ++it) {
+		std::map<std::string, const moveit_msgs::CollisionObject*>::iterator found =
+				present.find(it->first);
+		if (it->second == NULL) {
+			if (found != present.end())
+				return false;
+			continue;
+		}
+		if (found == present.end())
+			return false;
+		// Compare the first pose, it is where the object was added or moved
+		if (it->second->primitive_poses.empty()
+				|| found->second->primitive_poses.empty())
+			continue;
+		const geometry_msgs::Point& a = it->second->primitive_poses[0].position;
+		const geometry_msgs::Point& b =
+				found->second->primitive_poses[0].position;
+		if (fabs(a.x - b.x) > SCENE_POSE_TOLERANCE
+				|| fabs(a.y - b.y) > SCENE_POSE_TOLERANCE
+				|| fabs(a.z - b.z) > SCENE_POSE_TOLERANCE)
+			return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------------------------
+// Settings
+// --------------------------------------------------------------------------
+bool SceneTransaction::isEmpty() {
+	return diff_.world.collision_objects.empty();
+}
+
+int SceneTransaction::size() {
+	return diff_.world.collision_objects.size();
+}
+
+void SceneTransaction::clear() {
+	diff_.world.collision_objects.clear();
+}
+
+const moveit_msgs::PlanningScene& SceneTransaction::getDiff() {
+	return diff_;
+}
+
+std::string SceneTransaction::getFrameId() {
+	return frameId_;
+}
+
+void SceneTransaction::setFrameId(const std::string& frame_id) {
+	frameId_ = frame_id;
+}
@@ -0,0 +1,98 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Header file for SceneTransaction, used by Controller and Interface to
+ *   change the collision objects of the planning scene in one step.
+ *   Adds, moves and removes are collected in order into one PlanningScene
+ *   diff, which is published once on the planning_scene topic of
+ *   move_group. commit then polls get_planning_scene until the monitored
+ *   scene reflects every change, so a plan requested afterwards is planned
+ *   in the new scene.
+ *   A whole workcell is added by addURDF from an expanded URDF such as
+ *   kuka_kr6/robots/workcell.urdf (xacro workcell.xacro): every link that
+ *   is not a link of the robot becomes an object of its collision boxes,
+ *   spheres and cylinders, placed by the fixed joints from the root link.
+ *
+ */
+
+#ifndef MY_SCENETRANSACTION_H
+#define MY_SCENETRANSACTION_H
+
+#include <string>
+#include <vector>
+#include <ros/ros.h>
+#include <geometry_msgs/Pose.h>
+#include <moveit_msgs/CollisionObject.h>
+#include <moveit_msgs/PlanningScene.h>
+#include <shape_msgs/SolidPrimitive.h>
+
+// Time commit waits for the scene to acknowledge, in seconds
+#define SCENE_DEFAULT_TIMEOUT 1.0
+// Interval of polling get_planning_scene, in seconds
+#define SCENE_POLL_INTERVAL 0.01
+// Largest position difference of a moved object still taken as moved, in m
+#define SCENE_POSE_TOLERANCE 1e-4
+
+// --------------------------------------------------------------------------
+// SceneTransaction class
+// --------------------------------------------------------------------------
+class SceneTransaction {
+public:
+	// Poses of the transaction are in frame_id, the planning frame
+	SceneTransaction(const std::string& frame_id = "world");
+
+	// Add object collision_id of one shape at pose
+	void add(const std::string& collision_id,
+			const shape_msgs::SolidPrimitive& shape,
+			const geometry_msgs::Pose& pose);
+	// Add object, frame_id of the transaction is used if it has none
+	void add(const moveit_msgs::CollisionObject& object);
+	// Move object collision_id to pose, for objects of one shape
+	void move(const std::string& collision_id, const geometry_msgs::Pose& pose);
+	// Remove object collision_id
+	void remove(const std::string& collision_id);
+
+	// Add every link of urdf_xml that is not a link of robot_xml
+	//  - poses are of the root link of urdf_xml, taken as frame_id
+	//  - links without box, sphere or cylinder collisions are skipped
+	// return the number of objects added, -1 if urdf_xml cannot be parsed
+	int addURDF(const std::string& urdf_xml, const std::string& robot_xml =
+			"");
+
+	// True if nothing was collected
+	bool isEmpty();
+	// Number of changes collected
+	int size();
+	// Drop all changes
+	void clear();
+
+	// Get method: the collected diff
+	const moveit_msgs::PlanningScene& getDiff();
+	// Get method: frameId_
+	std::string getFrameId();
+	// Set method: frameId_, for changes collected afterwards
+	void setFrameId(const std::string& frame_id);
+
+	// Publish the diff in one message, then wait up to timeout until the
+	// scene of client reflects it, timeout 0 does not wait
+	// the transaction is kept, call clear to reuse it
+	// if return false, the diff is not acknowledged in time, it may still
+	// be applied later
+	bool commit(ros::Publisher& publisher, ros::ServiceClient& client,
+			double timeout = SCENE_DEFAULT_TIMEOUT);
+
+	// True if every change of the diff is in scene
+	bool isApplied(const moveit_msgs::PlanningScene& scene);
+
+private:
+	std::string frameId_;
+	moveit_msgs::PlanningScene diff_;
+};
+
+#endif
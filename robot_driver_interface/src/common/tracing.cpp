@@ -0,0 +1,132 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ */
+
+#include "tracing.h"
+
+#include <algorithm>
+#include <fstream>
+
+// Phases drawn for each Command: name, start stage, end stage
+static const struct {
+	const char* name;
+	CommandTrace::Stage begin;
+	CommandTrace::Stage end;
+} kPhases[] = { { "queued", CommandTrace::Created, CommandTrace::Written }, {
+		"sent", CommandTrace::Written, CommandTrace::Acked }, { "buffered",
+		CommandTrace::Buffered, CommandTrace::BufFront }, { "executing",
+		CommandTrace::BufFront, CommandTrace::Left } };
+
+void takeTraceSnapshot(TraceSnapshot& snapshot, std::list<Command*>& commands,
+		std::list<Feedback*>& feedbacks) {
+	snapshot.commands.clear();
+	snapshot.feedbacks.clear();
+
+	// Walk back from the latest, the lists are never walked in full
+	double first_created = -1.0;
+	std::list<Command*>::reverse_iterator cmd_it;
+	for (cmd_it = commands.rbegin();
+			cmd_it != commands.rend()
+					&& snapshot.commands.size() < TRACE_MAX_COMMANDS;
+			cmd_it++) {
+		TraceSnapshot::CommandItem item;
+		item.stamp = (*cmd_it)->getStamp();
+		item.type = (*cmd_it)->getType();
+		item.state = (*cmd_it)->getState();
+		item.trace = (*cmd_it)->getTrace();
+		snapshot.commands.push_back(item);
+		double t = item.trace.time_[CommandTrace::Created];
+		if (t > 0.0)
+			first_created = t;
+	}
+	std::reverse(snapshot.commands.begin(), snapshot.commands.end());
+
+	std::list<Feedback*>::reverse_iterator fb_it;
+	for (fb_it = feedbacks.rbegin();
+			fb_it != feedbacks.rend()
+					&& snapshot.feedbacks.size() < TRACE_MAX_FEEDBACKS;
+			fb_it++) {
+		Feedback* fb = *fb_it;
+		if (fb->getRecvTime() <= 0.0)
+			continue;
+		if (first_created > 0.0 && fb->getRecvTime() < first_created)
+			break;
+		TraceSnapshot::FeedbackItem item;
+		item.recvTime = fb->getRecvTime();
+		item.seq = fb->getSeq();
+		item.time = fb->getTime();
+		item.stamp = fb->getStamp();
+		item.front = fb->getBufferFront();
+		item.last = fb->getBufferLast();
+		snapshot.feedbacks.push_back(item);
+	}
+	std::reverse(snapshot.feedbacks.begin(), snapshot.feedbacks.end());
+}
+
+bool writeChromeTrace(const std::string& filename,
+		const TraceSnapshot& snapshot) {
+	std::ofstream out(filename.c_str());
+	if (!out.is_open()) {
+		std::cout << "writeChromeTrace: Cannot open " << filename << std::endl;
+		return false;
+	}
+
+	// Origin of the timeline: the earliest time stamp
+	double origin = -1.0;
+	for (size_t i = 0; i < snapshot.commands.size(); i++) {
+		double t = snapshot.commands[i].trace.time_[CommandTrace::Created];
+		if (t > 0.0 && (origin < 0.0 || t < origin))
+			origin = t;
+	}
+	if (!snapshot.feedbacks.empty()
+			&& (origin < 0.0 || snapshot.feedbacks.front().recvTime < origin))
+		origin = snapshot.feedbacks.front().recvTime;
+	if (origin < 0.0)
+		origin = 0.0;
+
+	out << std::fixed << std::setprecision(1);
+	out << "{\"traceEvents\":[" << std::endl;
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Commands\"}},"
+			<< std::endl;
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"KRC Feedback\"}}";
+
+	for (size_t c = 0; c < snapshot.commands.size(); c++) {
+		const TraceSnapshot::CommandItem& cmd = snapshot.commands[c];
+		for (int i = 0; i < sizeof(kPhases) / sizeof(kPhases[0]); i++) {
+			double t0 = cmd.trace.time_[kPhases[i].begin];
+			double t1 = cmd.trace.time_[kPhases[i].end];
+			if (t0 <= 0.0 || t1 < t0)
+				continue;
+			out << "," << std::endl << "{\"name\":\"" << kPhases[i].name
+					<< "\",\"cat\":\"command\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+					<< cmd.stamp << ",\"ts\":" << (t0 - origin) * 1.0e6
+					<< ",\"dur\":" << (t1 - t0) * 1.0e6
+					<< ",\"args\":{\"stamp\":" << cmd.stamp << ",\"type\":"
+					<< cmd.type << ",\"state\":" << cmd.state << "}}";
+		}
+	}
+
+	for (size_t f = 0; f < snapshot.feedbacks.size(); f++) {
+		const TraceSnapshot::FeedbackItem& fb = snapshot.feedbacks[f];
+		double ts = (fb.recvTime - origin) * 1.0e6;
+		int held = fb.last - fb.front;
+		if (held < 0)
+			held += KRL_BUF_LEN;
+		out << "," << std::endl << "{\"name\":\"feedback\",\"cat\":\"feedback\",\"ph\":\"i\",\"s\":\"t\",\"pid\":2,\"tid\":0,\"ts\":"
+				<< ts << ",\"args\":{\"seq\":" << fb.seq << ",\"krc_time\":"
+				<< fb.time << ",\"stamp\":" << fb.stamp << ",\"front\":"
+				<< fb.front << ",\"last\":" << fb.last << "}}";
+		out << "," << std::endl << "{\"name\":\"KRL buffer\",\"ph\":\"C\",\"pid\":2,\"ts\":"
+				<< ts << ",\"args\":{\"held\":" << held << "}}";
+	}
+
+	out << std::endl << "]}" << std::endl;
+	out.close();
+	return true;
+}
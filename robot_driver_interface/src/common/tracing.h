@@ -0,0 +1,79 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Header file for execution timeline tracing.
+ *   The CommandTrace of every Command in CommandList and the feedback ticks
+ *   in FeedbackList are exported as Chrome trace-event JSON, which could be
+ *   opened with chrome://tracing or Perfetto.
+ *   Each Command is drawn on its own row (tid = stamp) as four phases:
+ *       queued   : Created  -> Written
+ *       sent     : Written  -> Acked
+ *       buffered : Buffered -> BufFront
+ *       executing: BufFront -> Left
+ *   Feedback ticks are drawn as instant events, together with a counter of
+ *   the number of commands held in KRL buffer.
+ *   Exporting is split in two, so the control thread never formats or writes
+ *   the file:
+ *       - takeTraceSnapshot copies the latest TRACE_MAX_COMMANDS commands and
+ *         the feedbacks received meanwhile, by value
+ *       - writeChromeTrace writes a snapshot, on any thread
+ *
+ */
+
+#ifndef MY_TRACING_H
+#define MY_TRACING_H
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include "message.h"
+#include "tcpthread.h"
+
+// Commands in one exported trace, the latest ones
+#define TRACE_MAX_COMMANDS 1000
+// Feedbacks in one exported trace, about 4 minutes at 12 ms
+#define TRACE_MAX_FEEDBACKS 20000
+
+// --------------------------------------------------------------------------
+// Data structure: TraceSnapshot
+//  - what is drawn of commands and feedbacks, copied from the lists
+// --------------------------------------------------------------------------
+struct TraceSnapshot {
+	struct CommandItem {
+		int stamp;
+		int type;
+		int state;
+		CommandTrace trace;
+	};
+	struct FeedbackItem {
+		double recvTime;
+		int seq;
+		int time;
+		int stamp;
+		int front;
+		int last;
+	};
+
+	// Both oldest first
+	std::vector<CommandItem> commands;
+	std::vector<FeedbackItem> feedbacks;
+};
+
+// Copy the latest TRACE_MAX_COMMANDS commands, and the feedbacks received
+// since the first of them was created (up to TRACE_MAX_FEEDBACKS)
+void takeTraceSnapshot(TraceSnapshot& snapshot, std::list<Command*>& commands,
+		std::list<Feedback*>& feedbacks);
+
+// Write the timeline of snapshot to filename
+// if return false, the file could not be written
+bool writeChromeTrace(const std::string& filename,
+		const TraceSnapshot& snapshot);
+
+#endif
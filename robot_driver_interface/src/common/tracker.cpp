@@ -0,0 +1,180 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ */
+
+#include "tracker.h"
+
+const NDIToolSample* NDISample::find(int handle) const {
+	for (int i = 0; i < toolCount; i++)
+		if (tool[i].handle == handle)
+			return &tool[i];
+	return NULL;
+}
+
+NDITracker::NDITracker(boost::shared_ptr<CommandHandling> command_handling) :
+		commandHandling_(command_handling), home_(NULL), stop_(false), binary_(
+				false), outOfVolume_(false), count_(0) {
+}
+
+NDITracker::~NDITracker() {
+	stopAcquisition();
+}
+
+bool NDITracker::startAcquisition() {
+	if (isRunning()) {
+		std::cout << "NDITracker::startAcquisition: Already running"
+				<< std::endl;
+		return false;
+	}
+	stop_ = false;
+	// The serial port can only be used by the thread it belongs to
+	home_ = QThread::currentThread();
+	commandHandling_->MoveToThread(this);
+	start();
+	return true;
+}
+
+void NDITracker::stopAcquisition() {
+	stop_ = true;
+	wait();
+}
+
+void NDITracker::setReplyOption(bool binary, bool out_of_volume) {
+	binary_ = binary;
+	outOfVolume_ = out_of_volume;
+}
+
+// --------------------------------------------------------------------------
+// Acquisition
+// --------------------------------------------------------------------------
+void NDITracker::run() {
+	// No dialog can be shown from this thread, a timeout is a failed reply
+	commandHandling_->bTimeoutDialog_ = false;
+	ROS_INFO("NDITracker: Acquisition starts");
+
+	NDISample sample;
+	unsigned long last_frame = 0;
+	int failures = 0;
+	while (!stop_ && ros::ok()) {
+		int ok =
+				binary_ ?
+						commandHandling_->GetBXTransforms(outOfVolume_) :
+						commandHandling_->GetTXTransforms(outOfVolume_);
+		if (!ok) {
+			if (++failures == NDI_TRACKER_MAX_FAILURES)
+				ROS_WARN("NDITracker: %d replies failed in a row", failures);
+			continue;
+		}
+		failures = 0;
+		sample.stamp = ros::Time::now().toSec();
+
+		if (commandHandling_->dtSystemInformation_.nPortOccupied) {
+			ROS_INFO("NDITracker: New port occupied, acquisition stops");
+			emit portOccupied();
+			break;
+		}
+
+		sample.toolCount = 0;
+		sample.frameNumber = 0;
+		for (int handle = 0;
+				handle < NO_HANDLES && sample.toolCount < NDI_TRACKER_MAX_TOOLS;
+				handle++) {
+			const HandleInformation& info =
+					commandHandling_->pdtHandleInformation_[handle];
+			if (!info.dtHandleInfo.nEnabled)
+				continue;
+			NDIToolSample& tool = sample.tool[sample.toolCount++];
+			tool.handle = handle;
+			tool.transform = info.dtXfrms;
+			tool.status = info.dtHandleInfo;
+			if (sample.frameNumber == 0
+					&& (info.dtXfrms.ulFlags == TRANSFORM_VALID
+							|| info.dtXfrms.ulFlags == TRANSFORM_MISSING))
+				sample.frameNumber = info.dtXfrms.ulFrameNumber;
+		}
+		// Replied faster than the frame rate, the frame is already written
+		if (sample.frameNumber != 0 && sample.frameNumber == last_frame)
+			continue;
+		last_frame = sample.frameNumber;
+		write(sample);
+	}
+
+	commandHandling_->bTimeoutDialog_ = true;
+	commandHandling_->LogReplyLatency();
+	commandHandling_->MoveToThread(home_);
+	ROS_INFO("NDITracker: Acquisition stops after %lu samples", getCount());
+}
+
+void NDITracker::write(NDISample& sample) {
+	unsigned long index = getCount();
+	Slot& slot = ring_[index % NDI_TRACKER_HISTORY];
+	sample.index = index;
+	slot.sequence.fetchAndAddOrdered(1);
+	slot.sample = sample;
+	slot.sequence.fetchAndAddOrdered(1);
+	count_.fetchAndAddOrdered(1);
+}
+
+// --------------------------------------------------------------------------
+// Consumers
+// --------------------------------------------------------------------------
+bool NDITracker::read(unsigned long index, NDISample& sample) {
+	Slot& slot = ring_[index % NDI_TRACKER_HISTORY];
+	for (;;) {
+		int before = slot.sequence.fetchAndAddOrdered(0);
+		if (before & 1) {
+			// The writer is in the middle of write
+			QThread::yieldCurrentThread();
+			continue;
+		}
+		sample = slot.sample;
+		if (slot.sequence.fetchAndAddOrdered(0) == before)
+			return sample.index == index;
+	}
+}
+
+bool NDITracker::latest(NDISample& sample) {
+	for (;;) {
+		unsigned long count = getCount();
+		if (count == 0)
+			return false;
+		if (read(count - 1, sample))
+			return true;
+	}
+}
+
+bool NDITracker::waitForSample(NDISample& sample, unsigned long count,
+		double timeout) {
+	ros::WallTime end = ros::WallTime::now() + ros::WallDuration(timeout);
+	while (getCount() <= count) {
+		if (!isRunning() || !(ros::WallTime::now() < end))
+			return false;
+		ros::WallDuration(NDI_TRACKER_POLL_INTERVAL).sleep();
+	}
+	return latest(sample);
+}
+
+int NDITracker::history(std::vector<NDISample>& samples, int max_count) {
+	samples.clear();
+	unsigned long count = getCount();
+	unsigned long first =
+			count > (unsigned long) max_count ? count - max_count : 0;
+	if (count - first > NDI_TRACKER_HISTORY)
+		first = count - NDI_TRACKER_HISTORY;
+	NDISample sample;
+	for (unsigned long index = first; index < count; index++)
+		// Skip the oldest ones if overwritten meanwhile
+		if (read(index, sample))
+			samples.push_back(sample);
+	return samples.size();
+}
+
+unsigned long NDITracker::getCount() {
+	return (unsigned int) count_.fetchAndAddOrdered(0);
+}
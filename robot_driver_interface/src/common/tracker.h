@@ -0,0 +1,141 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Header file for NDITracker, the thread acquiring the tracking data of
+ *   the NDI system. While tracking, the thread owns CommandHandling and its
+ *   serial port, and sends TX or BX back to back, so the stream follows the
+ *   frame rate of the tracker (about 60 Hz) instead of the GUI timer.
+ *   Every new frame is written as an NDISample to a ring of
+ *   NDI_TRACKER_HISTORY slots, each guarded by a sequence counter (seqlock):
+ *       - the writer makes the counter of a slot odd while it writes, then
+ *         increases count_, the number of samples written
+ *       - a reader copies a slot and retries if the counter was odd or
+ *         changed, the latest sample is the slot of count_ - 1
+ *   Neither side ever blocks, and the writer is one slot ahead of the
+ *   readers of the latest sample, so they hardly ever retry. The GUI and the
+ *   calibration routines consume the samples instead of the serial port.
+ *   A new port occupied stops the thread and emits portOccupied, ports are
+ *   activated again by the thread of the GUI.
+ *
+ */
+
+#ifndef MY_TRACKER_H
+#define MY_TRACKER_H
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <QAtomicInt>
+#include <QThread>
+
+#include <ros/ros.h>
+
+#include "ndi/CommandHandling.h"
+
+// Samples kept in the history, about 4 s at 60 Hz
+#define NDI_TRACKER_HISTORY 256
+// Tools in one sample
+#define NDI_TRACKER_MAX_TOOLS 12
+// Interval of checking for a new sample while waiting, in seconds
+#define NDI_TRACKER_POLL_INTERVAL 0.001
+// Failed TX or BX in a row before a warning
+#define NDI_TRACKER_MAX_FAILURES 10
+
+// --------------------------------------------------------------------------
+// Data structure: NDIToolSample
+//  - transform and status of one port handle
+// --------------------------------------------------------------------------
+struct NDIToolSample {
+	int handle;
+	TransformInformation transform;
+	HandleStatus status;
+};
+
+// --------------------------------------------------------------------------
+// Data structure: NDISample
+//  - one frame of the tracker, tools of the enabled port handles
+// --------------------------------------------------------------------------
+struct NDISample {
+	// Index in the stream, starting at 0
+	unsigned long index;
+	// Frame number of the tracker
+	unsigned long frameNumber;
+	// ROS time the reply was received, in seconds
+	double stamp;
+	int toolCount;
+	NDIToolSample tool[NDI_TRACKER_MAX_TOOLS];
+
+	// Tool of handle, NULL if not in the sample
+	const NDIToolSample* find(int handle) const;
+};
+
+// --------------------------------------------------------------------------
+// NDITracker class
+// --------------------------------------------------------------------------
+class NDITracker: public QThread {
+Q_OBJECT
+public:
+	NDITracker(boost::shared_ptr<CommandHandling> command_handling);
+	~NDITracker();
+
+	// Move the serial port to the thread and start it, the system should
+	// be tracking already (TSTART), called by the thread of the GUI
+	// if return false, the thread is running already
+	bool startAcquisition();
+	// Stop the thread and wait for it, the serial port is back to the
+	// thread it was started from
+	void stopAcquisition();
+
+	// Set method: BX instead of TX, and report tools out of volume (0x0800)
+	void setReplyOption(bool binary, bool out_of_volume);
+
+	// Copy the latest sample to sample
+	// if return false, no sample has been acquired yet
+	bool latest(NDISample& sample);
+	// Wait until the stream has more than count samples, and copy the
+	// latest one to sample
+	// if return false, timeout (in seconds) or the thread stopped
+	bool waitForSample(NDISample& sample, unsigned long count, double timeout);
+	// Copy the latest samples, up to max_count, oldest first
+	// return number of samples copied
+	int history(std::vector<NDISample>& samples, int max_count);
+	// Get method: number of samples acquired since the tracker was created
+	unsigned long getCount();
+
+signals:
+	// A new port is occupied, the thread has stopped
+	void portOccupied();
+
+protected:
+	// Acquire samples until stopAcquisition
+	void run();
+
+private:
+	// Write sample to the slot of count_
+	void write(NDISample& sample);
+	// Copy sample of index from its slot
+	// if return false, the slot has been overwritten by a newer sample
+	bool read(unsigned long index, NDISample& sample);
+
+	boost::shared_ptr<CommandHandling> commandHandling_;
+	// Thread the serial port is moved back to
+	QThread* home_;
+	volatile bool stop_;
+	volatile bool binary_;
+	volatile bool outOfVolume_;
+
+	struct Slot {
+		// Odd while the sample is written
+		QAtomicInt sequence;
+		NDISample sample;
+	};
+	Slot ring_[NDI_TRACKER_HISTORY];
+	QAtomicInt count_;
+};
+
+#endif
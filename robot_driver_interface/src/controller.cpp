@@ -10,6 +10,53 @@
 
 #include "controller.h"
 
+#include <fstream>
+#include <sstream>
+#include <moveit/kinematic_constraints/kinematic_constraint.h>
+#include <moveit/kinematic_constraints/utils.h>
+#include <moveit/robot_state/conversions.h>
+#include <moveit_msgs/GetPlanningScene.h>
+#include <ros/serialization.h>
+#include <QMutexLocker>
+#include <QRunnable>
+
+// --------------------------------------------------------------------------
+// PlanTask class
+//  - runnable of one asynchronous plan on Controller::dtPlanningPool_
+// --------------------------------------------------------------------------
+class PlanTask: public QRunnable {
+public:
+	PlanTask(Controller* controller, PlanHandle handle) :
+			controller_(controller), handle_(handle) {
+	}
+	void run() {
+		controller_->runPlanRequest(handle_);
+	}
+private:
+	Controller* controller_;
+	PlanHandle handle_;
+};
+
+// Splice segment to the end of trajectory, the first point of segment is
+// the last point of trajectory and is dropped
+static void appendMotionPlan(Controller::MotionPlan& trajectory,
+		const Controller::MotionPlan& segment) {
+	trajectory_msgs::JointTrajectory& points =
+			trajectory.trajectory_.joint_trajectory;
+	const trajectory_msgs::JointTrajectory& next =
+			segment.trajectory_.joint_trajectory;
+	if (points.points.empty()) {
+		trajectory = segment;
+		return;
+	}
+	ros::Duration offset = points.points.back().time_from_start;
+	for (size_t i = 1; i < next.points.size(); i++) {
+		points.points.push_back(next.points[i]);
+		points.points.back().time_from_start += offset;
+	}
+	trajectory.planning_time_ += segment.planning_time_;
+}
+
 Controller::Controller(std::string group_name) :
 		dtPlannar_(), dtKukaFeedbackReceiver_() {
 
@@ -19,6 +66,10 @@ Controller::Controller(std::string group_name) :
 			"InteractiveMarkerFeedbackConstPtr");
 	qRegisterMetaType<TrajectoryGoal>("TrajectoryGoal");
 	qRegisterMetaType<MotionPlan>("MotionPlan");
+	qRegisterMetaType<MotionPlanPtr>("MotionPlanPtr");
+	qRegisterMetaType<PlanHandle>("PlanHandle");
+	qRegisterMetaType<Frame>("Frame");
+	qRegisterMetaType<Axis>("Axis");
 
 	// When object plannar_'s "newFeedback" function is called, its parameter will be passed to Controller's "newFeedback" function 
 	// and Controller's "newFeedback" function will be called.
@@ -34,12 +85,34 @@ Controller::Controller(std::string group_name) :
 			&dtKukaFeedbackReceiver_, SLOT(LastCommandComplete()),
 			Qt::QueuedConnection);
 	// Send Trajectory to plannar_ object
-	connect(this, SIGNAL(sendTrajectorySignal(const MotionPlan&)), &dtPlannar_,
-			SLOT(executeTrajectory(const MotionPlan&)), Qt::QueuedConnection);
+	connect(this, SIGNAL(sendTrajectorySignal(MotionPlanPtr)), &dtPlannar_,
+			SLOT(executeTrajectory(MotionPlanPtr)), Qt::QueuedConnection);
+	connect(this, SIGNAL(appendTrajectorySignal(MotionPlanPtr, bool)),
+			&dtPlannar_, SLOT(appendTrajectory(MotionPlanPtr, bool)),
+			Qt::QueuedConnection);
+	connect(this, SIGNAL(sendCartesianTrajectorySignal(MotionPlanPtr)),
+			&dtPlannar_, SLOT(executeCartesianTrajectory(MotionPlanPtr)),
+			Qt::QueuedConnection);
+	// Queued after the same thread, the speed is set before the trajectory
+	connect(this, SIGNAL(sendSpeedSignal(double, double, double)), &dtPlannar_,
+			SLOT(setPTPSpeed(double, double, double)), Qt::QueuedConnection);
+	connect(this, SIGNAL(resetSpeedSignal()), &dtPlannar_,
+			SLOT(resetPTPSpeed()), Qt::QueuedConnection);
 	connect(&dtKukaFeedbackReceiver_, SIGNAL(closeWindow()), this,
 			SIGNAL(closeWindow()), Qt::QueuedConnection);
 	connect(this, SIGNAL(changeMotionCompleteDelayTime(double)), &dtPlannar_,
 			SLOT(changeMotionCompleteDelayTime(double)), Qt::QueuedConnection);
+	// Servo mode
+	connect(this, SIGNAL(startServoSignal()), &dtPlannar_, SLOT(startServo()),
+			Qt::QueuedConnection);
+	connect(this, SIGNAL(stopServoSignal()), &dtPlannar_, SLOT(stopServo()),
+			Qt::QueuedConnection);
+	connect(this, SIGNAL(servoTargetSignal(Frame)), &dtPlannar_,
+			SLOT(setServoTarget(Frame)), Qt::QueuedConnection);
+	connect(this, SIGNAL(servoVelocitySignal(Frame)), &dtPlannar_,
+			SLOT(setServoVelocity(Frame)), Qt::QueuedConnection);
+	connect(this, SIGNAL(servoToAxisSignal(Axis)), &dtPlannar_,
+			SLOT(servoToAxis(Axis)), Qt::QueuedConnection);
 
 	// Settings for MoveGroup
 	pdtMoveGroup_ = boost::make_shared<moveit::planning_interface::MoveGroup>(
@@ -48,6 +121,119 @@ Controller::Controller(std::string group_name) :
 	pdtMoveGroup_->setNumPlanningAttempts(5);
 	pdtMoveGroup_->setStartState(*pdtMoveGroup_->getCurrentState());
 
+	// Settings for asynchronous planning, requests are planned one by one
+	// on a thread of their own with a MoveGroup of their own
+	pdtPlanningMoveGroup_ = boost::make_shared<
+			moveit::planning_interface::MoveGroup>(group_name);
+	pdtPlanningMoveGroup_->setPlannerId("LBKPIECEkConfigDefault");
+	pdtPlanningMoveGroup_->setNumPlanningAttempts(5);
+	dtPlanningPool_.setMaxThreadCount(1);
+	dtPlanningPool_.setExpiryTimeout(-1);
+
+	// Settings for Cartesian path planning, Descartes loads the model and
+	// IK of the group itself
+	strCartesianTip_ = "tip";
+	dtCartesianPlanner_.initialize(group_name,
+			pdtPlanningMoveGroup_->getPlanningFrame(), strCartesianTip_);
+	double cartesian_step, cartesian_speed;
+	ros::param::param<double>("~cartesian_step", cartesian_step,
+			CARTESIAN_DEFAULT_STEP);
+	ros::param::param<double>("~cartesian_speed", cartesian_speed,
+			CARTESIAN_DEFAULT_SPEED);
+	dtCartesianPlanner_.setStep(cartesian_step);
+	dtCartesianPlanner_.setSpeed(cartesian_speed);
+
+	// Settings for plan cache, saved to file unless plan_cache_file is empty
+	ros::NodeHandle node_handle;
+	dtGetPlanningSceneClient_ = node_handle.serviceClient<
+			moveit_msgs::GetPlanningScene>("get_planning_scene");
+	int capacity;
+	ros::param::param<int>("~plan_cache_capacity", capacity,
+			PLANCACHE_DEFAULT_CAPACITY);
+	dtPlanCache_.setCapacity(capacity > 0 ? capacity : 0);
+	std::string home = getenv("HOME") ? getenv("HOME") : "/tmp";
+	ros::param::param<std::string>("~plan_cache_file", strPlanCacheFile_,
+			home + "/.ros/kuka_plan_cache");
+	if (!strPlanCacheFile_.empty())
+		dtPlanCache_.load(strPlanCacheFile_);
+
+	// Settings for the planning scene monitored from move_group, plans are
+	// checked against it in this process
+	pdtPlanningSceneMonitor_.reset(
+			new planning_scene_monitor::PlanningSceneMonitor(
+					"robot_description"));
+	if (pdtPlanningSceneMonitor_->getRobotModel()) {
+		pdtPlanningSceneMonitor_->startSceneMonitor(
+				"/move_group/monitored_planning_scene");
+		pdtPlanningSceneMonitor_->startStateMonitor();
+	} else {
+		ROS_ERROR("Controller: planning scene not monitored, plans cannot be checked");
+		pdtPlanningSceneMonitor_.reset();
+	}
+
+	// Settings for portfolio planning, planners of ompl_planning.yaml run
+	// concurrently in this process on the monitored scene
+	ros::param::param<bool>("~portfolio_planning", bPortfolioPlanning_,
+			false);
+	if (pdtPlanningSceneMonitor_
+			&& (bPortfolioPlanning_
+					|| ros::param::has("~portfolio_planners"))) {
+		pdtPlannerPortfolio_.reset(
+				new PlannerPortfolio(
+						pdtPlanningSceneMonitor_->getRobotModel()));
+		std::vector<std::string> planners;
+		if (ros::param::get("~portfolio_planners", planners))
+			pdtPlannerPortfolio_->setPlanners(planners);
+		double deadline;
+		ros::param::param<double>("~portfolio_deadline", deadline,
+				PORTFOLIO_DEFAULT_DEADLINE);
+		pdtPlannerPortfolio_->setDeadline(deadline);
+		std::string policy;
+		ros::param::param<std::string>("~portfolio_policy", policy,
+				"first_valid");
+		pdtPlannerPortfolio_->setPolicy(
+				policy == "best_at_deadline" ?
+						PlannerPortfolio::BestAtDeadline :
+						PlannerPortfolio::FirstValid);
+		if (!pdtPlannerPortfolio_->isValid())
+			pdtPlannerPortfolio_.reset();
+	}
+	if (bPortfolioPlanning_ && !pdtPlannerPortfolio_) {
+		ROS_ERROR("Controller: portfolio planning disabled");
+		bPortfolioPlanning_ = false;
+	}
+
+	// Settings for collision objects, changes are published to move_group
+	// as one diff per transaction
+	dtPlanningSceneDiffPublisher_ = node_handle.advertise<
+			moveit_msgs::PlanningScene>("/planning_scene", 1);
+	dtSceneTransaction_.setFrameId(pdtMoveGroup_->getPlanningFrame());
+	std::string workcell_file;
+	if (ros::param::get("~workcell_file", workcell_file))
+		loadWorkcell(workcell_file);
+
+	// Settings for retiming, limits of the robot in deg/s and deg/s^2, off
+	// unless asked for as it changes the speed of the robot
+	ros::param::param<bool>("~retime_plans", bRetimePlans_, false);
+	double velocity_scale, acceleration_scale;
+	ros::param::param<double>("~retime_velocity_scale", velocity_scale,
+			RETIMER_DEFAULT_VELOCITY_SCALE);
+	ros::param::param<double>("~retime_acceleration_scale",
+			acceleration_scale, RETIMER_DEFAULT_ACCELERATION_SCALE);
+	dtRetimer_.setScales(velocity_scale, acceleration_scale);
+	std::vector<double> max_velocity, max_acceleration;
+	if (ros::param::get("~retime_max_velocity", max_velocity)
+			&& ros::param::get("~retime_max_acceleration", max_acceleration)
+			&& max_velocity.size() == 6 && max_acceleration.size() == 6)
+		for (int i = 0; i < 6; i++)
+			dtRetimer_.setJointLimits(i, max_velocity[i] / 180.0 * M_PI,
+					max_acceleration[i] / 180.0 * M_PI);
+
+	// Settings for servo mode, off until setServoMode
+	bServoMode_ = false;
+	dtServoTwistSubscriber_ = node_handle.subscribe("servo_twist", 1,
+			&Controller::servoTwistCb, this);
+
 	// Initialize target pose
 	dtTargetPose_.orientation.w = dtTargetPose_.orientation.z = 1.0;
 	dtTargetPose_.position.x = dtTargetPose_.position.y =
@@ -92,6 +278,9 @@ Controller::Controller(std::string group_name) :
 Controller::~Controller() {
 	std::cout << "Controller Deconstructing..." << std::endl;
 
+	std::cout << "Waiting for planning requests..." << std::endl;
+	dtPlanningPool_.waitForDone();
+
 	std::cout << "Plannar thread ends..." << std::endl;
 	dtPlannarThread_->exit();
 	std::cout << "Kuka feedback receiver thread ends..." << std::endl;
@@ -109,85 +298,368 @@ void Controller::newFeedbackReceived(Feedback* feedback) {
 	emit newFeedback(feedback);
 }
 
-// Obtain motion plan based on target pose
+// Obtain motion plan based on target pose, blocks until it is planned
 bool Controller::planTargetMotion(geometry_msgs::Pose target_pose,
 		const std::string end_effector_link) {
+	return waitForPlan(planAsync(target_pose, end_effector_link));
+}
 
-	pdtMoveGroup_->clearPoseTarget();
-	pdtMoveGroup_->setPoseTarget(target_pose, end_effector_link);
-	pdtMoveGroup_->setStartState(*pdtMoveGroup_->getCurrentState());
-
-	bPlanSuccess_ = pdtMoveGroup_->plan(dtMotionPlan_);
-	ROS_INFO("Motion plan %s", bPlanSuccess_ ? "SUCCEEDED" : "FAILED");
+bool Controller::planTargetPoseMotion(const std::string end_effector_link) {
+	return planTargetMotion(dtTargetPose_, end_effector_link);
+}
 
-	return bPlanSuccess_;
+// Obtain motion plan based on target joint values, blocks until it is
+// planned
+bool Controller::planTargetMotion(std::map<std::string, double> target_joints) {
+	return waitForPlan(planAsync(target_joints));
 }
+bool Controller::planTargetJointsMotion() {
+	return planTargetMotion(mpTargetJoints_);
+}
+// Obtain motion plan based on target Affine matrix
+bool Controller::planTargetMotion(Eigen::Affine3d target_affine,
+		const std::string end_effector_link) {
 
-bool Controller::planTargetPoseMotion(const std::string end_effector_link) {
+	geometry_msgs::Pose target_pose;
+	Eigen::Quaterniond q(target_affine.rotation());
+	target_pose.position.x = target_affine.translation().x();
+	target_pose.position.y = target_affine.translation().y();
+	target_pose.position.z = target_affine.translation().z();
+	target_pose.orientation.x = q.x();
+	target_pose.orientation.y = q.y();
+	target_pose.orientation.z = q.z();
+	target_pose.orientation.w = q.w();
+	return planTargetMotion(target_pose, end_effector_link);
+}
+bool Controller::planTargetAffineMotion(const std::string end_effector_link) {
+	return planTargetMotion(dtTargetAffine_, end_effector_link);
+}
 
-	pdtMoveGroup_->clearPoseTarget();
-	pdtMoveGroup_->setPoseTarget(dtTargetPose_, end_effector_link);
-	pdtMoveGroup_->setStartState(*pdtMoveGroup_->getCurrentState());
+// Obtain motion plan based on target joint values, asynchronously
+PlanHandle Controller::planAsync(std::map<std::string, double> target_joints,
+		double deadline, MotionPlanPtr start_after) {
+	PlanHandle handle(new PlanRequest(target_joints, deadline));
+	handle->setStartAfter(start_after);
+	return submitPlan(handle);
+}
 
-	bPlanSuccess_ = pdtMoveGroup_->plan(dtMotionPlan_);
-	ROS_INFO("Motion plan %s", bPlanSuccess_ ? "SUCCEEDED" : "FAILED");
+// Obtain motion plan based on target pose, asynchronously
+PlanHandle Controller::planAsync(geometry_msgs::Pose target_pose,
+		const std::string end_effector_link, double deadline,
+		MotionPlanPtr start_after) {
+	PlanHandle handle(
+			new PlanRequest(target_pose, end_effector_link, deadline));
+	handle->setStartAfter(start_after);
+	return submitPlan(handle);
+}
 
+// Obtain Cartesian path to target pose, blocks until it is planned
+bool Controller::planCartesianMotion(geometry_msgs::Pose target_pose,
+		const std::string end_effector_link) {
+	PlanHandle handle = planCartesianAsync(target_pose, end_effector_link);
+	handle->wait();
+	bPlanSuccess_ = handle->getStatus() == PlanRequest::Succeeded;
+	pdtCartesianMotionPlan_ = handle->getMotionPlan();
 	return bPlanSuccess_;
 }
 
-// Obtain motion plan based on target joint values
-bool Controller::planTargetMotion(std::map<std::string, double> target_joints) {
-
-	pdtMoveGroup_->clearPoseTarget();
-	pdtMoveGroup_->setJointValueTarget(target_joints);
-	pdtMoveGroup_->setStartState(*pdtMoveGroup_->getCurrentState());
+// Obtain Cartesian path to target pose, asynchronously
+PlanHandle Controller::planCartesianAsync(geometry_msgs::Pose target_pose,
+		const std::string end_effector_link, double deadline,
+		MotionPlanPtr start_after) {
+	PlanHandle handle(
+			new PlanRequest(target_pose, end_effector_link, deadline));
+	handle->setCartesian(true);
+	handle->setStartAfter(start_after);
+	return submitPlan(handle);
+}
 
-	bPlanSuccess_ = pdtMoveGroup_->plan(dtMotionPlan_);
-	ROS_INFO("Motion plan %s", bPlanSuccess_ ? "SUCCEEDED" : "FAILED");
+PlanHandle Controller::submitPlan(PlanHandle handle) {
+	ROS_INFO("Motion plan %d queued", handle->getId());
+	dtPlanningPool_.start(new PlanTask(this, handle));
+	return handle;
+}
 
+bool Controller::waitForPlan(PlanHandle handle) {
+	handle->wait();
+	bPlanSuccess_ = handle->getStatus() == PlanRequest::Succeeded;
+	if (bPlanSuccess_)
+		pdtMotionPlan_ = handle->getMotionPlan();
 	return bPlanSuccess_;
 }
-bool Controller::planTargetJointsMotion() {
 
-	pdtMoveGroup_->clearPoseTarget();
-	pdtMoveGroup_->setJointValueTarget(mpTargetJoints_);
-	pdtMoveGroup_->setStartState(*pdtMoveGroup_->getCurrentState());
+void Controller::runPlanRequest(PlanHandle handle) {
+	// Shared as it is once finished, never copied again
+	boost::shared_ptr<MotionPlan> motion_plan(new MotionPlan());
+	PlanRequest::Status status = PlanRequest::Cancelled;
+	if (handle->start()) {
+		bool success = planRequest(*handle, *motion_plan);
+		if (handle->isCancelled())
+			status = PlanRequest::Cancelled;
+		else if (handle->isOverdue())
+			status = PlanRequest::TimedOut;
+		else
+			status = success ? PlanRequest::Succeeded : PlanRequest::Failed;
+	}
+	ROS_INFO("Motion plan %d %s", handle->getId(),
+			PlanRequest::getStatusName(status));
+	handle->finish(status, motion_plan);
+	emit planFinished(handle);
+}
 
-	bPlanSuccess_ = pdtMoveGroup_->plan(dtMotionPlan_);
-	ROS_INFO("Motion plan %s", bPlanSuccess_ ? "SUCCEEDED" : "FAILED");
+bool Controller::planRequest(const PlanRequest& request,
+		MotionPlan& motion_plan) {
+	if (request.isOverdue())
+		return false;
+	moveit::planning_interface::MoveGroup& move_group = *pdtPlanningMoveGroup_;
+
+	// Start from the end of the given plan, the rest of the state is current
+	robot_state::RobotStatePtr start_state = move_group.getCurrentState();
+	MotionPlanPtr start_after = request.getStartAfter();
+	if (start_after) {
+		const trajectory_msgs::JointTrajectory& trajectory =
+				start_after->trajectory_.joint_trajectory;
+		if (!trajectory.points.empty())
+			start_state->setVariablePositions(trajectory.joint_names,
+					trajectory.points.back().positions);
+	}
+	if (request.isCartesian())
+		return planCartesian(*start_state, request, motion_plan);
+	move_group.setStartState(*start_state);
+	double remaining = request.getRemainingTime();
+	move_group.setPlanningTime(
+			remaining > 0.0 ? remaining : CONTROLLER_DEFAULT_PLANNING_TIME);
+
+	std::vector<double> start;
+	start_state->copyJointGroupPositions(move_group.getName(), start);
+	uint64_t revision;
+	bool cacheable = getSceneRevision(revision);
+	PlanCache::Key key;
+	moveit_msgs::Constraints goal;
+	move_group.clearPoseTargets();
+	if (request.isJointGoal()) {
+		move_group.setJointValueTarget(request.getTargetJoints());
+		key = dtPlanCache_.makeKey(start, request.getTargetJoints(), revision);
+		robot_state::RobotState goal_state(*start_state);
+		goal_state.setVariablePositions(request.getTargetJoints());
+		goal = kinematic_constraints::constructGoalConstraints(goal_state,
+				goal_state.getJointModelGroup(move_group.getName()),
+				move_group.getGoalJointTolerance());
+	} else {
+		move_group.setPoseTarget(request.getTargetPose(),
+				request.getEndEffectorLink());
+		key = dtPlanCache_.makeKey(start, request.getTargetPose(),
+				request.getEndEffectorLink(), revision);
+		geometry_msgs::PoseStamped target;
+		target.header.frame_id = move_group.getPlanningFrame();
+		target.pose = request.getTargetPose();
+		goal = kinematic_constraints::constructGoalConstraints(
+				request.getEndEffectorLink(), target,
+				move_group.getGoalPositionTolerance(),
+				move_group.getGoalOrientationTolerance());
+	}
+	return planMotion(*start_state, goal, cacheable ? &key : NULL, request,
+			motion_plan);
+}
 
-	return bPlanSuccess_;
+bool Controller::planCartesian(robot_state::RobotState& start_state,
+		const PlanRequest& request, MotionPlan& motion_plan) {
+	if (!dtCartesianPlanner_.isValid()) {
+		ROS_ERROR("Controller: Cartesian planner is not loaded");
+		return false;
+	}
+	if (request.getEndEffectorLink() != strCartesianTip_) {
+		ROS_ERROR("Controller: Cartesian path of %s is not supported",
+				request.getEndEffectorLink().c_str());
+		return false;
+	}
+
+	const robot_model::JointModelGroup* group =
+			start_state.getJointModelGroup(pdtPlanningMoveGroup_->getName());
+	std::vector<double> start_joints;
+	start_state.copyJointGroupPositions(group, start_joints);
+	Eigen::Affine3d start = start_state.getGlobalLinkTransform(
+			strCartesianTip_);
+	const geometry_msgs::Pose& target_pose = request.getTargetPose();
+	Eigen::Affine3d end = Eigen::Translation3d(target_pose.position.x,
+			target_pose.position.y, target_pose.position.z)
+			* Eigen::Quaterniond(target_pose.orientation.w,
+					target_pose.orientation.x, target_pose.orientation.y,
+					target_pose.orientation.z);
+
+	ros::WallTime begin = ros::WallTime::now();
+	CartesianPlanner::TrajectoryVec path;
+	if (!dtCartesianPlanner_.makeLinePath(start_joints, start, end, path)) {
+		ROS_ERROR("Controller: Cartesian path is shorter than one step");
+		return false;
+	}
+	trajectory_msgs::JointTrajectory& trajectory =
+			motion_plan.trajectory_.joint_trajectory;
+	if (!dtCartesianPlanner_.plan(path, group->getVariableNames(),
+			trajectory))
+		return false;
+	trajectory.header.frame_id = pdtPlanningMoveGroup_->getPlanningFrame();
+	moveit::core::robotStateToRobotStateMsg(start_state,
+			motion_plan.start_state_);
+	motion_plan.planning_time_ = (ros::WallTime::now() - begin).toSec();
+	// Descartes checks self collision only, the scene is checked here
+	if (!checkMotionPlan(motion_plan)) {
+		ROS_ERROR("Controller: Cartesian path is in collision");
+		return false;
+	}
+	ROS_INFO("Controller: Cartesian path of %d points, %.3f s",
+			(int) trajectory.points.size(), motion_plan.planning_time_);
+	return true;
 }
-// Obtain motion plan based on target Affine matrix
-bool Controller::planTargetMotion(Eigen::Affine3d target_affine,
-		const std::string end_effector_link) {
 
-	pdtMoveGroup_->clearPoseTarget();
-	pdtMoveGroup_->setPoseTarget(target_affine, end_effector_link);
-	pdtMoveGroup_->setStartState(*pdtMoveGroup_->getCurrentState());
+bool Controller::planMotion(const robot_state::RobotState& start_state,
+		const moveit_msgs::Constraints& goal, const PlanCache::Key* key,
+		const PlanRequest& request, MotionPlan& motion_plan) {
+
+	if (key != NULL && dtPlanCache_.lookup(*key, motion_plan)) {
+		ros::WallTime begin = ros::WallTime::now();
+		// Start exactly at the start state, it is within the quantum of
+		// the cached start
+		moveit::core::robotStateToRobotStateMsg(start_state,
+				motion_plan.start_state_);
+		trajectory_msgs::JointTrajectory& trajectory =
+				motion_plan.trajectory_.joint_trajectory;
+		if (!trajectory.points.empty())
+			for (size_t i = 0; i < trajectory.joint_names.size()
+					&& i < trajectory.points[0].positions.size(); i++)
+				trajectory.points[0].positions[i] =
+						start_state.getVariablePosition(
+								trajectory.joint_names[i]);
+		// The cached goal is within the quantum of the requested one only
+		if (checkMotionPlan(motion_plan, &goal)) {
+			dtPlanCache_.accept(*key,
+					(ros::WallTime::now() - begin).toSec());
+			ROS_INFO("Motion plan reused from cache");
+			dtPlanCache_.report();
+			return true;
+		}
+		ROS_INFO("Cached motion plan is no longer valid, replanning");
+		dtPlanCache_.reject(*key);
+	}
 
-	bPlanSuccess_ = pdtMoveGroup_->plan(dtMotionPlan_);
-	ROS_INFO("Motion plan %s", bPlanSuccess_ ? "SUCCEEDED" : "FAILED");
+	ros::WallTime begin = ros::WallTime::now();
+	if (bPortfolioPlanning_ ?
+			!planPortfolio(start_state, goal, request, motion_plan) :
+			!pdtPlanningMoveGroup_->plan(motion_plan))
+		return false;
+	if (key != NULL) {
+		dtPlanCache_.insert(*key, motion_plan,
+				(ros::WallTime::now() - begin).toSec());
+		if (!strPlanCacheFile_.empty())
+			dtPlanCache_.save(strPlanCacheFile_);
+		dtPlanCache_.report();
+	}
+	return true;
+}
 
-	return bPlanSuccess_;
+bool Controller::planPortfolio(const robot_state::RobotState& start_state,
+		const moveit_msgs::Constraints& goal, const PlanRequest& request,
+		MotionPlan& motion_plan) {
+
+	moveit_msgs::MotionPlanRequest plan_request;
+	plan_request.group_name = pdtPlanningMoveGroup_->getName();
+	moveit::core::robotStateToRobotStateMsg(start_state,
+			plan_request.start_state);
+	plan_request.goal_constraints.push_back(goal);
+	double remaining = request.getRemainingTime();
+	plan_request.allowed_planning_time = remaining > 0.0 ? remaining : 0.0;
+
+	// Planners read the snapshot concurrently, the monitor keeps updating
+	planning_scene::PlanningScenePtr scene;
+	{
+		planning_scene_monitor::LockedPlanningSceneRO locked_scene(
+				pdtPlanningSceneMonitor_);
+		scene = planning_scene::PlanningScene::clone(locked_scene);
+	}
+	bool success = pdtPlannerPortfolio_->plan(scene, plan_request,
+			motion_plan, request.getCancelFlag());
+	pdtPlannerPortfolio_->report();
+	return success;
 }
-bool Controller::planTargetAffineMotion(const std::string end_effector_link) {
 
-	pdtMoveGroup_->clearPoseTarget();
-	pdtMoveGroup_->setPoseTarget(dtTargetAffine_, end_effector_link);
-	pdtMoveGroup_->setStartState(*pdtMoveGroup_->getCurrentState());
+bool Controller::getSceneRevision(uint64_t& revision) {
+	moveit_msgs::GetPlanningScene srv;
+	srv.request.components.components =
+			moveit_msgs::PlanningSceneComponents::WORLD_OBJECT_NAMES
+					| moveit_msgs::PlanningSceneComponents::WORLD_OBJECT_GEOMETRY
+					| moveit_msgs::PlanningSceneComponents::ROBOT_STATE_ATTACHED_OBJECTS
+					| moveit_msgs::PlanningSceneComponents::ALLOWED_COLLISION_MATRIX;
+	if (!dtGetPlanningSceneClient_.call(srv)) {
+		ROS_WARN("Controller: get_planning_scene failed, plan cache bypassed");
+		return false;
+	}
 
-	bPlanSuccess_ = pdtMoveGroup_->plan(dtMotionPlan_);
-	ROS_INFO("Motion plan %s", bPlanSuccess_ ? "SUCCEEDED" : "FAILED");
+	// Hash only what collision checking depends on, stamps are cleared
+	moveit_msgs::PlanningScene& scene = srv.response.scene;
+	for (size_t i = 0; i < scene.world.collision_objects.size(); i++)
+		scene.world.collision_objects[i].header.stamp = ros::Time();
+	std::vector<moveit_msgs::AttachedCollisionObject>& attached =
+			scene.robot_state.attached_collision_objects;
+	for (size_t i = 0; i < attached.size(); i++)
+		attached[i].object.header.stamp = ros::Time();
+	uint32_t len = ros::serialization::serializationLength(scene.world)
+			+ ros::serialization::serializationLength(attached)
+			+ ros::serialization::serializationLength(
+					scene.allowed_collision_matrix);
+	std::vector<uint8_t> buffer(len);
+	ros::serialization::OStream stream(&buffer[0], len);
+	ros::serialization::serialize(stream, scene.world);
+	ros::serialization::serialize(stream, attached);
+	ros::serialization::serialize(stream, scene.allowed_collision_matrix);
+
+	// 64 bit FNV-1a
+	revision = 14695981039346656037ULL;
+	for (size_t i = 0; i < buffer.size(); i++) {
+		revision ^= buffer[i];
+		revision *= 1099511628211ULL;
+	}
+	return true;
+}
 
-	return bPlanSuccess_;
+bool Controller::checkMotionPlan(const MotionPlan& motion_plan,
+		const moveit_msgs::Constraints* goal) {
+	const trajectory_msgs::JointTrajectory& trajectory =
+			motion_plan.trajectory_.joint_trajectory;
+	if (trajectory.points.empty())
+		return false;
+	if (!pdtPlanningSceneMonitor_) {
+		ROS_WARN("Controller: planning scene not monitored, plan rejected");
+		return false;
+	}
+
+	// Only joints of the trajectory are given, the rest of the state and
+	// attached objects are taken from the monitored scene
+	planning_scene_monitor::LockedPlanningSceneRO scene(
+			pdtPlanningSceneMonitor_);
+	robot_state::RobotState state(scene->getCurrentState());
+	const std::string& group = pdtMoveGroup_->getName();
+	for (size_t i = 0; i < trajectory.points.size(); i++) {
+		state.setVariablePositions(trajectory.joint_names,
+				trajectory.points[i].positions);
+		state.update();
+		if (!scene->isStateValid(state, group))
+			return false;
+	}
+	if (goal == NULL)
+		return true;
+
+	// Last point within the tolerances of goal
+	kinematic_constraints::KinematicConstraintSet constraints(
+			scene->getRobotModel());
+	constraints.add(*goal, scene->getTransforms());
+	return constraints.decide(state).satisfied;
 }
 
 // Execute motion plan
-bool Controller::executeMotionPlan(
-		moveit::planning_interface::MoveGroup::Plan motion_plan) {
+bool Controller::executeMotionPlan(MotionPlanPtr motion_plan) {
+	MotionPlanPtr plan = retimeMotionPlan(motion_plan);
 #ifdef KUKA_SIM
-	dtMotionStatus_ = pdtMoveGroup_->execute(motion_plan);
+	dtMotionStatus_ = pdtMoveGroup_->execute(*plan);
 	if (dtMotionStatus_.val != moveit_msgs::MoveItErrorCodes::SUCCESS) {
 		ROS_INFO("Motion execution failed");
 		return false;
@@ -200,15 +672,21 @@ bool Controller::executeMotionPlan(
 	dtKukaFeedbackReceiver_.bLastCommandComplete_ = false;
 	dtKukaFeedbackReceiver_.dtLastCommandCompleteLock_.unlock();
 	ROS_INFO("Controller thread: %lu", QThread::currentThreadId());
-	emit sendTrajectorySignal((const MotionPlan) motion_plan);
+	setExecutingPlan(plan);
+	emit sendTrajectorySignal(plan);
 	ROS_INFO("Trajectory sended");
 	return true;
 #endif
 
 }
 bool Controller::executeMotionPlan() {
+	if (!pdtMotionPlan_) {
+		ROS_ERROR("Controller: No motion plan to execute");
+		return false;
+	}
+	MotionPlanPtr plan = retimeMotionPlan(pdtMotionPlan_);
 #ifdef KUKA_SIM
-	dtMotionStatus_ = pdtMoveGroup_->execute(dtMotionPlan_);
+	dtMotionStatus_ = pdtMoveGroup_->execute(*plan);
 	if (dtMotionStatus_.val != moveit_msgs::MoveItErrorCodes::SUCCESS) {
 		ROS_INFO("Motion execution failed");
 		return false;
@@ -221,17 +699,18 @@ bool Controller::executeMotionPlan() {
 	dtKukaFeedbackReceiver_.bLastCommandComplete_ = false;
 	dtKukaFeedbackReceiver_.dtLastCommandCompleteLock_.unlock();
 	ROS_INFO("Controller thread: %lu", QThread::currentThreadId());
-	emit sendTrajectorySignal((const MotionPlan) dtMotionPlan_);
+	setExecutingPlan(plan);
+	emit sendTrajectorySignal(plan);
 	ROS_INFO("Trajectory sended");
 	return true;
 #endif
 
 }
 // Async execute motion plan
-bool Controller::asyncExecuteMotionPlan(
-		moveit::planning_interface::MoveGroup::Plan motion_plan) {
+bool Controller::asyncExecuteMotionPlan(MotionPlanPtr motion_plan) {
+	MotionPlanPtr plan = retimeMotionPlan(motion_plan);
 #ifdef KUKA_SIM
-	dtMotionStatus_ = pdtMoveGroup_->asyncExecute(motion_plan);
+	dtMotionStatus_ = pdtMoveGroup_->asyncExecute(*plan);
 	if (dtMotionStatus_.val != moveit_msgs::MoveItErrorCodes::SUCCESS) {
 		ROS_INFO("Async motion execution failed");
 		return false;
@@ -244,13 +723,19 @@ bool Controller::asyncExecuteMotionPlan(
 	dtKukaFeedbackReceiver_.bLastCommandComplete_ = false;
 	dtKukaFeedbackReceiver_.dtLastCommandCompleteLock_.unlock();
 
-	emit sendTrajectorySignal((const MotionPlan) motion_plan);
+	setExecutingPlan(plan);
+	emit sendTrajectorySignal(plan);
 	return true;
 #endif
 }
 bool Controller::asyncExecuteMotionPlan() {
+	if (!pdtMotionPlan_) {
+		ROS_ERROR("Controller: No motion plan to execute");
+		return false;
+	}
+	MotionPlanPtr plan = retimeMotionPlan(pdtMotionPlan_);
 #ifdef KUKA_SIM
-	dtMotionStatus_ = pdtMoveGroup_->asyncExecute(dtMotionPlan_);
+	dtMotionStatus_ = pdtMoveGroup_->asyncExecute(*plan);
 	if (dtMotionStatus_.val != moveit_msgs::MoveItErrorCodes::SUCCESS) {
 		ROS_INFO("Async motion execution failed");
 		return false;
@@ -263,12 +748,75 @@ bool Controller::asyncExecuteMotionPlan() {
 	dtKukaFeedbackReceiver_.bLastCommandComplete_ = false;
 	dtKukaFeedbackReceiver_.dtLastCommandCompleteLock_.unlock();
 
-	emit sendTrajectorySignal((const MotionPlan) dtMotionPlan_);
+	setExecutingPlan(plan);
+	emit sendTrajectorySignal(plan);
+	return true;
+#endif
+}
+// Retime motion plan for execution
+MotionPlanPtr Controller::retimeMotionPlan(MotionPlanPtr motion_plan) {
+	RetimeResult result;
+	boost::shared_ptr<MotionPlan> plan;
+	if (bRetimePlans_) {
+		// motion_plan may be shared, e.g. visualized, the copy is retimed
+		plan.reset(new MotionPlan(*motion_plan));
+		if (!dtRetimer_.retime(plan->trajectory_.joint_trajectory, result))
+			plan.reset();
+	}
+	if (!plan) {
+#ifndef KUKA_SIM
+		// No speed of an earlier retimed plan is left, without retiming the
+		// speed of the KRL program is never touched
+		if (bRetimePlans_)
+			emit resetSpeedSignal();
+#endif
+		return motion_plan;
+	}
+	ROS_INFO(
+			"Controller: plan retimed from %.2f s to %.2f s (%.0f%% shorter), $VEL_PTP %.0f%%, $ACC_PTP %.0f%%",
+			result.originalDuration, result.duration,
+			result.originalDuration > 0.0 ?
+					100.0 * (1.0 - result.duration / result.originalDuration) :
+					0.0, result.velocityPercent, result.accelerationPercent);
+#ifndef KUKA_SIM
+	emit sendSpeedSignal(result.velocityPercent, result.accelerationPercent,
+			result.duration);
+#endif
+	return plan;
+}
+// Execute Cartesian motion plan
+bool Controller::executeCartesianMotionPlan() {
+	MotionPlanPtr plan = pdtCartesianMotionPlan_;
+	pdtCartesianMotionPlan_.reset();
+	if (!plan) {
+		ROS_ERROR("Controller: No Cartesian path to execute");
+		return false;
+	}
+#ifdef KUKA_SIM
+	dtMotionStatus_ = pdtMoveGroup_->execute(*plan);
+	if (dtMotionStatus_.val != moveit_msgs::MoveItErrorCodes::SUCCESS) {
+		ROS_INFO("Cartesian motion execution failed");
+		return false;
+	} else {
+		ROS_INFO("Cartesian motion execution succeeded");
+		return true;
+	}
+#else
+	dtKukaFeedbackReceiver_.dtLastCommandCompleteLock_.lockForWrite();
+	dtKukaFeedbackReceiver_.bLastCommandComplete_ = false;
+	dtKukaFeedbackReceiver_.dtLastCommandCompleteLock_.unlock();
+
+	// LIN motions are not retimed
+	if (bRetimePlans_)
+		emit resetSpeedSignal();
+	setExecutingPlan(plan);
+	emit sendCartesianTrajectorySignal(plan);
 	return true;
 #endif
 }
 void Controller::visualizeMotionPlan() {
-	emit visualizeMotionPlan(dtMotionPlan_);
+	if (pdtMotionPlan_)
+		emit visualizeMotionPlan(pdtMotionPlan_);
 }
 
 void Controller::stopMotion() {
@@ -292,35 +840,106 @@ void Controller::endEffectorPosCb(
 	if (feedback->mouse_point_valid) {
 		dtEndEffectorPos_ = feedback->pose;
 	}
+	if (bServoMode_) {
+		// Marker pose in mm and KUKA ABC angles, as Interface shows it
+		double a, b, c;
+		KDL::Rotation::Quaternion(feedback->pose.orientation.x,
+				feedback->pose.orientation.y, feedback->pose.orientation.z,
+				feedback->pose.orientation.w).GetRPY(c, b, a);
+		emit servoTargetSignal(
+				Frame(feedback->pose.position.x * 1000.0,
+						feedback->pose.position.y * 1000.0,
+						feedback->pose.position.z * 1000.0, a / M_PI * 180.0,
+						b / M_PI * 180.0, c / M_PI * 180.0));
+	}
+}
+// Twist in m/s and rad/s of the base, the angular velocity about Z, Y, X
+// is passed as A, B, C and integrated by Plannar::servoTick
+void Controller::servoTwistCb(const geometry_msgs::TwistConstPtr& twist) {
+	if (!bServoMode_)
+		return;
+	emit servoVelocitySignal(
+			Frame(twist->linear.x * 1000.0, twist->linear.y * 1000.0,
+					twist->linear.z * 1000.0, twist->angular.z / M_PI * 180.0,
+					twist->angular.y / M_PI * 180.0,
+					twist->angular.x / M_PI * 180.0));
+}
+void Controller::setServoMode(bool servo_mode) {
+	if (servo_mode == bServoMode_)
+		return;
+	bServoMode_ = servo_mode;
+	if (bServoMode_)
+		emit startServoSignal();
+	else
+		emit stopServoSignal();
 }
+bool Controller::getServoMode() {
+	return bServoMode_;
+}
+void Controller::toggleServoMode() {
+	setServoMode(!bServoMode_);
+}
+void Controller::cartesianPathCb() {
+	if (!planCartesianMotion(dtEndEffectorPos_, strCartesianTip_))
+		return;
+	emit visualizeMotionPlan(pdtCartesianMotionPlan_);
+	executeCartesianMotionPlan();
+}
+// Plan the waypoints as one chain, segment k + 1 starts at the end of
+// segment k and is planned while segment k streams to the robot
 void Controller::visualizeExecutePlanCb() {
 
-	moveit::planning_interface::MoveGroup::Plan temp_plan;
-
-	for (int i = 0; i < vecdtWaypoints_.size(); i++) {
-
-		pdtMoveGroup_->setPoseTarget(vecdtWaypoints_[i], "tip");
-		pdtMoveGroup_->setStartState(*pdtMoveGroup_->getCurrentState());
-
-		bool success = pdtMoveGroup_->plan(temp_plan);
-		ROS_INFO("Controller: visualizing plan (pose goal) %s",
-				success ? "" : "FAILED");
-		if (success) {
-#ifdef KUKA_SIM
-			pdtMoveGroup_->execute(temp_plan);
-#else
-			dtKukaFeedbackReceiver_.dtLastCommandCompleteLock_.lockForWrite();
-			dtKukaFeedbackReceiver_.bLastCommandComplete_ = false;
-			dtKukaFeedbackReceiver_.dtLastCommandCompleteLock_.unlock();
-
-			emit sendTrajectorySignal((const MotionPlan) temp_plan);
-#endif
-		} else {
+	// Only shared once all the segments are appended
+	boost::shared_ptr<MotionPlan> trajectory(new MotionPlan());
+	PlanHandle handle;
+	if (!vecdtWaypoints_.empty())
+		handle = planAsync(vecdtWaypoints_[0], "tip", 0.0,
+				getExecutingPlan());
+
+	for (size_t i = 0; i < vecdtWaypoints_.size(); i++) {
+		handle->wait();
+		ROS_INFO("Controller: planning waypoint %d %s", (int) i + 1,
+				PlanRequest::getStatusName(handle->getStatus()));
+		if (handle->getStatus() != PlanRequest::Succeeded) {
 			// This one ensures that no unreachable motion command will be sent to Kuka,
 			// so no need to do reachable check in plannar_ object
 			ROS_ERROR(
-					"Controller: error while planning position of arm, no move command was sent!\n");
+					"Controller: error while planning position of arm, no further move command was sent!\n");
+#ifndef KUKA_SIM
+			// The streamed segments end with C_DIS, stop exactly at the
+			// last point sent
+			if (!trajectory->trajectory_.joint_trajectory.points.empty()) {
+				boost::shared_ptr<MotionPlan> stop(new MotionPlan());
+				stop->trajectory_.joint_trajectory.points.assign(2,
+						trajectory->trajectory_.joint_trajectory.points.back());
+				emit appendTrajectorySignal(stop, true);
+			}
+#endif
+			break;
 		}
+		MotionPlanPtr segment = handle->getMotionPlan();
+		bool last = i + 1 == vecdtWaypoints_.size();
+		if (!last)
+			handle = planAsync(vecdtWaypoints_[i + 1], "tip", 0.0, segment);
+		appendMotionPlan(*trajectory, *segment);
+#ifndef KUKA_SIM
+		dtKukaFeedbackReceiver_.dtLastCommandCompleteLock_.lockForWrite();
+		dtKukaFeedbackReceiver_.bLastCommandComplete_ = false;
+		dtKukaFeedbackReceiver_.dtLastCommandCompleteLock_.unlock();
+
+		// Plans from the executing motion start at its last point, which is
+		// the end of the latest segment
+		setExecutingPlan(segment);
+		emit appendTrajectorySignal(retimeMotionPlan(segment), last);
+#endif
+	}
+
+	if (!trajectory->trajectory_.joint_trajectory.points.empty()) {
+#ifdef KUKA_SIM
+		pdtMoveGroup_->execute(*trajectory);
+#endif
+		pdtMotionPlan_ = trajectory;
+		emit visualizeMotionPlan(pdtMotionPlan_);
 	}
 
 	vecdtWaypoints_.clear();
@@ -333,47 +952,67 @@ void Controller::addCollisionObject(std::string collision_id,
 		shape_msgs::SolidPrimitive collision_shape,
 		geometry_msgs::Pose collision_pose) {
 
-	dtCollisionObject_.header.frame_id = pdtMoveGroup_->getPlanningFrame();
-
-	/* The id of the object is used to identify it. */
-	dtCollisionObject_.id = collision_id;
-
-	dtCollisionObject_.primitives.push_back(collision_shape);
-	dtCollisionObject_.primitive_poses.push_back(collision_pose);
-	dtCollisionObject_.operation = moveit_msgs::CollisionObject::ADD;
-
-	vecdtCollisionObjects_.push_back(dtCollisionObject_);
-
+	dtSceneTransaction_.add(collision_id, collision_shape, collision_pose);
 }
 void Controller::addCollisionObject(std::string collision_id) {
 
-	dtCollisionObject_.header.frame_id = pdtMoveGroup_->getPlanningFrame();
-
-	/* The id of the object is used to identify it. */
-	dtCollisionObject_.id = collision_id;
-
-	dtCollisionObject_.primitives.push_back(dtCollisionShape_);
-	dtCollisionObject_.primitive_poses.push_back(dtCollisionPose_);
-	dtCollisionObject_.operation = moveit_msgs::CollisionObject::ADD;
-
-	vecdtCollisionObjects_.push_back(dtCollisionObject_);
+	dtSceneTransaction_.add(collision_id, dtCollisionShape_,
+			dtCollisionPose_);
+}
+// Add collision object to be moved to wait list
+void Controller::moveCollisionObject(std::string collision_id,
+		geometry_msgs::Pose collision_pose) {
 
+	dtSceneTransaction_.move(collision_id, collision_pose);
 }
 // Add collision object to be removed to wait list
 void Controller::removeCollisionObject(std::string collision_id) {
 
-	vecstrRemoveCollisionIds_.push_back(collision_id);
+	dtSceneTransaction_.remove(collision_id);
 }
 // Update work cell
-void Controller::updateWorkcell() {
+bool Controller::updateWorkcell() {
 
-	ROS_INFO("Add collision objects into the world");
-	dtPlanningSceneInterface_.addCollisionObjects(vecdtCollisionObjects_);
-	dtPlanningSceneInterface_.removeCollisionObjects(vecstrRemoveCollisionIds_);
+	ROS_INFO("Update collision objects of the world");
+	bool success = commitScene(dtSceneTransaction_);
+	// Clear the wait list, a change not acknowledged may still be applied
+	dtSceneTransaction_.clear();
+	return success;
+}
 
-	// Clear the contents of collision_objects_ and remove_collision_ids
-	vecdtCollisionObjects_.clear();
-	vecstrRemoveCollisionIds_.clear();
+bool Controller::commitScene(SceneTransaction& transaction, double timeout) {
+	return transaction.commit(dtPlanningSceneDiffPublisher_,
+			dtGetPlanningSceneClient_, timeout);
+}
+
+bool Controller::loadWorkcell(std::string fn) {
+	std::string workcell_xml, robot_xml;
+	if (fn.empty()) {
+		if (!ros::param::get("workcell_description", workcell_xml)) {
+			std::cout
+					<< "Controller::loadWorkcell: Parameter workcell_description not found"
+					<< std::endl;
+			return false;
+		}
+	} else {
+		std::ifstream in(fn.c_str());
+		if (!in) {
+			std::cout << "Controller::loadWorkcell: Cannot open " << fn
+					<< std::endl;
+			return false;
+		}
+		std::stringstream ss;
+		ss << in.rdbuf();
+		workcell_xml = ss.str();
+	}
+	ros::param::get("robot_description", robot_xml);
+
+	SceneTransaction transaction(pdtMoveGroup_->getPlanningFrame());
+	int count = transaction.addURDF(workcell_xml, robot_xml);
+	if (count < 0)
+		return false;
+	ROS_INFO("Controller: %d workcell objects", count);
+	return commitScene(transaction);
 }
 
 Plannar* Controller::getPlannar() {
@@ -383,8 +1022,8 @@ boost::shared_ptr<moveit::planning_interface::MoveGroup> Controller::getMoveGrou
 	return pdtMoveGroup_;
 }
 
-moveit::planning_interface::MoveGroup::Plan& Controller::getMotionPlan() {
-	return dtMotionPlan_;
+MotionPlanPtr Controller::getMotionPlan() {
+	return pdtMotionPlan_;
 }
 
 geometry_msgs::Pose& Controller::getTargetPose() {
@@ -402,6 +1041,38 @@ geometry_msgs::Pose& Controller::getEndEffectorPos() {
 	return dtEndEffectorPos_;
 }
 
+PlanCache& Controller::getPlanCache() {
+	return dtPlanCache_;
+}
+
+boost::shared_ptr<PlannerPortfolio> Controller::getPlannerPortfolio() {
+	return pdtPlannerPortfolio_;
+}
+
+bool Controller::getPortfolioPlanning() {
+	return bPortfolioPlanning_;
+}
+
+MotionPlanPtr Controller::getExecutingPlan() {
+#ifdef KUKA_SIM
+	// MoveGroup executes the plan, its progress is not known here
+	return MotionPlanPtr();
+#else
+	dtKukaFeedbackReceiver_.dtLastCommandCompleteLock_.lockForRead();
+	bool executing = !dtKukaFeedbackReceiver_.bLastCommandComplete_;
+	dtKukaFeedbackReceiver_.dtLastCommandCompleteLock_.unlock();
+	if (!executing)
+		return MotionPlanPtr();
+	QMutexLocker locker(&dtExecutingPlanLock_);
+	return pdtExecutingPlan_;
+#endif
+}
+
+void Controller::setExecutingPlan(MotionPlanPtr plan) {
+	QMutexLocker locker(&dtExecutingPlanLock_);
+	pdtExecutingPlan_ = plan;
+}
+
 Axis Controller::getFeedbackAxis() {
 	Axis feedback_axis;
 	dtKukaFeedbackReceiver_.dtFeedbackLock_.lockForRead();
@@ -410,9 +1081,8 @@ Axis Controller::getFeedbackAxis() {
 	return feedback_axis;
 }
 
-void Controller::setMotionPlan(
-		moveit::planning_interface::MoveGroup::Plan motion_plan) {
-	dtMotionPlan_ = motion_plan;
+void Controller::setMotionPlan(MotionPlanPtr motion_plan) {
+	pdtMotionPlan_ = motion_plan;
 }
 
 void Controller::setTargetPose(geometry_msgs::Pose target_pose) {
@@ -427,3 +1097,12 @@ void Controller::setTargetAffine(Eigen::Affine3d target_affine) {
 	dtTargetAffine_ = target_affine;
 }
 
+bool Controller::setPortfolioPlanning(bool portfolio_planning) {
+	if (portfolio_planning && !pdtPlannerPortfolio_) {
+		ROS_ERROR("Controller: portfolio planning is not configured");
+		return false;
+	}
+	bPortfolioPlanning_ = portfolio_planning;
+	return true;
+}
+
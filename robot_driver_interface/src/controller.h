@@ -12,9 +12,22 @@
 #define KRC_CONTROLLER
 
 #include "plannar.h"
+#include "plancache.h"
+#include "portfolio.h"
+#include "planrequest.h"
+#include "cartesian.h"
+#include "scenetransaction.h"
+#include "retimer.h"
 #include "KukaFeedback.h"
 #include "WaitForExecution.h"
 
+#include <geometry_msgs/Twist.h>
+#include <moveit/planning_scene_monitor/planning_scene_monitor.h>
+#include <QThreadPool>
+
+// Planning time of a request without deadline, in seconds
+#define CONTROLLER_DEFAULT_PLANNING_TIME 5.0
+
 using namespace visualization_msgs;
 using namespace interactive_markers;
 
@@ -32,18 +45,28 @@ public:
 
 // get function
 	boost::shared_ptr<moveit::planning_interface::MoveGroup> getMoveGroup();
-	moveit::planning_interface::MoveGroup::Plan& getMotionPlan();
+	// NULL if nothing is planned
+	MotionPlanPtr getMotionPlan();
 	std::map<std::string, double>& getTargetJoints();
 	geometry_msgs::Pose& getEndEffectorPos();
 	geometry_msgs::Pose& getTargetPose();
 	Eigen::Affine3d& getTargetAffine();
 	Plannar* getPlannar();
 	Axis getFeedbackAxis();
+	PlanCache& getPlanCache();
+	// NULL if portfolio planning is not configured
+	boost::shared_ptr<PlannerPortfolio> getPlannerPortfolio();
+	bool getPortfolioPlanning();
+	// Plan sent to the robot, NULL if the robot is not executing
+	MotionPlanPtr getExecutingPlan();
 // set function
-	void setMotionPlan(moveit::planning_interface::MoveGroup::Plan motion_plan);
+	void setMotionPlan(MotionPlanPtr motion_plan);
 	void setTargetPose(geometry_msgs::Pose target_pose);
 	void setTargetJoints(std::map<std::string, double> target_joints);
 	void setTargetAffine(Eigen::Affine3d target_affine);
+	// Plan with PlannerPortfolio instead of MoveGroup
+	// if return false, portfolio is not configured and nothing is changed
+	bool setPortfolioPlanning(bool portfolio_planning);
 
 // Motion planning related function
 	void addWaypoints(geometry_msgs::Pose waypoint_pose);
@@ -52,25 +75,73 @@ public:
 			const std::string end_effector_link = "tip");
 	bool planTargetMotion(Eigen::Affine3d target_affine,
 			const std::string end_effector_link = "tip");
-	bool executeMotionPlan(
-			moveit::planning_interface::MoveGroup::Plan motion_plan);
-	bool asyncExecuteMotionPlan(
-			moveit::planning_interface::MoveGroup::Plan motion_plan);
+	bool executeMotionPlan(MotionPlanPtr motion_plan);
+	bool asyncExecuteMotionPlan(MotionPlanPtr motion_plan);
 	bool planTargetJointsMotion();
 	bool planTargetPoseMotion(const std::string end_effector_link = "tip");
 	bool planTargetAffineMotion(const std::string end_effector_link = "tip");
+	// Asynchronous planning, returns at once and plans on the planning
+	// thread, the handle is emitted by planFinished when it is done
+	//  - deadline in seconds from now, 0 for none
+	//  - if start_after is not NULL, plan from its last point instead of
+	//      the current state, e.g. while the robot executes it
+	PlanHandle planAsync(std::map<std::string, double> target_joints,
+			double deadline = 0.0, MotionPlanPtr start_after = MotionPlanPtr());
+	PlanHandle planAsync(geometry_msgs::Pose target_pose,
+			const std::string end_effector_link = "tip", double deadline = 0.0,
+			MotionPlanPtr start_after = MotionPlanPtr());
+	// Cartesian path mode: the tip follows a straight line to target_pose,
+	// e.g. needle insertion, the plan is kept in pdtCartesianMotionPlan_
+	// and sent by executeCartesianMotionPlan
+	bool planCartesianMotion(geometry_msgs::Pose target_pose,
+			const std::string end_effector_link = "tip");
+	PlanHandle planCartesianAsync(geometry_msgs::Pose target_pose,
+			const std::string end_effector_link = "tip", double deadline = 0.0,
+			MotionPlanPtr start_after = MotionPlanPtr());
+	// Send pdtCartesianMotionPlan_ as LIN motions, once
+	// if return false, no Cartesian path is planned
+	bool executeCartesianMotionPlan();
+	// Servo mode: the robot follows the interactive marker, or the twists
+	// of topic servo_twist, without planning, see Plannar::startServo
+	void setServoMode(bool servo_mode);
+	bool getServoMode();
 
 	bool asyncExecuteMotionPlan();
 	void visualizeMotionPlan();
 	void stopMotion();
 
 // collision object related function
+	// Changes are collected in dtSceneTransaction_ until updateWorkcell
 	void addCollisionObject(std::string collision_id);
 	void addCollisionObject(std::string collision_id,
 			shape_msgs::SolidPrimitive collision_shape,
 			geometry_msgs::Pose collision_pose);
+	void moveCollisionObject(std::string collision_id,
+			geometry_msgs::Pose collision_pose);
 	void removeCollisionObject(std::string collision_id);
-	void updateWorkcell();
+	// Commit the collected changes in one diff
+	// if return false, move_group did not acknowledge them in time
+	bool updateWorkcell();
+	// Publish transaction in one diff and wait for move_group to apply it
+	bool commitScene(SceneTransaction& transaction, double timeout =
+			SCENE_DEFAULT_TIMEOUT);
+	// Add the objects of an expanded workcell URDF in one diff, links of
+	// robot_description are skipped
+	//  - fn is the URDF file, parameter workcell_description if empty
+	// if return false, the URDF cannot be read or is not acknowledged
+	bool loadWorkcell(std::string fn = "");
+
+// Plan cache related function
+	// Revision of the planning scene: hash of world objects, attached
+	// objects and allowed collision matrix, so it survives restarts and
+	// covers changes made by other nodes
+	// if return false, move_group could not be asked and nothing is cached
+	bool getSceneRevision(uint64_t& revision);
+	// True if every point of motion_plan is valid in the monitored scene,
+	// and if goal is not NULL, its last point satisfies goal
+	// false if the scene is not monitored
+	bool checkMotionPlan(const MotionPlan& motion_plan,
+			const moveit_msgs::Constraints* goal = NULL);
 
 public slots:
 	void addWaypointsCb();
@@ -79,6 +150,9 @@ public slots:
 	void newFeedbackReceived(Feedback* feedback);
 	bool executeMotionPlan();
 	void closeDialogWindow();
+	void toggleServoMode();
+	// Plan the straight line to the interactive marker and execute it
+	void cartesianPathCb();
 	// Send trajectory to plannar object
 	//void sendTrajectory(const TrajectoryGoal& feedback);
 signals:
@@ -86,16 +160,72 @@ signals:
 	void shutdown();
 	// joint state feedback
 	void newFeedback(Feedback* feedback);
-	void visualizeMotionPlan(MotionPlan motion_plan);
-	void sendTrajectorySignal(const MotionPlan& motion_plan);
+	void visualizeMotionPlan(MotionPlanPtr plan);
+	void sendTrajectorySignal(MotionPlanPtr plan);
+	// One segment of a chained trajectory, last for the final segment
+	void appendTrajectorySignal(MotionPlanPtr plan, bool last);
+	void sendCartesianTrajectorySignal(MotionPlanPtr plan);
+	// $VEL_PTP and $ACC_PTP of the next trajectory, in percent, and its
+	// duration predicted by retiming, in seconds
+	void sendSpeedSignal(double velocity_percent, double acceleration_percent,
+			double duration);
+	// The next trajectory is not retimed, see Plannar::resetPTPSpeed
+	void resetSpeedSignal();
 	void changeMotionCompleteDelayTime(double delay_time);
 	void closeWindow();
+	// Asynchronous plan finished, emitted from the planning thread
+	void planFinished(PlanHandle handle);
+	// Servo mode of dtPlannar_
+	void startServoSignal();
+	void stopServoSignal();
+	void servoTargetSignal(Frame target);
+	void servoVelocitySignal(Frame velocity);
+	// Direct PTP motion of dtPlannar_, see Plannar::solveServoToFrame
+	void servoToAxisSignal(Axis target);
+
+private:
+	friend class PlanTask;
+
+	// Submit handle to the planning thread
+	PlanHandle submitPlan(PlanHandle handle);
+	// Wait for handle, then set pdtMotionPlan_ and bPlanSuccess_
+	bool waitForPlan(PlanHandle handle);
+	// Plan handle on the planning thread, then emit planFinished
+	void runPlanRequest(PlanHandle handle);
+	// Plan the goal of request with pdtPlanningMoveGroup_
+	bool planRequest(const PlanRequest& request, MotionPlan& motion_plan);
+	// Plan the straight line of request from start_state with
+	// dtCartesianPlanner_
+	bool planCartesian(robot_state::RobotState& start_state,
+			const PlanRequest& request, MotionPlan& motion_plan);
+	// Plan from start_state to the target set in pdtPlanningMoveGroup_,
+	// described by goal for portfolio planning
+	// if key is not NULL, the cached plan of key is reused when it is still
+	// valid, otherwise the new plan is cached
+	bool planMotion(const robot_state::RobotState& start_state,
+			const moveit_msgs::Constraints& goal, const PlanCache::Key* key,
+			const PlanRequest& request, MotionPlan& motion_plan);
+	// Plan from start_state to goal with pdtPlannerPortfolio_, on a
+	// snapshot of the monitored planning scene
+	bool planPortfolio(const robot_state::RobotState& start_state,
+			const moveit_msgs::Constraints& goal, const PlanRequest& request,
+			MotionPlan& motion_plan);
+	// Record motion_plan as sent to the robot
+	void setExecutingPlan(MotionPlanPtr plan);
+	// Copy of motion_plan retimed by dtRetimer_ for execution, the speed
+	// is sent to dtPlannar_ by sendSpeedSignal
+	// motion_plan itself is returned if retiming is off or fails, and the
+	// speed is reset by resetSpeedSignal
+	MotionPlanPtr retimeMotionPlan(MotionPlanPtr motion_plan);
+	// Twist input of servo mode, called by the ROS spinner thread
+	void servoTwistCb(const geometry_msgs::TwistConstPtr& twist);
 
 public:
 // Motion
 	boost::shared_ptr<moveit::planning_interface::MoveGroup> pdtMoveGroup_;
 	moveit::planning_interface::PlanningSceneInterface dtPlanningSceneInterface_;
-	moveit::planning_interface::MoveGroup::Plan dtMotionPlan_;
+	// Plan executed by executeMotionPlan, NULL if none
+	MotionPlanPtr pdtMotionPlan_;
 	ros::Publisher dtPlanningSceneDiffPublisher_;
 	// Target pose for motion
 	geometry_msgs::Pose dtTargetPose_;
@@ -115,12 +245,49 @@ public:
 // Add or remove collision object
 	geometry_msgs::Pose dtCollisionPose_;
 	shape_msgs::SolidPrimitive dtCollisionShape_;
-	moveit_msgs::CollisionObject dtCollisionObject_;
-	std::vector<std::string> vecstrRemoveCollisionIds_;
-	std::vector<moveit_msgs::CollisionObject> vecdtCollisionObjects_;
+	// Changes not yet committed by updateWorkcell
+	SceneTransaction dtSceneTransaction_;
 
 	QThread *dtPlannarThread_;
 
+// Plan cache
+	PlanCache dtPlanCache_;
+	// File the cache is saved to after every new plan, empty if not saved
+	std::string strPlanCacheFile_;
+	ros::ServiceClient dtGetPlanningSceneClient_;
+	// Scene of move_group, for checkMotionPlan and portfolio planning
+	// NULL if robot_description is invalid
+	planning_scene_monitor::PlanningSceneMonitorPtr pdtPlanningSceneMonitor_;
+
+// Portfolio planning
+	bool bPortfolioPlanning_;
+	boost::shared_ptr<PlannerPortfolio> pdtPlannerPortfolio_;
+
+// Asynchronous planning
+	// MoveGroup used only by the planning thread, move_group serves one
+	// planning goal at a time so the pool has one thread
+	boost::shared_ptr<moveit::planning_interface::MoveGroup> pdtPlanningMoveGroup_;
+	QThreadPool dtPlanningPool_;
+	// Last plan sent to the robot
+	QMutex dtExecutingPlanLock_;
+	MotionPlanPtr pdtExecutingPlan_;
+
+// Cartesian path planning, used only by the planning thread
+	CartesianPlanner dtCartesianPlanner_;
+	// Link of dtCartesianPlanner_ following the path
+	std::string strCartesianTip_;
+	// Latest path of planCartesianMotion, NULL if none or sent already, so
+	// a plan of pdtMotionPlan_ is never sent as LIN motions
+	MotionPlanPtr pdtCartesianMotionPlan_;
+
+// Retiming of plans before execution
+	bool bRetimePlans_;
+	TrajectoryRetimer dtRetimer_;
+
+// Servo mode
+	bool bServoMode_;
+	ros::Subscriber dtServoTwistSubscriber_;
+
 	KukaFeedback dtKukaFeedbackReceiver_;
 	QThread* dtKukaFeedbackThread_;
 	WaitForExecution* pdtSubWindowWaitForExecution_;
@@ -0,0 +1,688 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Micro-benchmarks of the conversion routines used by every feedback and
+ *   calibration step:
+ *       - Model: Axis2Frame, Axis2Frame_flange, Axis2Pos, Frame2Axis (both
+ *         backends), Pos2Axis
+ *       - Model: Axis2FrameBatch of a trajectory of BENCHMARK_BATCH_POINTS
+ *         axes, reported per batch and per point (_per_point)
+ *       - EulerQuaternionConversion: createRotationMatrix, Euler2Quaternion,
+ *         Quaternion2Euler
+ *       - ndi/Conversions: QuatCombineXfrms, QuatInverseXfrm
+ *       - hand-off of a motion plan of BENCHMARK_PLAN_POINTS points through
+ *         a queued signal, which copies every argument with QMetaType: by
+ *         value (MotionPlan) against by shared pointer (MotionPlanPtr)
+ *       - forward kinematics of the URDF chain: KDL against
+ *         FixedKinematics<KR6R700SixxNeedle>
+ *   Implementations of the same conversion are also checked against each
+ *   other on the same inputs, the program fails if a check fails:
+ *       - FixedKinematics against KDL, within BENCHMARK_FK_TOLERANCE
+ *       - Frame2Axis of IK_LMA against IK_ANALYTIC, both should find a
+ *         solution reproducing the Frame within BENCHMARK_IK_TOLERANCE
+ *       - Axis2FrameBatch against Axis2Frame, within BENCHMARK_FK_TOLERANCE
+ *       - Model used by BENCHMARK_THREADS threads at the same time (both IK
+ *         backends) against a single thread, bit by bit
+ *   Inputs are random but the same for every run (fixed seed).
+ *   Each benchmark is repeated until it runs for --benchmark_min_time
+ *   seconds, results are printed as a table, and written as JSON in the
+ *   format of Google Benchmark to --benchmark_out, e.g.
+ *       rosrun robot_driver_interface kinematics_benchmark <urdf>
+ *           --benchmark_out=kinematics.json
+ *   Without <urdf>, the model is read from parameter robot_description.
+ *   Options:
+ *       --benchmark_out=<file>      : JSON output
+ *       --benchmark_min_time=<s>    : minimum time of each benchmark, 0.5
+ *       --benchmark_filter=<text>   : only benchmarks whose name contains text
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <unistd.h>
+
+#include <QMetaType>
+#include <QFuture>
+#include <QtConcurrentRun>
+
+#include "common/geometry.h"
+#include "common/fixedkinematics.h"
+#include "common/motionplan.h"
+#include "common/ikcache.h"
+#include "EulerQuaternionConversion.h"
+#include "ndi/Conversions.h"
+
+#ifndef BENCHMARK_GIT_REVISION
+#define BENCHMARK_GIT_REVISION "unknown"
+#endif
+
+// Seed of random inputs and number of distinct inputs of each benchmark
+#define BENCHMARK_SEED 20160526
+#define BENCHMARK_INPUTS 1024
+// Points of the motion plan handed between threads
+#define BENCHMARK_PLAN_POINTS 1000
+// Axes of the trajectory converted by one Axis2FrameBatch
+#define BENCHMARK_BATCH_POINTS 1000
+// Largest difference of rotation matrix and position (in m) between two
+// forward solvers
+#define BENCHMARK_FK_TOLERANCE 1e-6
+// Largest position (in mm) and angle (in degrees) error of a Frame2Axis
+// solution converted back to Frame
+#define BENCHMARK_IK_TOLERANCE 0.01
+// Threads using Model at the same time
+#define BENCHMARK_THREADS 4
+
+typedef FixedKinematics<KR6R700SixxNeedle> NeedleKinematics;
+typedef moveit::planning_interface::MoveGroup::Plan MotionPlan;
+
+// --------------------------------------------------------------------------
+// Inputs, generated once
+// --------------------------------------------------------------------------
+static Model* model = NULL;
+// Chains of the same URDF, for the KDL solvers themselves
+static boost::shared_ptr<const KinematicDescription> description;
+static std::vector<Axis> axis(BENCHMARK_INPUTS);
+// first BENCHMARK_BATCH_POINTS of axis
+static std::vector<Axis> batch;
+// axis in rad, 6 values each
+static std::vector<double> q(6 * BENCHMARK_INPUTS);
+static std::vector<Frame> frame(BENCHMARK_INPUTS);
+static std::vector<Pos> pos(BENCHMARK_INPUTS);
+static std::vector<Eigen::Vector3d> euler(BENCHMARK_INPUTS);
+static std::vector<Eigen::Vector4d> quaternion(BENCHMARK_INPUTS);
+static std::vector<QuatTransformation> xfrm(BENCHMARK_INPUTS);
+static MotionPlanPtr plan;
+
+// Results are summed here, so that nothing is optimized away
+static volatile double sink = 0.0;
+
+static double uniform(double lower, double upper) {
+	return lower + (upper - lower) * rand() / (double) RAND_MAX;
+}
+
+static void generateInputs() {
+	srand(BENCHMARK_SEED);
+	for (int n = 0; n < BENCHMARK_INPUTS; n++) {
+		axis[n].set(uniform(A1_LOWER, A1_UPPER), uniform(A2_LOWER, A2_UPPER),
+				uniform(A3_LOWER, A3_UPPER), uniform(A4_LOWER, A4_UPPER),
+				uniform(A5_LOWER, A5_UPPER), uniform(A6_LOWER, A6_UPPER));
+		q[6 * n] = axis[n].A1 * M_PI / 180.0;
+		q[6 * n + 1] = axis[n].A2 * M_PI / 180.0;
+		q[6 * n + 2] = axis[n].A3 * M_PI / 180.0;
+		q[6 * n + 3] = axis[n].A4 * M_PI / 180.0;
+		q[6 * n + 4] = axis[n].A5 * M_PI / 180.0;
+		q[6 * n + 5] = axis[n].A6 * M_PI / 180.0;
+		euler[n] << uniform(-M_PI, M_PI), uniform(-M_PI / 2, M_PI / 2), uniform(
+				-M_PI, M_PI);
+		quaternion[n] = Euler2Quaternion(euler[n](0), euler[n](1), euler[n](2));
+		xfrm[n].dtRotation.fQ0 = quaternion[n](3);
+		xfrm[n].dtRotation.fQx = quaternion[n](0);
+		xfrm[n].dtRotation.fQy = quaternion[n](1);
+		xfrm[n].dtRotation.fQz = quaternion[n](2);
+		xfrm[n].dtTranslation.fTx = uniform(-1000.0, 1000.0);
+		xfrm[n].dtTranslation.fTy = uniform(-1000.0, 1000.0);
+		xfrm[n].dtTranslation.fTz = uniform(-1000.0, 1000.0);
+		if (model != NULL) {
+			model->Axis2Frame(axis[n], frame[n]);
+			model->Axis2Pos(axis[n], pos[n]);
+		}
+	}
+	batch.assign(axis.begin(), axis.begin() + BENCHMARK_BATCH_POINTS);
+
+	MotionPlan* p = new MotionPlan;
+	trajectory_msgs::JointTrajectory& trajectory =
+			p->trajectory_.joint_trajectory;
+	for (int k = 1; k <= 6; k++) {
+		std::ostringstream name;
+		name << "joint" << k;
+		trajectory.joint_names.push_back(name.str());
+	}
+	trajectory.points.resize(BENCHMARK_PLAN_POINTS);
+	for (int n = 0; n < BENCHMARK_PLAN_POINTS; n++) {
+		trajectory_msgs::JointTrajectoryPoint& point = trajectory.points[n];
+		for (int k = 0; k < 6; k++) {
+			point.positions.push_back(uniform(-M_PI, M_PI));
+			point.velocities.push_back(uniform(-1.0, 1.0));
+			point.accelerations.push_back(uniform(-1.0, 1.0));
+		}
+		point.time_from_start = ros::Duration(n * 0.01);
+	}
+	plan.reset(p);
+}
+
+// --------------------------------------------------------------------------
+// Benchmarks, each runs iterations times over the inputs
+// --------------------------------------------------------------------------
+static void BM_Model_Axis2Frame(long iterations) {
+	Frame f;
+	for (long i = 0; i < iterations; i++) {
+		model->Axis2Frame(axis[i % BENCHMARK_INPUTS], f);
+		sink += f.X;
+	}
+}
+
+static void BM_Model_Axis2FrameBatch(long iterations) {
+	std::vector<Frame> f;
+	for (long i = 0; i < iterations; i++) {
+		model->Axis2FrameBatch(batch, f);
+		sink += f.back().X;
+	}
+}
+
+static void BM_Model_Axis2Frame_flange(long iterations) {
+	Frame f;
+	for (long i = 0; i < iterations; i++) {
+		model->Axis2Frame_flange(axis[i % BENCHMARK_INPUTS], f);
+		sink += f.X;
+	}
+}
+
+static void BM_Model_Axis2Pos(long iterations) {
+	Pos p;
+	for (long i = 0; i < iterations; i++) {
+		model->Axis2Pos(axis[i % BENCHMARK_INPUTS], p);
+		sink += p.F.X;
+	}
+}
+
+static void frame2Axis(long iterations, Model::IKBackend backend) {
+	Model::IKBackend previous = model->getIKBackend();
+	model->setIKBackend(backend);
+	Axis a_init, a;
+	for (long i = 0; i < iterations; i++) {
+		model->Frame2Axis(a_init, frame[i % BENCHMARK_INPUTS], a);
+		sink += a.A1;
+	}
+	model->setIKBackend(previous);
+}
+
+static void BM_Model_Frame2Axis_LMA(long iterations) {
+	frame2Axis(iterations, Model::IK_LMA);
+}
+
+static void BM_Model_Frame2Axis_Analytic(long iterations) {
+	frame2Axis(iterations, Model::IK_ANALYTIC);
+}
+
+static void BM_Model_Pos2Axis(long iterations) {
+	Axis a_init, a;
+	for (long i = 0; i < iterations; i++) {
+		model->Pos2Axis(a_init, pos[i % BENCHMARK_INPUTS], a);
+		sink += a.A1;
+	}
+}
+
+static void BM_KDL_JntToCart(long iterations) {
+	KDL::ChainFkSolverPos_recursive solver(description->chain_);
+	KDL::JntArray jnt_q(6);
+	KDL::Frame tip;
+	for (long i = 0; i < iterations; i++) {
+		const double* qi = &q[6 * (i % BENCHMARK_INPUTS)];
+		for (int j = 0; j < 6; j++)
+			jnt_q(j) = qi[j];
+		solver.JntToCart(jnt_q, tip);
+		sink += tip.p(0);
+	}
+}
+
+static void BM_FixedKinematics_forward(long iterations) {
+	double R[9], p[3];
+	for (long i = 0; i < iterations; i++) {
+		NeedleKinematics::forward(&q[6 * (i % BENCHMARK_INPUTS)], R, p);
+		sink += p[0];
+	}
+}
+
+static void BM_createRotationMatrix_Euler(long iterations) {
+	for (long i = 0; i < iterations; i++) {
+		const Eigen::Vector3d& e = euler[i % BENCHMARK_INPUTS];
+		sink += createRotationMatrix(e(0), e(1), e(2))(0, 0);
+	}
+}
+
+static void BM_createRotationMatrix_Quaternion(long iterations) {
+	for (long i = 0; i < iterations; i++) {
+		const Eigen::Vector4d& q = quaternion[i % BENCHMARK_INPUTS];
+		sink += createRotationMatrix(q(0), q(1), q(2), q(3))(0, 0);
+	}
+}
+
+static void BM_Euler2Quaternion(long iterations) {
+	for (long i = 0; i < iterations; i++) {
+		const Eigen::Vector3d& e = euler[i % BENCHMARK_INPUTS];
+		sink += Euler2Quaternion(e(0), e(1), e(2))(0);
+	}
+}
+
+static void BM_Quaternion2Euler(long iterations) {
+	for (long i = 0; i < iterations; i++) {
+		const Eigen::Vector4d& q = quaternion[i % BENCHMARK_INPUTS];
+		sink += Quaternion2Euler(q(0), q(1), q(2), q(3))(0);
+	}
+}
+
+static void BM_QuatCombineXfrms(long iterations) {
+	QuatTransformation result;
+	for (long i = 0; i < iterations; i++) {
+		QuatCombineXfrms(&xfrm[i % BENCHMARK_INPUTS],
+				&xfrm[(i + 1) % BENCHMARK_INPUTS], &result);
+		sink += result.dtTranslation.fTx;
+	}
+}
+
+static void BM_QuatInverseXfrm(long iterations) {
+	QuatTransformation result;
+	for (long i = 0; i < iterations; i++) {
+		QuatInverseXfrm(&xfrm[i % BENCHMARK_INPUTS], &result);
+		sink += result.dtTranslation.fTx;
+	}
+}
+
+// A queued signal copies its argument into the event and destroys it after
+// the slot returned
+static void BM_MotionPlan_QueuedByValue(long iterations) {
+	int type = QMetaType::type("MotionPlan");
+	for (long i = 0; i < iterations; i++) {
+		void* argument = QMetaType::construct(type, plan.get());
+		sink += static_cast<MotionPlan*>(argument)->planning_time_;
+		QMetaType::destroy(type, argument);
+	}
+}
+
+static void BM_MotionPlan_QueuedSharedPtr(long iterations) {
+	int type = QMetaType::type("MotionPlanPtr");
+	for (long i = 0; i < iterations; i++) {
+		void* argument = QMetaType::construct(type, &plan);
+		sink += (*static_cast<MotionPlanPtr*>(argument))->planning_time_;
+		QMetaType::destroy(type, argument);
+	}
+}
+
+// --------------------------------------------------------------------------
+// Runner
+// --------------------------------------------------------------------------
+struct Benchmark {
+	enum Requirement {
+		None, ValidModel, AnalyticIK, FixedKinematics
+	};
+	const char* name;
+	void (*function)(long iterations);
+	Requirement requirement;
+	// points converted by each iteration, also reported per point if > 1
+	int points;
+};
+
+struct BenchmarkResult {
+	std::string name;
+	long iterations;
+	// per iteration, in ns
+	double realTime;
+	double cpuTime;
+};
+
+// --------------------------------------------------------------------------
+// Checks, run once over all inputs
+// --------------------------------------------------------------------------
+struct Check {
+	const char* name;
+	// return true if passed, detail is printed either way
+	bool (*function)(std::ostringstream& detail);
+	Benchmark::Requirement requirement;
+};
+
+static bool CHECK_FixedKinematics_KDL(std::ostringstream& detail) {
+	KDL::ChainFkSolverPos_recursive solver(description->chain_);
+	KDL::JntArray jnt_q(6);
+	KDL::Frame tip;
+	double errR = 0.0, errP = 0.0;
+	for (int n = 0; n < BENCHMARK_INPUTS; n++) {
+		for (int j = 0; j < 6; j++)
+			jnt_q(j) = q[6 * n + j];
+		solver.JntToCart(jnt_q, tip);
+		double R[9], p[3];
+		NeedleKinematics::forward(&q[6 * n], R, p);
+		for (int k = 0; k < 9; k++)
+			errR = std::max(errR, fabs(R[k] - tip.M(k / 3, k % 3)));
+		for (int k = 0; k < 3; k++)
+			errP = std::max(errP, fabs(p[k] - tip.p(k)));
+	}
+	detail << "max rotation difference " << errR << ", max position difference "
+			<< errP * 1000.0 << " mm";
+	return errR <= BENCHMARK_FK_TOLERANCE && errP <= BENCHMARK_FK_TOLERANCE;
+}
+
+// Largest difference of position (in mm) and of angles (in degrees, A and C
+// taken modulo 360) between two Frame
+static void frameError(const Frame& f1, const Frame& f2, double& errP,
+		double& errA) {
+	errP = std::max(errP,
+			sqrt((f1.X - f2.X) * (f1.X - f2.X) + (f1.Y - f2.Y) * (f1.Y - f2.Y)
+					+ (f1.Z - f2.Z) * (f1.Z - f2.Z)));
+	double d[3] = { f1.A - f2.A, f1.B - f2.B, f1.C - f2.C };
+	for (int k = 0; k < 3; k++)
+		errA = std::max(errA, fabs(remainder(d[k], 360.0)));
+}
+
+// Every input is reachable, so both backends should solve it, possibly with
+// another Status and Turn than the input
+static bool CHECK_Model_Frame2Axis_LMA_Analytic(std::ostringstream& detail) {
+	Model::IKBackend previous = model->getIKBackend();
+	const Model::IKBackend backend[2] = { Model::IK_LMA, Model::IK_ANALYTIC };
+	const char* name[2] = { "IK_LMA", "IK_ANALYTIC" };
+	bool passed = true;
+	for (int k = 0; k < 2; k++) {
+		model->setIKBackend(backend[k]);
+		int failed = 0, branch = 0;
+		double errP = 0.0, errA = 0.0;
+		Axis a_init;
+		for (int n = 0; n < BENCHMARK_INPUTS; n++) {
+			Axis a;
+			Frame f;
+			Pos p;
+			if (!model->Frame2Axis(a_init, frame[n], a)
+					|| !model->Axis2Frame(a, f) || !model->Axis2Pos(a, p)) {
+				failed++;
+				continue;
+			}
+			frameError(f, frame[n], errP, errA);
+			if (p.S != pos[n].S || p.T != pos[n].T)
+				branch++;
+		}
+		detail << (k == 0 ? "" : "; ") << name[k] << " failed " << failed
+				<< ", max position error " << errP << " mm, max angle error "
+				<< errA << " deg, other Status/Turn " << branch;
+		passed = passed && failed == 0 && errP <= BENCHMARK_IK_TOLERANCE
+				&& errA <= BENCHMARK_IK_TOLERANCE;
+	}
+	model->setIKBackend(previous);
+	return passed;
+}
+
+static bool CHECK_Model_Axis2FrameBatch(std::ostringstream& detail) {
+	std::vector<Frame> f_batch;
+	if (!model->Axis2FrameBatch(axis, f_batch)) {
+		detail << "Axis2FrameBatch failed";
+		return false;
+	}
+	double errP = 0.0, errA = 0.0;
+	for (int n = 0; n < BENCHMARK_INPUTS; n++)
+		frameError(f_batch[n], frame[n], errP, errA);
+	detail << "max position difference " << errP
+			<< " mm, max angle difference " << errA << " deg";
+	return errP <= BENCHMARK_FK_TOLERANCE * 1000.0
+			&& errA <= BENCHMARK_FK_TOLERANCE * 180.0 / M_PI;
+}
+
+// Worker of CHECK_Model_Concurrency, converts every input as the thread
+// that generated them did
+// returns number of results different from those of that thread
+static int concurrencyWorker(const std::vector<Axis>* inverse) {
+	int mismatch = 0;
+	Axis a_init;
+	for (int n = 0; n < BENCHMARK_INPUTS; n++) {
+		Frame f;
+		Pos p;
+		Axis a;
+		model->Axis2Frame(axis[n], f);
+		model->Axis2Pos(axis[n], p);
+		model->Frame2Axis(a_init, frame[n], a);
+
+		// Same code on same input, results should be identical bit by bit
+		const Frame& f_ref = frame[n];
+		if (f.X != f_ref.X || f.Y != f_ref.Y || f.Z != f_ref.Z
+				|| f.A != f_ref.A || f.B != f_ref.B || f.C != f_ref.C)
+			mismatch++;
+		const Pos& p_ref = pos[n];
+		if (p.F.X != p_ref.F.X || p.F.Y != p_ref.F.Y || p.F.Z != p_ref.F.Z
+				|| p.S != p_ref.S || p.T != p_ref.T)
+			mismatch++;
+		const Axis& a_ref = (*inverse)[n];
+		if (a.A1 != a_ref.A1 || a.A2 != a_ref.A2 || a.A3 != a_ref.A3
+				|| a.A4 != a_ref.A4 || a.A5 != a_ref.A5 || a.A6 != a_ref.A6)
+			mismatch++;
+	}
+	return mismatch;
+}
+
+// IKCache is disabled in main, so every thread really runs the solvers
+static bool CHECK_Model_Concurrency(std::ostringstream& detail) {
+	Model::IKBackend previous = model->getIKBackend();
+	int mismatch = 0;
+	for (int k = 0; k < 2; k++) {
+		if (!model->setIKBackend(k == 0 ? Model::IK_LMA : Model::IK_ANALYTIC))
+			continue;
+		std::vector<Axis> inverse(BENCHMARK_INPUTS);
+		Axis a_init;
+		for (int n = 0; n < BENCHMARK_INPUTS; n++)
+			model->Frame2Axis(a_init, frame[n], inverse[n]);
+
+		std::vector<QFuture<int> > futures;
+		for (int i = 0; i < BENCHMARK_THREADS; i++)
+			futures.push_back(QtConcurrent::run(&concurrencyWorker, &inverse));
+		for (int i = 0; i < BENCHMARK_THREADS; i++)
+			mismatch += futures[i].result();
+	}
+	model->setIKBackend(previous);
+	detail << BENCHMARK_THREADS << " threads, " << mismatch
+			<< " results differ from a single thread";
+	return mismatch == 0;
+}
+
+static double seconds(clockid_t clock) {
+	timespec t;
+	clock_gettime(clock, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Increase iterations until the benchmark runs for min_time
+static BenchmarkResult run(const Benchmark& b, double min_time) {
+	BenchmarkResult result;
+	result.name = b.name;
+	long iterations = 1;
+	while (true) {
+		double real = seconds(CLOCK_MONOTONIC);
+		double cpu = seconds(CLOCK_PROCESS_CPUTIME_ID);
+		b.function(iterations);
+		real = seconds(CLOCK_MONOTONIC) - real;
+		cpu = seconds(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+		if (real >= min_time || iterations >= 1000000000L) {
+			result.iterations = iterations;
+			result.realTime = real / iterations * 1e9;
+			result.cpuTime = cpu / iterations * 1e9;
+			return result;
+		}
+		// Aim at 1.4 x min_time, at most 10 x more each time
+		double factor = real > 0.0 ? min_time * 1.4 / real : 10.0;
+		iterations = std::max(iterations + 1,
+				(long) (iterations * std::min(10.0, factor)));
+	}
+}
+
+// If what a benchmark or check requires is there
+static bool available(Benchmark::Requirement requirement, bool analytic,
+		bool fixed) {
+	switch (requirement) {
+	case Benchmark::ValidModel:
+		return model != NULL;
+	case Benchmark::AnalyticIK:
+		return model != NULL && analytic;
+	case Benchmark::FixedKinematics:
+		return model != NULL && fixed;
+	default:
+		return true;
+	}
+}
+
+static bool writeJSON(const std::string& filename, const char* executable,
+		std::vector<BenchmarkResult>& results) {
+	std::ofstream out(filename.c_str());
+	if (!out) {
+		std::cout << "kinematics_benchmark: Cannot open " << filename
+				<< std::endl;
+		return false;
+	}
+	char date[64], host[256];
+	time_t now = time(NULL);
+	strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&now));
+	if (gethostname(host, sizeof(host)) != 0)
+		strcpy(host, "unknown");
+
+	out << "{\n  \"context\": {\n";
+	out << "    \"date\": \"" << date << "\",\n";
+	out << "    \"host_name\": \"" << host << "\",\n";
+	out << "    \"executable\": \"" << executable << "\",\n";
+	out << "    \"num_cpus\": " << sysconf(_SC_NPROCESSORS_ONLN) << ",\n";
+	out << "    \"git_revision\": \"" << BENCHMARK_GIT_REVISION << "\",\n";
+	out << "    \"seed\": " << BENCHMARK_SEED << ",\n";
+	out << "    \"inputs\": " << BENCHMARK_INPUTS << "\n";
+	out << "  },\n  \"benchmarks\": [\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		out << "    {\n";
+		out << "      \"name\": \"" << results[i].name << "\",\n";
+		out << "      \"iterations\": " << results[i].iterations << ",\n";
+		out << "      \"real_time\": " << results[i].realTime << ",\n";
+		out << "      \"cpu_time\": " << results[i].cpuTime << ",\n";
+		out << "      \"time_unit\": \"ns\"\n";
+		out << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n}\n";
+	return out.good();
+}
+
+int main(int argc, char *argv[]) {
+	std::string urdf, out, filter;
+	double min_time = 0.5;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg.find("--benchmark_out=") == 0)
+			out = arg.substr(16);
+		else if (arg.find("--benchmark_min_time=") == 0)
+			min_time = atof(arg.substr(21).c_str());
+		else if (arg.find("--benchmark_filter=") == 0)
+			filter = arg.substr(19);
+		else
+			urdf = arg;
+	}
+
+	// Without URDF argument, Model reads parameter robot_description
+	// Model benchmarks are skipped if URDF is invalid
+	if (urdf.empty())
+		ros::init(argc, argv, "kinematics_benchmark");
+	model = urdf.empty() ? new Model() : new Model(urdf);
+	Frame f;
+	Axis a;
+	bool analytic = false;
+	bool fixed = false;
+	if (!model->Axis2Frame(a, f)) {
+		std::cout << "kinematics_benchmark: Model invalid, skipped"
+				<< std::endl;
+		delete model;
+		model = NULL;
+	} else {
+		description.reset(new KinematicDescription(urdf, ""));
+		fixed = description->fixedValid_;
+		// Measure the solvers, not IKCache
+		model->getIKCache().setCapacity(0);
+		analytic = model->setIKBackend(Model::IK_ANALYTIC);
+		model->setIKBackend(Model::IK_LMA);
+	}
+	qRegisterMetaType<MotionPlan>("MotionPlan");
+	qRegisterMetaType<MotionPlanPtr>("MotionPlanPtr");
+	generateInputs();
+
+	const Benchmark benchmarks[] = {
+			{ "BM_Model_Axis2Frame", BM_Model_Axis2Frame,
+					Benchmark::ValidModel },
+			{ "BM_Model_Axis2FrameBatch", BM_Model_Axis2FrameBatch,
+					Benchmark::ValidModel, BENCHMARK_BATCH_POINTS },
+			{ "BM_Model_Axis2Frame_flange", BM_Model_Axis2Frame_flange,
+					Benchmark::ValidModel },
+			{ "BM_Model_Axis2Pos", BM_Model_Axis2Pos,
+					Benchmark::ValidModel },
+			{ "BM_Model_Frame2Axis_LMA", BM_Model_Frame2Axis_LMA,
+					Benchmark::ValidModel },
+			{ "BM_Model_Frame2Axis_Analytic", BM_Model_Frame2Axis_Analytic,
+					Benchmark::AnalyticIK },
+			{ "BM_Model_Pos2Axis", BM_Model_Pos2Axis,
+					Benchmark::ValidModel },
+			{ "BM_KDL_JntToCart", BM_KDL_JntToCart, Benchmark::ValidModel },
+			{ "BM_FixedKinematics_forward", BM_FixedKinematics_forward,
+					Benchmark::FixedKinematics },
+			{ "BM_createRotationMatrix_Euler", BM_createRotationMatrix_Euler,
+					Benchmark::None },
+			{ "BM_createRotationMatrix_Quaternion",
+					BM_createRotationMatrix_Quaternion, Benchmark::None },
+			{ "BM_Euler2Quaternion", BM_Euler2Quaternion, Benchmark::None },
+			{ "BM_Quaternion2Euler", BM_Quaternion2Euler, Benchmark::None },
+			{ "BM_QuatCombineXfrms", BM_QuatCombineXfrms, Benchmark::None },
+			{ "BM_QuatInverseXfrm", BM_QuatInverseXfrm, Benchmark::None },
+			{ "BM_MotionPlan_QueuedByValue", BM_MotionPlan_QueuedByValue,
+					Benchmark::None },
+			{ "BM_MotionPlan_QueuedSharedPtr", BM_MotionPlan_QueuedSharedPtr,
+					Benchmark::None } };
+
+	const Check checks[] = {
+			{ "CHECK_FixedKinematics_KDL", CHECK_FixedKinematics_KDL,
+					Benchmark::FixedKinematics },
+			{ "CHECK_Model_Frame2Axis_LMA_Analytic",
+					CHECK_Model_Frame2Axis_LMA_Analytic, Benchmark::AnalyticIK },
+			{ "CHECK_Model_Axis2FrameBatch", CHECK_Model_Axis2FrameBatch,
+					Benchmark::ValidModel },
+			{ "CHECK_Model_Concurrency", CHECK_Model_Concurrency,
+					Benchmark::ValidModel } };
+
+	std::vector<BenchmarkResult> results;
+	std::cout << std::left << std::setw(40) << "Benchmark" << std::right
+			<< std::setw(14) << "Time (ns)" << std::setw(14) << "CPU (ns)"
+			<< std::setw(14) << "Iterations" << std::endl;
+	for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+		const Benchmark& b = benchmarks[i];
+		if (!available(b.requirement, analytic, fixed)
+				|| std::string(b.name).find(filter) == std::string::npos)
+			continue;
+		results.push_back(run(b, min_time));
+		if (b.points > 1) {
+			BenchmarkResult point = results.back();
+			point.name += "_per_point";
+			point.iterations *= b.points;
+			point.realTime /= b.points;
+			point.cpuTime /= b.points;
+			results.push_back(point);
+		}
+		for (size_t r = (b.points > 1 ? 2 : 1); r > 0; r--) {
+			const BenchmarkResult& result = results[results.size() - r];
+			std::cout << std::left << std::setw(40) << result.name
+					<< std::right << std::setw(14) << result.realTime
+					<< std::setw(14) << result.cpuTime << std::setw(14)
+					<< result.iterations << std::endl;
+		}
+	}
+
+	int failed = 0;
+	for (size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); i++) {
+		const Check& c = checks[i];
+		if (!available(c.requirement, analytic, fixed)
+				|| std::string(c.name).find(filter) == std::string::npos)
+			continue;
+		std::ostringstream detail;
+		bool passed = c.function(detail);
+		if (!passed)
+			failed++;
+		std::cout << std::left << std::setw(40) << c.name
+				<< (passed ? "passed: " : "FAILED: ") << detail.str()
+				<< std::endl;
+	}
+
+	bool ok = out.empty() || writeJSON(out, argv[0], results);
+	delete model;
+	return ok && failed == 0 ? 0 : 1;
+}
@@ -24,7 +24,8 @@ static int bFirst = 1;
 
  Description:   CommandHandling Constructor
  *****************************************************************/
-CommandHandling::CommandHandling() {
+CommandHandling::CommandHandling() :
+		dtReplyFramer_(pchrLastReply_, sizeof(pchrLastReply_)) {
 	/* set up com port class, start from new. */
 	dtCOMPort_ = new Comm32Port;
 
@@ -40,6 +41,7 @@ CommandHandling::CommandHandling() {
 	strConfigurationFile_ = "/home/lxt12/NDIConfiguration.ini";
 	bClearLogFile_ = false;
 	bDisplayErrorsWhileTracking_ = false;
+	bTimeoutDialog_ = true;
 	nRefHandle_ = -1;
 	nTimeout_ = 3;
 	nDefaultTimeout_ = 10;
@@ -1833,6 +1835,39 @@ int CommandHandling::GetAlerts(bool bNewAlerts) {
 	}
 }
 
+/*****************************************************************
+ Name:				MoveToThread
+
+ Inputs:
+ QThread *pThread - the thread using the serial port from now on
+
+ Return Value:
+ None.
+
+ Description:   This routine hands the serial port over to another
+ thread, it must be called by the thread the port belongs to.
+ *****************************************************************/
+void CommandHandling::MoveToThread(QThread *pThread) {
+	dtCOMPort_->moveToThread(pThread);
+	dtCOMPort_->pdtSerialPort_->moveToThread(pThread);
+} /* MoveToThread */
+
+/*****************************************************************
+ Name:				LogReplyLatency
+
+ Inputs:
+ None.
+
+ Return Value:
+ None.
+
+ Description:   This routine logs the latency histogram of the
+ replies to every command sent so far.
+ *****************************************************************/
+void CommandHandling::LogReplyLatency() {
+	dtReplyFramer_.logLatency();
+} /* LogReplyLatency */
+
 /***********************************************************
  Name: LookupTimeout
 
@@ -1959,6 +1994,7 @@ int CommandHandling::SendMessage(char *Command_, bool bAddCRC) {
 		return bComplete;
 	} /* if */
 	//ROS_INFO("Sending Command: %s", Command_);
+	dtReplyFramer_.begin(*dtCOMPort_->pdtSerialPort_, Command_);
 	for (i = 0; i < strlen(Command_); i++) {
 		if (dtCOMPort_->SerialPutChar(Command_[i]) <= 0) {
 			bComplete = false;
@@ -2003,22 +2039,18 @@ int CommandHandling::GetResponse() {
 	bool bDone = false;
 	int nCount = 0, nRet = 0, nRetry = 0;
 
-	memset(pchrLastReply_, 0, sizeof(pchrLastReply_));
 	/*
 	 * Get the start time that the call was initialized.
 	 */
 	time(&starttime);
 
-	boost::shared_ptr<QSerialPort> serial = this->dtCOMPort_->pdtSerialPort_;
-
 	do {
-		if (serial->waitForReadyRead(nTimeout_ * 1000)) {
-			// read response
-			QByteArray requestData = serial->readAll();
-			while (serial->waitForReadyRead(10))
-				requestData += serial->readAll();
-			//ROS_INFO("Response: %s", requestData.data());
-			strcpy(pchrLastReply_, requestData.data());
+		/*
+		 * the reply is read straight into LastReply_, and returned as
+		 * soon as the carriage return is received.
+		 */
+		if (dtReplyFramer_.read(*dtCOMPort_->pdtSerialPort_, nTimeout_ * 1000)
+				> 0) {
 			bDone = true;
 		} else {
 			nRetry++;
@@ -2026,6 +2058,9 @@ int CommandHandling::GetResponse() {
 				memset(pchrLastReply_, 0, sizeof(pchrLastReply_));
 				// Resending the last command
 				SendMessage(pchrCommand_, false); /* Command already has CRC */
+			} else if (!bTimeoutDialog_) {
+				ROS_ERROR("CommandHandling: Get response timed out");
+				return false;
 			} else {
 				dtSubWindowCOMPortTimeOut_.exec();
 				nRet = dtSubWindowCOMPortTimeOut_.nReturnValue_;
@@ -2162,113 +2197,59 @@ int CommandHandling::GetResponse() {
  all calls except the BX call.
  *****************************************************************/
 int CommandHandling::GetBinaryResponse() {
-	char chChar;
-	time_t currenttime, starttime;
-	bool bDone = false;
-	int nTotalBinaryLength = -1, //initialize it to a number smaller than nCount
-			nCount = 0, nRet = 0, nRetry = 0;
-
-	memset(pchrLastReply_, 0, sizeof(pchrLastReply_));
+	int nRet = 0, nRetry = 0;
 
 	/*
-	 * Get the start time that the call was initialized.
+	 * the reply is read straight into LastReply_, and returned as soon
+	 * as the number of bytes specified in the header is received.
 	 */
-	time(&starttime);
-
-	do {
-		/* Check COM port */
-		if (dtCOMPort_ == NULL) {
+	while (dtReplyFramer_.read(*dtCOMPort_->pdtSerialPort_, nTimeout_ * 1000)
+			<= 0) {
+		/*
+		 * If a COM port timeout is noted, we will try to
+		 * send the command again, up to 3 times.
+		 */
+		if (nRetry < 3) {
+			nRetry++;
+			/*
+			 * Do not clear the Command_ at this point, since
+			 * we are re-sending the same command.
+			 */
+			SendMessage(pchrCommand_, false); /* Command already has CRC */
+		} else if (!bTimeoutDialog_) {
+			ROS_ERROR("Time out when getting binary response ");
 			return false;
-		}/* if */
-
-		while ((dtCOMPort_->SerialCharsAvailable() > 0) && (!bDone)) {
-			chChar = dtCOMPort_->SerialGetChar();
-
-			pchrLastReply_[nCount] = chChar;
-
+		} else {
 			/*
-			 * Get the total length of the buffer
+			 * If a COM port timeout is noted again, the communication
+			 * error seems not recoverable and we will stop sending
+			 * the command and spawns a dialog. The dialog allows
+			 * the user to retry the current command, restart the application
+			 * or close the application.
 			 */
-			if (nCount == 3) {
-				/* + 7 to account for header information */
-				nTotalBinaryLength = GetHex2(&pchrLastReply_[2]) + 7 + 1;
-			}/* if */
-
-			nCount++;
-
-			if (nCount == nTotalBinaryLength) {
-				bDone = TRUE;
-			}/* if */
-		} /* while */
+			dtSubWindowCOMPortTimeOut_.exec();
+			nRet = dtSubWindowCOMPortTimeOut_.nReturnValue_;
 
-		if (!bDone) {
 			/*
-			 * Get the current time and compare with start time
-			 * if longer "timeout" assume no response and timeout
+			 * if the user chooses to retry sending the command
+			 * handle that here.
 			 */
-			time(&currenttime);
-
-			if (difftime(currenttime, starttime) >= nTimeout_) {
-				/*
-				 * If a COM port timeout is noted, we will try to
-				 * send the command again, up to 3 times.
-				 */
-				nCount = 0;
-				if (nRetry < 3) {
-					nRetry++;
-					memset(pchrLastReply_, 0, sizeof(pchrLastReply_));
-
-					/*
-					 * Do not clear the Command_ at this point, since
-					 * we are re-sending the same command.
-					 */
+			if (nRet == ERROR_TIMEOUT_CONT) {
+				if (strlen(pchrCommand_) > 0) {
+					nRetry = 1;
 					SendMessage(pchrCommand_, false); /* Command already has CRC */
-
-					/* Reset the start time. */
-					time(&starttime);
 				} else {
-					/*
-					 * If a COM port timeout is noted again, the communication
-					 * error seems not recoverable and we will stop sending
-					 * the command and spawns a dialog. The dialog allows
-					 * the user to retry the current command, restart the application
-					 * or close the application. You could eliminate this dialog and
-					 * return false from this area and handle the false return
-					 * directly.
-					 */
-					dtSubWindowCOMPortTimeOut_.exec();
-					nRet = dtSubWindowCOMPortTimeOut_.nReturnValue_;
-					memset(pchrLastReply_, 0, sizeof(pchrLastReply_));
-
-					/*
-					 * if the user chooses to retry sending the command
-					 * handle that here.
-					 */
-					if (nRet == ERROR_TIMEOUT_CONT) {
-						if (strlen(pchrCommand_) > 0) {
-							nRetry = 1;
-							memset(pchrLastReply_, 0, sizeof(pchrLastReply_));
-							/*
-							 * Do not clear the Command_ at this point, since
-							 * we are re-sending the same command.
-							 */
-							SendMessage(pchrCommand_, false); /* Command already has CRC */
-							/* Reset the start time. */
-							time(&starttime);
-						} else {
-							dtCOMPort_->SerialBreak();
-						} /* else */
-					} else {
-						ROS_ERROR("Time out when getting binary response ");
-						return false;
-					}/* else */
-				}/* else */
-			}/* if */
-		} /* if */
-	} while (!bDone);
+					dtCOMPort_->SerialBreak();
+				} /* else */
+			} else {
+				ROS_ERROR("Time out when getting binary response ");
+				return false;
+			}/* else */
+		}/* else */
+	} /* while */
 
 	LogToFile(1, pchrLastReply_);
-	return bDone;
+	return true;
 
 } /* GetBinaryResponse */
 
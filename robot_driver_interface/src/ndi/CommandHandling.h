@@ -11,6 +11,7 @@
 #include "Comm32Port.h"
 #include "ndi/COMPortTimeOut.h"
 #include "APIStructures.h"
+#include "common/replyframer.h"
 
 class CommandHandling {
 public:
@@ -44,6 +45,8 @@ public:
 	int GetBXTransforms(bool ReportOOV);
 	int StopTracking();
 	int GetAlerts(bool NewAlerts);
+	void MoveToThread(QThread *pThread);
+	void LogReplyLatency();
 
 	void ErrorMessage();
 	void WarningMessage();
@@ -77,6 +80,7 @@ public:
 	CIniFile dtErrorIniFile_;
 	std::string strConfigurationFile_;
 	COMPortTimeOut dtSubWindowCOMPortTimeOut_;
+	bool bTimeoutDialog_; /* ask the user on a COM port timeout, false out of the GUI thread */
 protected:
 	/*****************************************************************
 	 Routine Definitions
@@ -108,6 +112,7 @@ protected:
 
 	char pchrLastReply_[MAX_REPLY_MSG], /* Last reply received from the system */
 	pchrCommand_[MAX_COMMAND_MSG]; /* command to send to the system */
+	ReplyFramer dtReplyFramer_; /* reads the replies into LastReply_ */
 	bool bClearLogFile_, /* clear log file on intialization */
 	bDisplayErrorsWhileTracking_; /* display the error while tracking */
 	int nTimeout_, nDefaultTimeout_; /* timeout value in seconds */
@@ -0,0 +1,42 @@
+/**
+ *   Copyright (C) Tsinghua University 2016
+ *
+ *   Version   : 2.0
+ *   Date      : 2016
+ *   Author    : Xingtong Liu
+ *   Company   : Tsinghua University
+ *   Email     : 327586708@qq.com
+ *
+ *   Offline generation of ReachabilityMap, run again whenever the URDF
+ *   (e.g. the tool) changes:
+ *       rosrun robot_driver_interface reachability_map <urdf> <map file>
+ *           [voxel in mm] [samples]
+ *   Load the result in KRC4_control_async with ROS parameter
+ *   ~reachability_map set to <map file>.
+ *
+ */
+
+#include <cstdlib>
+
+#include "common/reachmap.h"
+
+int main(int argc, char *argv[]) {
+	if (argc < 3) {
+		std::cout << "Usage: " << argv[0]
+				<< " <urdf> <map file> [voxel in mm] [samples]" << std::endl;
+		return 1;
+	}
+	double voxel = argc > 3 ? atof(argv[3]) : REACHMAP_DEFAULT_VOXEL;
+	uint64_t samples =
+			argc > 4 ? strtoull(argv[4], NULL, 10) : REACHMAP_DEFAULT_SAMPLES;
+
+	Model model(argv[1]);
+	if (!ReachabilityMap::generate(model, argv[2], voxel, samples))
+		return 1;
+
+	// Check the file is accepted
+	ReachabilityMap map;
+	if (!map.load(argv[2], model.getURDFHash()))
+		return 1;
+	return 0;
+}